@@ -930,7 +930,11 @@ static void run_state_machine (struct state_CTX *ctx)
   while (1)
   {
     ETP_state old_state = ctx->state;
-    BOOL      rc = (*ctx->state) (ctx);
+    BOOL      rc;
+
+    TRACE_BEGIN ("ETP", ETP_state_name(old_state));
+    rc = (*ctx->state) (ctx);
+    TRACE_END ("ETP");
 
     if (opt.debug >= 2)
     {
@@ -0,0 +1,182 @@
+/**\file    arena.c
+ * \ingroup Misc
+ * \brief
+ *   A bump-pointer allocator with mark / reset scopes.
+ *
+ * The reporting of each match used to \c MALLOC() and \c FREE() a few small
+ * strings. With an arena, these are carved out of a chunk by advancing a
+ * pointer. A caller takes a \c arena_mark() before a unit of work (e.g.
+ * a directory) and does a \c arena_reset() after it. The chunks are kept
+ * and reused for the next unit. So in the steady state there are no
+ * heap allocations at all.
+ */
+#include "envtool.h"
+#include "arena.h"
+
+/*
+ * All allocations are aligned to this.
+ */
+#define ARENA_ALIGN  sizeof(void*)
+
+/*
+ * The default size of a chunk.
+ */
+#define ARENA_DEFAULT_CHUNK  (16*1024)
+
+/**\struct arena_chunk
+ * The header of a chunk. The data follows.
+ */
+struct arena_chunk {
+       struct arena_chunk *next;   /** the next chunk; may be unused after a reset */
+       size_t              size;   /** the size of the data */
+       size_t              used;   /** how much of the data is allocated */
+     };
+
+/**\struct arena_t
+ */
+struct arena_t {
+       struct arena_chunk *first;       /** the first chunk */
+       struct arena_chunk *cur;         /** the chunk allocations come from */
+       size_t              chunk_size;  /** the size of new chunks */
+       size_t              num_allocs;  /** # of arena_alloc() */
+       size_t              num_resets;  /** # of arena_reset() */
+       UINT64              bytes;       /** total bytes given out */
+     };
+
+#define CHUNK_DATA(c)  ((BYTE*) ((c) + 1))
+
+static struct arena_chunk *chunk_new (size_t size)
+{
+  struct arena_chunk *c = MALLOC (sizeof(*c) + size);
+
+  c->next = NULL;
+  c->size = size;
+  c->used = 0;
+  return (c);
+}
+
+/*
+ * Create an arena with chunks of 'chunk_size' bytes.
+ * Use 0 for the default.
+ */
+arena_t *arena_new (size_t chunk_size)
+{
+  arena_t *a = CALLOC (1, sizeof(*a));
+
+  a->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+  a->first = a->cur = chunk_new (a->chunk_size);
+  return (a);
+}
+
+/*
+ * Free the arena 'a' and all its chunks.
+ * Any pointers returned from it are invalid after this.
+ */
+void arena_free (arena_t *a)
+{
+  struct arena_chunk *c, *next;
+
+  if (!a)
+     return;
+
+  for (c = a->first; c; c = next)
+  {
+    next = c->next;
+    FREE (c);
+  }
+  mem_arena_count (a->num_allocs, a->num_resets, a->bytes);
+  FREE (a);
+}
+
+/*
+ * Return 'size' bytes from the arena 'a'. Never returns NULL.
+ * If the current chunk is full, use the next free chunk (left by an
+ * 'arena_reset()') or add a new chunk.
+ */
+void *arena_alloc (arena_t *a, size_t size)
+{
+  struct arena_chunk *c = a->cur;
+  void  *p;
+
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  while (c->used + size > c->size)
+  {
+    if (!c->next)
+    {
+      c->next = chunk_new (max(size, a->chunk_size));
+      c = c->next;
+      break;
+    }
+    c = c->next;
+    c->used = 0;
+  }
+
+  a->cur = c;
+  p = CHUNK_DATA(c) + c->used;
+  c->used += size;
+  a->num_allocs++;
+  a->bytes += size;
+  return (p);
+}
+
+/*
+ * As above, but zero the memory.
+ */
+void *arena_calloc (arena_t *a, size_t size)
+{
+  return memset (arena_alloc(a, size), '\0', size);
+}
+
+/*
+ * Copy 'len' characters of 'str' into the arena and 0-terminate it.
+ */
+char *arena_strndup (arena_t *a, const char *str, size_t len)
+{
+  char *p = arena_alloc (a, len + 1);
+
+  memcpy (p, str, len);
+  p [len] = '\0';
+  return (p);
+}
+
+/*
+ * A 'strdup()' into the arena.
+ */
+char *arena_strdup (arena_t *a, const char *str)
+{
+  return arena_strndup (a, str, strlen(str));
+}
+
+/*
+ * As 'dirname()', but the result is in the arena.
+ */
+char *arena_dirname (arena_t *a, const char *fname)
+{
+  size_t size = strlen (fname) + 3;   /* room for "x:." */
+
+  return dirname_buf (fname, arena_alloc(a, size), size);
+}
+
+/*
+ * Return the current position in 'a'.
+ */
+arena_mark_t arena_mark (const arena_t *a)
+{
+  arena_mark_t mark;
+
+  mark.chunk = a->cur;
+  mark.used  = a->cur->used;
+  return (mark);
+}
+
+/*
+ * Release everything allocated from 'a' since 'mark' was taken.
+ * The chunks are kept for reuse.
+ */
+void arena_reset (arena_t *a, arena_mark_t mark)
+{
+  a->cur = mark.chunk;
+  a->cur->used = mark.used;
+  a->num_resets++;
+}
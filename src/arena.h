@@ -0,0 +1,34 @@
+/** \file arena.h
+ */
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/**\typedef arena_t
+ * A bump-pointer allocator for short-lived strings and structs.
+ * The memory is taken from a list of large chunks and is given back all at
+ * once with \c arena_reset() or \c arena_free(). There is no per-block free.
+ *
+ * An arena is not thread-safe; use one per thread.
+ */
+typedef struct arena_t arena_t;  /* Opaque struct; defined in arena.c */
+
+/**\typedef arena_mark_t
+ * A position in an arena returned by \c arena_mark(). All allocations
+ * done after it are released by \c arena_reset().
+ */
+typedef struct arena_mark_t {
+        struct arena_chunk *chunk;
+        size_t              used;
+      } arena_mark_t;
+
+arena_t     *arena_new (size_t chunk_size);
+void         arena_free (arena_t *a);
+void        *arena_alloc (arena_t *a, size_t size);
+void        *arena_calloc (arena_t *a, size_t size);
+char        *arena_strdup (arena_t *a, const char *str);
+char        *arena_strndup (arena_t *a, const char *str, size_t len);
+char        *arena_dirname (arena_t *a, const char *fname);
+arena_mark_t arena_mark (const arena_t *a);
+void         arena_reset (arena_t *a, arena_mark_t mark);
+
+#endif
@@ -133,6 +133,31 @@ static const struct login_info *common_lookup (const char *host, BOOL is_netrc)
   return (NULL);
 }
 
+/*
+ * Split the 'len' bytes at 'line' in-place into at most 'max' words
+ * separated by blanks. Each word is 0-terminated. There's no limit on
+ * the length of a word.
+ * Returns the number of words.
+ */
+static int split_words (char *line, size_t len, char **words, int max)
+{
+  char *p = line, *end = line + len;
+  int   num = 0;
+
+  while (num < max)
+  {
+    while (p < end && isspace((int)*p))
+       p++;
+    if (p >= end)
+       break;
+    words [num++] = p;
+    while (p < end && !isspace((int)*p))
+       p++;
+    *p++ = '\0';    /* 'line[len]' is the 0-terminator */
+  }
+  return (num);
+}
+
 /*
  * Parse a line from '~/.netrc'. Match lines like:
  *   machine <host> login <user> password <password>
@@ -141,28 +166,25 @@ static const struct login_info *common_lookup (const char *host, BOOL is_netrc)
  *
  * And add to the 'login_list' smartlist.
  */
-static void netrc_parse (smartlist_t *sl, const char *line)
+static void netrc_parse (smartlist_t *sl, char *line, size_t len)
 {
   struct login_info *li = NULL;
-  char   host [256];
-  char   user [50];
-  char   passw[50];
-  const char *fmt1 = "machine %256s login %50s password %50s";
-  const char *fmt2 = "default login %50s password %50s";
+  char  *w [6];
+  int    num = split_words (line, len, w, DIM(w));
 
-  if (sscanf(line, fmt1, host, user, passw) == 3)
+  if (num == 6 && !strcmp(w[0],"machine") && !strcmp(w[2],"login") && !strcmp(w[4],"password"))
   {
     li = CALLOC (1, sizeof(*li));
-    li->host     = STRDUP (host);
-    li->user     = STRDUP (user);
-    li->passw    = STRDUP (passw);
+    li->host     = STRDUP (w[1]);
+    li->user     = STRDUP (w[3]);
+    li->passw    = STRDUP (w[5]);
     li->is_netrc = TRUE;
   }
-  else if (sscanf(line, fmt2, user, passw) == 2)
+  else if (num >= 5 && !strcmp(w[0],"default") && !strcmp(w[1],"login") && !strcmp(w[3],"password"))
   {
     li = CALLOC (1, sizeof(*li));
-    li->user       = STRDUP (user);
-    li->passw      = STRDUP (passw);
+    li->user       = STRDUP (w[2]);
+    li->passw      = STRDUP (w[4]);
     li->is_default = TRUE;
     li->is_netrc   = TRUE;
   }
@@ -178,30 +200,30 @@ static void netrc_parse (smartlist_t *sl, const char *line)
  *
  * And add to the 'login_list' smartlist.
  */
-static void authinfo_parse (smartlist_t *sl, const char *line)
+static void authinfo_parse (smartlist_t *sl, char *line, size_t len)
 {
   struct login_info *li = NULL;
-  char   host [256];
-  char   user [50];
-  char   passw[50];
-  int    port = 0;
-  const char *fmt1 = "machine %256s port %d login %50s password %50s";
-  const char *fmt2 = "default port %d login %50s password %50s";
-
-  if (sscanf(line, fmt1, host, &port, user, passw) == 4 && port > 0 && port < USHRT_MAX)
+  char  *w [8];
+  int    port, num = split_words (line, len, w, DIM(w));
+
+  if (num == 8 && !strcmp(w[0],"machine") && !strcmp(w[2],"port") &&
+      !strcmp(w[4],"login") && !strcmp(w[6],"password") &&
+      (port = atoi(w[3])) > 0 && port < USHRT_MAX)
   {
     li = CALLOC (1, sizeof(*li));
-    li->host     = STRDUP (host);
-    li->user     = STRDUP (user);
-    li->passw    = STRDUP (passw);
+    li->host     = STRDUP (w[1]);
+    li->user     = STRDUP (w[5]);
+    li->passw    = STRDUP (w[7]);
     li->port     = port;
     li->is_netrc = FALSE;
   }
-  else if (sscanf(line, fmt2, &port, user, passw) == 3 && port > 0 && port < USHRT_MAX)
+  else if (num >= 7 && !strcmp(w[0],"default") && !strcmp(w[1],"port") &&
+           !strcmp(w[3],"login") && !strcmp(w[5],"password") &&
+           (port = atoi(w[2])) > 0 && port < USHRT_MAX)
   {
     li = CALLOC (1, sizeof(*li));
-    li->user       = STRDUP (user);
-    li->passw      = STRDUP (passw);
+    li->user       = STRDUP (w[4]);
+    li->passw      = STRDUP (w[6]);
     li->port       = port;
     li->is_default = TRUE;
     li->is_netrc   = FALSE;
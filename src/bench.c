@@ -0,0 +1,363 @@
+/**\file    bench.c
+ * \ingroup Misc
+ * \brief
+ *   Micro-benchmarks for the functions on the hot paths of envtool.
+ *
+ * Each kernel is run over a generated corpus until one run takes at least
+ * \c BENCH_MIN_NSEC. The time, the number of heap allocations and the
+ * bytes allocated per operation are collected and written as JSON by
+ * \c bench_exit(). So the numbers from two builds can be compared by a
+ * script.
+ *
+ * Used by option \c "--bench[=file]". The kernels that need the
+ * \c dir_array are in envtool.c.
+ */
+#include <errno.h>
+
+#include "envtool.h"
+#include "smartlist.h"
+#include "regex.h"
+#include "ignore.h"
+#include "bench.h"
+
+/**
+ * The minimum time of the measured run of a kernel.
+ */
+#define BENCH_MIN_NSEC  ((UINT64)200 * 1000 * 1000)
+
+/**
+ * The number of elements in the generated corpus.
+ */
+#define BENCH_CORPUS    1000
+
+/**\struct bench_result
+ */
+struct bench_result {
+       const char *name;    /** name of the kernel */
+       UINT64      ops;     /** # of operations in the measured run */
+       UINT64      nsec;    /** time of the measured run */
+       UINT64      allocs;  /** # of heap allocations in the measured run */
+       UINT64      bytes;   /** bytes allocated in the measured run */
+     };
+
+/**\struct bench_corpus
+ * The data shared by the kernels in this file.
+ */
+struct bench_corpus {
+       smartlist_t *paths;     /** generated path-names */
+       smartlist_t *names;     /** the file-name part of 'paths' */
+       smartlist_t *sorted;    /** the list sorted by 'bench_sort()' etc. */
+       smartlist_t *lookup;    /** 'names' sorted for 'smartlist_bsearch()' */
+       time_t      *times;     /** time-stamps for 'get_time_str()' */
+       regex_t      re;        /** for 'regexec()' */
+       char         buf [_MAX_PATH];
+     };
+
+static smartlist_t *bench_results;
+static BOOL         bench_alloc_tracked;
+
+/**
+ * Some typical \c "<file-spec>" patterns.
+ */
+static const char *bench_patterns[] = {
+                  "*.dll", "file_0*.h", "*.[ch]", "*lib*", "file_?????.exe", "*"
+                };
+
+/*
+ * Make a smartlist of 'num' paths from 'make_test_paths()'.
+ */
+smartlist_t *bench_make_paths (int num)
+{
+  smartlist_t *sl = smartlist_new();
+  char       **paths = make_test_paths (num);
+  int          i;
+
+  for (i = 0; i < num; i++)
+      smartlist_add (sl, paths[i]);
+  FREE (paths);
+  return (sl);
+}
+
+/*
+ * Run 'iter' operations of 'func'.
+ */
+static void bench_loop (bench_func func, void *arg, UINT64 iter, int corpus_size)
+{
+  UINT64 i;
+  int    idx = 0;
+
+  for (i = 0; i < iter; i++)
+  {
+    (*func) (arg, idx);
+    if (++idx == corpus_size)
+       idx = 0;
+  }
+}
+
+void bench_init (void)
+{
+  bench_results = smartlist_new();
+}
+
+/*
+ * Run the kernel 'func' with 1, 2, 4 ... times 'corpus_size' operations until
+ * a run takes at least 'BENCH_MIN_NSEC'. The shorter runs are the warm-up.
+ * Record the result of the last run.
+ */
+void bench_run (const char *name, bench_func func, void *arg, int corpus_size)
+{
+  struct bench_result *res = CALLOC (1, sizeof(*res));
+  UINT64 iter, start, allocs, bytes;
+
+  for (iter = corpus_size; ; iter *= 2)
+  {
+    bench_alloc_tracked = mem_get_counters (&allocs, &bytes);
+    start = get_time_ns();
+    bench_loop (func, arg, iter, corpus_size);
+    res->nsec = get_time_ns() - start;
+    if (res->nsec >= BENCH_MIN_NSEC || halt_flag)
+       break;
+  }
+
+  mem_get_counters (&res->allocs, &res->bytes);
+  res->allocs -= allocs;
+  res->bytes  -= bytes;
+  res->ops     = iter;
+  res->name    = name;
+  smartlist_add (bench_results, res);
+
+  DEBUGF (1, "%-20s %10" U64_FMT " ops, %.1f ns/op.\n",
+          name, res->ops, (double)res->nsec / (double)res->ops);
+}
+
+static void bench_fnmatch (void *arg, int idx)
+{
+  const struct bench_corpus *c = arg;
+
+  fnmatch (bench_patterns [idx % DIM(bench_patterns)], smartlist_get(c->names, idx), FNM_FLAG_NOCASE);
+}
+
+static void bench_regexec (void *arg, int idx)
+{
+  const struct bench_corpus *c = arg;
+  regmatch_t matches [3];
+
+  regexec (&c->re, smartlist_get(c->names, idx), DIM(matches), matches, 0);
+}
+
+static void bench_translate (void *arg, int idx)
+{
+  translate_shell_pattern (bench_patterns [idx % DIM(bench_patterns)]);
+  ARGSUSED (arg);
+}
+
+static int bench_compare (const void **a, const void **b)
+{
+  return stricmp (*(const char**)a, *(const char**)b);
+}
+
+static int bench_compare_key (const void *key, const void **member)
+{
+  return stricmp ((const char*)key, *(const char**)member);
+}
+
+static const char *bench_sort_key (const void *elem, int *group)
+{
+  ARGSUSED (group);
+  return (const char*) elem;
+}
+
+/*
+ * Put the elements of 'sorted' back in the order of 'paths'.
+ */
+static void bench_unsort (struct bench_corpus *c)
+{
+  int i, max = smartlist_len (c->paths);
+
+  for (i = 0; i < max; i++)
+      smartlist_set (c->sorted, i, smartlist_get(c->paths, i));
+}
+
+static void bench_sort (void *arg, int idx)
+{
+  struct bench_corpus *c = arg;
+
+  bench_unsort (c);
+  smartlist_sort (c->sorted, bench_compare);
+  ARGSUSED (idx);
+}
+
+static void bench_sort_str (void *arg, int idx)
+{
+  struct bench_corpus *c = arg;
+
+  bench_unsort (c);
+  smartlist_sort_str (c->sorted, bench_sort_key, STR_SORT_NOCASE);
+  ARGSUSED (idx);
+}
+
+static void bench_bsearch (void *arg, int idx)
+{
+  const struct bench_corpus *c = arg;
+
+  smartlist_bsearch (c->lookup, smartlist_get(c->names, idx), bench_compare_key);
+}
+
+static void bench_ignore (void *arg, int idx)
+{
+  const struct bench_corpus *c = arg;
+
+  cfg_ignore_lookup ("[PE-resources]", smartlist_get(c->names, idx));
+}
+
+static void bench_slashify (void *arg, int idx)
+{
+  struct bench_corpus *c = arg;
+
+  slashify2 (c->buf, smartlist_get(c->paths, idx), '/');
+}
+
+static void bench_time_str (void *arg, int idx)
+{
+  const struct bench_corpus *c = arg;
+
+  get_time_str (c->times[idx]);
+}
+
+/*
+ * Load a config-file with every 10th name in the "[PE-resources]" section.
+ * This replaces the ignore-list from "%APPDATA%\\envtool.cfg".
+ */
+static BOOL bench_ignore_init (const struct bench_corpus *c)
+{
+  char *tmp = create_temp_file();
+  FILE *f;
+  int   i;
+
+  if (!tmp)
+     return (FALSE);
+
+  f = fopen (tmp, "w");
+  if (!f)
+  {
+    FREE (tmp);
+    return (FALSE);
+  }
+
+  fputs ("[PE-resources]\n", f);
+  for (i = 0; i < BENCH_CORPUS; i += 10)
+      fprintf (f, "ignore = %s\n", (const char*)smartlist_get(c->names, i));
+  fclose (f);
+
+  cfg_ignore_exit();
+  cfg_ignore_init (tmp);
+  unlink (tmp);
+  FREE (tmp);
+  return (TRUE);
+}
+
+/*
+ * Run all the kernels in this file.
+ */
+void bench_kernels (void)
+{
+  struct bench_corpus c;
+  int    i;
+
+  memset (&c, '\0', sizeof(c));
+  c.paths  = bench_make_paths (BENCH_CORPUS);
+  c.names  = smartlist_new();
+  c.sorted = smartlist_new();
+  c.lookup = smartlist_new();
+  c.times  = MALLOC (BENCH_CORPUS * sizeof(time_t));
+
+  for (i = 0; i < BENCH_CORPUS; i++)
+  {
+    char *path = smartlist_get (c.paths, i);
+
+    smartlist_add (c.names, basename(path));
+    smartlist_add (c.sorted, path);
+    smartlist_add (c.lookup, basename(path));
+    c.times[i] = 946684800 + i * 987654;    /* from year 2000 */
+  }
+  smartlist_sort (c.lookup, bench_compare);
+
+  bench_run ("fnmatch", bench_fnmatch, &c, BENCH_CORPUS);
+
+  if (regcomp(&c.re, translate_shell_pattern("file_0*.dll"), REG_ICASE) == 0)
+  {
+    bench_run ("regexec", bench_regexec, &c, BENCH_CORPUS);
+    regfree (&c.re);
+  }
+
+  bench_run ("translate_shell_pattern", bench_translate, &c, DIM(bench_patterns));
+  bench_run ("smartlist_sort", bench_sort, &c, 1);
+  bench_run ("smartlist_sort_str", bench_sort_str, &c, 1);
+  bench_run ("smartlist_bsearch", bench_bsearch, &c, BENCH_CORPUS);
+
+  if (bench_ignore_init(&c))
+     bench_run ("cfg_ignore_lookup", bench_ignore, &c, BENCH_CORPUS);
+
+  bench_run ("slashify2", bench_slashify, &c, BENCH_CORPUS);
+  bench_run ("get_time_str", bench_time_str, &c, BENCH_CORPUS);
+
+  smartlist_free_all (c.paths);
+  smartlist_free (c.names);
+  smartlist_free (c.sorted);
+  smartlist_free (c.lookup);
+  FREE (c.times);
+}
+
+/*
+ * Write the results as JSON to 'json_file' or to 'stdout' if it's NULL.
+ * When written to a file, show a table of them too.
+ */
+int bench_exit (const char *json_file)
+{
+  FILE *f = stdout;
+  int   i, max = smartlist_len (bench_results);
+
+  if (json_file)
+  {
+    f = fopen (json_file, "wt");
+    if (!f)
+    {
+      WARN ("Failed to create \"%s\"; %s.\n", json_file, strerror(errno));
+      smartlist_free_all (bench_results);
+      return (1);
+    }
+  }
+
+  fprintf (f, "{\n"
+              "  \"program\": \"envtool\",\n"
+              "  \"version\": \"%s\",\n"
+              "  \"compiler\": \"%s\",\n"
+              "  \"allocs_tracked\": %s,\n"
+              "  \"benchmarks\": [\n",
+           VER_STRING, compiler_version(), bench_alloc_tracked ? "true" : "false");
+
+  for (i = 0; i < max; i++)
+  {
+    const struct bench_result *res = smartlist_get (bench_results, i);
+    double ops = (double) res->ops;
+
+    fprintf (f, "    { \"name\": \"%s\", \"ops\": %" U64_FMT ", \"ns_per_op\": %.2f, "
+                "\"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f }%s\n",
+             res->name, res->ops, (double)res->nsec / ops,
+             (double)res->allocs / ops, (double)res->bytes / ops, i < max-1 ? "," : "");
+
+    if (json_file)
+       C_printf ("  %-25s %12.2f ns/op %8.3f allocs/op %10.1f bytes/op\n",
+                 res->name, (double)res->nsec / ops,
+                 (double)res->allocs / ops, (double)res->bytes / ops);
+  }
+  fputs ("  ]\n}\n", f);
+
+  if (json_file)
+     fclose (f);
+  else fflush (f);
+
+  smartlist_free_all (bench_results);
+  bench_results = NULL;
+  return (0);
+}
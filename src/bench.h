@@ -0,0 +1,18 @@
+/** \file bench.h
+ */
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/**\typedef bench_func
+ * One operation of a benchmark kernel. \c idx is the corpus element to
+ * use; it cycles through \c 0 .. \c corpus_size-1.
+ */
+typedef void (*bench_func) (void *arg, int idx);
+
+extern void         bench_init (void);
+extern void         bench_run (const char *name, bench_func func, void *arg, int corpus_size);
+extern void         bench_kernels (void);
+extern int          bench_exit (const char *json_file);
+extern smartlist_t *bench_make_paths (int num);
+
+#endif /* _BENCH_H */
@@ -0,0 +1,364 @@
+/**\file    cache.c
+ * \ingroup Misc
+ * \brief
+ *   A persistent cache for results that are expensive to get.
+ *   E.g. the version, \c sys.path[] etc. of a Python interpreter which
+ *   otherwise requires spawning the program.
+ *
+ * Each value is stored under a \c section, a \c file and a \c key.
+ * Together with the value, the size and modification-time of \c file
+ * is stored. A value is only returned by \c cache_get() if the \c file
+ * still has the same size and modification-time.
+ *
+ * The cache is loaded on first use and written to \c "%TEMP%\envtool-probe.cache"
+ * in \c cache_exit() if anything was changed. The format is one
+ * tab-separated record per line:
+ * \code
+ *   section  file  size  mtime  key  value
+ * \endcode
+ */
+#include <errno.h>
+
+#include "envtool.h"
+#include "smartlist.h"
+#include "cache.h"
+
+/**\struct cache_node
+ * One record in the cache.
+ */
+struct cache_node {
+       enum cache_sections section;  /** which section */
+       char               *file;     /** the file the value was derived from */
+       char               *key;      /** the name of the value */
+       char               *value;    /** the value itself */
+       UINT64              size;     /** the size of \c file when \c value was stored */
+       time_t              mtime;    /** the modification time of \c file ditto */
+     };
+
+/**
+ * The names of the sections written to the cache-file.
+ */
+static const char *section_names [SECTION_LAST] = {
+                  "python",
+                  "compiler",
+                  "trust",
+                  "version"
+                };
+
+static smartlist_t     *cache_nodes = NULL;  /**< sorted on section, file and key */
+static char            *cache_fname = NULL;
+static BOOL             cache_dirty = FALSE;
+static CRITICAL_SECTION cache_crit;
+
+/**
+ * 0: not loaded, 1: being loaded by \c cache_init(), 2: loaded.
+ */
+static volatile LONG    cache_state = 0;
+
+/**
+ * Compare a \c cache_node and a \c key for \c smartlist_bsearch_idx().
+ * Files are compared case-insensitively.
+ */
+static int cache_compare (const void *_key, const void **_member)
+{
+  const struct cache_node *key = (const struct cache_node*) _key;
+  const struct cache_node *m   = *(const struct cache_node**) _member;
+  int   rc;
+
+  if (key->section != m->section)
+     return (key->section < m->section ? -1 : 1);
+  rc = stricmp (key->file, m->file);
+  if (rc)
+     return (rc);
+  return strcmp (key->key, m->key);
+}
+
+static int cache_sort (const void **_a, const void **_b)
+{
+  return cache_compare (*_a, _b);
+}
+
+static void cache_free_node (void *e)
+{
+  struct cache_node *c = (struct cache_node*) e;
+
+  FREE (c->file);
+  FREE (c->key);
+  FREE (c->value);
+  FREE (c);
+}
+
+/**
+ * Get the size and modification-time of \c file.
+ */
+static BOOL cache_stamp (const char *file, UINT64 *size, time_t *mtime)
+{
+  struct stat st;
+
+  if (stat(file, &st) != 0)
+     return (FALSE);
+  *size  = (UINT64) st.st_size;
+  *mtime = st.st_mtime;
+  return (TRUE);
+}
+
+/**
+ * Split off the next tab-separated field in \c *line (which ends at \c end).
+ */
+static char *cache_field (char **line, const char *end)
+{
+  char *start = *line;
+  char *tab;
+
+  if (!start)
+     return (NULL);
+  tab = memchr (start, '\t', end - start);
+  if (tab)
+  {
+    *tab++ = '\0';
+    *line = tab;
+  }
+  else
+    *line = NULL;
+  return (start);
+}
+
+/**
+ * Parse one line from the cache-file and add it to \c cache_nodes.
+ * Called from \c file_read_lines() with the newline already cut off.
+ */
+static void cache_parse (char *line, size_t len, void *arg)
+{
+  struct cache_node *c;
+  char  *section, *file, *size, *mtime, *key, *value;
+  const char *end;
+  UINT64 fsize;
+  INT64  ftime;
+  int    i;
+
+  ARGSUSED (arg);
+  if (len == 0 || line[0] == '#')
+     return;
+
+  end     = line + len;
+  section = cache_field (&line, end);
+  file    = cache_field (&line, end);
+  size    = cache_field (&line, end);
+  mtime   = cache_field (&line, end);
+  key     = cache_field (&line, end);
+  value   = line;
+  if (!value ||
+      sscanf(size, "%" U64_FMT, &fsize) != 1 ||
+      sscanf(mtime, "%" S64_FMT, &ftime) != 1)
+     return;
+
+  for (i = 0; i < SECTION_LAST; i++)
+      if (!strcmp(section, section_names[i]))
+         break;
+  if (i == SECTION_LAST)
+     return;
+
+  c = CALLOC (1, sizeof(*c));
+  c->section = (enum cache_sections) i;
+  c->file    = STRDUP (file);
+  c->key     = STRDUP (key);
+  c->value   = STRDUP (value);
+  c->size    = fsize;
+  c->mtime   = (time_t) ftime;
+  smartlist_add (cache_nodes, c);
+}
+
+/**
+ * Read the cache-file into \c cache_nodes.
+ */
+static void cache_load (void)
+{
+  cache_nodes = smartlist_new();
+  cache_fname = getenv_expand ("%TEMP%\\envtool-probe.cache");
+  cache_dirty = FALSE;
+
+  /* With "--no-cache", start with an empty cache. Thus all values are
+   * probed again and the cache-file is rewritten in cache_exit().
+   */
+  if (opt.no_cache)
+     return;
+
+  if (file_read_lines(cache_fname, cache_parse, NULL) < 0)
+     return;
+
+  smartlist_sort (cache_nodes, cache_sort);
+  smartlist_make_uniq (cache_nodes, cache_sort, cache_free_node);
+  DEBUGF (2, "Loaded %d records from \"%s\".\n", smartlist_len(cache_nodes), cache_fname);
+}
+
+/**
+ * Load the cache-file. Called on first use of \c cache_get() or \c cache_put().
+ * Only the first caller loads it; other threads calling at the same time
+ * wait until it's done.
+ */
+void cache_init (void)
+{
+  if (InterlockedCompareExchange(&cache_state, 1, 0) != 0)
+  {
+    while (cache_state != 2)
+       Sleep (0);
+    return;
+  }
+
+  InitializeCriticalSection (&cache_crit);
+  cache_load();
+  InterlockedExchange (&cache_state, 2);
+}
+
+/**
+ * Write the cache-file (if anything was changed) and free the memory.
+ */
+void cache_exit (void)
+{
+  int i, max;
+
+  if (cache_state != 2)
+     return;
+
+  max = smartlist_len (cache_nodes);
+  if (cache_dirty)
+  {
+    FILE *f = fopen (cache_fname, "w+t");
+
+    if (f)
+    {
+      fprintf (f, "# envtool probe-cache. Generated at %s. Do not edit.\n",
+               get_time_str(time(NULL)));
+      for (i = 0; i < max; i++)
+      {
+        const struct cache_node *c = smartlist_get (cache_nodes, i);
+        UINT64 size;
+        time_t mtime;
+
+        /* Drop the records of deleted or changed files. These can never be
+         * returned by cache_get() again.
+         */
+        if (!cache_stamp(c->file, &size, &mtime) || size != c->size || mtime != c->mtime)
+           continue;
+        fprintf (f, "%s\t%s\t%" U64_FMT "\t%" S64_FMT "\t%s\t%s\n",
+                 section_names[c->section], c->file, c->size, (INT64)c->mtime,
+                 c->key, c->value);
+      }
+      fclose (f);
+      DEBUGF (2, "Wrote records to \"%s\".\n", cache_fname);
+    }
+    else
+      DEBUGF (1, "Failed to write \"%s\"; errno: %d.\n", cache_fname, errno);
+  }
+
+  smartlist_wipe (cache_nodes, cache_free_node);
+  smartlist_free (cache_nodes);
+  cache_nodes = NULL;
+  FREE (cache_fname);
+  DeleteCriticalSection (&cache_crit);
+  InterlockedExchange (&cache_state, 0);
+}
+
+/**
+ * Return a copy of the value of \c key for \c file in \c section.
+ * Returns NULL if not found or if \c file has changed since the value
+ * was stored.
+ *
+ * \note The value is copied while the cache is locked; another thread may
+ *       \c cache_put() the same \c key right after. The caller must
+ *       \c FREE() it.
+ */
+char *cache_get (enum cache_sections section, const char *file, const char *key)
+{
+  struct cache_node  node, *c = NULL;
+  char              *value = NULL;
+  UINT64             size;
+  time_t             mtime;
+  int                idx, found;
+
+  cache_init();
+
+  if (!cache_stamp(file, &size, &mtime))
+     return (NULL);
+
+  node.section = section;
+  node.file    = (char*) file;
+  node.key     = (char*) key;
+
+  EnterCriticalSection (&cache_crit);
+  idx = smartlist_bsearch_idx (cache_nodes, &node, cache_compare, &found);
+  if (found)
+  {
+    c = smartlist_get (cache_nodes, idx);
+    if (c->size == size && c->mtime == mtime)
+       value = STRDUP (c->value);
+  }
+  LeaveCriticalSection (&cache_crit);
+  return (value);
+}
+
+/**
+ * Store (or replace) the \c value of \c key for \c file in \c section.
+ * The current size and modification-time of \c file are stored with it.
+ * The \c value can not contain any newlines. A \c value longer than
+ * \c CACHE_MAX_VALUE is not stored.
+ */
+void cache_put (enum cache_sections section, const char *file, const char *key, const char *value)
+{
+  struct cache_node  node, *c;
+  UINT64             size;
+  time_t             mtime;
+  int                idx, found;
+
+  cache_init();
+
+  if (strlen(value) > CACHE_MAX_VALUE || !cache_stamp(file, &size, &mtime))
+     return;
+
+  ASSERT (strchr(value, '\n') == NULL);
+  ASSERT (strchr(key, '\t') == NULL);
+
+  node.section = section;
+  node.file    = (char*) file;
+  node.key     = (char*) key;
+
+  EnterCriticalSection (&cache_crit);
+  idx = smartlist_bsearch_idx (cache_nodes, &node, cache_compare, &found);
+  if (found)
+  {
+    c = smartlist_get (cache_nodes, idx);
+    if (c->size == size && c->mtime == mtime && !strcmp(c->value, value))
+    {
+      LeaveCriticalSection (&cache_crit);
+      return;
+    }
+    FREE (c->value);
+  }
+  else
+  {
+    c = CALLOC (1, sizeof(*c));
+    c->section = section;
+    c->file    = STRDUP (file);
+    c->key     = STRDUP (key);
+    smartlist_insert (cache_nodes, idx, c);
+  }
+  c->value = STRDUP (value);
+  c->size  = size;
+  c->mtime = mtime;
+  cache_dirty = TRUE;
+  LeaveCriticalSection (&cache_crit);
+}
+
+/**
+ * A var-arg version of \c cache_put().
+ */
+void cache_putf (enum cache_sections section, const char *file, const char *key, const char *fmt, ...)
+{
+  char    value [CACHE_MAX_VALUE+1];
+  va_list args;
+
+  va_start (args, fmt);
+  vsnprintf (value, sizeof(value), fmt, args);
+  va_end (args);
+  cache_put (section, file, key, value);
+}
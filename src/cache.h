@@ -0,0 +1,30 @@
+/** \file cache.h
+ */
+#ifndef _CACHE_H
+#define _CACHE_H
+
+/**\enum cache_sections
+ * The sections in the cache-file.
+ * Each section has it's own set of files and keys.
+ */
+enum cache_sections {
+     SECTION_PYTHON = 0,
+     SECTION_COMPILER,
+     SECTION_TRUST,
+     SECTION_VERSION,
+     SECTION_LAST
+   };
+
+/**
+ * Values longer than this are not stored.
+ */
+#define CACHE_MAX_VALUE  8000
+
+extern void        cache_init (void);
+extern void        cache_exit (void);
+extern char       *cache_get  (enum cache_sections section, const char *file, const char *key);
+extern void        cache_put  (enum cache_sections section, const char *file, const char *key, const char *value);
+extern void        cache_putf (enum cache_sections section, const char *file, const char *key, const char *fmt, ...)
+                               ATTR_PRINTF(4,5);
+
+#endif /* _CACHE_H */
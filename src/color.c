@@ -94,6 +94,8 @@ int C_use_fwrite = 0;
 
 unsigned C_redundant_flush = 0;
 
+uint64_t C_bytes_written = 0;
+
 void (*C_write_hook) (const char *buf) = NULL;
 
 static char   c_buf [C_BUF_SIZE];
@@ -424,6 +426,9 @@ size_t C_flush (void)
        len2 = fwrite (c_buf, 1, len1, c_out);
   else len2 = _write (_fileno(c_out), c_buf, (unsigned int)len1);
 
+  if (len2 != (size_t)-1)
+     C_bytes_written += len2;
+
   if (C_write_hook)
   {
     c_buf [len1] = '\0';
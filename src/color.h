@@ -46,6 +46,11 @@ extern int C_use_fwrite;
  */
 extern unsigned C_redundant_flush;
 
+/**
+ * Count of bytes written by \c C_flush().
+ */
+extern uint64_t C_bytes_written;
+
 extern int C_printf (_Printf_format_string_ const char *fmt, ...)
   #if defined(__GNUC__)
     __attribute__ ((format(printf,1,2)))
@@ -31,6 +31,8 @@
 #include "envtool.h"
 #include "color.h"
 #include "dirlist.h"
+#include "strsort.h"
+#include "arena.h"
 #include "getopt_long.h"
 
 typedef int (*QsortCmpFunc) (const void *, const void *);
@@ -39,17 +41,17 @@ typedef int (*ScandirCmpFunc) (const void **, const void **);
 /*
  * Local functions
  */
-static char *getdirent2 (HANDLE *hnd, const char *spec, WIN32_FIND_DATA *ff);
-static void  free_contents (DIR2 *dp);
-static void  set_sort_funcs (enum od2x_sorting sort, QsortCmpFunc *qsort_func, ScandirCmpFunc *sd_cmp_func);
-
-static BOOL setdirent2 (struct dirent2 *de, const char *dir, const char *file)
+static char              *getdirent2 (HANDLE *hnd, const char *spec, WIN32_FIND_DATA *ff);
+static void               free_contents (DIR2 *dp);
+static void               set_sort_funcs (enum od2x_sorting sort, QsortCmpFunc *qsort_func, ScandirCmpFunc *sd_cmp_func);
+static const char        *dirent2_sort_key (const void *elem, int *group);
+static unsigned           str_sort_flags (void);
+static enum od2x_sorting  get_sort_type (ScandirCmpFunc dcomp);
+
+static BOOL setdirent2 (struct dirent2 *de, arena_t *arena, const char *dir, const char *file)
 {
   size_t len = strlen(file) + strlen(dir) + 2;
-  char  *p   = MALLOC (len);
-
-  if (!p)
-     return (FALSE);
+  char  *p   = arena_alloc (arena, len);
 
   de->d_name   = p;
   de->d_reclen = len;
@@ -78,6 +80,7 @@ static int _sd_select (const struct dirent2 *de)
 
 static int sort_reverse = 0;
 static int sort_exact = 0;
+static enum od2x_sorting sort_type = OD2X_UNSORTED;  /* without the 'OD2X_SORT_x' flags */
 
 static int reverse_sort (int rc)
 {
@@ -202,6 +205,10 @@ DIR2 *opendir2x (const char *dir_name, const struct od2x_options *opts)
 
   DEBUGF (3, "CALLOC (%u) -> %p\n", (unsigned)max_size, dirp->dd_contents);
 
+  /* All the 'd_name' strings are carved out of this.
+   */
+  dirp->dd_arena = arena_new (64*1024);
+
  /*
   * If we're called from 'scandir2()', we have no pattern; we match all files.
   * If we're called from 'opendir2x()', maybe use "*" as pattern if 'opts->recursive == 1'?
@@ -222,7 +229,7 @@ DIR2 *opendir2x (const char *dir_name, const struct od2x_options *opts)
   {
     de = dirp->dd_contents + dirp->dd_num;
 
-    if (!setdirent2(de, dir_name, file))
+    if (!setdirent2(de, dirp->dd_arena, dir_name, file))
     {
       free_contents (dirp);
       goto enomem;
@@ -267,7 +274,8 @@ DIR2 *opendir2x (const char *dir_name, const struct od2x_options *opts)
 
     set_sort_funcs (opts->sort, &sorter, NULL);
     if (sorter)
-       qsort (dirp->dd_contents, dirp->dd_num, sizeof(struct dirent2), sorter);
+       str_sort_array (dirp->dd_contents, (int)dirp->dd_num, sizeof(struct dirent2),
+                       dirent2_sort_key, str_sort_flags());
   }
 
   return (dirp);
@@ -334,12 +342,11 @@ static void free_contents (DIR2 *dp)
   for (i = 0; i < dp->dd_num; i++, de++)
   {
     if (de)
-    {
-      FREE (de->d_name);
-      FREE (de->d_link);
-    }
+       FREE (de->d_link);
   }
   FREE (dp->dd_contents);
+  arena_free (dp->dd_arena);
+  dp->dd_arena = NULL;
 }
 
 static char *getdirent2 (HANDLE *hnd, const char *spec, WIN32_FIND_DATA *ff)
@@ -356,13 +363,19 @@ static char *getdirent2 (HANDLE *hnd, const char *spec, WIN32_FIND_DATA *ff)
     else *hnd = FindFirstFile (spec, ff);
 
     if (*hnd != INVALID_HANDLE_VALUE)
-       okay = TRUE;
+    {
+      STAT_INC (STAT_DIRS_OPENED);
+      okay = TRUE;
+    }
   }
   else          /* get next entry */
     okay = FindNextFile (*hnd, ff);
 
   if (okay)
-     rc = ff->cFileName;
+  {
+    STAT_INC (STAT_ENTRIES);
+    rc = ff->cFileName;
+  }
   else
   {
     FindClose (*hnd);
@@ -472,7 +485,10 @@ int scandir2 (const char       *dirname,
     }
   }
 
-  if (dcomp)
+  sort_type = get_sort_type (dcomp);
+  if (sort_type != OD2X_UNSORTED)
+       str_sort ((void**)namelist, num, dirent2_sort_key, str_sort_flags());
+  else if (dcomp)
        qsort (namelist, num, sizeof(struct dirent2*), (QsortCmpFunc)dcomp);
   else sort_reverse = 0;
 
@@ -560,6 +576,52 @@ int sd_compare_dirs_first (const void **a, const void **b)
   return compare_dirs_first (*a, *b);
 }
 
+/*
+ * The 'str_sort()' key-function used instead of the above compare functions.
+ * The key is the base-name. The group puts the directories before (or after)
+ * the files.
+ */
+static const char *dirent2_sort_key (const void *elem, int *group)
+{
+  const struct dirent2 *de = (const struct dirent2*) elem;
+  BOOL  is_dir = (de->d_attrib & FILE_ATTRIBUTE_DIRECTORY) ? TRUE : FALSE;
+
+  if (sort_type == OD2X_DIRECTORIES_FIRST)
+     *group = is_dir ? 0 : 1;
+  else if (sort_type == OD2X_FILES_FIRST)
+     *group = is_dir ? 1 : 0;
+  return basename (de->d_name);
+}
+
+/*
+ * The 'str_sort()' flags for 'sort_exact' and 'sort_reverse'.
+ */
+static unsigned str_sort_flags (void)
+{
+  unsigned flags = 0;
+
+  if (!sort_exact)
+     flags |= STR_SORT_NOCASE;
+  if (sort_reverse)
+     flags |= STR_SORT_REVERSE;
+  return (flags);
+}
+
+/*
+ * Return the sort-type for one of the 'sd_compare_x()' functions.
+ * Or 'OD2X_UNSORTED' for a compare function from the caller.
+ */
+static enum od2x_sorting get_sort_type (ScandirCmpFunc dcomp)
+{
+  if (dcomp == sd_compare_alphasort)
+     return (OD2X_ON_NAME);
+  if (dcomp == sd_compare_files_first)
+     return (OD2X_FILES_FIRST);
+  if (dcomp == sd_compare_dirs_first)
+     return (OD2X_DIRECTORIES_FIRST);
+  return (OD2X_UNSORTED);
+}
+
 /*
  * Return the sorting function based on 'sort'.
  */
@@ -569,6 +631,7 @@ static void set_sort_funcs (enum od2x_sorting sort, QsortCmpFunc *qsort_func, Sc
 
   sort_reverse = (sort & OD2X_SORT_REVERSE) ? 1 : 0;
   sort_exact   = (sort & OD2X_SORT_EXACT)   ? 1 : 0;
+  sort_type    = s;
 
   switch (s)
   {
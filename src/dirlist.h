@@ -28,7 +28,7 @@ struct dirent2 {
        ino_t     d_ino;          /* a bit of a farce */
        size_t    d_reclen;       /* more farce */
        size_t    d_namlen;       /* length of d_name */
-       char     *d_name;         /* MALLOC()'ed fully qualified file-name */
+       char     *d_name;         /* fully qualified file-name. In 'DIR2::dd_arena' */
        char     *d_link;         /* MALLOC()'ed name of Repare-Point (Junction target) */
        DWORD     d_attrib;       /* FILE_ATTRIBUTE_xx. Ref MSDN. */
        FILETIME  d_time_create;
@@ -41,6 +41,7 @@ typedef struct _dirdesc2 {
         size_t          dd_loc;       /* index into below dd_contents[] */
         size_t          dd_num;       /* max # of entries in dd_contents[] */
         struct dirent2 *dd_contents;  /* pointer to contents of dir */
+        struct arena_t *dd_arena;     /* holds the 'd_name' of all entries */
       } DIR2;
 
 extern DIR2           *opendir2 (const char *dir);
@@ -0,0 +1,618 @@
+/**\file    dups.c
+ * \ingroup Misc
+ * \brief
+ *   Find duplicated files among the search results (option \c "--hash").
+ *
+ * Every file reported by \c report_file() is added with \c dups_add().
+ * Then \c dups_report() groups them into:
+ *  \li sets of identical files; E.g. the same DLL copied into several
+ *      directories in \c %PATH.
+ *  \li files with the same name but different content.
+ *
+ * To read as little as possible, the candidates are narrowed down in 3 steps:
+ *  \li Only files sharing their size with another file can be identical.
+ *      Files with a unique size are never opened.
+ *  \li The first and last \c DUPS_PARTIAL_SIZE bytes of each candidate are
+ *      hashed. Most files that differ are rejected here.
+ *  \li The remaining files with equal size and partial hash are hashed in
+ *      full with large sequential reads.
+ *
+ * The hashing in step 2 and 3 runs in parallel in \c tasks_run_list().
+ * The hash is XXH64; fast and good enough since the results are only shown
+ * (a collision would at worst report 2 files as identical).
+ */
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include "envtool.h"
+#include "color.h"
+#include "smartlist.h"
+#include "tasks.h"
+#include "dups.h"
+
+/**
+ * The number of bytes hashed from each end of a file in step 2.
+ * A file not larger than twice this is hashed in full in step 2.
+ */
+#define DUPS_PARTIAL_SIZE  4096
+
+/**
+ * The size of each read in step 3.
+ */
+#define DUPS_READ_SIZE  (1024*1024)
+
+/**\struct dup_file
+ * A file added by \c dups_add().
+ */
+struct dup_file {
+       char       *file;       /** the full file-name */
+       const char *base;       /** the basename of \c file */
+       UINT64      size;       /** the size when it was found */
+       time_t      mtime;      /** the modification time ditto */
+       UINT64      partial;    /** the hash of the first and last \c DUPS_PARTIAL_SIZE bytes */
+       UINT64      full;       /** the hash of the whole file */
+       BOOL        full_done;  /** \c full is valid */
+       BOOL        error;      /** it could not be read or has changed size */
+       int         set;        /** the set of identical files it belongs to; 0 if unique */
+     };
+
+static smartlist_t *dup_files = NULL;
+
+/*
+ * XXH64 by Yann Collet. Ref: https://github.com/Cyan4973/xxHash
+ */
+#define XXH_P1  0x9E3779B185EBCA87ULL
+#define XXH_P2  0xC2B2AE3D27D4EB4FULL
+#define XXH_P3  0x165667B19E3779F9ULL
+#define XXH_P4  0x85EBCA77C2B2AE63ULL
+#define XXH_P5  0x27D4EB2F165667C5ULL
+
+#define XXH_ROL64(x, n)  (((x) << (n)) | ((x) >> (64 - (n))))
+
+static UINT64 xxh_read64 (const BYTE *p)
+{
+  UINT64 v;
+
+  memcpy (&v, p, sizeof(v));   /* little-endian only */
+  return (v);
+}
+
+static DWORD xxh_read32 (const BYTE *p)
+{
+  DWORD v;
+
+  memcpy (&v, p, sizeof(v));
+  return (v);
+}
+
+static UINT64 xxh_round (UINT64 acc, UINT64 input)
+{
+  acc += input * XXH_P2;
+  acc  = XXH_ROL64 (acc, 31);
+  return (acc * XXH_P1);
+}
+
+static UINT64 xxh_merge_round (UINT64 acc, UINT64 val)
+{
+  acc ^= xxh_round (0, val);
+  return (acc * XXH_P1 + XXH_P4);
+}
+
+/**
+ * Hash whole 32 byte stripes. Returns the number of bytes consumed.
+ */
+static size_t xxh64_stripes (UINT64 *v, const BYTE *p, size_t len)
+{
+  const BYTE *start = p;
+  const BYTE *limit;
+  UINT64      v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+
+  if (len < 32)
+     return (0);
+
+  limit = p + len - 32;
+
+  do
+  {
+    v1 = xxh_round (v1, xxh_read64(p));
+    v2 = xxh_round (v2, xxh_read64(p+8));
+    v3 = xxh_round (v3, xxh_read64(p+16));
+    v4 = xxh_round (v4, xxh_read64(p+24));
+    p += 32;
+  }
+  while (p <= limit);
+
+  v[0] = v1;
+  v[1] = v2;
+  v[2] = v3;
+  v[3] = v4;
+  return (p - start);
+}
+
+void xxh64_init (struct xxh64_state *s, UINT64 seed)
+{
+  memset (s, '\0', sizeof(*s));
+  s->seed = seed;
+  s->v[0] = seed + XXH_P1 + XXH_P2;
+  s->v[1] = seed + XXH_P2;
+  s->v[2] = seed;
+  s->v[3] = seed - XXH_P1;
+}
+
+void xxh64_update (struct xxh64_state *s, const void *data, size_t len)
+{
+  const BYTE *p = (const BYTE*) data;
+  size_t      n;
+
+  s->total_len += len;
+
+  if (s->mem_size + len < sizeof(s->mem))
+  {
+    memcpy (s->mem + s->mem_size, p, len);
+    s->mem_size += len;
+    return;
+  }
+
+  if (s->mem_size > 0)
+  {
+    n = sizeof(s->mem) - s->mem_size;
+    memcpy (s->mem + s->mem_size, p, n);
+    xxh64_stripes (s->v, s->mem, sizeof(s->mem));
+    p   += n;
+    len -= n;
+    s->mem_size = 0;
+  }
+
+  n = xxh64_stripes (s->v, p, len);
+  p   += n;
+  len -= n;
+  if (len > 0)
+  {
+    memcpy (s->mem, p, len);
+    s->mem_size = len;
+  }
+}
+
+UINT64 xxh64_digest (const struct xxh64_state *s)
+{
+  const BYTE *p   = s->mem;
+  const BYTE *end = s->mem + s->mem_size;
+  UINT64      h;
+
+  if (s->total_len >= 32)
+  {
+    h = XXH_ROL64 (s->v[0], 1) + XXH_ROL64 (s->v[1], 7) +
+        XXH_ROL64 (s->v[2], 12) + XXH_ROL64 (s->v[3], 18);
+    h = xxh_merge_round (h, s->v[0]);
+    h = xxh_merge_round (h, s->v[1]);
+    h = xxh_merge_round (h, s->v[2]);
+    h = xxh_merge_round (h, s->v[3]);
+  }
+  else
+    h = s->seed + XXH_P5;
+
+  h += s->total_len;
+
+  for ( ; p + 8 <= end; p += 8)
+  {
+    h ^= xxh_round (0, xxh_read64(p));
+    h  = XXH_ROL64 (h, 27) * XXH_P1 + XXH_P4;
+  }
+  if (p + 4 <= end)
+  {
+    h ^= (UINT64) xxh_read32(p) * XXH_P1;
+    h  = XXH_ROL64 (h, 23) * XXH_P2 + XXH_P3;
+    p += 4;
+  }
+  for ( ; p < end; p++)
+  {
+    h ^= (*p) * XXH_P5;
+    h  = XXH_ROL64 (h, 11) * XXH_P1;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_P2;
+  h ^= h >> 29;
+  h *= XXH_P3;
+  h ^= h >> 32;
+  return (h);
+}
+
+/**
+ * Add a file found in the search.
+ */
+void dups_add (const char *file, UINT64 size, time_t mtime)
+{
+  struct dup_file *d = CALLOC (1, sizeof(*d));
+
+  if (!dup_files)
+     dup_files = smartlist_new();
+
+  d->file  = STRDUP (file);
+  d->base  = basename (d->file);
+  d->size  = size;
+  d->mtime = mtime;
+  smartlist_add (dup_files, d);
+}
+
+static void dups_free (void *e)
+{
+  struct dup_file *d = (struct dup_file*) e;
+
+  FREE (d->file);
+  FREE (d);
+}
+
+void dups_exit (void)
+{
+  if (!dup_files)
+     return;
+  smartlist_wipe (dup_files, dups_free);
+  smartlist_free (dup_files);
+  dup_files = NULL;
+}
+
+/*
+ * The compare functions for the steps.
+ */
+#define CMP(a, b)  ((a) < (b) ? -1 : (a) > (b) ? 1 : 0)
+
+static const char *dup_file_key (const void *_f, int *group)
+{
+  const struct dup_file *f = (const struct dup_file*) _f;
+
+  ARGSUSED (group);
+  return (f->file);
+}
+
+static int compare_name (const void **_a, const void **_b)
+{
+  const struct dup_file *a = *(const struct dup_file**) _a;
+  const struct dup_file *b = *(const struct dup_file**) _b;
+
+  return stricmp (a->file, b->file);
+}
+
+static int compare_size (const void **_a, const void **_b)
+{
+  const struct dup_file *a = *(const struct dup_file**) _a;
+  const struct dup_file *b = *(const struct dup_file**) _b;
+
+  return CMP (a->size, b->size);
+}
+
+static int compare_partial (const void **_a, const void **_b)
+{
+  const struct dup_file *a = *(const struct dup_file**) _a;
+  const struct dup_file *b = *(const struct dup_file**) _b;
+
+  if (a->size != b->size)
+     return CMP (a->size, b->size);
+  return CMP (a->partial, b->partial);
+}
+
+static int compare_full (const void **_a, const void **_b)
+{
+  const struct dup_file *a = *(const struct dup_file**) _a;
+  const struct dup_file *b = *(const struct dup_file**) _b;
+
+  if (a->size != b->size)
+     return CMP (a->size, b->size);
+  return CMP (a->full, b->full);
+}
+
+static int compare_base (const void **_a, const void **_b)
+{
+  const struct dup_file *a = *(const struct dup_file**) _a;
+  const struct dup_file *b = *(const struct dup_file**) _b;
+  int   rc = stricmp (a->base, b->base);
+
+  if (rc)
+     return (rc);
+  if (a->set != b->set)
+     return CMP (a->set, b->set);
+  return stricmp (a->file, b->file);
+}
+
+/**
+ * The job-function for step 2.
+ */
+static void dups_partial_job (void *arg)
+{
+  struct dup_file   *d = (struct dup_file*) arg;
+  struct xxh64_state s;
+  BYTE   buf [2*DUPS_PARTIAL_SIZE];
+  size_t len = 0;
+  FILE  *f = fopen (d->file, "rb");
+
+  if (!f)
+  {
+    d->error = TRUE;
+    return;
+  }
+
+  if (d->size <= sizeof(buf))
+  {
+    len = fread (buf, 1, sizeof(buf), f);
+    d->full_done = TRUE;
+    if (len != d->size)
+       d->error = TRUE;
+  }
+  else
+  {
+    len = fread (buf, 1, DUPS_PARTIAL_SIZE, f);
+    if (len == DUPS_PARTIAL_SIZE && fseek(f, -DUPS_PARTIAL_SIZE, SEEK_END) == 0)
+       len += fread (buf + len, 1, DUPS_PARTIAL_SIZE, f);
+    if (len != sizeof(buf))
+       d->error = TRUE;
+  }
+  fclose (f);
+
+  xxh64_init (&s, 0);
+  xxh64_update (&s, buf, len);
+  d->partial = xxh64_digest (&s);
+  if (d->full_done)
+     d->full = d->partial;
+}
+
+/**
+ * The job-function for step 3.
+ */
+static void dups_full_job (void *arg)
+{
+  struct dup_file   *d = (struct dup_file*) arg;
+  struct xxh64_state s;
+  UINT64 total = 0;
+  size_t len;
+  BYTE  *buf;
+  FILE  *f;
+
+  if (d->full_done || d->error)
+     return;
+
+  f = fopen (d->file, "rb");
+  if (!f)
+  {
+    d->error = TRUE;
+    return;
+  }
+
+  /* We read in large chunks anyway. No need for stdio to copy it too.
+   */
+  setvbuf (f, NULL, _IONBF, 0);
+  buf = MALLOC (DUPS_READ_SIZE);
+  xxh64_init (&s, 0);
+  while ((len = fread(buf, 1, DUPS_READ_SIZE, f)) > 0)
+  {
+    xxh64_update (&s, buf, len);
+    total += len;
+  }
+  fclose (f);
+  FREE (buf);
+
+  d->full      = xxh64_digest (&s);
+  d->full_done = TRUE;
+  if (total != d->size)
+     d->error = TRUE;
+}
+
+/**
+ * Add the elements of \c sl which are equal to a neighbour (according to
+ * \c compare) to \c out. \c sl must be sorted on \c compare.
+ */
+static void dups_add_runs (const smartlist_t *sl, smartlist_sort_func compare, smartlist_t *out)
+{
+  int i, j, max = smartlist_len (sl);
+
+  for (i = 0; i < max; i = j)
+  {
+    const void *a = smartlist_get (sl, i);
+
+    for (j = i + 1; j < max; j++)
+    {
+      const void *b = smartlist_get (sl, j);
+
+      if ((*compare)(&a, &b) != 0)
+         break;
+    }
+    if (j - i > 1)
+    {
+      int k;
+
+      for (k = i; k < j; k++)
+      {
+        struct dup_file *d = smartlist_get (sl, k);
+
+        if (!d->error)
+           smartlist_add (out, d);
+      }
+    }
+  }
+}
+
+/**
+ * Print one file in a set.
+ */
+static void dups_print_file (const struct dup_file *d, const char *label)
+{
+  int raw;
+
+  C_printf ("    %s%s - %s: ", label, get_time_str(d->mtime), get_file_size_str(d->size));
+  raw = C_setraw (1);
+  C_puts (d->file);
+  C_setraw (raw);
+  C_putc ('\n');
+}
+
+/**
+ * Print the sets of identical files. Returns the number of sets.
+ * \c same_full must be sorted on \c compare_full().
+ */
+static int dups_print_identical (smartlist_t *same_full)
+{
+  UINT64 wasted = 0;
+  int    i, j, num_sets = 0, num_dups = 0;
+  int    max = smartlist_len (same_full);
+
+  for (i = 0; i < max; i = j)
+  {
+    struct dup_file *a = smartlist_get (same_full, i);
+
+    for (j = i + 1; j < max; j++)
+    {
+      const struct dup_file *b = smartlist_get (same_full, j);
+
+      if (b->size != a->size || b->full != a->full)
+         break;
+    }
+    if (j - i < 2)
+       continue;
+
+    if (num_sets++ == 0)
+       C_puts ("\n~3Identical files:~0\n");
+
+    C_printf ("  ~6%d files~0 with xxh64 %08lX%08lX:\n",
+              j - i, (u_long)(a->full >> 32), (u_long)(a->full & 0xFFFFFFFF));
+    num_dups += j - i - 1;
+    wasted   += (UINT64)(j - i - 1) * a->size;
+
+    for ( ; i < j; i++)
+    {
+      struct dup_file *d = smartlist_get (same_full, i);
+
+      d->set = num_sets;
+      dups_print_file (d, "");
+    }
+  }
+
+  if (num_sets > 0)
+     C_printf ("  %d redundant copies using %s.\n", num_dups, str_trim((char*)get_file_size_str(wasted)));
+  return (num_sets);
+}
+
+/**
+ * Print the files with the same name but different content.
+ * Returns the number of such names.
+ *
+ * A file that could not be read (\c error) has an unknown content. It's
+ * neither counted nor printed; it could be identical to any of the others.
+ */
+static int dups_print_divergent (smartlist_t *files)
+{
+  int i, j, k, max, num_names = 0;
+
+  smartlist_sort (files, compare_base);
+  max = smartlist_len (files);
+
+  for (i = 0; i < max; i = j)
+  {
+    const struct dup_file *a = smartlist_get (files, i);
+    int   num_contents = 0, last_set = -1;
+
+    for (j = i + 1; j < max; j++)
+    {
+      const struct dup_file *b = smartlist_get (files, j);
+
+      if (stricmp(a->base, b->base))
+         break;
+    }
+
+    /* Files in the same set are sorted next to each other.
+     */
+    for (k = i; k < j; k++)
+    {
+      const struct dup_file *d = smartlist_get (files, k);
+
+      if (d->error)
+         continue;
+      if (d->set == 0 || d->set != last_set)
+         num_contents++;
+      last_set = d->set;
+    }
+    if (num_contents < 2)
+       continue;
+
+    if (num_names++ == 0)
+       C_puts ("\n~3Same name, different content:~0\n");
+
+    C_printf ("  ~6%s~0 has %d different contents:\n", a->base, num_contents);
+    num_contents = 0;
+    last_set = -1;
+    for (k = i; k < j; k++)
+    {
+      const struct dup_file *d = smartlist_get (files, k);
+      char  label [20];
+
+      if (d->error)
+         continue;
+      if (d->set == 0 || d->set != last_set)
+         num_contents++;
+      last_set = d->set;
+      snprintf (label, sizeof(label), "[%d] ", num_contents);
+      dups_print_file (d, label);
+    }
+  }
+  return (num_names);
+}
+
+/**
+ * Hash the candidates and print the sets of identical and divergent files.
+ */
+void dups_report (void)
+{
+  smartlist_t *same_size, *same_partial, *same_full;
+  int          i, max, num_identical, num_divergent;
+
+  if (!dup_files)
+     return;
+
+  /* The same file could be found twice; E.g. a directory twice in %PATH.
+   */
+  smartlist_sort_str (dup_files, dup_file_key, STR_SORT_NOCASE);
+  smartlist_make_uniq (dup_files, compare_name, dups_free);
+
+  /* Step 1: only files with the same size.
+   */
+  same_size = smartlist_new();
+  smartlist_sort (dup_files, compare_size);
+  dups_add_runs (dup_files, compare_size, same_size);
+
+  /* Step 2: hash the ends of these.
+   */
+  max = smartlist_len (same_size);
+  for (i = 0; i < max; i++)
+  {
+    struct dup_file *d = smartlist_get (same_size, i);
+
+    if (d->size == 0)
+       d->full_done = TRUE;
+  }
+  tasks_run_list (same_size, dups_partial_job);
+
+  /* Step 3: hash the whole of those with the same size and partial hash.
+   */
+  same_partial = smartlist_new();
+  smartlist_sort (same_size, compare_partial);
+  dups_add_runs (same_size, compare_partial, same_partial);
+  tasks_run_list (same_partial, dups_full_job);
+
+  DEBUGF (1, "%d files, %d with the same size, %d with the same partial hash.\n",
+          smartlist_len(dup_files), smartlist_len(same_size), smartlist_len(same_partial));
+
+  /* Drop those that failed or changed while reading them.
+   */
+  same_full = smartlist_new();
+  smartlist_sort (same_partial, compare_full);
+  dups_add_runs (same_partial, compare_full, same_full);
+
+  num_identical = dups_print_identical (same_full);
+  num_divergent = dups_print_divergent (dup_files);
+
+  if (num_identical == 0 && num_divergent == 0)
+     C_puts ("\nNo duplicated files found.\n");
+
+  smartlist_free (same_size);
+  smartlist_free (same_partial);
+  smartlist_free (same_full);
+}
@@ -0,0 +1,25 @@
+/** \file dups.h
+ */
+#ifndef _DUPS_H
+#define _DUPS_H
+
+/**\struct xxh64_state
+ * The state of a streaming XXH64 hash.
+ */
+struct xxh64_state {
+       UINT64 v [4];         /** the 4 accumulators */
+       UINT64 total_len;     /** the number of bytes hashed so far */
+       UINT64 seed;          /** the seed given to \c xxh64_init() */
+       BYTE   mem [32];      /** a partial stripe */
+       size_t mem_size;      /** the number of bytes in \c mem */
+     };
+
+extern void   xxh64_init   (struct xxh64_state *s, UINT64 seed);
+extern void   xxh64_update (struct xxh64_state *s, const void *data, size_t len);
+extern UINT64 xxh64_digest (const struct xxh64_state *s);
+
+extern void dups_add    (const char *file, UINT64 size, time_t mtime);
+extern void dups_report (void);
+extern void dups_exit   (void);
+
+#endif /* _DUPS_H */
@@ -30,6 +30,7 @@
 #include <windows.h>
 #include <shlobj.h>
 #include <psapi.h>
+#include <imagehlp.h>
 
 #define INSIDE_ENVTOOL_C
 
@@ -42,10 +43,21 @@
 
 #include "color.h"
 #include "smartlist.h"
+#include "vector.h"
+#include "arena.h"
+#include "pathview.h"
+#include "bench.h"
+#include "trace.h"
 #include "regex.h"
 #include "ignore.h"
 #include "envtool.h"
 #include "envtool_py.h"
+#include "cache.h"
+#include "tasks.h"
+#include "runner.h"
+#include "sniff.h"
+#include "pe.h"
+#include "dups.h"
 
 /**
  * <!-- \includedoc  README.md ->
@@ -88,19 +100,37 @@ char *program_name = NULL;
 #define EVERYTHING_IPC_IS_DB_BUSY   402
 #endif
 
+/*
+ * The bits in 'dir_array.flags[]'.
+ */
+#define DIR_EXIST        0x01  /* does it exist? */
+#define DIR_IS_NATIVE    0x02  /* and is it a native dir; like %WinDir\sysnative */
+#define DIR_IS_DIR       0x04  /* and is it a dir; _S_ISDIR() */
+#define DIR_IS_CWD       0x08  /* and is it equal to current_dir[] */
+#define DIR_EXP_OK       0x10  /* ExpandEnvironmentStrings() returned with no '%'? */
+#define DIR_CHECK_EMPTY  0x20  /* check if it contains at least 1 file? */
+
+/*
+ * The directories of the env-var (or compiler) being checked.
+ * A struct of arrays; entry 'i' is element 'i' of each column. So a loop
+ * over the flags of all entries touches only 1 byte per entry. All the
+ * names are in one string-pool.
+ */
 struct directory_array {
-       char    *dir;         /* FQDN of this entry */
-       char    *cyg_dir;     /* The Cygwin POSIX form of the above */
-       int      exist;       /* does it exist? */
-       int      is_native;   /* and is it a native dir; like %WinDir\sysnative */
-       int      is_dir;      /* and is it a dir; _S_ISDIR() */
-       int      is_cwd;      /* and is it equal to current_dir[] */
-       int      exp_ok;      /* ExpandEnvironmentStrings() returned with no '%'? */
-       int      num_dup;     /* is duplicated elsewhere in %VAR%? */
-       BOOL     check_empty; /* check if it contains at least 1 file? */
-       unsigned line;        /* Debug: at what line was add_to_dir_array() called */
+       vector_t flags;       /* BYTE: the 'DIR_x' bits above */
+       vector_t num_dup;     /* int: is duplicated elsewhere in %VAR%? */
+       vector_t hash;        /* DWORD: 'dir_array_hash()' of the name */
+       vector_t dir;         /* int: offset of the FQDN in 'pool' */
+       vector_t cyg_dir;     /* int: offset of the Cygwin POSIX form in 'pool'. -1 if none */
+       vector_t line;        /* unsigned: Debug: at what line was add_to_dir_array() called */
+       vector_t pool;        /* char: the 0-terminated names */
      };
 
+#define DIR_FLAGS(i)     VECTOR_AT (&dir_array.flags, BYTE, i)
+#define DIR_HAS(i, bit)  ((DIR_FLAGS(i) & (bit)) ? 1 : 0)
+#define DIR_NUM_DUP(i)   VECTOR_AT (&dir_array.num_dup, int, i)
+#define DIR_NAME(i)      (VECTOR_DATA(&dir_array.pool, char) + VECTOR_AT(&dir_array.dir, int, i))
+
 struct registry_array {
        char   *fname;        /* basename of this entry. I.e. the name of the enumerated key. */
        char   *real_fname;   /* normally the same as above unless aliased. E.g. "winzip.exe -> "winzip32.exe" */
@@ -111,7 +141,26 @@ struct registry_array {
        HKEY    key;
      };
 
-static smartlist_t *dir_array, *reg_array;
+static struct directory_array dir_array;
+static smartlist_t           *reg_array;
+
+/**
+ * Short-lived allocations done while matching and reporting.
+ * \c process_dir() and \c do_check_evry() release them when done.
+ */
+static arena_t *scratch_arena;
+
+/**\struct stat_phase
+ * The time spent in a phase of the run. Shown by option "--stats".
+ */
+struct stat_phase {
+       char    *name;    /** the phase; e.g. "do_check_env(PATH)" */
+       UINT64   nsec;    /** total time in it */
+       unsigned calls;   /** # of times it was run */
+     };
+
+static smartlist_t *stat_phases;
+static UINT64       stat_start_ns;
 
 struct prog_options opt;
 
@@ -143,9 +192,6 @@ static int   new_argc;             /* 1... to highest allocated cmd-line compone
 static int   path_separator = ';';
 static char  current_dir [_MAX_PATH];
 
-static char *vcache_fname = NULL;
-static BOOL  use_cache = FALSE;
-
 static regex_t    re_hnd;         /* regex handle/state */
 static regmatch_t re_matches[3];  /* regex sub-expressions */
 static int        re_err;         /* last regex error-code */
@@ -162,11 +208,10 @@ static void get_evry_bitness (HWND wnd);
 static void  usage (const char *fmt, ...) ATTR_PRINTF(1,2);
 static int   do_check (void);
 static int   do_tests (void);
+static int   do_bench (void);
 static void  searchpath_all_cc (void);
 static void  print_build_cflags (void);
 static void  print_build_ldflags (void);
-static int   get_pkg_config_info (const char **exe, struct ver_info *ver);
-static int   get_cmake_info (char **exe, struct ver_info *ver);
 
 /**
  * \todo: Add support for 'kpathsea'-like path searches (which some TeX programs uses).
@@ -286,10 +331,174 @@ static void get_evry_bitness (HWND wnd)
   DEBUGF (2, "fname: %s, evry_bitness: %d.\n", fname, evry_bitness);
 }
 
+/*
+ * The callbacks for the version probes below. The 'arg' is the
+ * 'struct ver_info' of the program; never a global.
+ */
+static int find_cmake_version_cb (char *buf, int index, void *arg)
+{
+  struct ver_info *ver = (struct ver_info*) arg;
+  static char prefix[] = "cmake version ";
+
+  ARGSUSED (index);
+  if (!strncmp(buf,prefix,sizeof(prefix)-1) &&
+      sscanf(buf+sizeof(prefix)-1, "%u.%u.%u", &ver->val_1, &ver->val_2, &ver->val_3) == 3)
+     return (1);
+  return (0);
+}
+
+static int find_pkg_config_version_cb (char *buf, int index, void *arg)
+{
+  struct ver_info *ver = (struct ver_info*) arg;
+
+  ARGSUSED (index);
+  if (sscanf(buf, "%u.%u", &ver->val_1, &ver->val_2) == 2)
+     return (1);
+  return (0);
+}
+
+/**\struct ver_probe
+ * How to get the version of an external program.
+ * The result is kept in the cache-file under 'SECTION_VERSION'.
+ */
+struct ver_probe {
+       const char     *key;       /* the key in 'SECTION_VERSION' */
+       const char     *cmd_fmt;   /* the command printing the version */
+       runner_callback cb;        /* parses the version from a line of it */
+       int             fields;    /* 2 for "major.minor", 3 for "major.minor.micro" */
+     };
+
+static const struct ver_probe cmake_probe      = { "cmake",      "\"%s\" -version",  find_cmake_version_cb,      3 };
+static const struct ver_probe pkg_config_probe = { "pkg-config", "\"%s\" --version", find_pkg_config_version_cb, 2 };
+
+/*
+ * Get the cached version of 'exe' if it's unchanged since it was last probed.
+ */
+static BOOL get_cached_version (const struct ver_probe *probe, const char *exe, struct ver_info *ver)
+{
+  char *value = cache_get (SECTION_VERSION, exe, probe->key);
+  BOOL  cached;
+
+  memset (ver, '\0', sizeof(*ver));
+  cached = (value && sscanf(value, "%u.%u.%u", &ver->val_1, &ver->val_2, &ver->val_3) >= probe->fields);
+  FREE (value);
+  return (cached);
+}
+
+static void put_cached_version (const struct ver_probe *probe, const char *exe, const struct ver_info *ver)
+{
+  if (probe->fields == 3)
+       cache_putf (SECTION_VERSION, exe, probe->key, "%u.%u.%u", ver->val_1, ver->val_2, ver->val_3);
+  else cache_putf (SECTION_VERSION, exe, probe->key, "%u.%u", ver->val_1, ver->val_2);
+}
+
+/*
+ * Get the version of the program 'exe' and wait for it.
+ * From the cache if 'exe' is unchanged since it was last probed.
+ */
+static BOOL get_ext_version (const struct ver_probe *probe, const char *exe, struct ver_info *ver)
+{
+  if (get_cached_version(probe, exe, ver))
+     return (TRUE);
+
+  if (runner_runf(RUNNER_STDERR_NULL, probe->cb, ver, probe->cmd_fmt, exe) <= 0)
+     return (FALSE);
+
+  put_cached_version (probe, exe, ver);
+  return (TRUE);
+}
+
+/**\struct ext_versions
+ * The programs on PATH whose version is shown by \c show_ext_versions().
+ * Python is handled in envtool_py.c.
+ */
+struct ext_versions {
+       char           *cmake_exe;        /* NULL if not found or the probe failed */
+       char           *pkg_config_exe;
+       struct ver_info cmake_ver;
+       struct ver_info pkg_config_ver;
+       struct runner  *runner;           /* runs the probes not in the cache */
+       int             cmake_id;         /* the 'runner' id. -1 if not run */
+       int             pkg_config_id;
+     };
+
+/*
+ * Submit a probe for 'exe' unless it's version is in the cache.
+ * Returns the runner id or -1.
+ */
+static int ext_version_submit (struct ext_versions *ext, const struct ver_probe *probe,
+                               const char *exe, struct ver_info *ver)
+{
+  if (!exe || get_cached_version(probe, exe, ver))
+     return (-1);
+
+  if (!ext->runner)
+     ext->runner = runner_new();
+  return runner_submitf (ext->runner, RUNNER_STDERR_NULL, probe->cb, ver, probe->cmd_fmt, exe);
+}
+
+/*
+ * Check the result of a probe started by 'ext_version_submit()'.
+ * Frees '*exe' if the probe failed.
+ */
+static void ext_version_collect (struct ext_versions *ext, const struct ver_probe *probe,
+                                 int id, char **exe, const struct ver_info *ver)
+{
+  if (id < 0)
+     return;
+  if (runner_result(ext->runner, id) > 0)
+       put_cached_version (probe, *exe, ver);
+  else FREE (*exe);
+}
+
+/*
+ * Find 'cmake.exe' and 'pkg-config.exe' on PATH and start probing their versions.
+ * The probes are independent of each other and of the Python probes in 'py_init()'.
+ * So the children run while the main thread does 'py_init()'.
+ * A probe whose program is unchanged since last time, is just a 'cache_get()'.
+ */
+static void ext_versions_probe (struct ext_versions *ext)
+{
+  const char *exe;
+  char        buf [_MAX_PATH];
+
+  memset (ext, '\0', sizeof(*ext));
+
+  exe = searchpath ("cmake.exe", "PATH");
+  if (exe)
+     ext->cmake_exe = STRDUP (slashify2(buf, exe, '\\'));
+
+  exe = searchpath ("pkg-config.exe", "PATH");
+  if (exe)
+     ext->pkg_config_exe = STRDUP (slashify2(buf, exe, '\\'));
+
+  ext->cmake_id      = ext_version_submit (ext, &cmake_probe, ext->cmake_exe, &ext->cmake_ver);
+  ext->pkg_config_id = ext_version_submit (ext, &pkg_config_probe, ext->pkg_config_exe, &ext->pkg_config_ver);
+
+  if (ext->runner)
+     runner_run (ext->runner);
+}
+
+/*
+ * Wait for the probes started by 'ext_versions_probe()' and collect their results.
+ * The callbacks and the 'cache_putf()' calls are all done in this thread.
+ */
+static void ext_versions_finish (struct ext_versions *ext)
+{
+  if (!ext->runner)
+     return;
+
+  runner_wait (ext->runner);
+  ext_version_collect (ext, &cmake_probe, ext->cmake_id, &ext->cmake_exe, &ext->cmake_ver);
+  ext_version_collect (ext, &pkg_config_probe, ext->pkg_config_id, &ext->pkg_config_exe, &ext->pkg_config_ver);
+  runner_free (ext->runner);
+  ext->runner = NULL;
+}
+
 /*
  * Show version information for various programs.
  */
-static void show_ext_versions (void)
+static void show_ext_versions (const struct ext_versions *ext)
 {
   static const char *found_fmt[] = { "  Python %u.%u.%u detected",
                                      "  Cmake %u.%u.%u detected",
@@ -304,39 +513,39 @@ static void show_ext_versions (void)
 
   char           found [3][FOUND_SZ];
   int            pad_len, len [3] = { 0,0,0 };
-  const char     *py_exe = NULL, *pkg_config_exe = NULL;
-  char           *cmake_exe = NULL;
-  struct ver_info py_ver, cmake_ver, pkg_config_ver;
+  const char     *py_exe = NULL;
+  const char     *cmake_exe = ext->cmake_exe;
+  const char     *pkg_config_exe = ext->pkg_config_exe;
+  struct ver_info py_ver;
+  char            py_copy [_MAX_PATH];
+  char            slash = opt.show_unix_paths ? '/' : '\\';
 
   memset (&found, '\0', sizeof(found));
   memset (&py_ver, '\0', sizeof(py_ver));
-  memset (&cmake_ver, '\0', sizeof(cmake_ver));
-  memset (&pkg_config_ver, '\0', sizeof(pkg_config_ver));
 
   pad_len = sizeof("  pkg-config 9.99 detected");
 
   if (py_get_info(&py_exe, NULL, &py_ver))
   {
-    char py_copy [_MAX_PATH];
-
-    py_exe = slashify2 (py_copy, py_exe, opt.show_unix_paths ? '/' : '\\');
+    py_exe = slashify2 (py_copy, py_exe, slash);
     len[0] = snprintf (found[0], FOUND_SZ, found_fmt[0], py_ver.val_1, py_ver.val_2, py_ver.val_3);
     pad_len = len[0];
   }
 
-  if (get_cmake_info(&cmake_exe, &cmake_ver))
+  if (cmake_exe)
   {
-   /* Because searchpath() returns a static buffer
-    */
-    cmake_exe = STRDUP (cmake_exe);
-    len[1] = snprintf (found[1], FOUND_SZ, found_fmt[1], cmake_ver.val_1, cmake_ver.val_2, cmake_ver.val_3);
+    const struct ver_info *ver = &ext->cmake_ver;
+
+    len[1] = snprintf (found[1], FOUND_SZ, found_fmt[1], ver->val_1, ver->val_2, ver->val_3);
     if (len[1] > pad_len)
         pad_len = len[1];
   }
 
-  if (get_pkg_config_info(&pkg_config_exe, &pkg_config_ver))
+  if (pkg_config_exe)
   {
-    len[2] = snprintf (found[2], FOUND_SZ, found_fmt[2], pkg_config_ver.val_1, pkg_config_ver.val_2);
+    const struct ver_info *ver = &ext->pkg_config_ver;
+
+    len[2] = snprintf (found[2], FOUND_SZ, found_fmt[2], ver->val_1, ver->val_2);
     if (len[2] > pad_len)
         pad_len = len[2];
   }
@@ -346,91 +555,35 @@ static void show_ext_versions (void)
   else C_printf (not_found_fmt[0]);
 
   if (cmake_exe)
-       C_printf ("%-*s -> ~6%s~0\n", pad_len, found[1], cmake_exe);
+       C_printf ("%-*s -> ~6%s~0\n", pad_len, found[1], slashify(cmake_exe, slash));
   else C_printf (not_found_fmt[1]);
 
   if (pkg_config_exe)
-       C_printf ("%-*s -> ~6%s~0\n", pad_len, found[2], pkg_config_exe);
+       C_printf ("%-*s -> ~6%s~0\n", pad_len, found[2], slashify(pkg_config_exe, slash));
   else C_printf (not_found_fmt[2]);
-
-  FREE (cmake_exe);
-}
-
-/*
- * Hook-function for color.c functions.
- * Used to dump version-information to file-cache.
- */
-static BOOL  saw_newline;
-static FILE *fcache;
-
-static void write_hook (const char *buf)
-{
-  size_t len = strlen (buf);
-
-  if (len >= 1)
-  {
-    /* Put 'opt.cache_ver_level' only on lines after [\r\n] was seen
-     */
-    if (saw_newline)
-         fprintf (fcache, "%d:%s", opt.cache_ver_level, buf);
-    else fputs (buf, fcache);
-    saw_newline = (buf[len-1] == '\r' || buf[len-1] == '\n');
-  }
-}
-
-static void read_hook (smartlist_t *sl, const char *buf)
-{
-  int vlevel = (int)buf[0];
-
-  if (isdigit(vlevel) && buf[1] == ':')
-  {
-    if (opt.do_version >= vlevel - '0')
-       C_puts (buf+2);
-  }
-  else
-    C_puts (buf);
-  ARGSUSED (sl);
 }
 
 /*
  * Show some basic version information:    option '-V'.
  * Show more detailed version information: option '-VV'.
+ *
+ * The versions of external programs are kept in the cache-file
+ * ('SECTION_PYTHON' and 'SECTION_VERSION'). These are keyed on the
+ * program's file-name, size and time-stamp. So only the programs that
+ * changed since last time are probed again.
  */
 static int show_version (void)
 {
-  HWND         wnd;
-  BOOL         wow64 = is_wow64_active();
-  smartlist_t *vcache = NULL;
-
-  if (use_cache)
-  {
-    if (FILE_EXISTS(vcache_fname))
-    {
-      /* If file-cache exist, read from it and print it.
-       */
-      vcache = smartlist_read_file (vcache_fname, read_hook);
-      goto quit;
-    }
+  HWND                wnd;
+  BOOL                wow64 = is_wow64_active();
+  struct ext_versions ext;
 
-    /* Otherwise, create the cache's content
-     */
-    // opt.do_version = 3;
-    fcache = fopen (vcache_fname, "w+t");
-    if (fcache)
-    {
-      /* Initialised to TRUE so that the first line written gets
-       * a 'opt.cache_ver_level' prefix.
-       */
-      saw_newline = TRUE;
-      C_write_hook = write_hook;
-    }
-  }
-
-  opt.cache_ver_level = 1;
   C_printf ("%s.\n  Version ~3%s ~1(%s, %s%s)~0 by %s.\n  Hosted at: ~6%s~0\n",
             who_am_I, VER_STRING, compiler_version(), WIN_VERSTR,
             wow64 ? ", ~1WOW64" : "", AUTHOR_STR, GITHUB_STR);
 
+  ext_versions_probe (&ext);
+
   wnd = FindWindow (EVERYTHING_IPC_WNDCLASS, 0);
   if (wnd)
   {
@@ -448,12 +601,14 @@ static int show_version (void)
   py_init();
   C_printf ("\r                             \r");
 
-  show_ext_versions();
+  ext_versions_finish (&ext);
+
+  show_ext_versions (&ext);
+  FREE (ext.cmake_exe);
+  FREE (ext.pkg_config_exe);
 
   if (opt.do_version >= 2)
   {
-    opt.cache_ver_level = 2;
-
     C_printf ("  OS-version: %s (%s bits).\n", os_name(), os_bits());
     C_printf ("  User-name:  \"%s\", %slogged in as Admin.\n", get_user_name(), is_user_admin() ? "" : "not ");
 
@@ -469,14 +624,6 @@ static int show_version (void)
     C_printf ("\n  Pythons on ~3PATH~0:");
     py_searchpaths();
   }
-
-quit:
-  if (vcache)
-     smartlist_free (vcache);
-  if (fcache)
-     fclose (fcache);
-  fcache = NULL;
-  C_write_hook = NULL;
   return (0);
 }
 
@@ -516,6 +663,7 @@ static int show_help (void)
             "    ~6--python~0[~3=X~0]:   check and search in ~3%%PYTHONPATH%%~0 and ~3sys.path[]~0. ~2[3]~0\n"
             "    ~6--check~0         check for missing directories in ~6all~0 supported environment variables\n"
             "                    and missing files in ~3HKx\\Microsoft\\Windows\\CurrentVersion\\App Paths~0 keys.\n"
+            "    ~6--list-modules~0  list the installed modules of the ~6--python~0[~3=X~0] selected.\n"
             "\n"
             "  ~6Options~0:\n"
             "    ~6--no-gcc~0:       don't spawn " PFX_GCC " prior to checking.      ~2[2]~0\n"
@@ -525,15 +673,23 @@ static int show_help (void)
             "    ~6--no-usr~0:       don't scan ~3HKCU\\Environment~0.\n"
             "    ~6--no-app~0:       don't scan ~3HKCU\\" REG_APP_PATH "~0 and\n"
             "                               ~3HKLM\\" REG_APP_PATH "~0.\n"
+            "    ~6--no-cache~0:     don't use the results cached from earlier runs (refresh them).\n"
             "    ~6--no-colour~0:    don't print using colours.\n"
             "    ~6--no-watcom~0:    don't check for Watcom in ~6--include~0 or ~6--lib~0 mode\n"
             NO_ANSI
             "    ~6--owner~0:        shown owner of the file.\n"
+            "    ~6--hash~0:         hash the files found and report identical files and files\n"
+            "                    with the same name but different content.\n"
             "    ~6--pe~0:           print checksum and version-info for PE-files.\n"
             "    ~6--32~0:           tell " PFX_GCC " to return only 32-bit libs in ~6--lib~0 mode.\n"
             "                    report only 32-bit PE-files with ~6--pe~0 option.\n"
             "    ~6--64~0:           tell " PFX_GCC " to return only 64-bit libs in ~6--lib~0 mode.\n"
             "                    report only 64-bit PE-files with ~6--pe~0 option.\n"
+            "    ~6--stats~0[~3=file~0]: show the time spent in each phase and some counters at exit.\n"
+            "                    Or write them as JSON to ~3file~0.\n"
+            "    ~6--trace=file~0:   write a Chrome trace of the directory scans, child processes,\n"
+            "                    Python calls, PE-checks and ETP states to ~3file~0.\n"
+            "    ~6--threads=N~0:    use ~3N~0 worker-threads for ~6--pe~0 etc. (default is # of CPUs).\n"
             "    ~6-c~0:             don't add current directory to search-lists.\n"
             "    ~6-C~0:             be case-sensitive.\n"
             "    ~6-d~0, ~6--debug~0:    set debug level (~3-dd~0 sets ~3PYTHONVERBOSE=1~0 in ~6--python~0 mode).\n"
@@ -547,6 +703,7 @@ static int show_help (void)
             "                    the size of all files under directories matching ~6<file-spec>~0.\n"
             "    ~6-q~0, ~6--quiet~0:    disable warnings.\n"
             "    ~6-t~0:             do some internal tests.\n"
+            "    ~6--bench~0[~3=file~0]: run the micro-benchmarks and write the results as JSON to ~3file~0 or stdout.\n"
             "    ~6-T~0:             show file times in sortable decimal format. E.g. \"~620121107.180658~0\".\n"
             "    ~6-u~0:             show all paths on Unix format: \"~2c:/ProgramFiles/~0\".\n"
             "    ~6-v~0:             increase verbose level (currently only used in ~6--pe~0).\n"
@@ -587,72 +744,121 @@ static int show_help (void)
 }
 
 /*
- * Add the 'dir' to the 'dir_array' smartlist.
+ * Return a hash of 'dir' that is equal for names that 'str_equal()'
+ * says are equal. A FNV-1a hash.
+ */
+static DWORD dir_array_hash (const char *dir)
+{
+  DWORD hash = 2166136261UL;
+
+  for ( ; *dir; dir++)
+  {
+    hash ^= (BYTE) (opt.case_sensitive ? *dir : toupper((int)*dir));
+    hash *= 16777619UL;
+  }
+  return (hash);
+}
+
+/*
+ * Copy 'str' into the 'dir_array' string-pool and return its offset.
+ */
+static int dir_array_pool_add (const char *str)
+{
+  int ofs = vector_len (&dir_array.pool);
+
+  vector_add_n (&dir_array.pool, str, (int)strlen(str) + 1);
+  return (ofs);
+}
+
+/*
+ * Return the Cygwin POSIX form of entry 'i' or NULL if it has none.
+ */
+static const char *dir_array_cyg_dir (int i)
+{
+  int ofs = VECTOR_AT (&dir_array.cyg_dir, int, i);
+
+  return (ofs >= 0 ? VECTOR_DATA(&dir_array.pool, char) + ofs : NULL);
+}
+
+/*
+ * Add the 'dir' to the 'dir_array' columns.
  * 'is_cwd' == 1 if 'dir' == current working directory.
  *
  * Since this function could be called with a 'dir' from ExpandEnvironmentStrings(),
  * we check here if it returned with no '%'.
+ *
+ * Only the names with the same hash are compared when counting the duplicates.
  */
 void add_to_dir_array (const char *dir, int is_cwd, unsigned line)
 {
-  struct directory_array *d = CALLOC (1, sizeof(*d));
-  struct stat st;
-  int    max, i, exp_ok = (dir && *dir != '%');
-  BOOL   exists = FALSE;
-  BOOL   is_dir = FALSE;
+  struct stat  st;
+  const DWORD *hashes;
+  DWORD        hash;
+  BYTE         flags = 0;
+  int          max, i, num_dup = 0, cyg_ofs = -1, exp_ok = (dir && *dir != '%');
+  BOOL         exists = FALSE;
+  BOOL         is_dir = FALSE;
 
   if (safe_stat(dir, &st, NULL) == 0)
      is_dir = exists = _S_ISDIR (st.st_mode);
 
-  d->cyg_dir = NULL;
-  d->dir     = STRDUP (dir);
-  d->exp_ok  = exp_ok;
-  d->exist   = exp_ok && exists;
-  d->is_dir  = is_dir;
-  d->is_cwd  = is_cwd;
-  d->line    = line;
+  if (exp_ok)
+     flags |= DIR_EXP_OK;
+  if (exp_ok && exists)
+     flags |= DIR_EXIST;
+  if (is_dir)
+     flags |= DIR_IS_DIR;
+  if (is_cwd)
+     flags |= DIR_IS_CWD;
 
   /* Can we have >1 native dirs?
    */
-  d->is_native = (str_equal(dir,sys_native_dir) == 0);
+  if (str_equal(dir,sys_native_dir) == 0)
+     flags |= DIR_IS_NATIVE;
 
 #if (IS_WIN64)
-  if (d->is_native && !d->exist)  /* No access to this directory from WIN64; ignore */
+  if ((flags & DIR_IS_NATIVE) && !(flags & DIR_EXIST))  /* No access to this directory from WIN64; ignore */
   {
-    d->exist = d->is_dir = TRUE;
+    flags |= DIR_EXIST | DIR_IS_DIR;
     DEBUGF (2, "Ignore native dir '%s'.\n", dir);
   }
 #else
-  if (d->is_native && !have_sys_native_dir)
+  if ((flags & DIR_IS_NATIVE) && !have_sys_native_dir)
      DEBUGF (2, "Native dir '%s' doesn't exist.\n", dir);
-  else if (!d->exist)
+  else if (!(flags & DIR_EXIST))
      DEBUGF (2, "'%s' doesn't exist.\n", dir);
 #endif
 
 #if defined(__CYGWIN__)
   {
     char cyg_dir [_MAX_PATH];
-    int  rc = cygwin_conv_path (CCP_WIN_A_TO_POSIX, d->dir, cyg_dir, sizeof(cyg_dir));
+    int  rc = cygwin_conv_path (CCP_WIN_A_TO_POSIX, dir, cyg_dir, sizeof(cyg_dir));
 
     if (rc == 0)
-       d->cyg_dir = STRDUP (cyg_dir);
+       cyg_ofs = dir_array_pool_add (cyg_dir);
     DEBUGF (2, "cygwin_conv_path(): rc: %d, '%s'\n", rc, cyg_dir);
   }
 #endif
 
-  smartlist_add (dir_array, d);
-
-  if (is_cwd || !exp_ok)
-     return;
+  hash = dir_array_hash (dir);
+  max  = vector_len (&dir_array.hash);
 
-  max = smartlist_len (dir_array);
-  for (i = 0; i < max-1; i++)
+  if (!is_cwd && exp_ok)
   {
-    const struct directory_array *d2 = smartlist_get (dir_array, i);
-
-    if (!str_equal(dir,d2->dir))
-       d->num_dup++;
+    hashes = VECTOR_DATA (&dir_array.hash, DWORD);
+    for (i = 0; i < max; i++)
+    {
+      if (hashes[i] == hash && !str_equal(dir,DIR_NAME(i)))
+         num_dup++;
+    }
   }
+
+  VECTOR_ADD (&dir_array.flags, BYTE, flags);
+  VECTOR_ADD (&dir_array.num_dup, int, num_dup);
+  VECTOR_ADD (&dir_array.hash, DWORD, hash);
+  VECTOR_ADD (&dir_array.dir, int, dir_array_pool_add(dir));
+  VECTOR_ADD (&dir_array.cyg_dir, int, cyg_ofs);
+  VECTOR_ADD (&dir_array.line, unsigned, line);
 }
 
 static int dump_dir_array (const char *where, const char *note)
@@ -661,35 +867,17 @@ static int dump_dir_array (const char *where, const char *note)
 
   DEBUGF (2, "%s now%s\n", where, note);
 
-  max = smartlist_len (dir_array);
+  max = vector_len (&dir_array.flags);
   for (i = 0; i < max; i++)
   {
-    const struct directory_array *dir = smartlist_get (dir_array, i);
+    const char *cyg_dir = dir_array_cyg_dir (i);
 
     DEBUGF (2, "  dir_array[%d]: exist:%d, num_dup:%d, %s  %s\n",
-            (int)i, dir->exist, dir->num_dup, dir->dir, dir->cyg_dir ? dir->cyg_dir : "");
+            (int)i, DIR_HAS(i,DIR_EXIST), DIR_NUM_DUP(i), DIR_NAME(i), cyg_dir ? cyg_dir : "");
   }
   return (max);
 }
 
-/**
- * 'smartlist_make_uniq()' helper.
- * No need to use 'stricmp()' or 'str_equal()' since we already checked for
- * duplicates when items where added. Use that 'num_dup' count.
- */
-static int dir_array_compare (const void **_a, const void **_b)
-{
-  struct directory_array *a = *(struct directory_array **) _a;
-  struct directory_array *b = *(struct directory_array **) _b;
-
-  if (b->num_dup > 0)  /* this will get removed */
-  {
-    a->num_dup = 0;
-    return (0);
-  }
-  return (1);
-}
-
 /**
  * 'smartlist_wipe()' helper.
  * Free an item in the 'reg_array' smartlist.
@@ -704,32 +892,35 @@ static void reg_array_free (void *_r)
   FREE (r);
 }
 
-/**
- * 'smartlist_wipe()' and 'smartlist_make_uniq()' helper.
- * Free an item in the 'reg_array' smartlist.
- */
-static void dir_array_free (void *_d)
-{
-  struct directory_array *d = (struct directory_array*) _d;
-
-  FREE (d->dir);
-  FREE (d->cyg_dir);
-  FREE (d);
-}
-
 /**
  * The GNU-C report of directories is a mess. Especially all the duplicates and
  * non-canonical names. CygWin is more messy than others. So just remove the
  * duplicates.
  *
- * Loop over the 'dir_array' smartlist and remove all non-unique items.
+ * Remove the 'dir_array' entries that are duplicates of an earlier one.
+ * No need to use 'stricmp()' or 'str_equal()' since we already checked for
+ * duplicates when items where added. Use that 'num_dup' count.
+ * The names stay in the string-pool until 'free_dir_array()'.
  */
 static int make_unique_dir_array (const char *where)
 {
-  int old_len, new_len;
+  BYTE *keep;
+  int   i, old_len, new_len;
 
   old_len = dump_dir_array (where, ", non-unique");
-  smartlist_make_uniq (dir_array, dir_array_compare, dir_array_free);
+  if (old_len == 0)
+     return (0);
+
+  keep = alloca (old_len);
+  for (i = 0; i < old_len; i++)
+      keep[i] = (DIR_NUM_DUP(i) == 0);
+
+  vector_compact (&dir_array.flags, keep);
+  vector_compact (&dir_array.num_dup, keep);
+  vector_compact (&dir_array.hash, keep);
+  vector_compact (&dir_array.dir, keep);
+  vector_compact (&dir_array.cyg_dir, keep);
+  vector_compact (&dir_array.line, keep);
   new_len = dump_dir_array (where, ", unique");
   return (old_len - new_len);    /* This should always be 0 or positive */
 }
@@ -818,20 +1009,26 @@ static void free_reg_array (void)
 
 static void free_dir_array (void)
 {
-  smartlist_wipe (dir_array, dir_array_free);
+  vector_clear (&dir_array.flags);
+  vector_clear (&dir_array.num_dup);
+  vector_clear (&dir_array.hash);
+  vector_clear (&dir_array.dir);
+  vector_clear (&dir_array.cyg_dir);
+  vector_clear (&dir_array.line);
+  vector_clear (&dir_array.pool);
 }
 
 /*
- * Parses an environment string and returns all components as an array of
- * 'struct directory_array' pointing into the global 'dir_array[]'.
- * This works since  we handle only one env-var at a time. The 'dir_array[]'
+ * Parses an environment string into the global 'dir_array' and returns the
+ * number of components.
+ * This works since  we handle only one env-var at a time. The 'dir_array'
  * gets cleared in 'free_dir_array()' first (in case it was used already).
  *
  * Add current working directory first if 'opt.add_cwd' is TRUE.
  *
  * Convert CygWin style paths to Windows paths: "/cygdrive/x/.." -> "x:/.."
  */
-static smartlist_t *split_env_var (const char *env_name, const char *value)
+static int split_env_var (const char *env_name, const char *value)
 {
   char *tok, *val;
   int   is_cwd, max, i;
@@ -840,7 +1037,7 @@ static smartlist_t *split_env_var (const char *env_name, const char *value)
   if (!value)
   {
     DEBUGF (1, "split_env_var(\"%s\", NULL)' called!\n", env_name);
-    return (NULL);
+    return (0);
   }
 
   val = STRDUP (value);  /* Freed before we return */
@@ -939,7 +1136,7 @@ static smartlist_t *split_env_var (const char *env_name, const char *value)
   }
 
   FREE (val);
-  return (dir_array);
+  return vector_len (&dir_array.flags);
 }
 
 /*
@@ -991,15 +1188,41 @@ show_ver.c(587): Unable to access file "f:\ProgramFiler\Disk\MiniTool-PartitionW
 
  */
 
-static void print_PE_info (const char *file, BOOL chksum_ok,
-                           const struct ver_info *ver, enum Bitness bits)
+
+/**\struct PE_job
+ * A PE-file queued in \c PE_pipe.
+ * \c PE_job_work() fills in the results in a worker-thread and
+ * \c PE_job_done() prints them in the main thread.
+ */
+struct PE_job {
+       char                 *file;        /** the file as it will be printed */
+       char                 *header;      /** a copy of \c report_header (or NULL) */
+       const char           *note;        /** the registry note (or NULL) */
+       char                  size [40];   /** the size string from \c report_file() */
+       time_t                mtime;       /** the file-time */
+       enum Bitness          bits;        /** from \c check_if_PE() */
+       BOOL                  chksum_ok;   /** from \c sniff_PE_checksum() */
+       BOOL                  version_ok;  /** from \c get_PE_version_info() */
+       struct ver_info       ver;         /** ditto */
+       char                 *ver_trace;   /** ditto; only if \c opt.verbose >= 1 */
+       DWORD                 trust_rc;    /** from \c wintrust_check_r() */
+       struct wintrust_info  trust;       /** ditto */
+     };
+
+/**
+ * The pipeline for \c "--pe" checks. Created on the first PE-file reported.
+ */
+static struct task_pipe *PE_pipe = NULL;
+
+static void print_PE_info (const struct PE_job *job)
 {
   const char *filler = "      ";
-  char       *ver_trace, *line, *bitness;
+  const struct ver_info *ver = &job->ver;
+  char       *line, *bitness;
   char        trust_buf [200], *p = trust_buf;
   size_t      left = sizeof(trust_buf);
   int         raw;
-  DWORD       rc = wintrust_check (file, (opt.debug || opt.verbose) ? TRUE : FALSE, FALSE);
+  DWORD       rc = job->trust_rc;
 
   switch (rc)
   {
@@ -1020,23 +1243,22 @@ static void print_PE_info (const char *file, BOOL chksum_ok,
          break;
   }
 
-  if (wintrust_signer_subject)
-       snprintf (p, left, ", %s)~0.", wintrust_signer_subject);
+  if (job->trust.signer_subject)
+       snprintf (p, left, ", %s)~0.", job->trust.signer_subject);
   else snprintf (p, left, ")~0.");
 
-  bitness = (bits == bit_32) ? "~232" :
-            (bits == bit_64) ? "~364" : "~5?";
+  bitness = (job->bits == bit_32) ? "~232" :
+            (job->bits == bit_64) ? "~364" : "~5?";
 
   C_printf ("\n%sver ~6%u.%u.%u.%u~0, %s~0-bit, Chksum %s%s\n",
             filler, ver->val_1, ver->val_2, ver->val_3, ver->val_4,
-            bitness, chksum_ok ? "~2OK" : "~5fail", trust_buf);
+            bitness, job->chksum_ok ? "~2OK" : "~5fail", trust_buf);
 
-  ver_trace = get_PE_version_info_buf();
-  if (ver_trace)
+  if (job->ver_trace)
   {
     raw = C_setraw (1);  /* In case version-info contains a "~" (SFN). */
 
-    for (line = strtok(ver_trace,"\n"); line; line = strtok(NULL,"\n"))
+    for (line = strtok(job->ver_trace,"\n"); line; line = strtok(NULL,"\n"))
     {
       const char *colon  = strchr (line, ':');
       size_t      indent = strlen (filler);
@@ -1057,41 +1279,198 @@ static void print_PE_info (const char *file, BOOL chksum_ok,
       C_puts_long_line (line, indent);
     }
     C_setraw (raw);
-    get_PE_version_info_free();
   }
 }
 
-static int print_PE_file (const char *file, const char *note, const char *filler,
-                          const char *size, time_t mtime)
+/**
+ * How long (in seconds) a verdict that depends on the trust-store of this
+ * machine is reused. A certificate can be revoked or a root-certificate
+ * added or removed without the file changing.
+ */
+#define TRUST_CACHE_MAX_AGE  (24*3600)
+
+/**
+ * Return TRUE if the verdict \c rc depends only on the content of the file.
+ */
+static BOOL trust_verdict_is_static (DWORD rc)
+{
+  return (rc == TRUST_E_NOSIGNATURE || rc == TRUST_E_SUBJECT_FORM_UNKNOWN ||
+          rc == TRUST_E_BAD_DIGEST);
+}
+
+/**
+ * A cached \c wintrust_check_r().
+ *
+ * The verdict is stored in \c SECTION_TRUST of the cache together with
+ * the Authenticode SHA-256 digest of the file. Hence it's only reused while
+ * the file has the same size, modification-time \b and content. Computing
+ * the digest is much cheaper than \c WinVerifyTrust() which must do the same
+ * hashing and then verify the certificate chain.
+ *
+ * A verdict that depends only on the content is reused as long as the
+ * file is unchanged. The others (like \c ERROR_SUCCESS or
+ * \c TRUST_E_EXPLICIT_DISTRUST) depend on the trust-store and revocation
+ * state too; these are reused for \c TRUST_CACHE_MAX_AGE only.
+ * Use \c "--no-cache" to verify everything again.
+ *
+ * A file without a certificate table is "not signed" without asking
+ * \c WinVerifyTrust() at all.
+ */
+static DWORD PE_trust_check (const char *file, struct wintrust_info *info)
+{
+  struct pe_file pe;
+  BYTE        digest [SHA256_DIGEST_SIZE];
+  char        hex [2*SHA256_DIGEST_SIZE+1];
+  char       *value;
+  size_t      dir_ofs, cert_ofs;
+  DWORD       cert_size, rc;
+  BOOL        details = (opt.debug || opt.verbose) ? TRUE : FALSE;
+  BOOL        have_digest = FALSE;
+
+  if (pe_open(&pe, file))
+  {
+    if (pe_get_certificates(&pe, &dir_ofs, &cert_ofs, &cert_size) && cert_size == 0)
+    {
+      pe_close (&pe);
+      memset (info, '\0', sizeof(*info));
+      return (TRUST_E_NOSIGNATURE);
+    }
+    have_digest = pe_authenticode_digest (&pe, SHA_256, digest);
+    pe_close (&pe);
+  }
+
+  if (!have_digest)
+     return wintrust_check_r (file, details, FALSE, info);
+
+  sha_hex (digest, sizeof(digest), hex);
+
+  /* The value is "<digest> <verdict> <time stored> <signer>".
+   * One record per file; it's replaced when the file changes.
+   */
+  value = cache_get (SECTION_TRUST, file, "authenticode");
+  if (value)
+  {
+    char   cached_hex [2*SHA256_DIGEST_SIZE+1];
+    u_long cached_rc;
+    INT64  stored;
+    int    len = 0;
+
+    if (sscanf(value, "%64s %lx %" S64_FMT " %n", cached_hex, &cached_rc, &stored, &len) == 3 &&
+        len > 0 && !strcmp(cached_hex, hex) &&
+        (trust_verdict_is_static(cached_rc) || (INT64)time(NULL) - stored < TRUST_CACHE_MAX_AGE) &&
+        (!details || value[len] || cached_rc != ERROR_SUCCESS))
+    {
+      /* A verdict cached without the signer details is no good if we need them.
+       */
+      memset (info, '\0', sizeof(*info));
+      if (value[len])
+         info->signer_subject = STRDUP (value + len);
+      FREE (value);
+      return (cached_rc);
+    }
+    FREE (value);
+  }
+
+  rc = wintrust_check_r (file, details, FALSE, info);
+  switch (rc)
+  {
+    case ERROR_SUCCESS:
+    case TRUST_E_NOSIGNATURE:
+    case TRUST_E_SUBJECT_FORM_UNKNOWN:
+    case TRUST_E_BAD_DIGEST:
+    case TRUST_E_PROVIDER_UNKNOWN:
+    case TRUST_E_SUBJECT_NOT_TRUSTED:
+    case TRUST_E_EXPLICIT_DISTRUST:
+         cache_putf (SECTION_TRUST, file, "authenticode", "%s %08lX %" S64_FMT " %s",
+                     hex, (u_long)rc, (INT64)time(NULL),
+                     info->signer_subject ? info->signer_subject : "");
+         break;
+  }
+  return (rc);
+}
+
+/**
+ * The job-function for \c task_pipe_new().
+ * Does the slow checks on a PE-file. Must not print anything.
+ */
+static void PE_job_work (void *arg)
+{
+  struct PE_job *job = (struct PE_job*) arg;
+  DWORD  calc_sum;
+
+  TRACE_BEGIN ("PE", job->file);
+  job->chksum_ok  = sniff_PE_checksum (job->file, &calc_sum);
+  job->version_ok = get_PE_version_info (job->file, &job->ver,
+                                         opt.verbose >= 1 ? &job->ver_trace : NULL);
+  job->trust_rc   = PE_trust_check (job->file, &job->trust);
+  TRACE_END ("PE");
+}
+
+/**
+ * The done-function for \c task_pipe_new().
+ * Print the results of a \c PE_job in the order they were found.
+ */
+static void PE_job_done (void *arg)
+{
+  struct PE_job *job = (struct PE_job*) arg;
+  const char    *filler = "      ";
+  int            raw;
+
+  if (job->version_ok)
+     num_version_ok++;
+
+  if (job->header)
+     C_printf ("~3%s~0", job->header);
+
+  C_printf ("~3%s~0%s%s: ", job->note ? job->note : filler, get_time_str(job->mtime), job->size);
+  raw = C_setraw (1);
+  C_puts (job->file);
+  C_setraw (raw);
+  print_PE_info (job);
+  C_putc ('\n');
+
+  wintrust_info_free (&job->trust);
+  FREE (job->ver_trace);
+  FREE (job->header);
+  FREE (job->file);
+  FREE (job);
+}
+
+/**
+ * Queue a PE-file for the slow checks in \c PE_pipe.
+ * The quick checks for the PE-signature and bitness are done here since
+ * these decide the return value. The header of the file is most likely
+ * in the sniff-cache already.
+ */
+static int print_PE_file (const char *file, const char *note, const char *size, time_t mtime)
 {
-  struct ver_info ver;
-  enum Bitness    bits;
-  BOOL            chksum_ok  = FALSE;
-  BOOL            version_ok = FALSE;
-  int             raw;
+  struct PE_job *job;
+  enum Bitness   bits;
 
   if (!check_if_PE(file,&bits))
      return (0);
 
-  memset (&ver, 0, sizeof(ver));
-
   if (opt.only_32bit && bits != bit_32)
      return (0);
 
   if (opt.only_64bit && bits != bit_64)
      return (0);
 
-  chksum_ok  = verify_PE_checksum (file);
-  version_ok = get_PE_version_info (file, &ver);
-  if (version_ok)
-     num_version_ok++;
+  job = CALLOC (1, sizeof(*job));
+  job->file   = STRDUP (file);
+  job->header = report_header ? STRDUP (report_header) : NULL;
+  job->note   = note;
+  job->mtime  = mtime;
+  job->bits   = bits;
+  _strlcpy (job->size, size, sizeof(job->size));
+  report_header = NULL;
 
-  C_printf ("~3%s~0%s%s: ", note ? note : filler, get_time_str(mtime), size);
-  raw = C_setraw (1);
-  C_puts (file);
-  C_setraw (raw);
-  print_PE_info (file, chksum_ok, &ver, bits);
-  C_putc ('\n');
+  if (!PE_pipe)
+  {
+    cache_init();   /* before the jobs use it */
+    PE_pipe = task_pipe_new (0, PE_job_work, PE_job_done);
+  }
+  task_pipe_submit (PE_pipe, job);
   return (1);
 }
 
@@ -1135,11 +1514,11 @@ UINT64 get_directory_size (const char *dir)
  * to align up more nicely.
  * Not ideal since we don't know the length of all files we need to report.
  */
-static int get_trailing_indent (const char *file)
+static int get_trailing_indent (size_t file_len)
 {
   static int longest_file_so_far = 0;
   static int indent = 0;
-  int    len = (int) strlen (file);
+  int    len = (int) file_len;
 
   if (longest_file_so_far == 0 || len > longest_file_so_far)
      longest_file_so_far = len;
@@ -1168,6 +1547,9 @@ int report_file (const char *file, time_t mtime, UINT64 fsize,
   int         raw;
   BOOL        have_it = TRUE;
   BOOL        show_dir_size = TRUE;
+  pathview_t  pv;
+  char        pv_buf [_MAX_PATH+1];
+  size_t      file_len;
 
   if (key == HKEY_CURRENT_USER)
   {
@@ -1247,23 +1629,37 @@ int report_file (const char *file, time_t mtime, UINT64 fsize,
   else
     size[0] = '\0';
 
+  pathview_init (&pv, pv_buf, sizeof(pv_buf));
   if (key != HKEY_PYTHON_EGG)
   {
-    char  buf [_MAX_PATH];
-    char *p = _fix_path (file, NULL);  /* Has '\\' slashes */
+    pathview_full (&pv, file);  /* Has '\\' slashes */
+    if (opt.show_unix_paths)
+       pathview_slashify (&pv, '/');
+    file     = pv.buf;
+    file_len = pv.len;
+  }
+  else
+    file_len = strlen (file);
 
-    file = slashify2 (buf, p, opt.show_unix_paths ? '/' : '\\');
-    FREE (p);
+  if (opt.PE_check && key != HKEY_INC_LIB_FILE && key != HKEY_MAN_FILE && key != HKEY_EVERYTHING_ETP)
+  {
+    BOOL rc = print_PE_file (file, note, size, mtime);
+
+    if (rc && opt.do_hash)
+       dups_add (file, fsize, mtime);
+    pathview_free (&pv);
+    return (rc ? 1 : 0);
   }
 
+  /* Any queued PE-files must be printed before this one.
+   */
+  task_pipe_flush (PE_pipe);
+
   if (report_header)
      C_printf ("~3%s~0", report_header);
 
   report_header = NULL;
 
-  if (opt.PE_check && key != HKEY_INC_LIB_FILE && key != HKEY_MAN_FILE && key != HKEY_EVERYTHING_ETP)
-     return print_PE_file (file, note, filler, size, mtime);
-
   C_printf ("~3%s~0%s%s: ", note ? note : filler, get_time_str(mtime), size);
 
   /* The remote 'file' from EveryThing is not something Windows knows
@@ -1293,37 +1689,189 @@ int report_file (const char *file, time_t mtime, UINT64 fsize,
    */
   if (is_dir)
   {
-    const char *end = strchr (file, '\0');
-
-    if (end > file && end[-1] != '\\' && end[-1] != '/')
+    if (file_len > 0 && !IS_SLASH(file[file_len-1]))
        C_putc (opt.show_unix_paths ? '/' : '\\');
   }
   else if (key == HKEY_MAN_FILE)
   {
     const char *link = get_man_link (file);
 
-    if (!link)
-       link = get_gzip_link (file);
     if (link)
-       C_printf ("%*s(%s)", get_trailing_indent(file), " ", link);
+       C_printf ("%*s(%s)", get_trailing_indent(file_len), " ", link);
   }
   else
   {
     const char *shebang = check_if_shebang (file);
 
     if (shebang)
-       C_printf ("%*s(%s)", get_trailing_indent(file), " ", shebang);
+       C_printf ("%*s(%s)", get_trailing_indent(file_len), " ", shebang);
   }
 
   C_putc ('\n');
+
+  /* The remote and .egg files can not be hashed.
+   */
+  if (opt.do_hash && !is_dir && key != HKEY_PYTHON_EGG && key != HKEY_EVERYTHING_ETP)
+     dups_add (file, fsize, mtime);
+  pathview_free (&pv);
   return (1);
 }
 
+/*
+ * Start timing a phase for option "--stats".
+ */
+static UINT64 phase_begin (void)
+{
+  return (opt.do_stats ? get_time_ns() : 0);
+}
+
+/*
+ * Add the time since 'start' to the phase "name" or "name(arg)".
+ * A phase run more than once (e.g. for each ETP-host) is summed up.
+ */
+static void phase_end (UINT64 start, const char *name, const char *arg)
+{
+  struct stat_phase *ph;
+  char   buf [200];
+  UINT64 now;
+  int    i, max;
+
+  if (!opt.do_stats)
+     return;
+
+  now = get_time_ns();
+  if (arg)
+  {
+    snprintf (buf, sizeof(buf), "%s(%s)", name, arg);
+    name = buf;
+  }
+
+  max = smartlist_len (stat_phases);
+  for (i = 0; i < max; i++)
+  {
+    ph = smartlist_get (stat_phases, i);
+    if (!strcmp(ph->name, name))
+       break;
+  }
+  if (i == max)
+  {
+    ph = CALLOC (1, sizeof(*ph));
+    ph->name = STRDUP (name);
+    smartlist_add (stat_phases, ph);
+  }
+  ph->nsec += now - start;
+  ph->calls++;
+}
+
+/**
+ * 'smartlist_wipe()' helper.
+ * Free an item in the 'stat_phases' smartlist.
+ */
+static void stat_phase_free (void *_ph)
+{
+  struct stat_phase *ph = (struct stat_phase*) _ph;
+
+  FREE (ph->name);
+  FREE (ph);
+}
+
+/*
+ * Write the phases and counters as JSON to 'opt.stats_file'.
+ */
+static void write_stats_json (const char **names, const UINT64 *values, int num, UINT64 total)
+{
+  FILE *f = fopen (opt.stats_file, "wt");
+  int   i, max = smartlist_len (stat_phases);
+
+  if (!f)
+  {
+    WARN ("Failed to create \"%s\"; %s.\n", opt.stats_file, strerror(errno));
+    return;
+  }
+
+  fprintf (f, "{\n  \"total_msec\": %.3f,\n  \"phases\": [\n", (double)total / 1E6);
+  for (i = 0; i < max; i++)
+  {
+    const struct stat_phase *ph = smartlist_get (stat_phases, i);
+    const char *s;
+    char  name [2*_MAX_PATH];
+    char *p = name;
+
+    /* Escape the '\\' and '"' in a host or environment name.
+     */
+    for (s = ph->name; *s && p < name + sizeof(name) - 2; s++)
+    {
+      if (*s == '\\' || *s == '"')
+         *p++ = '\\';
+      *p++ = *s;
+    }
+    *p = '\0';
+    fprintf (f, "    { \"name\": \"%s\", \"msec\": %.3f, \"calls\": %u }%s\n",
+             name, (double)ph->nsec / 1E6, ph->calls, i < max-1 ? "," : "");
+  }
+
+  fputs ("  ],\n  \"counters\": {\n", f);
+  for (i = 0; i < num; i++)
+      fprintf (f, "    \"%s\": %" U64_FMT "%s\n", names[i], values[i], i < num-1 ? "," : "");
+  fputs ("  }\n}\n", f);
+  fclose (f);
+}
+
+/*
+ * Print the time spent in each phase and the counters for option "--stats".
+ * Or write them as JSON with "--stats=file".
+ */
+static void print_stats (void)
+{
+  static const char *names [STAT_MAX + 2] = {
+                    "dirs_opened",
+                    "entries_examined",
+                    "safe_stat_calls",
+                    "pattern_matches",
+                    "processes_spawned",
+                    "bytes_received",
+                    "bytes_written"
+                  };
+  UINT64 values [DIM(names)];
+  UINT64 total;
+  int    i, max = smartlist_len (stat_phases);
+
+  C_flush();
+  total = get_time_ns() - stat_start_ns;
+  for (i = 0; i < STAT_MAX; i++)
+      values[i] = (UINT64) stat_counters[i];
+  values [STAT_MAX]   = ETP_total_rcv;
+  values [STAT_MAX+1] = C_bytes_written;
+
+  if (opt.stats_file)
+  {
+    write_stats_json (names, values, DIM(names), total);
+    return;
+  }
+
+  C_printf ("\n  %-40s %12s %7s\n", "Phase", "msec", "calls");
+  for (i = 0; i < max; i++)
+  {
+    const struct stat_phase *ph = smartlist_get (stat_phases, i);
+
+    C_printf ("  %-40.40s %12.3f %7u\n", ph->name, (double)ph->nsec / 1E6, ph->calls);
+  }
+  C_printf ("  %-40s %12.3f\n\n", "total", (double)total / 1E6);
+
+  for (i = 0; i < DIM(names); i++)
+      C_printf ("  %-40s %12s\n", names[i], qword_str(values[i]));
+}
+
 static void final_report (int found)
 {
   BOOL do_warn = FALSE;
   char duplicates [50] = "";
 
+  task_pipe_flush (PE_pipe);
+
+  if (opt.do_hash)
+     dups_report();
+
   if ((found_in_hkey_current_user || found_in_hkey_current_user_env ||
        found_in_hkey_local_machine || found_in_hkey_local_machine_sess_man) &&
        found_in_default_env)
@@ -1384,6 +1932,9 @@ static void final_report (int found)
     C_printf (" %d have PE-version info. %d are verified.", num_version_ok, num_verified);
   }
   C_putc ('\n');
+
+  if (opt.do_stats)
+     print_stats();
 }
 
 /**
@@ -1668,17 +2219,12 @@ static void scan_reg_environment (HKEY top_key, const char *sub_key,
 
 static int do_check_env2 (HKEY key, const char *env, const char *value)
 {
-  smartlist_t *list = split_env_var (env, value);
-  int          found = 0;
-  int          i, max = list ? smartlist_len (list) : 0;
+  int found = 0;
+  int i, max = split_env_var (env, value);
 
   for (i = 0; i < max; i++)
-  {
-    const struct directory_array *arr = smartlist_get (list, i);
-
-    found += process_dir (arr->dir, arr->num_dup, arr->exist, arr->check_empty,
-                          arr->is_dir, arr->exp_ok, env, key, FALSE);
-  }
+     found += process_dir (DIR_NAME(i), DIR_NUM_DUP(i), DIR_HAS(i,DIR_EXIST), DIR_HAS(i,DIR_CHECK_EMPTY),
+                           DIR_HAS(i,DIR_IS_DIR), DIR_HAS(i,DIR_EXP_OK), env, key, FALSE);
   free_dir_array();
   return (found);
 }
@@ -1795,8 +2341,10 @@ static int do_check_registry (void)
  *
  * \note It is quite normal that e.g. \c "%INCLUDE" contain a directory with
  *       no .h-files but at least 1 subdirectory with .h-files.
+ *
+ * If \c quiet, nothing is printed. For the jobs in \c tasks_run_list().
  */
-static BOOL dir_is_empty (const char *env_var, const char *dir)
+static BOOL dir_is_empty (const char *env_var, const char *dir, BOOL quiet)
 {
   HANDLE          handle;
   WIN32_FIND_DATA ff_data;
@@ -1815,7 +2363,8 @@ static BOOL dir_is_empty (const char *env_var, const char *dir)
   }
   while (num_entries == 0 && FindNextFile(handle, &ff_data));
 
-  DEBUGF (3, "%s(): at least %d entries in '%s'.\n", __FUNCTION__, num_entries, dir);
+  if (!quiet)
+     DEBUGF (3, "%s(): at least %d entries in '%s'.\n", __FUNCTION__, num_entries, dir);
   FindClose (handle);
   return (num_entries == 0);
 }
@@ -1841,6 +2390,164 @@ static BOOL regex_match (const char *str)
   return (FALSE);
 }
 
+/**\struct deferred_file
+ * A match in 'process_dir()' that is reported after all matches in the
+ * directory are known. Used for man-pages; all the matching files can
+ * then be sniffed (and their links resolved) in parallel.
+ */
+struct deferred_file {
+       char   *file;
+       time_t  mtime;
+       UINT64  fsize;
+       BOOL    is_dir;
+       BOOL    is_junction;
+     };
+
+/*
+ * The 'deferred_file' is allocated from 'arena'. Since an arena is not
+ * thread-safe, a worker-thread must use its own.
+ */
+static void defer_report (smartlist_t *deferred, arena_t *arena, const char *file,
+                          const struct stat *st, BOOL is_dir, BOOL is_junction)
+{
+  struct deferred_file *df = arena_alloc (arena, sizeof(*df));
+
+  df->file        = arena_strdup (arena, file);
+  df->mtime       = st->st_mtime;
+  df->fsize       = st->st_size;
+  df->is_dir      = is_dir;
+  df->is_junction = is_junction;
+  smartlist_add (deferred, df);
+}
+
+static int report_deferred (smartlist_t *deferred, HKEY key)
+{
+  smartlist_t *files = smartlist_new();
+  int          i, found = 0, max = smartlist_len (deferred);
+
+  for (i = 0; i < max; i++)
+  {
+    const struct deferred_file *df = smartlist_get (deferred, i);
+
+    smartlist_add (files, df->file);
+  }
+  sniff_prefetch (files);
+  smartlist_free (files);
+
+  for (i = 0; i < max; i++)
+  {
+    struct deferred_file *df = smartlist_get (deferred, i);
+
+    if (report_file(df->file, df->mtime, df->fsize, df->is_dir, df->is_junction, key))
+       found++;
+  }
+  smartlist_free (deferred);
+  return (found);
+}
+
+/*
+ * The 'FindFirstFile()' spec and the sub-dir part of 'opt.file_spec'.
+ * Set by 'dir_spec_init()' on the main-thread; 'opt.file_spec' is constant
+ * throughout the program.
+ */
+static char *dir_fspec  = NULL;
+static char *dir_subdir = NULL;  /* Looking for a 'opt.file_spec' with a sub-dir part in it. */
+
+static void dir_spec_init (void)
+{
+  if (!dir_fspec)
+     dir_fspec = opt.use_regex ? "*" : fix_filespec (&dir_subdir);
+}
+
+/*
+ * Set 'fqfn' to the "path\<subdir><fspec>" to give to 'FindFirstFile()'.
+ * Returns the length of the "path\" prefix. This is the same for all
+ * entries; hence it's normalised only once.
+ * With '--regex', the match is on the path as given.
+ */
+static size_t dir_spec_path (pathview_t *fqfn, const char *path)
+{
+  const char dir_sep = DIR_SEP;
+  size_t     prefix_len;
+
+  pathview_set (fqfn, path, strlen(path));
+  pathview_append (fqfn, &dir_sep, 1);
+  if (!opt.use_regex)
+  {
+    pathview_slashify (fqfn, DIR_SEP);
+    pathview_fix_drive (fqfn);
+  }
+  prefix_len = fqfn->len;
+
+  if (dir_subdir)
+     pathview_append (fqfn, dir_subdir, strlen(dir_subdir));
+  pathview_append (fqfn, dir_fspec, strlen(dir_fspec));
+  return (prefix_len);
+}
+
+/*
+ * Set 'fqfn' to the "path\<subdir><name>" of a 'FindFirstFile()' entry.
+ */
+static void dir_entry_path (pathview_t *fqfn, size_t prefix_len, const char *name)
+{
+  pathview_truncate (fqfn, prefix_len);
+  if (dir_subdir)
+     pathview_append (fqfn, dir_subdir, strlen(dir_subdir));
+  pathview_append (fqfn, name, strlen(name));
+}
+
+/*
+ * The match-step of 'process_dir()' and 'scan_man_section()'.
+ * Match the entry in 'fqfn' (from 'dir_entry_path()') against 'opt.file_spec'.
+ * Returns TRUE and fills 'st' if it's a match that can be stat'ed.
+ *
+ * If 'quiet', nothing is printed. 'scan_man_section()' runs in a worker-thread
+ * and must not print.
+ */
+static BOOL dir_entry_match (pathview_t *fqfn, size_t prefix_len, BOOL is_dir,
+                             BOOL is_junction, BOOL quiet, struct stat *st)
+{
+  DWORD win_err;
+  const char *base = fqfn->buf + prefix_len;
+  int         match = fnmatch (opt.file_spec, base, fnmatch_case(0) | FNM_FLAG_NOESCAPE);
+
+#if 0
+  if (match == FNM_NOMATCH && strchr(opt.file_spec,'~'))
+  {
+    /* The case where 'opt.file_spec' is a SFN, fnmatch() doesn't work.
+     * What to do?
+     */
+  }
+  else
+#endif
+
+  if (match == FNM_NOMATCH)
+  {
+    /* The case where 'base' is a dotless file, fnmatch() doesn't work.
+     * I.e. if 'opt.file_spec' == "ratio.*" and base == "ratio", we qualify
+     *      this as a match.
+     */
+    if (!is_dir && !opt.dir_mode && !opt.man_mode &&
+        !str_equal_n(base,opt.file_spec,fqfn->len - prefix_len))
+       match = FNM_MATCH;
+  }
+
+  /* Only a 'subdir' can have slashes that are not normalised yet.
+   */
+  if (dir_subdir)
+     pathview_slashify (fqfn, DIR_SEP);
+
+  if (!quiet)
+     DEBUGF (1, "Testing \"%s\". is_dir: %d, is_junction: %d, %s\n",
+             fqfn->buf, is_dir, is_junction, fnmatch_res(match));
+
+  if (match != FNM_MATCH)
+     return (FALSE);
+
+  STAT_INC (STAT_MATCHES);
+  return (safe_stat(fqfn->buf, st, quiet ? &win_err : NULL) == 0);
+}
+
 /*
  * Process directory specified by 'path' and report any matches
  * to the global 'opt.file_spec'.
@@ -1851,13 +2558,12 @@ int process_dir (const char *path, int num_dup, BOOL exist, BOOL check_empty,
 {
   HANDLE          handle;
   WIN32_FIND_DATA ff_data;
-  char            fqfn  [_MAX_PATH];  /* Fully qualified file-name */
+  pathview_t      fqfn;               /* Fully qualified file-name */
+  char            fqfn_buf [_MAX_PATH+1];
+  size_t          prefix_len;
   int             found = 0;
-
-  /* We need to set these only once; 'opt.file_spec' is constant throughout the program.
-   */
-  static char *fspec  = NULL;
-  static char *subdir = NULL;  /* Looking for a 'opt.file_spec' with a sub-dir part in it. */
+  smartlist_t    *deferred = NULL;
+  arena_mark_t    mark;
 
   if (num_dup > 0)
   {
@@ -1890,44 +2596,54 @@ int process_dir (const char *path, int num_dup, BOOL exist, BOOL check_empty,
     return (0);
   }
 
-  if (check_empty && is_dir && dir_is_empty(prefix,path))
+  if (check_empty && is_dir && dir_is_empty(prefix,path,FALSE))
      WARN ("%s: directory \"%s\" is empty.\n", prefix, path);
 
-  if (!fspec)
-     fspec = opt.use_regex ? "*" : fix_filespec (&subdir);
+  dir_spec_init();
+  pathview_init (&fqfn, fqfn_buf, sizeof(fqfn_buf));
+  prefix_len = dir_spec_path (&fqfn, path);
 
-  snprintf (fqfn, sizeof(fqfn), "%s%c%s%s", path, DIR_SEP, subdir ? subdir : "", fspec);
-  handle = FindFirstFile (fqfn, &ff_data);
+  TRACE_BEGIN ("dir", path);
+  handle = FindFirstFile (fqfn.buf, &ff_data);
   if (handle == INVALID_HANDLE_VALUE)
   {
-    DEBUGF (1, "\"%s\" not found.\n", fqfn);
+    DEBUGF (1, "\"%s\" not found.\n", fqfn.buf);
+    pathview_free (&fqfn);
+    TRACE_END ("dir");
     return (0);
   }
+  STAT_INC (STAT_DIRS_OPENED);
+
+  if (key == HKEY_MAN_FILE && !opt.use_regex)
+     deferred = smartlist_new();
+
+  mark = arena_mark (scratch_arena);
 
   do
   {
     struct stat   st;
-    char  *base, *file;
-    int    match, len;
     BOOL   is_junction;
     BOOL   ignore = opt.use_regex &&
                     ((ff_data.cFileName[0] == '.' && ff_data.cFileName[1] == '\0') ||
                     !strcmp(ff_data.cFileName,".."));
+
+    STAT_INC (STAT_ENTRIES);
     if (ignore)
        continue;
 
-    len  = snprintf (fqfn, sizeof(fqfn), "%s%c", path, DIR_SEP);
-    base = fqfn + len;
-    snprintf (base, sizeof(fqfn)-len, "%s%s", subdir ? subdir : "", ff_data.cFileName);
-
+    dir_entry_path (&fqfn, prefix_len, ff_data.cFileName);
     is_dir      = ((ff_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
     is_junction = ((ff_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0);
 
     if (opt.use_regex)
     {
-      if (regex_match(fqfn) && safe_stat(fqfn, &st, NULL) == 0)
+      if (!regex_match(fqfn.buf))
+         continue;
+
+      STAT_INC (STAT_MATCHES);
+      if (safe_stat(fqfn.buf, &st, NULL) == 0)
       {
-        if (report_file(fqfn, st.st_mtime, st.st_size, is_dir, is_junction, key))
+        if (report_file(fqfn.buf, st.st_mtime, st.st_size, is_dir, is_junction, key))
         {
           found++;
        // regex_print (&re_hnd, re_matches, fqfn);
@@ -1936,42 +2652,22 @@ int process_dir (const char *path, int num_dup, BOOL exist, BOOL check_empty,
       continue;
     }
 
-    file  = slashify (fqfn, DIR_SEP);
-    match = fnmatch (opt.file_spec, base, fnmatch_case(0) | FNM_FLAG_NOESCAPE);
-
-#if 0
-    if (match == FNM_NOMATCH && strchr(opt.file_spec,'~'))
-    {
-      /* The case where 'opt.file_spec' is a SFN, fnmatch() doesn't work.
-       * What to do?
-       */
-    }
-    else
-#endif
-
-    if (match == FNM_NOMATCH)
-    {
-      /* The case where 'base' is a dotless file, fnmatch() doesn't work.
-       * I.e. if 'opt.file_spec' == "ratio.*" and base == "ratio", we qualify
-       *      this as a match.
-       */
-      if (!is_dir && !opt.dir_mode && !opt.man_mode &&
-          !str_equal_n(base,opt.file_spec,strlen(base)))
-         match = FNM_MATCH;
-    }
-
-    DEBUGF (1, "Testing \"%s\". is_dir: %d, is_junction: %d, %s\n",
-            file, is_dir, is_junction, fnmatch_res(match));
+    if (!dir_entry_match(&fqfn, prefix_len, is_dir, is_junction, FALSE, &st))
+       continue;
 
-    if (match == FNM_MATCH && safe_stat(file, &st, NULL) == 0)
-    {
-      if (report_file(file, st.st_mtime, st.st_size, is_dir, is_junction, key))
-         found++;
-    }
+    if (deferred)
+       defer_report (deferred, scratch_arena, fqfn.buf, &st, is_dir, is_junction);
+    else if (report_file(fqfn.buf, st.st_mtime, st.st_size, is_dir, is_junction, key))
+       found++;
   }
   while (FindNextFile(handle, &ff_data));
 
   FindClose (handle);
+  if (deferred)
+     found += report_deferred (deferred, key);
+  arena_reset (scratch_arena, mark);
+  pathview_free (&fqfn);
+  TRACE_END ("dir");
   ARGSUSED (recursive);
   return (found);
 }
@@ -2131,6 +2827,7 @@ static int do_check_evry (void)
   char *base  = NULL;
   int   len, found = 0;
   HWND  wnd;
+  arena_mark_t mark;
 
   wnd = FindWindow (EVERYTHING_IPC_WNDCLASS, 0);
   num_evry_dups = 0;
@@ -2151,9 +2848,10 @@ static int do_check_evry (void)
   /* EveryThing seems not to support '\\'. Must split the 'opt.file_spec'
    * into a 'dir' and 'base' part.
    */
+  mark = arena_mark (scratch_arena);
   if (strpbrk(opt.file_spec, "/\\"))
   {
-    dir  = dirname (opt.file_spec);   /* Allocates memory */
+    dir  = arena_dirname (scratch_arena, opt.file_spec);
     base = basename (opt.file_spec);
   }
 
@@ -2177,7 +2875,7 @@ static int do_check_evry (void)
      snprintf (query+len, sizeof(query)-len, "content: %s", opt.evry_grep);
 #endif
 
-  FREE (dir);
+  arena_reset (scratch_arena, mark);
 
   Everything_SetMatchCase (opt.case_sensitive);
 
@@ -2326,10 +3024,10 @@ static int do_check_evry (void)
  */
 static int do_check_env (const char *env_name, BOOL recursive)
 {
-  smartlist_t *list;
-  int          i, max, found = 0;
-  BOOL         check_empty = FALSE;
-  char        *orig_e = getenv_expand (env_name);
+  UINT64 start = phase_begin();
+  int    i, max, found = 0;
+  BOOL   check_empty = FALSE;
+  char  *orig_e = getenv_expand (env_name);
 
   if (!orig_e)
   {
@@ -2345,55 +3043,193 @@ static int do_check_env (const char *env_name, BOOL recursive)
       !strcmp(env_name,"CPLUS_INCLUDE_PATH"))
     check_empty = TRUE;
 
-  list = split_env_var (env_name, orig_e);
-  max  = smartlist_len (list);
+  max = split_env_var (env_name, orig_e);
   for (i = 0; i < max; i++)
   {
-    struct directory_array *arr = smartlist_get (list, i);
-
-    if (check_empty && arr->exist)
-       arr->check_empty = check_empty;
-    found += process_dir (arr->dir, arr->num_dup, arr->exist, arr->check_empty,
-                          arr->is_dir, arr->exp_ok, env_name, NULL,
+    if (check_empty && DIR_HAS(i,DIR_EXIST))
+       DIR_FLAGS (i) |= DIR_CHECK_EMPTY;
+    found += process_dir (DIR_NAME(i), DIR_NUM_DUP(i), DIR_HAS(i,DIR_EXIST), DIR_HAS(i,DIR_CHECK_EMPTY),
+                          DIR_HAS(i,DIR_IS_DIR), DIR_HAS(i,DIR_EXP_OK), env_name, NULL,
                           recursive);
   }
   free_dir_array();
   FREE (orig_e);
+  phase_end (start, "do_check_env", env_name);
   return (found);
 }
 
+/*
+ * The patterns for the sub-directories of a %MANPATH directory:
+ *   MAN_SECTION_RE: a section like "man1", "cat3", "man3p" or "mann".
+ *   MAN_LOCALE_RE:  a locale like "de", "pt_BR" or "ja_JP.eucJP" which
+ *                   has it's own section directories.
+ */
+#define MAN_SECTION_RE  "^(man|cat)[0-9nlo][a-z]?$"
+#define MAN_LOCALE_RE   "^[a-z][a-z](_[a-z][a-z])?([.@].+)?$"
+
+static regex_t man_section_re, man_locale_re;
+
+/**\struct man_section
+ * A section directory found by 'find_man_sections()'.
+ * Scanned by 'scan_man_section()' in a worker-thread.
+ */
+struct man_section {
+       char         dir [_MAX_PATH];
+       smartlist_t *matches;      /* the matching files; 'struct deferred_file' */
+       arena_t     *arena;        /* 'matches' are allocated from this */
+       BOOL         is_empty;
+     };
+
+static const char *man_section_key (const void *_s, int *group)
+{
+  const struct man_section *s = (const struct man_section*) _s;
+
+  ARGSUSED (group);
+  return (s->dir);
+}
+
+/*
+ * Enumerate 'root' once and add the section directories in it to 'sections'.
+ * If 'locales', do the same for the locale directories in 'root'.
+ */
+static void find_man_sections (const char *root, smartlist_t *sections, BOOL locales)
+{
+  HANDLE          handle;
+  WIN32_FIND_DATA ff_data;
+  smartlist_t    *found, *locale_dirs, *list;
+  struct man_section *s;
+  char            path [_MAX_PATH];
+  int             i, max;
+
+  snprintf (path, sizeof(path), "%s\\*", root);
+  handle = FindFirstFile (path, &ff_data);
+  if (handle == INVALID_HANDLE_VALUE)
+     return;
+
+  found       = smartlist_new();
+  locale_dirs = smartlist_new();
+  do
+  {
+    const char *name = ff_data.cFileName;
+
+    if (!(ff_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+        !strcmp(name,".") || !strcmp(name,".."))
+       continue;
+
+    if (regexec(&man_section_re, name, 0, NULL, 0) == 0)
+       list = found;
+    else if (locales && regexec(&man_locale_re, name, 0, NULL, 0) == 0)
+       list = locale_dirs;
+    else
+       continue;
+
+    s = CALLOC (1, sizeof(*s));
+    snprintf (s->dir, sizeof(s->dir), "%s\\%s", root, name);
+    smartlist_add (list, s);
+  }
+  while (FindNextFile(handle, &ff_data));
+  FindClose (handle);
+
+  /* Not all file-systems return the names in sorted order.
+   */
+  smartlist_sort_str (found, man_section_key, STR_SORT_NOCASE);
+  smartlist_append (sections, found);
+  smartlist_free (found);
+
+  smartlist_sort_str (locale_dirs, man_section_key, STR_SORT_NOCASE);
+  max = smartlist_len (locale_dirs);
+  for (i = 0; i < max; i++)
+  {
+    s = smartlist_get (locale_dirs, i);
+    DEBUGF (2, "Checking locale directory \"%s\".\n", s->dir);
+    find_man_sections (s->dir, sections, FALSE);
+    FREE (s);
+  }
+  smartlist_free (locale_dirs);
+}
+
+/*
+ * The job-function for 'tasks_run_list()'.
+ * Collect the files in a section directory matching 'opt.file_spec'.
+ * Like 'process_dir()' in 'opt.man_mode', but prints nothing.
+ * 'dir_spec_init()' must be called first.
+ */
+static void scan_man_section (void *arg)
+{
+  struct man_section *s = (struct man_section*) arg;
+  HANDLE              handle;
+  WIN32_FIND_DATA     ff_data;
+  pathview_t          fqfn;
+  char                fqfn_buf [_MAX_PATH+1];
+  size_t              prefix_len;
+
+  TRACE_BEGIN ("dir", s->dir);
+  s->matches  = smartlist_new();
+  s->arena    = arena_new (0);
+  s->is_empty = dir_is_empty (NULL, s->dir, TRUE);
+
+  pathview_init (&fqfn, fqfn_buf, sizeof(fqfn_buf));
+  prefix_len = dir_spec_path (&fqfn, s->dir);
+  handle = FindFirstFile (fqfn.buf, &ff_data);
+  if (handle == INVALID_HANDLE_VALUE)
+  {
+    pathview_free (&fqfn);
+    TRACE_END ("dir");
+    return;
+  }
+  STAT_INC (STAT_DIRS_OPENED);
+
+  do
+  {
+    struct stat st;
+    BOOL   is_dir, is_junction;
+
+    STAT_INC (STAT_ENTRIES);
+    if (!strcmp(ff_data.cFileName,".") || !strcmp(ff_data.cFileName,".."))
+       continue;
+
+    dir_entry_path (&fqfn, prefix_len, ff_data.cFileName);
+    is_dir      = ((ff_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    is_junction = ((ff_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0);
+
+    if (dir_entry_match(&fqfn, prefix_len, is_dir, is_junction, TRUE, &st))
+       defer_report (s->matches, s->arena, fqfn.buf, &st, is_dir, is_junction);
+  }
+  while (FindNextFile(handle, &ff_data));
+
+  FindClose (handle);
+  pathview_free (&fqfn);
+  TRACE_END ("dir");
+}
+
 /*
  * The MANPATH checking needs to be recursive (1 level); check all
- * 'man*' and 'cat*' directories under each directory in %MANPATH.
+ * 'man*' and 'cat*' section directories under each directory in %MANPATH
+ * (and under the locale directories in it).
+ *
+ * Each %MANPATH directory is enumerated only once. All the section
+ * directories found are then scanned in parallel and the matches are
+ * reported in order.
  *
  * If ".\\" (or "./") is in MANPATH, test for existence in 'current_dir'
  * first.
  */
 static int do_check_manpath (void)
 {
-  struct directory_array *arr;
-  smartlist_t *list;
-  int    i, j, max, save, found = 0;
+  smartlist_t *sections;
+  int    i, max, save, found = 0;
+  BOOL   serial;
   char  *orig_e;
-  char   subdir [_MAX_PATH];
   char   report [300];
   static const char env_name[] = "MANPATH";
 
-  /* \todo: this should be all directories matching "man?[pn]" or "cat?[pn]".
-   */
-  static const char *sub_dirs[] = { "cat1", "cat2", "cat3", "cat4", "cat5",
-                                    "cat6", "cat7", "cat8", "cat9",
-                                    "man1", "man2", "man3", "man4", "man5",
-                                    "man6", "man7", "man8", "man9", "mann"
-                                  };
-
   orig_e = getenv_expand (env_name);
-  list   = orig_e ? split_env_var (env_name, orig_e) : NULL;
-  if (!list)
+  if (!orig_e)
   {
     WARN ("Env-var %s not defined.\n", env_name);
     return (0);
   }
+  max = split_env_var (env_name, orig_e);
 
   snprintf (report, sizeof(report), "Matches in %%%s:\n", env_name);
   report_header = report;
@@ -2404,17 +3240,19 @@ static int do_check_manpath (void)
    */
   opt.man_mode = 1;
 
-  max = smartlist_len (list);
+  regcomp (&man_section_re, MAN_SECTION_RE, REG_EXTENDED | REG_ICASE | REG_NOSUB);
+  regcomp (&man_locale_re, MAN_LOCALE_RE, REG_EXTENDED | REG_ICASE | REG_NOSUB);
+  sections = smartlist_new();
+
   for (i = 0; i < max; i++)
   {
-    arr = smartlist_get (list, i);
-    if (!arr->exist)
+    if (!DIR_HAS(i,DIR_EXIST))
     {
-      WARN ("%s: directory \"%s\" doesn't exist.\n", env_name, arr->dir);
+      WARN ("%s: directory \"%s\" doesn't exist.\n", env_name, DIR_NAME(i));
       continue;
     }
 #if 0
-    if (!str_equal(arr->dir,current_dir))
+    if (!str_equal(DIR_NAME(i),current_dir))
     {
       DEBUGF (2, "Checking in current_dir '%s'\n", current_dir);
 
@@ -2425,85 +3263,73 @@ static int do_check_manpath (void)
       }
     }
 #endif
-    for (j = 0; j < DIM(sub_dirs); j++)
+    find_man_sections (DIR_NAME(i), sections, TRUE);
+  }
+
+  /* A regex must go through 'process_dir()'.
+   */
+  serial = opt.use_regex;
+  if (!serial)
+  {
+    dir_spec_init();
+    tasks_run_list (sections, scan_man_section);
+  }
+
+  max = smartlist_len (sections);
+  for (i = 0; i < max; i++)
+  {
+    struct man_section *s = smartlist_get (sections, i);
+
+    if (serial)
+       found += process_dir (s->dir, 0, TRUE, TRUE, 1, TRUE, env_name, HKEY_MAN_FILE, FALSE);
+    else
     {
-      snprintf (subdir, sizeof(subdir), "%s\\%s", arr->dir, sub_dirs[j]);
-      if (FILE_EXISTS(subdir))
-         found += process_dir (subdir, 0, TRUE, TRUE, 1, TRUE, env_name, HKEY_MAN_FILE, FALSE);
+      if (s->is_empty)
+         WARN ("%s: directory \"%s\" is empty.\n", env_name, s->dir);
+      found += report_deferred (s->matches, HKEY_MAN_FILE);
     }
+    arena_free (s->arena);
+    FREE (s);
   }
+  smartlist_free (sections);
+  regfree (&man_section_re);
+  regfree (&man_locale_re);
+
   opt.man_mode = save;
   free_dir_array();
   FREE (orig_e);
   return (found);
 }
 
-/*
- * Find the version and location pkg-config.exe (on PATH).
- */
-static int pkg_config_major, pkg_config_minor;
-
-static int find_pkg_config_version_cb (char *buf, int index)
-{
-  ARGSUSED (index);
-  if (sscanf (buf, "%d.%d", &pkg_config_major, &pkg_config_minor) == 2)
-     return (1);
-  return (0);
-}
-
-static int get_pkg_config_info (const char **exe, struct ver_info *ver)
-{
-  char exe_copy [_MAX_PATH];
-
-  pkg_config_major = pkg_config_minor = -1;
-  *exe = searchpath ("pkg-config.exe", "PATH");
-  if (*exe == NULL)
-     return (0);
-
-  slashify2 (exe_copy, *exe, '\\');
-
-  if (popen_runf(find_pkg_config_version_cb, "\"%s\" --version", exe_copy) > 0)
-  {
-    ver->val_1 = pkg_config_major;
-    ver->val_2 = pkg_config_minor;
-    return (1);
-  }
-  *exe = NULL;
-  return (0);
-}
-
 /*
  * Search and check along %PKG_CONFIG_PATH%.
  */
 static int do_check_pkg (void)
 {
-  smartlist_t *list;
-  int          i, max, num, prev_num = 0, found = 0;
-  BOOL         do_warn = FALSE;
-  char        *orig_e;
-  char         report [300];
+  int   i, max, num, prev_num = 0, found = 0;
+  BOOL  do_warn = FALSE;
+  char *orig_e;
+  char  report [300];
   static const char env_name[] = "PKG_CONFIG_PATH";
 
   orig_e = getenv_expand (env_name);
-  list = orig_e ? split_env_var (env_name, orig_e) : NULL;
-  if (!list)
+  if (!orig_e)
   {
     WARN ("Env-var %s not defined.\n", env_name);
     return (0);
   }
+  max = split_env_var (env_name, orig_e);
 
   snprintf (report, sizeof(report), "Matches in %%%s:\n", env_name);
   report_header = report;
 
-  max = smartlist_len (list);
   for (i = 0; i < max; i++)
   {
-    const struct directory_array *arr = smartlist_get (list, i);
-
-    DEBUGF (2, "Checking in dir '%s'\n", arr->dir);
-    num = process_dir (arr->dir, 0, arr->exist, TRUE, arr->is_dir, arr->exp_ok, env_name, NULL, FALSE);
+    DEBUGF (2, "Checking in dir '%s'\n", DIR_NAME(i));
+    num = process_dir (DIR_NAME(i), 0, DIR_HAS(i,DIR_EXIST), TRUE, DIR_HAS(i,DIR_IS_DIR),
+                       DIR_HAS(i,DIR_EXP_OK), env_name, NULL, FALSE);
 
-    if (arr->num_dup == 0 && prev_num > 0 && num > 0)
+    if (DIR_NUM_DUP(i) == 0 && prev_num > 0 && num > 0)
        do_warn = TRUE;
     if (prev_num == 0 && num > 0)
        prev_num = num;
@@ -2529,46 +3355,6 @@ static int do_check_pkg (void)
  *   cmake.exe     -> f:\MinGW32\bin\CMake\bin\cmake.exe.
  *   built-in path -> f:\MinGW32\bin\CMake\share\cmake-X.Y\Modules
  */
-static int cmake_major, cmake_minor, cmake_micro;
-
-static int find_cmake_version_cb (char *buf, int index)
-{
-  static char prefix[] = "cmake version ";
-
-  if (!strncmp(buf,prefix,sizeof(prefix)-1) && strlen(buf) >= sizeof(prefix))
-  {
-    char *p = buf + sizeof(prefix) - 1;
-
-    sscanf (p, "%d.%d.%d", &cmake_major, &cmake_minor, &cmake_micro);
-    return (1);
-  }
-  ARGSUSED (index);
-  return (0);
-}
-
-static int get_cmake_info (char **exe, struct ver_info *ver)
-{
-  char exe_copy [_MAX_PATH];
-
-  cmake_major = cmake_minor = cmake_micro = -1;
-  *exe = searchpath ("cmake.exe", "PATH");
-  if (*exe == NULL)
-     return (0);
-
-  slashify2 (exe_copy, *exe, '\\');
-
-  if (popen_runf(find_cmake_version_cb, "\"%s\" -version", exe_copy) > 0)
-  {
-    ver->val_1 = cmake_major;
-    ver->val_2 = cmake_minor;
-    ver->val_3 = cmake_micro;
-    ver->val_4 = 0;
-    return (1);
-  }
-  *exe = NULL;
-  return (0);
-}
-
 static int do_check_cmake (void)
 {
   const char *cmake_bin = searchpath ("cmake.exe", "PATH");
@@ -2577,8 +3363,6 @@ static int do_check_cmake (void)
   BOOL        check_env = TRUE;
   char        report [_MAX_PATH+50];
 
-  cmake_major = cmake_minor = cmake_micro = -1;
-
   if (!getenv(env_name))
   {
     WARN ("Env-var %s not defined.\n", env_name);
@@ -2587,20 +3371,21 @@ static int do_check_cmake (void)
 
   if (cmake_bin)
   {
-    char *cmake_root = dirname (cmake_bin);
-    char  cmake_copy [_MAX_PATH];
+    char  *cmake_root = dirname (cmake_bin);
+    char   cmake_copy [_MAX_PATH];
+    struct ver_info ver;
 
     DEBUGF (3, "cmake -> '%s', cmake_root: '%s'\n", cmake_bin, cmake_root);
     slashify2 (cmake_copy, cmake_bin, '\\');
 
-    if (popen_runf(find_cmake_version_cb, "\"%s\" -version", cmake_copy) > 0)
+    if (get_ext_version(&cmake_probe, cmake_copy, &ver))
     {
       char dir [_MAX_PATH];
 
-      snprintf (dir, sizeof(dir), "%s\\..\\share\\cmake-%d.%d\\Modules",
-                cmake_root, cmake_major, cmake_minor);
-      DEBUGF (1, "found Cmake version %d.%d.%d. Module-dir -> '%s'\n",
-              cmake_major, cmake_minor, cmake_micro, dir);
+      snprintf (dir, sizeof(dir), "%s\\..\\share\\cmake-%u.%u\\Modules",
+                cmake_root, ver.val_1, ver.val_2);
+      DEBUGF (1, "found Cmake version %u.%u.%u. Module-dir -> '%s'\n",
+              ver.val_1, ver.val_2, ver.val_3, dir);
 
       report_header = "Matches among built-in Cmake modules:\n";
       found = process_dir (dir, 0, TRUE, TRUE, 1, TRUE, env_name, NULL, FALSE);
@@ -2640,6 +3425,15 @@ static BOOL  found_search_line = FALSE;
 static char  cygwin_fqfn [_MAX_PATH];
 static char *cygwin_root = NULL;
 
+/*
+ * The directories from spawning a '*gcc' are cached in 'SECTION_COMPILER'
+ * of the probe-cache (see cache.c). The cache-file is the full name of the
+ * '*gcc' and the key is "inc" or "lib" plus the '-m32'/'-m64' flag used.
+ * If the '*gcc' is changed (size or time-stamp), the cached values are ignored.
+ * The value is the list of directories separated by ';'.
+ */
+static char  gcc_cache_file [_MAX_PATH];
+
 static void check_if_cygwin (const char *path)
 {
   static const char cyg_usr[] = "/usr/";
@@ -2671,10 +3465,12 @@ static void setup_cygwin_root (const char *gcc)
   looks_like_cygwin = FALSE;
   cygwin_root = NULL;
   cygwin_fqfn[0] = '\0';
+  gcc_cache_file[0] = '\0';
   if (p)
   {
     char *bin_dir;
 
+    _strlcpy (gcc_cache_file, p, sizeof(gcc_cache_file));
     slashify2 (cygwin_fqfn, p, '/');
     bin_dir = strstr (cygwin_fqfn, "/bin");
     if (bin_dir)
@@ -2685,7 +3481,7 @@ static void setup_cygwin_root (const char *gcc)
   }
 }
 
-static int find_include_path_cb (char *buf, int index)
+static int find_include_path_cb (char *buf, int index, void *arg)
 {
   static const char start[] = "#include <...> search starts here:";
   static const char end[]   = "End of search list.";
@@ -2743,10 +3539,11 @@ static int find_include_path_cb (char *buf, int index)
   }
 
   ARGSUSED (index);
+  ARGSUSED (arg);
   return (0);
 }
 
-static int find_library_path_cb (char *buf, int index)
+static int find_library_path_cb (char *buf, int index, void *arg)
 {
   static const char prefix[] = "LIBRARY_PATH=";
   char   buf2 [_MAX_PATH];
@@ -2800,35 +3597,141 @@ static int find_library_path_cb (char *buf, int index)
     DEBUGF (3, "tok %d: '%s'\n", i, rc);
   }
   ARGSUSED (index);
+  ARGSUSED (arg);
   return (i);
 }
 
 
+/*
+ * Run by 'runner_runf()'; the stdin of a child is the null-device.
+ */
 #if defined(__CYGWIN__)
-  #define CLANG_DUMP_FMT "clang -v -dM -xc -c - < /dev/null 2>&1"
-  #define GCC_DUMP_FMT   "%s %s -v -dM -xc -c - < /dev/null 2>&1"
+  #define CLANG_DUMP_FMT "clang -v -dM -xc -c -"
+  #define GCC_DUMP_FMT   "%s %s -v -dM -xc -c -"
 #else
-  #define CLANG_DUMP_FMT "clang -o NUL -v -dM -xc -c - < NUL 2>&1"
-  #define GCC_DUMP_FMT   "%s %s -o NUL -v -dM -xc -c - < NUL 2>&1"
+  #define CLANG_DUMP_FMT "clang -o NUL -v -dM -xc -c -"
+  #define GCC_DUMP_FMT   "%s %s -o NUL -v -dM -xc -c -"
 #endif             /* gcc ^, ^ '', '-m32' or '-m64' */
 
+/*
+ * The env-vars that change the search-dirs gcc reports.
+ * Their values are part of the key in the cache.
+ */
+static const char *gcc_cache_env[] = {
+                  "LIBRARY_PATH",
+                  "C_INCLUDE_PATH",
+                  "CPATH"
+                };
+
+/*
+ * Make the real key for 'key'; 'key' plus a hash of the above env-vars.
+ */
+static const char *gcc_cache_key (const char *key, char *buf, size_t size)
+{
+  struct xxh64_state s;
+  UINT64 hash;
+  int    i;
+
+  xxh64_init (&s, 0);
+  for (i = 0; i < DIM(gcc_cache_env); i++)
+  {
+    const char *env = getenv (gcc_cache_env[i]);
+
+    if (env)
+       xxh64_update (&s, env, strlen(env));
+    xxh64_update (&s, "", 1);    /* a NUL cannot be in a value */
+  }
+  hash = xxh64_digest (&s);
+  snprintf (buf, size, "%s-%08lX%08lX", key, (u_long)(hash >> 32), (u_long)hash);
+  return (buf);
+}
+
+/*
+ * Add the directories cached for 'key' to 'dir_array'.
+ * Returns -1 if nothing is cached. Otherwise the number of directories added.
+ */
+static int gcc_cache_get (const char *key, BOOL check_cwd)
+{
+  char *value, *cygwin, *tok;
+  char  env_key [50];
+  int   found = 0;
+
+  if (!gcc_cache_file[0])
+     return (-1);
+
+  value = cache_get (SECTION_COMPILER, gcc_cache_file, gcc_cache_key(key, env_key, sizeof(env_key)));
+  if (!value)
+     return (-1);
+
+  cygwin = cache_get (SECTION_COMPILER, gcc_cache_file, "cygwin");
+  looks_like_cygwin = (cygwin && *cygwin == '1');
+  FREE (cygwin);
+
+  for (tok = strtok(value,";"); tok; tok = strtok(NULL,";"), found++)
+      add_to_dir_array (tok, check_cwd && !stricmp(current_dir,tok), __LINE__);
+  FREE (value);
+  return (found);
+}
+
+/*
+ * Store the directories in 'dir_array' under 'key'.
+ * A list too long for the cache is not stored.
+ */
+static void gcc_cache_put (const char *key)
+{
+  char   value [CACHE_MAX_VALUE+1];
+  char   env_key [50];
+  char  *p = value;
+  size_t left = sizeof(value);
+  int    i, len, max = vector_len (&dir_array.flags);
+
+  if (!gcc_cache_file[0])
+     return;
+
+  value[0] = '\0';
+  for (i = 0; i < max; i++)
+  {
+    len = snprintf (p, left, "%s%s", i > 0 ? ";" : "", DIR_NAME(i));
+    if (len < 0 || (size_t)len >= left)
+       return;
+    p    += len;
+    left -= len;
+  }
+  cache_put (SECTION_COMPILER, gcc_cache_file, gcc_cache_key(key, env_key, sizeof(env_key)), value);
+  cache_put (SECTION_COMPILER, gcc_cache_file, "cygwin", looks_like_cygwin ? "1" : "0");
+}
+
 static int setup_gcc_includes (const char *gcc)
 {
-  int found;
+  DWORD  start = GetTickCount();
+  UINT64 start_ns;
+  BOOL   cached;
+  int    found;
 
   free_dir_array();
 
-  /* We want the output of stderr only. But that seems impossible on CMD/4NT.
-   * Hence redirect stderr + stdout into the same pipe for us to read.
+  /* We want the output of stderr only. With '-o NUL', stdout is empty.
+   * The runner reads stderr on it's own pipe.
    * Also assume that the '*gcc' is on PATH.
    */
   found_search_line = FALSE;
 
   setup_cygwin_root (gcc);
 
-  found = popen_runf (find_include_path_cb, GCC_DUMP_FMT, gcc, "");
+  start_ns = phase_begin();
+  found  = gcc_cache_get ("inc", TRUE);
+  cached = (found >= 0);
+  if (!cached)
+  {
+    found = runner_runf (RUNNER_STDERR_PIPE, find_include_path_cb, NULL, GCC_DUMP_FMT, gcc, "");
+    if (found > 0)
+       gcc_cache_put ("inc");
+  }
+  phase_end (start_ns, "gcc_includes", gcc);
+
   if (found > 0)
-       DEBUGF (1, "found %d include paths for %s.\n", found, gcc);
+       DEBUGF (1, "found %d include paths for %s in %lu msec%s.\n",
+               found, gcc, (unsigned long)(GetTickCount() - start), cached ? " (cached)" : "");
   else WARN ("Calling %s returned %d.\n", cygwin_fqfn[0] ? cygwin_fqfn : gcc, found);
   return (found);
 }
@@ -2836,7 +3739,11 @@ static int setup_gcc_includes (const char *gcc)
 static int setup_gcc_library_path (const char *gcc, BOOL warn)
 {
   const char *m_cpu;
-  int   found, duplicates;
+  char   key [10];
+  DWORD  start = GetTickCount();
+  UINT64 start_ns;
+  BOOL   cached;
+  int    found, duplicates;
 
   free_dir_array();
 
@@ -2849,15 +3756,26 @@ static int setup_gcc_library_path (const char *gcc, BOOL warn)
        m_cpu = "-m64";
   else m_cpu = "";
 
-  /* We want the output of stderr only. But that seems impossible on CMD/4NT.
-   * Hence redirect stderr + stdout into the same pipe for us to read.
+  /* We want the output of stderr only. With '-o NUL', stdout is empty.
+   * The runner reads stderr on it's own pipe.
    * Also assume that the '*gcc' is on PATH.
    */
   found_search_line = FALSE;
 
   setup_cygwin_root (gcc);
 
-  found = popen_runf (find_library_path_cb, GCC_DUMP_FMT, gcc, m_cpu);
+  snprintf (key, sizeof(key), "lib%s", m_cpu);
+  start_ns = phase_begin();
+  found  = gcc_cache_get (key, FALSE);
+  cached = (found >= 0);
+  if (!cached)
+  {
+    found = runner_runf (RUNNER_STDERR_PIPE, find_library_path_cb, NULL, GCC_DUMP_FMT, gcc, m_cpu);
+    if (found > 0)
+       gcc_cache_put (key);
+  }
+  phase_end (start_ns, "gcc_library_path", gcc);
+
   if (found <= 0)
   {
     if (warn)
@@ -2865,7 +3783,8 @@ static int setup_gcc_library_path (const char *gcc, BOOL warn)
     return (found);
   }
 
-  DEBUGF (1, "found %d library paths for %s.\n", found, gcc);
+  DEBUGF (1, "found %d library paths for %s in %lu msec%s.\n",
+          found, gcc, (unsigned long)(GetTickCount() - start), cached ? " (cached)" : "");
 
 #if defined(__CYGWIN__)
   /*
@@ -2895,15 +3814,13 @@ static int setup_gcc_library_path (const char *gcc, BOOL warn)
 static int process_gcc_dirs (const char *gcc, int *num_dirs)
 {
   int i, found = 0;
-  int max = smartlist_len (dir_array);
+  int max = vector_len (&dir_array.flags);
 
   for (i = 0; i < max; i++)
   {
-    const struct directory_array *arr = smartlist_get (dir_array, i);
-
-    DEBUGF (2, "dir: %s\n", arr->dir);
-    found += process_dir (arr->dir, arr->num_dup, arr->exist, arr->check_empty,
-                          arr->is_dir, arr->exp_ok, gcc, HKEY_INC_LIB_FILE,
+    DEBUGF (2, "dir: %s\n", DIR_NAME(i));
+    found += process_dir (DIR_NAME(i), DIR_NUM_DUP(i), DIR_HAS(i,DIR_EXIST), DIR_HAS(i,DIR_CHECK_EMPTY),
+                          DIR_HAS(i,DIR_IS_DIR), DIR_HAS(i,DIR_EXP_OK), gcc, HKEY_INC_LIB_FILE,
                           FALSE);
   }
   *num_dirs = max;
@@ -2985,30 +3902,24 @@ static void get_longest (const char **cc, size_t num)
  */
 static void print_gcc_internal_dirs (const char *env_name, const char *env_value)
 {
-  struct directory_array *arr;
-  smartlist_t            *list;
-  char                  **copy;
-  int                     i, j, max, slash = opt.show_unix_paths ? '/' : '\\';
+  char      **copy;
+  int         i, j, max, slash = opt.show_unix_paths ? '/' : '\\';
   static BOOL done_note = FALSE;
 
-  max = smartlist_len (dir_array);
+  max = vector_len (&dir_array.flags);
   if (max == 0)
      return;
 
   copy = alloca ((max+1) * sizeof(char*));
   for (i = 0; i < max; i++)
-  {
-    arr = smartlist_get (dir_array, i);
-    copy[i] = STRDUP (slashify(arr->dir,slash));
-  }
+      copy[i] = STRDUP (slashify(DIR_NAME(i),slash));
   copy[i] = NULL;
   DEBUGF (3, "Made a 'copy[]' of %d directories.\n", max);
 
   free_dir_array();
 
-  list = split_env_var (env_name, env_value);
-  max  = list ? smartlist_len (list) : 0;
-  DEBUGF (3, "smartlist for '%s' have %d entries.\n", env_name, max);
+  max = split_env_var (env_name, env_value);
+  DEBUGF (3, "dir_array for '%s' have %d entries.\n", env_name, max);
 
   for (i = 0; copy[i]; i++)
   {
@@ -3017,8 +3928,7 @@ static void print_gcc_internal_dirs (const char *env_name, const char *env_value
 
     for (j = 0; j < max; j++)
     {
-      arr = smartlist_get (list, j);
-      dir = slashify (arr->dir, slash);
+      dir = slashify (DIR_NAME(j), slash);
       if (!stricmp(dir,copy[i]))
       {
         found = TRUE;
@@ -3088,14 +3998,7 @@ static size_t num_gpp (void)
 
 static void searchpath_all_cc (void)
 {
-  BOOL print_lib_path = FALSE;
-  int  save = opt.cache_ver_level;
-
-  if (opt.do_version >= 3)
-  {
-    opt.cache_ver_level = 3;
-    print_lib_path = TRUE;
-  }
+  BOOL print_lib_path = (opt.do_version >= 3);
 
   build_gnu_prefixes();
 
@@ -3111,7 +4014,6 @@ static void searchpath_all_cc (void)
 
   if (print_lib_path)
      C_puts ("    ~3(1)~0: internal GCC library paths.\n");
-  opt.cache_ver_level = save;
 }
 
 static int do_check_gcc_includes (void)
@@ -3236,14 +4138,10 @@ static int do_check_watcom_includes (void)
     return (0);
   }
 
-  max = smartlist_len (dir_array);
+  max = vector_len (&dir_array.flags);
   for (i = found = 0; i < max; i++)
-  {
-    struct directory_array *arr = smartlist_get (dir_array, i);
-
-    found += process_dir (arr->dir, arr->num_dup, arr->exist, 0,
-                          arr->is_dir, arr->exp_ok, "WATCOM", NULL, 0);
-  }
+     found += process_dir (DIR_NAME(i), DIR_NUM_DUP(i), DIR_HAS(i,DIR_EXIST), 0,
+                           DIR_HAS(i,DIR_IS_DIR), DIR_HAS(i,DIR_EXP_OK), "WATCOM", NULL, 0);
   frere_watcom_dirs();
   free_dir_array();
   return (found);
@@ -3263,14 +4161,10 @@ static int do_check_watcom_library_paths (void)
     return (0);
   }
 
-  max = smartlist_len (dir_array);
+  max = vector_len (&dir_array.flags);
   for (i = found = 0; i < max; i++)
-  {
-    struct directory_array *arr = smartlist_get (dir_array, i);
-
-    found += process_dir (arr->dir, arr->num_dup, arr->exist, 0,
-                          arr->is_dir, arr->exp_ok, "WATCOM", NULL, 0);
-  }
+     found += process_dir (DIR_NAME(i), DIR_NUM_DUP(i), DIR_HAS(i,DIR_EXIST), 0,
+                           DIR_HAS(i,DIR_IS_DIR), DIR_HAS(i,DIR_EXP_OK), "WATCOM", NULL, 0);
   dump_dir_array (NULL, NULL);
   frere_watcom_dirs();
   free_dir_array();
@@ -3317,6 +4211,13 @@ static const struct option long_options[] = {
            { "no-watcom",   no_argument,       NULL, 0 },    /* 33 */
            { "owner",       no_argument,       NULL, 0 },
            { "check",       no_argument,       NULL, 0 },    /* 35 */
+           { "list-modules",no_argument,       NULL, 0 },
+           { "no-cache",    no_argument,       NULL, 0 },    /* 37 */
+           { "threads",     required_argument, NULL, 0 },
+           { "hash",        no_argument,       NULL, 0 },    /* 39 */
+           { "bench",       optional_argument, NULL, 0 },
+           { "stats",       optional_argument, NULL, 0 },    /* 41 */
+           { "trace",       required_argument, NULL, 0 },
            { NULL,          no_argument,       NULL, 0 }
          };
 
@@ -3357,6 +4258,13 @@ static int *values_tab[] = {
             &opt.no_watcom,       /* 33 */
             &opt.show_owner,
             &opt.do_check,        /* 35 */
+            &opt.do_list_modules,
+            &opt.no_cache,        /* 37 */
+            &task_num_threads,
+            &opt.do_hash,         /* 39 */
+            &opt.do_bench,
+            &opt.do_stats,        /* 41 */
+            &opt.do_trace
           };
 
 /*
@@ -3504,6 +4412,30 @@ static void set_long_option (int o, const char *arg)
 
     else if (!strcmp("host",long_options[o].name))
       set_evry_options (arg);
+
+    else if (!strcmp("threads",long_options[o].name))
+      task_num_threads = atoi (arg);
+
+    else if (!strcmp("bench",long_options[o].name))
+    {
+      opt.do_bench = 1;
+      FREE (opt.bench_file);
+      opt.bench_file = STRDUP (arg);
+    }
+
+    else if (!strcmp("stats",long_options[o].name))
+    {
+      opt.do_stats = 1;
+      FREE (opt.stats_file);
+      opt.stats_file = STRDUP (arg);
+    }
+
+    else if (!strcmp("trace",long_options[o].name))
+    {
+      opt.do_trace = 1;
+      FREE (opt.trace_file);
+      opt.trace_file = STRDUP (arg);
+    }
   }
   else
   {
@@ -3614,9 +4546,25 @@ static void cleanup (void)
   if (halt_flag == 0)
      py_exit();
 
+  /* Don't wait for the PE-jobs if interrupted.
+   */
+  if (halt_flag == 0)
+     task_pipe_free (PE_pipe);
+
+  if (opt.trace_file)
+     trace_exit (opt.trace_file);
+
   wintrust_cleanup();
   free_dir_array();
 
+  /* Save the cache unless we were interrupted.
+   */
+  if (halt_flag == 0)
+     cache_exit();
+
+  sniff_exit();
+  dups_exit();
+
   FREE (who_am_I);
 
   FREE (system_env_path);
@@ -3637,13 +4585,24 @@ static void cleanup (void)
 
   FREE (opt.file_spec_re);
   FREE (opt.file_spec);
-  FREE (vcache_fname);
+  FREE (opt.bench_file);
+  FREE (opt.stats_file);
+  FREE (opt.trace_file);
 
   if (re_alloc)
      regfree (&re_hnd);
 
-  smartlist_free (dir_array);
+  vector_release (&dir_array.flags);
+  vector_release (&dir_array.num_dup);
+  vector_release (&dir_array.hash);
+  vector_release (&dir_array.dir);
+  vector_release (&dir_array.cyg_dir);
+  vector_release (&dir_array.line);
+  vector_release (&dir_array.pool);
   smartlist_free (reg_array);
+  arena_free (scratch_arena);
+  smartlist_wipe (stat_phases, stat_phase_free);
+  smartlist_free (stat_phases);
 
   smartlist_free_all (opt.evry_host);
 
@@ -3706,15 +4665,22 @@ static void init_all (void)
   opt.add_cwd = 1;
   C_use_colours = 1;  /* Turned off by "--no-colour" */
 
-  dir_array = smartlist_new();
+  vector_init (&dir_array.flags, sizeof(BYTE));
+  vector_init (&dir_array.num_dup, sizeof(int));
+  vector_init (&dir_array.hash, sizeof(DWORD));
+  vector_init (&dir_array.dir, sizeof(int));
+  vector_init (&dir_array.cyg_dir, sizeof(int));
+  vector_init (&dir_array.line, sizeof(unsigned));
+  vector_init (&dir_array.pool, sizeof(char));
   reg_array = smartlist_new();
+  scratch_arena = arena_new (0);
+  stat_phases = smartlist_new();
+  stat_start_ns = get_time_ns();
 
 #ifdef __CYGWIN__
   opt.conv_cygdrive = 1;
 #endif
 
-  vcache_fname = getenv_expand ("%TEMP%\\envtool.cache");
-
   current_dir[0] = '.';
   current_dir[1] = DIR_SEP;
   current_dir[2] = '\0';
@@ -3737,7 +4703,8 @@ static void init_all (void)
 
 int main (int argc, char **argv)
 {
-  int found = 0;
+  int    found = 0;
+  UINT64 start;
 
   init_all();
 
@@ -3765,6 +4732,9 @@ int main (int argc, char **argv)
 
   parse_cmdline (argc, argv, &opt.file_spec);
 
+  if (opt.trace_file)
+     trace_init();
+
   cfg_ignore_init ("%APPDATA%\\envtool.cfg");
   check_sys_dirs();
 
@@ -3781,6 +4751,9 @@ int main (int argc, char **argv)
   if (opt.do_version)
      return show_version();
 
+  if (opt.do_list_modules)
+     opt.do_python = 1;
+
   if (opt.do_python)
      py_init();
 
@@ -3790,6 +4763,12 @@ int main (int argc, char **argv)
   if (opt.do_tests)
      return do_tests();
 
+  if (opt.do_bench)
+     return do_bench();
+
+  if (opt.do_list_modules)
+     return py_list_modules();
+
   if (opt.do_evry && !opt.do_path)
      opt.no_sys_env = opt.no_usr_env = opt.no_app_path = 1;
 
@@ -3839,15 +4818,27 @@ int main (int argc, char **argv)
   DEBUGF (1, "file_spec: '%s', file_spec_re: '%s'.\n", opt.file_spec, opt.file_spec_re);
 
   if (!opt.no_sys_env)
-     found += scan_system_env();
+  {
+    start = phase_begin();
+    found += scan_system_env();
+    phase_end (start, "scan_system_env", NULL);
+  }
 
   if (!opt.no_usr_env)
-     found += scan_user_env();
+  {
+    start = phase_begin();
+    found += scan_user_env();
+    phase_end (start, "scan_user_env", NULL);
+  }
 
   if (opt.do_path)
   {
     if (!opt.no_app_path)
-       found += do_check_registry();
+    {
+      start = phase_begin();
+      found += do_check_registry();
+      phase_end (start, "do_check_registry", NULL);
+    }
 
     report_header = "Matches in %PATH:\n";
     found += do_check_env ("PATH", FALSE);
@@ -3895,7 +4886,9 @@ int main (int argc, char **argv)
     py_get_info (&py_exe, NULL, NULL);
     snprintf (report, sizeof(report), "Matches in \"%s\" sys.path[]:\n", py_exe);
     report_header = report;
+    start = phase_begin();
     found += py_search();
+    phase_end (start, "py_search", NULL);
   }
 
   /* Mode "--evry" specified.
@@ -3917,12 +4910,16 @@ int main (int argc, char **argv)
 
       snprintf (buf, sizeof(buf), "Matches from %s:\n", host);
       report_header = buf;
+      start = phase_begin();
       found += do_check_evry_ept (host);
+      phase_end (start, "do_check_evry_ept", host);
     }
     if (max  == 0)
     {
       report_header = "Matches from EveryThing:\n";
+      start = phase_begin();
       found += do_check_evry();
+      phase_end (start, "do_check_evry", NULL);
     }
   }
 
@@ -3935,23 +4932,21 @@ int main (int argc, char **argv)
  */
 void test_split_env (const char *env)
 {
-  smartlist_t *list;
-  char        *value;
-  int          i, max;
+  char *value;
+  int   i, max;
 
   C_printf ("~3%s():~0 ", __FUNCTION__);
   C_printf (" 'split_env_var (\"%s\",\"%%%s\")':\n", env, env);
 
   value = getenv_expand (env);
-  list  = split_env_var (env, value);
-  max   = list ? smartlist_len (list) : 0;
+  max   = split_env_var (env, value);
   for (i = 0; i < max; i++)
   {
-    const struct directory_array *arr = smartlist_get (list, i);
+    const char *cyg_dir = dir_array_cyg_dir (i);
     char  buf [_MAX_PATH];
-    char *dir = arr->dir;
+    char *dir = DIR_NAME (i);
 
-    if (arr->exist && arr->is_dir)
+    if (DIR_HAS(i,DIR_EXIST) && DIR_HAS(i,DIR_IS_DIR))
        dir = _fix_path (dir, buf);
 
     if (opt.show_unix_paths)
@@ -3959,16 +4954,16 @@ void test_split_env (const char *env)
 
     C_printf ("  arr[%2d]: %-65s", i, dir);
 
-    if (arr->cyg_dir)
-       C_printf ("\n%*s%s", 11, "", arr->cyg_dir);
+    if (cyg_dir)
+       C_printf ("\n%*s%s", 11, "", cyg_dir);
 
-    if (arr->num_dup > 0)
+    if (DIR_NUM_DUP(i) > 0)
        C_puts ("  ~3**duplicated**~0");
-    if (arr->is_native && !have_sys_native_dir)
+    if (DIR_HAS(i,DIR_IS_NATIVE) && !have_sys_native_dir)
        C_puts ("  ~5**native dir not existing**~0");
-    else if (!arr->exist)
+    else if (!DIR_HAS(i,DIR_EXIST))
        C_puts ("  ~5**not existing**~0");
-    else if (!arr->is_dir)
+    else if (!DIR_HAS(i,DIR_IS_DIR))
        C_puts ("  **not a dir**");
 
     C_putc ('\n');
@@ -3985,9 +4980,8 @@ void test_split_env (const char *env)
 
 void test_split_env_cygwin (const char *env)
 {
-  smartlist_t *list;
-  char        *value, *cyg_value;
-  int          i, max, rc, needed, save = opt.conv_cygdrive;
+  char *value, *cyg_value;
+  int   i, max, rc, needed, save = opt.conv_cygdrive;
 
   free_dir_array();
 
@@ -4010,29 +5004,26 @@ void test_split_env_cygwin (const char *env)
 
   path_separator = ':';
   opt.conv_cygdrive = 0;
-  list = split_env_var (env, cyg_value);
-
-  max = list ? smartlist_len (list) : 0;
+  max = split_env_var (env, cyg_value);
 
   for (i = 0; i < max; i++)
   {
-    const struct directory_array *arr = smartlist_get (list, i);
-    char *dir = arr->dir;
+    char *dir = DIR_NAME (i);
 
-    if (arr->exist && arr->is_dir)
+    if (DIR_HAS(i,DIR_EXIST) && DIR_HAS(i,DIR_IS_DIR))
        dir = cygwin_create_path (CCP_WIN_A_TO_POSIX, dir);
 
     C_printf ("  arr[%d]: %s", i, dir);
 
-    if (arr->num_dup > 0)
+    if (DIR_NUM_DUP(i) > 0)
        C_puts ("  ~4**duplicated**~0");
-    if (!arr->exist)
+    if (!DIR_HAS(i,DIR_EXIST))
        C_puts ("  ~5**not existing**~0");
-    if (!arr->is_dir)
+    if (!DIR_HAS(i,DIR_IS_DIR))
        C_puts ("  ~4**not a dir**~0");
     C_putc ('\n');
 
-    if (dir != arr->dir)
+    if (dir != DIR_NAME(i))
        free (dir);
   }
   free_dir_array();
@@ -4301,6 +5292,46 @@ static void test_fix_path (void)
   C_putc ('\n');
 }
 
+/*
+ * Tests for the 'pathview_x()' functions.
+ */
+static void test_pathview (void)
+{
+  static const struct test_table {
+         const char *path;
+         const char *expect;
+       } tests[] = {
+         { "c:\\foo\\.\\bar\\..\\baz\\", "c:\\foo\\baz" },
+         { "C:///foo//bar/./",             "c:\\foo\\bar" },
+         { "c:\\..\\Windows",              "c:\\Windows"    },
+         { "..\\foo\\..\\..\\bar",         "..\\..\\bar"    },
+         { "foo/../../bar/..",             ".."            },
+         { "C:\\",                        "c:\\"          }
+       };
+  int i;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < DIM(tests); i++)
+  {
+    const struct test_table *t = tests + i;
+    pathview_t pv;
+    char       buf [10];   /* too small for some; forces a heap buffer */
+
+    pathview_init (&pv, buf, sizeof(buf));
+    pathview_set (&pv, t->path, strlen(t->path));
+    pathview_slashify (&pv, '\\');
+    pathview_collapse_dots (&pv);
+    pathview_strip_trailing (&pv);
+    pathview_fix_drive (&pv);
+
+    C_puts (strcmp(pv.buf, t->expect) ? "~5  FAIL~0" : "~2  OK  ~0");
+    C_printf (" \"%s\" -> \"%s\", len: %u\n", t->path, pv.buf, (unsigned)pv.len);
+    pathview_free (&pv);
+  }
+  C_putc ('\n');
+}
+
 /*
  * https://msdn.microsoft.com/en-us/library/windows/desktop/bb762181%28v=vs.85%29.aspx
  */
@@ -4560,6 +5591,122 @@ static void test_PE_wintrust (void)
   C_putc ('\n');
 }
 
+/*
+ * Get the 'FileVersion' of 'file' the Win32 way.
+ */
+static BOOL get_win32_version (const char *file, struct ver_info *ver)
+{
+  VS_FIXEDFILEINFO *fixed;
+  UINT   len;
+  DWORD  handle, size = GetFileVersionInfoSize (file, &handle);
+  void  *data;
+  BOOL   rc = FALSE;
+
+  memset (ver, 0, sizeof(*ver));
+  if (size == 0)
+     return (FALSE);
+
+  data = MALLOC (size);
+  if (GetFileVersionInfo(file, 0, size, data) &&
+      VerQueryValue(data, "\\", (void**)&fixed, &len) && len >= sizeof(*fixed))
+  {
+    ver->val_1 = HIWORD (fixed->dwFileVersionMS);
+    ver->val_2 = LOWORD (fixed->dwFileVersionMS);
+    ver->val_3 = HIWORD (fixed->dwFileVersionLS);
+    ver->val_4 = LOWORD (fixed->dwFileVersionLS);
+    rc = TRUE;
+  }
+  FREE (data);
+  return (rc);
+}
+
+/*
+ * Check the PE-parser in pe.c against the Win32 API on some
+ * PE-files; our own .exe and some files in '%WinDir%\System32'.
+ * The 'CheckSum' is compared to what 'MapFileAndCheckSum()' says,
+ * and the version to what 'VerQueryValue()' says.
+ */
+static void test_PE_parser (void)
+{
+  static const char *files[] = {
+              NULL,            /* our own .exe */
+              "%s\\kernel32.dll",
+              "%s\\ntdll.dll",
+              "%s\\shell32.dll",
+              "notepad.exe"
+            };
+  int i;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < DIM(files); i++)
+  {
+    struct pe_file  pe;
+    struct ver_info ver, win_ver;
+    char   path [_MAX_PATH];
+    char  *file = (char*) files[i];
+    char  *is_sys = file ? strchr (file, '%') : NULL;
+    DWORD  calc_sum, pe_sum, hdr_sum, win_sum;
+    BOOL   sum_ok, have_ver, have_win_ver;
+    size_t len;
+
+    if (!file)
+    {
+      if (!GetModuleFileName(NULL, path, sizeof(path)))
+         continue;
+      file = path;
+    }
+    else if (is_sys)
+    {
+      if (have_sys_native_dir)
+           snprintf (path, sizeof(path), "%s\\%s", sys_native_dir, is_sys+3);
+      else snprintf (path, sizeof(path), "%s\\%s", sys_dir, is_sys+3);
+      file = path;
+    }
+    else
+      file = searchpath (file, "PATH");
+
+    if (!file)
+    {
+      C_printf ("  %d: %-50.50s -> ~5not found~0\n", i, files[i]);
+      continue;
+    }
+
+    len = strlen (file);
+    if (len > 50)
+         C_printf ("  %d: ...%-47.47s ->", i, file+len-47);
+    else C_printf ("  %d: %-50.50s ->", i, _fix_drive(file));
+
+    if (!pe_open(&pe, file))
+    {
+      C_puts (" ~5pe_open() failed~0\n");
+      continue;
+    }
+
+    C_printf (" %s,", pe.bits == bit_32 ? "32-bit" : pe.bits == bit_64 ? "64-bit" : "unknown");
+    sum_ok = pe_verify_checksum (&pe, &calc_sum);
+    pe_sum = pe.header_sum;
+    pe_close (&pe);
+
+    if (MapFileAndCheckSum(file, &hdr_sum, &win_sum) != CHECKSUM_SUCCESS)
+         C_puts (" CheckSum ~5MapFileAndCheckSum() failed~0,");
+    else if (calc_sum == win_sum && hdr_sum == pe_sum)
+         C_printf (" CheckSum ~2%s~0,", sum_ok ? "OK" : "bad (as for Windows)");
+    else C_printf (" CheckSum ~5mismatch~0 (0x%08lX vs 0x%08lX),", (u_long)calc_sum, (u_long)win_sum);
+
+    have_ver     = get_PE_version_info (file, &ver, NULL);
+    have_win_ver = get_win32_version (file, &win_ver);
+    if (have_ver != have_win_ver || memcmp(&ver, &win_ver, sizeof(ver)))
+         C_printf (" version ~5mismatch~0 (%u.%u.%u.%u vs %u.%u.%u.%u)\n",
+                   ver.val_1, ver.val_2, ver.val_3, ver.val_4,
+                   win_ver.val_1, win_ver.val_2, win_ver.val_3, win_ver.val_4);
+    else if (have_ver)
+         C_printf (" version ~2%u.%u.%u.%u~0\n", ver.val_1, ver.val_2, ver.val_3, ver.val_4);
+    else C_puts (" no version\n");
+  }
+  C_putc ('\n');
+}
+
 static void test_disk_ready (void)
 {
   static int drives[] = { 'A', 'C', 'X', 'Y' };
@@ -4687,11 +5834,9 @@ void regex_print (const regex_t *re, const regmatch_t *rm, const char *str)
  */
 static void check_env_val (const char *env, int *num, char *status, size_t status_sz)
 {
-  smartlist_t                  *list;
-  int                           i, max = 0;
-  int                           save  = opt.conv_cygdrive;
-  char                         *value = getenv_expand (env);
-  const struct directory_array *arr;
+  int   i, max = 0;
+  int   save  = opt.conv_cygdrive;
+  char *value = getenv_expand (env);
 
   status[0] = '\0';
   *num = 0;
@@ -4709,16 +5854,14 @@ static void check_env_val (const char *env, int *num, char *status, size_t statu
     value = cyg_value;
 #endif
 
-    list = split_env_var (env, value);
-    *num = max = smartlist_len (list);
+    *num = max = split_env_var (env, value);
   }
 
   for (i = 0; i < max; i++)
   {
-    arr = smartlist_get (list, i);
-    if (!arr->exist)
+    if (!DIR_HAS(i,DIR_EXIST))
     {
-      snprintf (status, status_sz, "~5Missing dir~0: ~3\"%s\"~0", arr->dir);
+      snprintf (status, status_sz, "~5Missing dir~0: ~3\"%s\"~0", DIR_NAME(i));
       break;
     }
   }
@@ -4871,8 +6014,10 @@ static int do_tests (void)
   test_searchpath();
   test_fnmatch();
   test_PE_wintrust();
+  test_PE_parser();
   test_slashify();
   test_fix_path();
+  test_pathview();
   test_disk_ready();
   test_SHGetFolderPath();
   test_ReparsePoints();
@@ -4885,6 +6030,67 @@ static int do_tests (void)
   return (0);
 }
 
+/*
+ * The 'split_env_var()' and 'add_to_dir_array()' kernels for 'do_bench()'.
+ * 'add_to_dir_array()' starts on a new 'dir_array' for each round of the corpus.
+ */
+static void bench_split_env_var (void *arg, int idx)
+{
+  split_env_var ("BENCH", smartlist_get((const smartlist_t*)arg, idx));
+}
+
+static void bench_add_to_dir_array (void *arg, int idx)
+{
+  if (idx == 0)
+     free_dir_array();
+  add_to_dir_array (smartlist_get((const smartlist_t*)arg, idx), 0, __LINE__);
+}
+
+/*
+ * The handler for option "--bench" / "--bench=file".
+ * The directories in the generated environment values does not exist. So this
+ * measures the cost of a failing 'safe_stat()' too.
+ */
+static int do_bench (void)
+{
+  smartlist_t *paths, *dirs, *values;
+  char         value [100*_MAX_PATH];
+  int          i, j, save = opt.quiet;
+
+  bench_init();
+  bench_kernels();
+
+  paths  = bench_make_paths (100);
+  dirs   = smartlist_new();
+  values = smartlist_new();
+
+  for (i = 0; i < smartlist_len(paths); i++)
+      smartlist_add (dirs, dirname(smartlist_get(paths, i)));
+
+  /* 10 values of 20 directories each. Like a typical %PATH%.
+   */
+  for (i = 0; i < 10; i++)
+  {
+    char *p = value;
+
+    for (j = 0; j < 20; j++)
+        p += snprintf (p, value + sizeof(value) - p, "%s%c",
+                       (const char*)smartlist_get(dirs, (i*20 + j) % smartlist_len(dirs)), path_separator);
+    smartlist_add (values, STRDUP(value));
+  }
+
+  opt.quiet = 1;   /* no warnings on the "dir with space" components */
+  bench_run ("split_env_var", bench_split_env_var, values, smartlist_len(values));
+  bench_run ("add_to_dir_array", bench_add_to_dir_array, dirs, smartlist_len(dirs));
+  opt.quiet = save;
+  free_dir_array();
+
+  smartlist_free_all (paths);
+  smartlist_free_all (dirs);
+  smartlist_free_all (values);
+  return bench_exit (opt.bench_file);
+}
+
 
 #if defined(__MINGW32__)
   #define CFLAGS   "cflags_MinGW.h"
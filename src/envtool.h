@@ -292,6 +292,9 @@ struct prog_options {
        int   no_gpp;
        int   no_watcom;
        int   do_tests;
+       int   do_bench;
+       int   do_stats;
+       int   do_trace;
        int   do_evry;
        int   do_version;
        int   do_path;
@@ -302,13 +305,18 @@ struct prog_options {
        int   do_cmake;
        int   do_pkg;
        int   do_check;
+       int   do_list_modules;
+       int   no_cache;
+       int   do_hash;
        int   conv_cygdrive;
        int   case_sensitive;
-       int   cache_ver_level;
        int   keep_temp;
        void *evry_host;     /* A smartlist_t */
        char *file_spec;
        char *file_spec_re;
+       char *bench_file;
+       char *stats_file;
+       char *trace_file;
      };
 
 extern struct prog_options opt;
@@ -363,6 +371,7 @@ extern char *_fix_drive    (char *path);
 extern char *path_ltrim    (const char *p1, const char *p2);
 extern char *basename      (const char *fname);
 extern char *dirname       (const char *fname);
+extern char *dirname_buf   (const char *fname, char *buf, size_t size);
 extern int   _is_DOS83     (const char *fname);
 extern char *slashify      (const char *path, char use);
 extern char *slashify2     (char *buf, const char *path, char use);
@@ -379,6 +388,24 @@ extern BOOL  _has_drive             (const char *path);
 extern BOOL   is_directory          (const char *file);
 extern int    safe_stat             (const char *file, struct stat *st, DWORD *win_err);
 
+/* A read-only memory-mapping of a whole file.
+ */
+struct mapped_file {
+       HANDLE      file;
+       HANDLE      map;
+       const BYTE *data;
+       UINT64      size;
+     };
+
+extern BOOL   map_file   (const char *fname, struct mapped_file *mf);
+extern void   unmap_file (struct mapped_file *mf);
+
+/* A callback for 'file_read_lines()'.
+ */
+typedef void (*file_line_func) (char *line, size_t len, void *arg);
+
+extern int    file_read_lines (const char *fname, file_line_func func, void *arg);
+
 extern char       *make_cyg_path (const char *path, char *result);
 extern wchar_t    *make_cyg_pathw (const wchar_t *path, wchar_t *result);
 
@@ -450,18 +477,16 @@ extern unsigned    list_lookup_value (const char *name, const struct search_list
 extern const char *flags_decode (DWORD flags, const struct search_list *list, int num);
 extern const char *get_file_size_str (UINT64 size);
 extern const char *get_time_str (time_t t);
+extern UINT64      get_time_ns (void);
+extern char      **make_test_paths (int num);
 extern const char *get_file_ext (const char *file);
 extern char       *create_temp_file (void);
-extern int         get_PE_version_info (const char *file, struct ver_info *ver);
-extern char       *get_PE_version_info_buf (void);
-extern void        get_PE_version_info_free (void);
+extern int         get_PE_version_info (const char *file, struct ver_info *ver, char **trace);
 extern const char *check_if_shebang (const char *fname);
 extern int         check_if_zip (const char *fname);
 extern int         check_if_gzip (const char *fname);
-extern const char *get_gzip_link (const char *file);
 extern const char *get_man_link (const char *file);
 extern int         check_if_PE (const char *fname, enum Bitness *bits);
-extern int         verify_PE_checksum (const char *fname);
 extern BOOL        is_wow64_active (void);
 
 extern REGSAM      reg_read_access (void);
@@ -500,9 +525,29 @@ extern const char *os_bits (void);
 #define TRUST_E_SUBJECT_FORM_UNKNOWN (HRESULT) 0x800B0003
 #endif
 
+#ifndef TRUST_E_EXPLICIT_DISTRUST
+#define TRUST_E_EXPLICIT_DISTRUST    (HRESULT) 0x800B0111
+#endif
+
+#ifndef TRUST_E_BAD_DIGEST
+#define TRUST_E_BAD_DIGEST           (HRESULT) 0x80096010
+#endif
+
 extern char       *wintrust_signer_subject,    *wintrust_signer_issuer;
 extern char       *wintrust_timestamp_subject, *wintrust_timestamp_issuer;
 extern DWORD       wintrust_check (const char *pe_file, BOOL details, BOOL revoke_check);
+
+/* A thread-safe 'wintrust_check()'. The subject/issuer names are
+ * returned in 'info' instead of the above globals.
+ */
+struct wintrust_info {
+       char *signer_subject,    *signer_issuer;
+       char *timestamp_subject, *timestamp_issuer;
+     };
+
+extern DWORD       wintrust_check_r (const char *pe_file, BOOL details, BOOL revoke_check,
+                                     struct wintrust_info *info);
+extern void        wintrust_info_free (struct wintrust_info *info);
 extern const char *wintrust_check_result (DWORD rc);
 extern void        wintrust_cleanup (void);
 
@@ -519,6 +564,55 @@ extern char    *strdup_at  (const char *str, const char *file, unsigned line);
 extern wchar_t *wcsdup_at  (const wchar_t *str, const char *file, unsigned line);
 extern void     free_at    (void *ptr, const char *file, unsigned line);
 extern void     mem_report (void);
+extern void     mem_arena_count (size_t allocs, size_t resets, UINT64 bytes);
+extern BOOL     mem_get_counters (UINT64 *allocs, UINT64 *bytes);
+
+/**
+ * Counters of events on the hot paths. Shown by option "--stats".
+ * Some are updated in worker-threads; hence the \c InterlockedIncrement().
+ */
+enum stat_counters {
+     STAT_DIRS_OPENED = 0,
+     STAT_ENTRIES,
+     STAT_SAFE_STAT,
+     STAT_MATCHES,
+     STAT_SPAWNED,
+     STAT_MAX
+   };
+
+extern volatile LONG stat_counters [STAT_MAX];
+
+#define STAT_INC(c)  InterlockedIncrement (&stat_counters[c])
+
+/**
+ * Set by \c trace_init() for option "--trace=file". NULL when not tracing.
+ * The \c cat argument must be a string literal; the \c name is copied.
+ */
+extern void (*trace_hook) (char ph, const char *cat, const char *name, unsigned id);
+
+#define TRACE_BEGIN(cat, name)  do {                                     \
+                                  if (trace_hook)                        \
+                                     (*trace_hook) ('B', cat, name, 0);  \
+                                } while (0)
+
+#define TRACE_END(cat)          do {                                     \
+                                  if (trace_hook)                        \
+                                     (*trace_hook) ('E', cat, NULL, 0);  \
+                                } while (0)
+
+/**
+ * For spans that overlap others in the same thread; they need not nest.
+ * E.g. the children of runner.c. The begin and end are paired on \c cat and \c id.
+ */
+#define TRACE_ASYNC_BEGIN(cat, name, id)  do {                                     \
+                                            if (trace_hook)                        \
+                                               (*trace_hook) ('b', cat, name, id); \
+                                          } while (0)
+
+#define TRACE_ASYNC_END(cat, name, id)    do {                                     \
+                                            if (trace_hook)                        \
+                                               (*trace_hook) ('e', cat, name, id); \
+                                          } while (0)
 
 #if defined(_CRTDBG_MAP_ALLOC)
   #define MALLOC        malloc
@@ -543,6 +637,9 @@ typedef int (*popen_callback) (char *buf, int index);
 int popen_run  (popen_callback callback, const char *cmd);
 int popen_runf (popen_callback callback, const char *fmt, ...);
 
+void spawn_lock (void);
+void spawn_unlock (void);
+
 /* fnmatch() ret-values and flags:
  */
 #define FNM_MATCH          1
@@ -16,6 +16,10 @@
 #include "envtool.h"
 #include "envtool_py.h"
 #include "smartlist.h"
+#include "tasks.h"
+#include "cache.h"
+#include "zip.h"
+#include "runner.h"
 
 /* No need to include <Python.h> just for this:
  */
@@ -131,6 +135,14 @@ struct python_info {
    */
   PyObject *catcher;
   HANDLE    dll_hnd;
+
+  /** The entry in \c all_py_programs[] this Python was matched against.
+   */
+  const struct python_info *matched;
+
+  /** The long-lived helper process (if started) used by \c popen_run_py().
+   */
+  struct py_helper *helper;
 };
 
 /**
@@ -167,12 +179,6 @@ static struct python_info *g_py;
  */
 static enum Bitness  our_bitness;
 
-/**
- * Some temporary globals.
- */
-static int  tmp_ver_major, tmp_ver_minor, tmp_ver_micro;
-static char tmp_user_site [_MAX_PATH];
-
 static int longest_py_program = 0;  /* set in py_init() */
 static int longest_py_version = 0;  /* set in py_init() */
 static int global_indent = 0;
@@ -181,14 +187,14 @@ static int global_indent = 0;
   static HANDLE ex_hnd = NULL;
 #endif
 
-static int get_python_version (const char *exe_name);
-
 /**
  * The list Pythons from the PATH and from 'HKLM\Software\Python\PythonCore\xx\InstallPath'
  * locations. This is an array of 'struct python_info'.
  */
 static smartlist_t *py_programs;
 
+static void py_helper_stop (struct python_info *py);
+
 /**
  * \def LOAD_FUNC(is_opt, f)
  *   A \c GetProcAddress() helper.
@@ -661,6 +667,9 @@ static void free_py_program (void *e)
   if (py->is_embeddable)
      py_exit_embedding (py);
 
+  if (py->helper)
+     py_helper_stop (py);
+
   if (py->sys_path)
   {
     smartlist_wipe (py->sys_path, free_sys_path);
@@ -849,8 +858,10 @@ static char *call_python_func (struct python_info *py, const char *py_prog)
   }
 
   ASSERT (py->catcher);
+  TRACE_BEGIN ("python", py->exe_name);
   rc  = (*PyRun_SimpleString) (py_prog);
   obj = (*PyObject_GetAttrString) (py->catcher, "value");
+  TRACE_END ("python");
 
   DEBUGF (4, "rc: %d, obj: %p\n", rc, obj);
 
@@ -1009,6 +1020,264 @@ static char *tmp_fputs (const struct python_info *py, const char *buf)
   return (tmp);
 }
 
+/**\struct py_helper
+ * A Python child-process that is started once and kept alive for the
+ * whole run. It reads Python programs on it's \c stdin and writes back
+ * what they printed on it's \c stdout. Thus no temp-files are needed and
+ * each query costs only one pipe round-trip instead of a new process.
+ *
+ * The protocol is length-framed in both directions:
+ * \code
+ *   request:  "<length>\n" <length bytes of Python code>
+ *   response: "<rc> <length>\n" <length bytes of output>
+ * \endcode
+ *
+ * \c rc is 1 if the program raised an exception; the output then
+ * ends with the traceback. Both \c sys.stdout and \c sys.stderr are
+ * captured. A program must not write directly to fd 1 (\c os.write(1,..))
+ * since that would corrupt the protocol.
+ */
+struct py_helper {
+       HANDLE process;     /** the Python process */
+       HANDLE to_child;    /** write-end of it's stdin */
+       HANDLE from_child;  /** read-end of it's stdout */
+       BOOL   failed;      /** it died or could not be started; don't try again */
+     };
+
+/**
+ * \def PY_HELPER_PROG
+ *   The program given to \c "python -u -c". Works with Python 2 and 3.
+ *   It can not contain any double-quotes.
+ */
+#define PY_HELPER_PROG                                                   \
+        "import sys, traceback\n"                                        \
+        "try:\n"                                                         \
+        "  from cStringIO import StringIO\n"                             \
+        "except ImportError:\n"                                          \
+        "  from io import StringIO\n"                                    \
+        "inp = getattr (sys.stdin, 'buffer', sys.stdin)\n"               \
+        "out = getattr (sys.stdout, 'buffer', sys.stdout)\n"             \
+        "std = (sys.stdout, sys.stderr)\n"                               \
+        "while True:\n"                                                  \
+        "  line = inp.readline()\n"                                      \
+        "  if not line:\n"                                               \
+        "    break\n"                                                    \
+        "  code = inp.read (int(line)).decode ('utf-8')\n"               \
+        "  buf = StringIO()\n"                                           \
+        "  sys.stdout = sys.stderr = buf\n"                              \
+        "  rc = 0\n"                                                     \
+        "  try:\n"                                                       \
+        "    exec (code, { '__name__': '__main__' })\n"                  \
+        "  except SystemExit:\n"                                         \
+        "    pass\n"                                                     \
+        "  except:\n"                                                    \
+        "    traceback.print_exc()\n"                                    \
+        "    rc = 1\n"                                                   \
+        "  sys.stdout, sys.stderr = std\n"                               \
+        "  data = buf.getvalue()\n"                                      \
+        "  if not isinstance (data, bytes):\n"                           \
+        "    data = data.encode ('utf-8')\n"                             \
+        "  out.write (('%d %d\\n' % (rc, len(data))).encode ('ascii'))\n" \
+        "  out.write (data)\n"                                           \
+        "  out.flush()\n"
+
+/**
+ * Start the helper process for \c py.
+ * Its \c stderr is inherited from us; only startup errors should go there.
+ */
+static BOOL py_helper_start (struct python_info *py)
+{
+  struct py_helper   *h;
+  SECURITY_ATTRIBUTES sa;
+  STARTUPINFO         si;
+  PROCESS_INFORMATION pi;
+  HANDLE              in_rd = NULL, in_wr = NULL, out_rd = NULL, out_wr = NULL;
+  char               *cmd;
+  size_t              len;
+  BOOL                rc;
+
+  h = py->helper = CALLOC (1, sizeof(*h));
+
+  memset (&sa, '\0', sizeof(sa));
+  sa.nLength        = sizeof(sa);
+  sa.bInheritHandle = TRUE;
+
+  /* No other thread may start a child until our inheritable pipe-ends are closed.
+   */
+  spawn_lock();
+  if (!CreatePipe(&in_rd, &in_wr, &sa, 0) || !CreatePipe(&out_rd, &out_wr, &sa, 0))
+  {
+    DEBUGF (1, "CreatePipe() failed; %s\n", win_strerror(GetLastError()));
+    goto fail;
+  }
+
+  /* Our ends of the pipes must not be inherited. Otherwise the child never
+   * sees EOF on it's stdin when we close 'to_child'.
+   */
+  SetHandleInformation (in_wr, HANDLE_FLAG_INHERIT, 0);
+  SetHandleInformation (out_rd, HANDLE_FLAG_INHERIT, 0);
+
+  memset (&si, '\0', sizeof(si));
+  si.cb         = sizeof(si);
+  si.dwFlags    = STARTF_USESTDHANDLES;
+  si.hStdInput  = in_rd;
+  si.hStdOutput = out_wr;
+  si.hStdError  = GetStdHandle (STD_ERROR_HANDLE);
+
+  len = strlen(py->exe_name) + sizeof(PY_HELPER_PROG) + 20;
+  cmd = MALLOC (len);
+  snprintf (cmd, len, "\"%s\" -u -c \"%s\"", py->exe_name, PY_HELPER_PROG);
+
+  memset (&pi, '\0', sizeof(pi));
+  rc = CreateProcess (NULL, cmd, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+  FREE (cmd);
+  if (!rc)
+  {
+    DEBUGF (1, "CreateProcess (\"%s\") failed; %s\n", py->exe_name, win_strerror(GetLastError()));
+    goto fail;
+  }
+
+  STAT_INC (STAT_SPAWNED);
+  CloseHandle (pi.hThread);
+  CloseHandle (in_rd);
+  CloseHandle (out_wr);
+  spawn_unlock();
+  h->process    = pi.hProcess;
+  h->to_child   = in_wr;
+  h->from_child = out_rd;
+  DEBUGF (2, "Started helper for \"%s\"; pid: %lu.\n", py->exe_name, (unsigned long)pi.dwProcessId);
+  return (TRUE);
+
+fail:
+  if (in_rd)
+     CloseHandle (in_rd);
+  if (in_wr)
+     CloseHandle (in_wr);
+  if (out_rd)
+     CloseHandle (out_rd);
+  if (out_wr)
+     CloseHandle (out_wr);
+  spawn_unlock();
+  h->failed = TRUE;
+  return (FALSE);
+}
+
+/**
+ * Stop the helper process of \c py.
+ * Closing it's \c stdin makes it exit by itself. Kill it if that
+ * does not happen within 2 sec.
+ */
+static void py_helper_stop (struct python_info *py)
+{
+  struct py_helper *h = py->helper;
+
+  if (h->to_child)
+     CloseHandle (h->to_child);
+  if (h->from_child)
+     CloseHandle (h->from_child);
+  if (h->process)
+  {
+    if (WaitForSingleObject(h->process, 2000) != WAIT_OBJECT_0)
+       TerminateProcess (h->process, 1);
+    CloseHandle (h->process);
+  }
+  FREE (py->helper);
+}
+
+/**
+ * Write all of \c size bytes in \c buf to the helper.
+ */
+static BOOL py_helper_write (struct py_helper *h, const char *buf, size_t size)
+{
+  DWORD written;
+
+  while (size > 0)
+  {
+    if (!WriteFile(h->to_child, buf, (DWORD)size, &written, NULL) || written == 0)
+       return (FALSE);
+    buf  += written;
+    size -= written;
+  }
+  return (TRUE);
+}
+
+/**
+ * Read exactly \c size bytes from the helper into \c buf.
+ */
+static BOOL py_helper_read (struct py_helper *h, char *buf, size_t size)
+{
+  DWORD got;
+
+  while (size > 0)
+  {
+    if (!ReadFile(h->from_child, buf, (DWORD)size, &got, NULL) || got == 0)
+       return (FALSE);
+    buf  += got;
+    size -= got;
+  }
+  return (TRUE);
+}
+
+/**
+ * Let the helper of \c py run the program \c py_prog and return what it printed.
+ * The helper is started on first use.
+ *
+ * \param[in]  py       the Python to run the program in.
+ * \param[in]  py_prog  the Python program.
+ * \param[out] crashed  set to TRUE if the program raised an exception.
+ *
+ * \retval !NULL the output of \c py_prog. Caller must \c FREE() it.
+ * \retval NULL  the helper failed (or could not be started). The caller
+ *               should fall back to spawning \c py.
+ */
+static char *py_helper_call (struct python_info *py, const char *py_prog, BOOL *crashed)
+{
+  struct py_helper *h = py->helper;
+  char     header [30], *out;
+  unsigned rc, len, i;
+
+  if (!h)
+  {
+    if (py->is_cygwin || !py_helper_start(py))
+       return (NULL);
+    h = py->helper;
+  }
+  if (h->failed)
+     return (NULL);
+
+  snprintf (header, sizeof(header), "%u\n", (unsigned)strlen(py_prog));
+  if (!py_helper_write(h, header, strlen(header)) ||
+      !py_helper_write(h, py_prog, strlen(py_prog)))
+     goto fail;
+
+  for (i = 0; i < sizeof(header)-1; i++)
+  {
+    if (!py_helper_read(h, header+i, 1))
+       goto fail;
+    if (header[i] == '\n')
+       break;
+  }
+  header[i] = '\0';
+  if (sscanf(header, "%u %u", &rc, &len) != 2)
+     goto fail;
+
+  out = MALLOC (len+1);
+  if (!py_helper_read(h, out, len))
+  {
+    FREE (out);
+    goto fail;
+  }
+  out [len] = '\0';
+  if (crashed)
+     *crashed = (rc != 0);
+  return (out);
+
+fail:
+  DEBUGF (1, "Helper for \"%s\" failed; %s\n", py->exe_name, win_strerror(GetLastError()));
+  h->failed = TRUE;
+  return (NULL);
+}
+
 /**
  * Variables used in the generic callback helper function \c popen_append_out().
  */
@@ -1074,11 +1343,31 @@ static void popen_append_clear (const struct python_info *py)
   FREE (popen_tmp);
 }
 
-static char *popen_run_py (const struct python_info *py, const char *py_prog, BOOL redir_stderr)
+/**
+ * Run the program \c py_prog in \c py and return it's output.
+ * Use the helper process if possible. Otherwise write it to a temp-file
+ * and spawn \c py on it.
+ */
+static char *popen_run_py (struct python_info *py, const char *py_prog, BOOL redir_stderr)
 {
   char report [1000];
+  char *out;
+  BOOL crashed = FALSE;
   int  rc;
 
+  TRACE_BEGIN ("python", py->exe_name);
+  out = py_helper_call (py, py_prog, &crashed);
+  TRACE_END ("python");
+  if (out)
+  {
+    if (!crashed)
+       return (out);
+    WARN ("Failed script in \"%s\":\n", py->exe_name);
+    C_puts (out);
+    FREE (out);
+    return (NULL);
+  }
+
   popen_tmp = tmp_fputs (py, py_prog);
   if (!popen_tmp)
   {
@@ -1182,8 +1471,298 @@ static char *popen_run_py (const struct python_info *py, const char *py_prog, BO
         "\n"                                                                         \
         "list_modules()\n"
 
+/**\struct py_module
+ * One installed distribution found by \c py_scan_modules().
+ */
+struct py_module {
+       char *name;       /** the project name */
+       char *version;    /** it's version (or NULL if unknown) */
+       char *key;        /** the lower-case "safe" name; sorted on this */
+       char *meta_file;  /** the \c METADATA or \c PKG-INFO file to read (or NULL) */
+       char *location;   /** the directory (or .egg) it was found in */
+       BOOL  is_zip;     /** \c location is a zipped .egg */
+       BOOL  exist;      /** \c location exists */
+       int   order;      /** the index of the \c sys.path[] entry it was found in */
+     };
+
+/**
+ * Split a distribution file-name like \c "name-version-py2.7.egg",
+ * \c "name-version.dist-info" or \c "name.egg-info" into \c name and \c version.
+ */
+static void py_module_split_name (struct py_module *m, const char *fname)
+{
+  char *copy = STRDUP (basename(fname));
+  char *dot  = strrchr (copy, '.');
+  char *dash;
+
+  if (dot)
+     *dot = '\0';
+
+  dash = strchr (copy, '-');
+  if (dash)
+  {
+    char *end;
+
+    *dash++ = '\0';
+    end = strchr (dash, '-');
+    if (end)
+       *end = '\0';
+    if (*dash)
+       m->version = STRDUP (dash);
+  }
+  m->name = STRDUP (copy);
+  FREE (copy);
+}
+
+/**
+ * Allocate a new \c py_module and add it to \c modules.
+ */
+static struct py_module *py_module_add (smartlist_t *modules, const char *fname,
+                                        const char *meta_file, const char *location,
+                                        int order)
+{
+  struct py_module *m = CALLOC (1, sizeof(*m));
+
+  py_module_split_name (m, fname);
+  m->meta_file = meta_file ? STRDUP (meta_file) : NULL;
+  m->location  = STRDUP (location);
+  m->exist     = TRUE;
+  m->order     = order;
+  smartlist_add (modules, m);
+  return (m);
+}
+
+/**
+ * Look for distributions in the \c sys.path[] directory \c dir:
+ *   \li \c "X.dist-info\METADATA"
+ *   \li \c "X.egg-info\PKG-INFO" or a \c "X.egg-info" file.
+ *   \li \c "X.egg\EGG-INFO\PKG-INFO" or a zipped \c "X.egg".
+ */
+static void py_scan_module_dir (smartlist_t *modules, const char *dir, int order)
+{
+  struct od2x_options opts;
+  struct dirent2     *de;
+  DIR2               *dp;
+  char                meta [_MAX_PATH];
+
+  memset (&opts, '\0', sizeof(opts));
+  opts.pattern = "*";
+
+  dp = opendir2x (dir, &opts);
+  if (!dp)
+     return;
+
+  while ((de = readdir2(dp)) != NULL)
+  {
+    const char *ext  = get_file_ext (de->d_name);
+    BOOL        is_dir = (de->d_attrib & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+    if (!stricmp(ext, "dist-info") && is_dir)
+    {
+      snprintf (meta, sizeof(meta), "%s\\METADATA", de->d_name);
+      py_module_add (modules, de->d_name, meta, dir, order);
+    }
+    else if (!stricmp(ext, "egg-info"))
+    {
+      snprintf (meta, sizeof(meta), "%s\\PKG-INFO", de->d_name);
+      py_module_add (modules, de->d_name, is_dir ? meta : de->d_name, dir, order);
+    }
+    else if (!stricmp(ext, "egg"))
+    {
+      struct py_module *m;
+
+      snprintf (meta, sizeof(meta), "%s\\EGG-INFO\\PKG-INFO", de->d_name);
+      m = py_module_add (modules, de->d_name, is_dir ? meta : NULL, de->d_name, order);
+      m->is_zip = !is_dir;
+    }
+  }
+  closedir2 (dp);
+}
+
+/**
+ * Get the \c "Name:" and \c "Version:" from the headers of a
+ * \c METADATA or \c PKG-INFO file.
+ */
+static void py_read_meta_file (struct py_module *m)
+{
+  FILE *f = fopen (m->meta_file, "rt");
+  char  buf [500];
+
+  if (!f)
+     return;
+
+  while (fgets(buf, sizeof(buf), f))
+  {
+    strip_nl (buf);
+    if (!buf[0])      /* end of headers */
+       break;
+    if (!strncmp(buf,"Name: ",6))
+    {
+      FREE (m->name);
+      m->name = STRDUP (str_trim(buf+6));
+    }
+    else if (!strncmp(buf,"Version: ",9))
+    {
+      FREE (m->version);
+      m->version = STRDUP (str_trim(buf+9));
+    }
+  }
+  fclose (f);
+}
+
+/**
+ * \c zip_list() callback for \c py_read_module(). We only need to know
+ * it's a valid ZIP-file. Stop at the first entry.
+ */
+static int zip_check_cb (const struct zip_entry *ze, void *arg)
+{
+  ARGSUSED (ze);
+  ARGSUSED (arg);
+  return (-1);
+}
+
+/**
+ * The worker-thread job for \c py_scan_modules(). Must not print anything.
+ *
+ * Read the meta-data of a distribution, check if a zipped .egg is
+ * a valid ZIP-file and set the \c key.
+ */
+static void py_read_module (void *arg)
+{
+  struct py_module *m = (struct py_module*) arg;
+  char  *p;
+
+  if (m->meta_file)
+     py_read_meta_file (m);
+
+  if (m->is_zip)
+     m->is_zip = (zip_list(m->location, zip_check_cb, NULL) >= 0);
+
+  /* Like 'pkg_resources.safe_name(name).lower()'.
+   */
+  m->key = STRDUP (m->name);
+  for (p = m->key; *p; p++)
+  {
+    if (isalnum((int)*p) || *p == '.')
+         *p = (char) tolower ((int)*p);
+    else *p = '-';
+  }
+}
+
+static int py_module_compare (const void **_a, const void **_b)
+{
+  const struct py_module *a = *(const struct py_module**) _a;
+  const struct py_module *b = *(const struct py_module**) _b;
+  int   rc = strcmp (a->key, b->key);
+
+  if (rc)
+     return (rc);
+  return (a->order - b->order);
+}
+
+static void free_py_module (void *e)
+{
+  struct py_module *m = (struct py_module*) e;
+
+  FREE (m->name);
+  FREE (m->version);
+  FREE (m->key);
+  FREE (m->meta_file);
+  FREE (m->location);
+  FREE (m);
+}
+
+/**
+ * Find all installed distributions along \c py->sys_path[] without
+ * starting Python. The directories are listed here, but the meta-data
+ * files are read by a pool of worker-threads.
+ *
+ * Like \c pkg_resources, only the first distribution with a given name
+ * on the \c sys.path[] is used.
+ *
+ * \retval a list of \c py_module sorted on \c key.
+ */
+static smartlist_t *py_scan_modules (const struct python_info *py)
+{
+  smartlist_t *modules = smartlist_new();
+  int          i, max = smartlist_len (py->sys_path);
+
+  for (i = 0; i < max; i++)
+  {
+    const struct python_path *pp = smartlist_get (py->sys_path, i);
+    const char *ext = get_file_ext (pp->dir);
+    struct py_module *m;
+
+    if (!stricmp(ext, "egg"))
+    {
+      char meta [_MAX_PATH];
+
+      snprintf (meta, sizeof(meta), "%s\\EGG-INFO\\PKG-INFO", pp->dir);
+      m = py_module_add (modules, pp->dir, pp->is_dir ? meta : NULL, pp->dir, i);
+      m->is_zip = pp->is_zip;
+      m->exist  = pp->exist;
+    }
+    else if (pp->is_dir)
+      py_scan_module_dir (modules, pp->dir, i);
+  }
+
+  tasks_run_list (modules, py_read_module);
+
+  smartlist_sort (modules, py_module_compare);
+  for (i = 1; i < smartlist_len(modules); i++)
+  {
+    const struct py_module *prev = smartlist_get (modules, i-1);
+    struct py_module       *m    = smartlist_get (modules, i);
+
+    if (!strcmp(prev->key, m->key))
+    {
+      DEBUGF (2, "%s in %s is shadowed by %s.\n", m->key, m->location, prev->location);
+      free_py_module (m);
+      smartlist_del_keeporder (modules, i--);
+    }
+  }
+  return (modules);
+}
+
+/**
+ * Print the list of installed Python modules found by \c py_scan_modules().
+ */
+static int py_print_modules_native (void)
+{
+  smartlist_t *modules = py_scan_modules (g_py);
+  int          i, max = smartlist_len (modules);
+  int          zips_found = 0;
+
+  for (i = 0; i < max; i++)
+  {
+    const struct py_module *m = smartlist_get (modules, i);
+    char  version [50];
+    char *path;
+
+    snprintf (version, sizeof(version), "v.%s", m->version ? m->version : "?");
+    if (!m->exist)
+         path = STRDUP (m->location);
+    else if (m->is_zip)
+         path = STRDUP (m->location);
+    else path = _stracat (STRDUP(m->location), "\\");
+
+    C_printf ("~6%3d:~0 %-25s %-10s -> %s %s\n", i+1, m->key, version, py_relative(g_py,path),
+              !m->exist ? "!" : m->is_zip ? "(ZIP)" : "");
+    if (m->is_zip)
+       zips_found++;
+    FREE (path);
+  }
+  C_printf ("~6Found %d modules~0 (%d are ZIP/EGG files).\n", max, zips_found);
+
+  smartlist_wipe (modules, free_py_module);
+  smartlist_free (modules);
+  return (max);
+}
+
 /**
  * Print the list of installed Python modules.
+ * Use \c py_print_modules_native() if the \c sys.path[] is known.
+ * Otherwise run \c PY_LIST_MODULES() in Python.
  * \anchor py_print_modules
  */
 int py_print_modules (void)
@@ -1193,6 +1772,9 @@ int py_print_modules (void)
 
   C_printf ("~6List of modules for %s:~0\n", g_py->exe_name);
 
+  if (smartlist_len(g_py->sys_path) > 0)
+     return py_print_modules_native();
+
   if (g_py->is_embeddable)
   {
     /**
@@ -1256,11 +1838,12 @@ static BOOL check_bitness (struct python_info *pi, char **needed_bits)
   else if (sizeof(void*) == 8)
      our_bitness = bit_64;
 
-  if (pi->bitness == bit_unknown)
-     pi->bitness_ok = (pi->dll_name && check_if_PE(pi->dll_name, &pi->bitness));
+  /* The bitness could be known already from the cache.
+   */
+  if (pi->bitness == bit_unknown && pi->dll_name)
+     check_if_PE (pi->dll_name, &pi->bitness);
 
-  if (pi->bitness_ok && pi->bitness != our_bitness)
-     pi->bitness_ok = FALSE;
+  pi->bitness_ok = (pi->bitness != bit_unknown && pi->bitness == our_bitness);
 
   if (needed_bits)
      *needed_bits = (our_bitness == bit_32 ? "32" : "64");
@@ -1268,171 +1851,157 @@ static BOOL check_bitness (struct python_info *pi, char **needed_bits)
   return (pi->bitness_ok);
 }
 
-/**
- * Parse the output line from the \c PY_ZIP_LIST program below.
- * Each line on the form:
- * \code
- *    81053 20130327.164158 stem/control.py
- *    ^     ^
- *    size  time: YYYYMMDD.HHMMSS
- * \endcode
+/**\struct zip_match
+ * A matching entry inside a ZIP/EGG-file.
  */
-static int report_zip_file (struct python_info *py, const char *zip_file, char *output)
-{
-  struct tm    tm;
-  const  char *space, *p, *file_within_zip;
-  char   *q, report [1024];
-  int    num;
-  time_t mtime;
-  long   fsize;
-
-  space = strrchr (output, ' ');
-  if (!space)
-  {
-    WARN (" (1) Unexpected 'zipfile' line: %s\n", output);
-    return (0);
-  }
-
-  file_within_zip = space + 1;
-  p = space - 1;
-  while (p > output && *p != ' ')
-      --p;
-
-  if (p <= output)
-  {
-    WARN (" (2) Unexpected 'zipfile' line: %s\n", output);
-    return (0);
-  }
-
-  p++;
-  memset (&tm, 0, sizeof(tm));
-  num = sscanf (output, "%ld %4u%2u%2u.%2u%2u%2u",
-                &fsize, &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
-                        &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
-  if (num != 7)
-  {
-    WARN (" (3) Unexpected 'zipfile' line: %s\n", output);
-    return (0);
-  }
-
-  tm.tm_year -= 1900;
-  tm.tm_mon  -= 1;
-
-  mtime = mktime (&tm);
-  if (mtime == -1)
-  {
-    WARN (" (4) Unexpected timestamp: \"%.*s\".\n", (int)(space-p), p);
-    DEBUGF (1, "parsed tm: %04u%02u%02u.%02u%02u%02u. num: %d\n",
-            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-            tm.tm_hour, tm.tm_min, tm.tm_sec, num);
-    return (0);
-  }
-
-  /* The \c 'zipfile' module always reports 'file_within_zip' with '/' slashes.
-   */
-  slashify2 (report, file_within_zip, opt.show_unix_paths ? '/' : '\\');
-  q = strchr (report, '\0');
-  snprintf (q, sizeof(report) - (q-report), "  (%s)", py_relative(py,zip_file));
+struct zip_match {
+       char   *name;      /** MALLOC()'ed name of the entry (with native slashes) */
+       time_t  mtime;     /** it's time-stamp */
+       UINT64  fsize;     /** and uncompressed size */
+     };
 
-  /** \todo: incase \c '--pe-check' is specified and \c 'report' file is a .pyd-file,
-   *         we should save the .pyd to a \c %TEMP-file and examine it in \c report_file().
-   */
-  report_file (report, mtime, fsize, FALSE, FALSE, HKEY_PYTHON_EGG);
-  return (1);
-}
+/**\struct zip_job
+ * The job of listing one ZIP/EGG-file in \c sys.path[].
+ * Done by a worker-thread in \c zip_scan().
+ */
+struct zip_job {
+       const char  *zfile;        /** the ZIP/EGG-file to list */
+       smartlist_t *matches;      /** list of \c "struct zip_match" */
+       int          num_entries;  /** number of entries in \c zfile; -1 if not a valid ZIP-file */
+       DWORD        win_err;      /** why \c zip_list() failed; reported by \c process_zip() */
+       char        *name;         /** a 0-terminated copy of the current entry name */
+       size_t       name_sz;      /** the size of the above buffer */
+     };
 
 /**
- * List a ZIP/EGG-file (file) for a matching \c opt.file_spec.
+ * The callback for \c zip_list(). Check if an entry matches \c opt.file_spec.
  *
  * \note
- *   We are not interested in the dir-part. Hence get the basename of 'f.filename' first.
- *   Thus:
+ *   Like Python's \c zipfile + \c fnmatch module did for us previously, match
+ *   on both the full name and the basename within the ZIP-file. Thus:
  *   \code
  *     "EGG-INFO/requires.txt" -> False
  *     "egg-timer.txt"         -> True
- *    \endcode
- *
- * \note
- *   'fnmatch.fnmatch ("EGG-INFO/dependency_links.txt", "egg*.txt")' will return True!
- *
- * \def PY_ZIP_LIST
- *   This text goes into a buffer used by \c call_python_func().
- */
-#define PY_ZIP_LIST                                                                 \
-        "import os, sys, fnmatch, zipfile\n"                                        \
-        PY_TRACE_DEF()                                                              \
-        "\n"                                                                        \
-        "def print_zline (f, debug):\n"                                             \
-        "  base = os.path.basename (f.filename)\n"                                  \
-        "  if debug >= 3:\n"                                                        \
-        "    trace ('egg-file: %%s, base: %%s\\n' %% (f.filename, base))\n"         \
-        "  if (%d):\n"                            /* opt.case_sensitive */          \
-        "    match = fnmatch.fnmatchcase\n"                                         \
-        "  else:\n"                                                                 \
-        "    match = fnmatch.fnmatch\n"                                             \
-        "\n"                                                                        \
-        "  file_spec = '%s'\n"                    /* opt.file_spec */               \
-        "  if match(f.filename, file_spec) or match(base, file_spec):\n"            \
-        "    date = \"%%4d%%02d%%02d\"  %% (f.date_time[0:3])\n"                    \
-        "    time = \"%%02d%%02d%%02d\" %% (f.date_time[3:6])\n"                    \
-        "    str = \"%%d %%s.%%s %%s\"  %% (f.file_size, date, time, f.filename)\n" \
-        "    if debug >= 3:\n"                                                      \
-        "      trace ('str: \"%%s\"\\n' %% str)\n"                                  \
-        "    print (str)\n"                                                         \
-        "\n"                                                                        \
-        "zf = zipfile.ZipFile (r\"%s\", 'r')\n"   /* zfile */                       \
-        "for f in zf.infolist():\n"                                                 \
-        "  print_zline (f, %d)\n"                 /* opt.debug */
-
-static int process_zip (struct python_info *py, const char *zfile)
-{
-  char  cmd [sizeof(PY_ZIP_LIST) + _MAX_PATH + 100];
-  char *line, *str = NULL;
-  int   found = 0;
-  int   len = snprintf (cmd, sizeof(cmd), PY_ZIP_LIST,
-                        opt.case_sensitive, opt.file_spec, zfile, opt.debug);
-  if (len < 0)
-     FATAL ("cmd[] buffer too small.\n");
-
-  if (py->is_embeddable)
-       str = call_python_func (py, cmd);
-  else str = popen_run_py (py, cmd, TRUE);
+ *   \endcode
+ */
+static int zip_match_cb (const struct zip_entry *ze, void *arg)
+{
+  struct zip_job   *job = (struct zip_job*) arg;
+  struct zip_match *m;
+  const char       *base;
+  char             *p, slash;
+  int               flags = fnmatch_case (0);
 
-  if (str)
+  if (ze->name_len + 1 > job->name_sz)
   {
-    for (found = 0, line = strtok(str,"\n"); line; line = strtok(NULL,"\n"), found++)
-    {
-      DEBUGF (2, "line: \"%s\", found: %d\n", line, found);
-      if (!strncmp(line,"str: ",5))   /* if opt.debug >= 3; ignore these from stderr */
-         continue;
-      if (!report_zip_file(py, zfile, line))
-         break;
-    }
+    job->name_sz = ze->name_len + 100;
+    job->name    = REALLOC (job->name, job->name_sz);
   }
-  popen_append_clear (py);
+  memcpy (job->name, ze->name, ze->name_len);
+  job->name [ze->name_len] = '\0';
 
-  if (str && found == 0)
-     DEBUGF (1, "No matches in %s for %s.\n", zfile, opt.file_spec);
+  base = strrchr (job->name, '/');
+  base = base ? base+1 : job->name;
 
-  FREE (str);
-  return (found);
+  if (fnmatch(opt.file_spec, job->name, flags) != FNM_MATCH &&
+      fnmatch(opt.file_spec, base, flags) != FNM_MATCH)
+     return (0);
+
+  /* ZIP-files always have '/' slashes.
+   */
+  slash = opt.show_unix_paths ? '/' : '\\';
+  for (p = job->name; *p; p++)
+      if (IS_SLASH(*p))
+         *p = slash;
+
+  m = MALLOC (sizeof(*m));
+  m->name  = STRDUP (job->name);
+  m->mtime = ze->mtime;
+  m->fsize = ze->size;
+  smartlist_add (job->matches, m);
+  return (1);
 }
 
 /**
- * Allocate a 'python_path' node and add it to 'pi->sys_path[]' smartlist.
+ * The job-function for \c tasks_run_list().
+ * Runs in a worker-thread; must not print anything.
  */
-static void add_sys_path (struct python_info *pi, const char *dir)
+static void zip_scan (void *arg)
 {
-  struct python_path *pp = CALLOC (1, sizeof(*pp));
-  struct stat st;
+  struct zip_job *job = (struct zip_job*) arg;
 
-  _strlcpy (pp->dir, dir, sizeof(pp->dir));
+  job->num_entries = zip_list (job->zfile, zip_match_cb, job);
+  if (job->num_entries < 0)
+     job->win_err = GetLastError();
+  FREE (job->name);
+}
+
+static void free_zip_match (void *e)
+{
+  struct zip_match *m = (struct zip_match*) e;
+
+  FREE (m->name);
+  FREE (m);
+}
+
+static void free_zip_job (void *e)
+{
+  struct zip_job *job = (struct zip_job*) e;
+
+  smartlist_wipe (job->matches, free_zip_match);
+  smartlist_free (job->matches);
+  FREE (job);
+}
+
+/**
+ * Report the matches found by \c zip_scan() in a ZIP/EGG-file.
+ * Called in the main thread in the order of \c sys.path[].
+ */
+static int process_zip (struct python_info *py, const struct zip_job *job)
+{
+  int i, max = smartlist_len (job->matches);
+
+  if (job->num_entries < 0)
+  {
+    DEBUGF (1, "\"%s\" is not a valid ZIP-file; %s.\n", job->zfile, win_strerror(job->win_err));
+    return (0);
+  }
+
+  DEBUGF (2, "%s: %d entries, %d matches.\n", job->zfile, job->num_entries, max);
+
+  for (i = 0; i < max; i++)
+  {
+    const struct zip_match *m = smartlist_get (job->matches, i);
+    char  report [1024];
+
+    snprintf (report, sizeof(report), "%s  (%s)", m->name, py_relative(py,job->zfile));
+
+    /** \todo: incase \c '--pe-check' is specified and \c 'report' file is a .pyd-file,
+     *         we should save the .pyd to a \c %TEMP-file and examine it in \c report_file().
+     */
+    report_file (report, m->mtime, m->fsize, FALSE, FALSE, HKEY_PYTHON_EGG);
+  }
+
+  if (max == 0)
+     DEBUGF (1, "No matches in %s for %s.\n", job->zfile, opt.file_spec);
+  return (max);
+}
+
+/**
+ * Allocate a 'python_path' node and add it to 'pi->sys_path[]' smartlist.
+ */
+static void add_sys_path (struct python_info *pi, const char *dir)
+{
+  struct python_path *pp = CALLOC (1, sizeof(*pp));
+  struct stat st;
+
+  _strlcpy (pp->dir, dir, sizeof(pp->dir));
   memset (&st, '\0', sizeof(st));
   pp->exist  = (stat(dir, &st) == 0);
   pp->is_dir = pp->exist && _S_ISDIR(st.st_mode);
   pp->is_zip = pp->exist && _S_ISREG(st.st_mode) && check_if_zip (dir);
 
-  smartlist_add (g_py->sys_path, pp);
+  smartlist_add (pi->sys_path, pp);
 }
 
 /**
@@ -1463,13 +2032,15 @@ static int build_sys_path (char *str, int index)
 }
 
 /**
- *\def PY_GET_VERSION
+ *\def PY_PROBE_CMD
  *   Run python with this on the cmd-line to get the version triplet.\n
- *   Also in the same command, print the \c user-site path.
+ *   Also in the same command, print the \c user-site path and
+ *   the \c sys.path[] (one per line).
  */
-#define PY_GET_VERSION  "import os, sys, sysconfig; " \
-                        "print (sys.version_info); "  \
-                        "print (sysconfig.get_path('purelib', '%s_user' % os.name))"
+#define PY_PROBE_CMD  "import os, sys, sysconfig; " \
+                      "print (sys.version_info); "  \
+                      "print (sysconfig.get_path('purelib', '%s_user' % os.name)); " \
+                      "[sys.stdout.write(p + '\\n') for p in sys.path]"
 
 /**
  * \def PY_PRINT_SYS_PATH_DIRECT
@@ -1495,6 +2066,398 @@ static int build_sys_path (char *str, int index)
                                 "[print(p) for (i,p) in enumerate(sys.path)]"
 
 /**
+ * Add \c dir to the list \c sl unless it's already there.
+ * Like \c site.removeduppaths(), the test is case-insensitive.
+ */
+static void native_add (smartlist_t *sl, const char *dir)
+{
+  int i, max = smartlist_len (sl);
+
+  for (i = 0; i < max; i++)
+      if (!stricmp(dir, (const char*)smartlist_get(sl, i)))
+         return;
+  smartlist_add (sl, STRDUP(dir));
+}
+
+/**
+ * Add \c site_dir and process the \c .pth-files in it like
+ * \c site.addsitedir() does. \n
+ * A directory is only added if it exists.
+ *
+ * \retval FALSE  a \c .pth-file has an \c "import" line. The Python must then be
+ *                spawned to get the correct \c sys.path[].
+ * \retval TRUE   otherwise.
+ */
+static BOOL native_add_site_dir (smartlist_t *sl, const char *site_dir)
+{
+  struct od2x_options opts;
+  struct dirent2     *de;
+  DIR2               *dp;
+  BOOL                rc = TRUE;
+
+  if (!is_directory(site_dir))
+     return (TRUE);
+
+  native_add (sl, site_dir);
+
+  memset (&opts, '\0', sizeof(opts));
+  opts.pattern = "*.pth";
+  opts.sort    = OD2X_ON_NAME;
+
+  dp = opendir2x (site_dir, &opts);
+  if (!dp)
+     return (TRUE);
+
+  while (rc && (de = readdir2(dp)) != NULL)
+  {
+    FILE *f;
+    char  line [_MAX_PATH+2], dir [_MAX_PATH];
+
+    if (de->d_attrib & FILE_ATTRIBUTE_DIRECTORY)
+       continue;
+
+    f = fopen (de->d_name, "rt");
+    if (!f)
+       continue;
+
+    while (fgets(line, sizeof(line), f))
+    {
+      if (line[0] == '#')
+         continue;
+
+      if (!strncmp(line,"import ",7) || !strncmp(line,"import\t",7))
+      {
+        DEBUGF (2, "%s has an import-line. Must spawn Python.\n", de->d_name);
+        rc = FALSE;
+        break;
+      }
+
+      str_rtrim (line);
+      if (!line[0])
+         continue;
+
+      if (IS_SLASH(line[0]) || (line[0] && line[1] == ':'))
+           _strlcpy (dir, line, sizeof(dir));
+      else snprintf (dir, sizeof(dir), "%s\\%s", site_dir, line);
+
+      _fix_path (dir, dir);
+      if (FILE_EXISTS(dir) || is_directory(dir))
+         native_add (sl, dir);
+    }
+    fclose (f);
+  }
+  closedir2 (dp);
+  return (rc);
+}
+
+/**
+ * Add the \c site-packages directories for \c prefix.
+ * On Windows, \c site.getsitepackages() returns the prefix itself and
+ * the \c "lib\\site-packages" under it.
+ */
+static BOOL native_add_site_packages (smartlist_t *sl, const char *prefix)
+{
+  char dir [_MAX_PATH];
+
+  snprintf (dir, sizeof(dir), "%s\\lib\\site-packages", prefix);
+  return (native_add_site_dir(sl, prefix) && native_add_site_dir(sl, dir));
+}
+
+/**
+ * Look for a \c "pyvenv.cfg" in the directory of \c py->exe_name or it's parent.
+ * If found, return it's \c "home" and \c "include-system-site-packages" values
+ * and set \c prefix to the directory of the \c "pyvenv.cfg" file.
+ */
+static BOOL native_read_pyvenv (const struct python_info *py, char *prefix,
+                                char *home, size_t home_size, BOOL *system_site)
+{
+  FILE *f = NULL;
+  char  buf [_MAX_PATH+50], *p;
+  int   i;
+
+  _strlcpy (prefix, py->dir, _MAX_PATH);
+  for (i = 0; i < 2; i++)
+  {
+    snprintf (buf, sizeof(buf), "%s\\pyvenv.cfg", prefix);
+    f = fopen (buf, "rt");
+    if (f)
+       break;
+    p = strrchr (prefix, '\\');
+    if (!p)
+       break;
+    *p = '\0';
+  }
+  if (!f)
+     return (FALSE);
+
+  home[0] = '\0';
+  *system_site = FALSE;
+
+  while (fgets(buf, sizeof(buf), f))
+  {
+    char *key, *value;
+
+    p = strchr (buf, '=');
+    if (!p)
+       continue;
+    *p++ = '\0';
+    key   = str_trim (buf);
+    value = str_trim (p);
+    if (!stricmp(key, "home"))
+       _strlcpy (home, value, home_size);
+    else if (!stricmp(key, "include-system-site-packages"))
+       *system_site = (stricmp(value, "true") == 0);
+  }
+  fclose (f);
+
+  p = strchr (home, '\0');
+  if (p > home && IS_SLASH(p[-1]))
+     p[-1] = '\0';
+
+  DEBUGF (2, "pyvenv.cfg: prefix: '%s', home: '%s', system_site: %d\n",
+          prefix, home, *system_site);
+  return (home[0] != '\0');
+}
+
+/**
+ * Handle a \c "._pth" file. Only the paths in it are used (relative to the
+ * directory of it) and \c %PYTHONPATH etc. is ignored. If it has an
+ * \c "import site" line, the \c site-packages are added too.
+ */
+static BOOL native_read_pth_file (smartlist_t *sl, const char *pth_file)
+{
+  FILE *f = fopen (pth_file, "rt");
+  char *pth_dir, line [_MAX_PATH+2], dir [_MAX_PATH];
+  BOOL  rc = TRUE, import_site = FALSE;
+
+  if (!f)
+     return (FALSE);
+
+  pth_dir = dirname (pth_file);
+  while (fgets(line, sizeof(line), f))
+  {
+    str_trim (line);
+    if (!line[0] || line[0] == '#')
+       continue;
+
+    if (!strncmp(line,"import ",7))
+    {
+      if (!strcmp(line,"import site"))
+           import_site = TRUE;
+      else rc = FALSE;
+      continue;
+    }
+    if (IS_SLASH(line[0]) || line[1] == ':')
+         _strlcpy (dir, line, sizeof(dir));
+    else snprintf (dir, sizeof(dir), "%s\\%s", pth_dir, line);
+    native_add (sl, _fix_path(dir, dir));
+  }
+  fclose (f);
+
+  if (rc && import_site)
+     rc = native_add_site_packages (sl, pth_dir);
+  FREE (pth_dir);
+  return (rc);
+}
+
+/**
+ * Compute the user-site path of \c py like \c sysconfig does for the \c "nt_user" scheme:
+ *   \c "%PYTHONUSERBASE\\PythonXY\\site-packages" or
+ *   \c "%APPDATA%\\Python\\PythonXY\\site-packages".
+ */
+static BOOL native_user_site (const struct python_info *py, char *buf, size_t size)
+{
+  const char *base = getenv ("PYTHONUSERBASE");
+  const char *appdata = getenv ("APPDATA");
+
+  if (base && *base)
+     snprintf (buf, size, "%s\\Python%d%d\\site-packages", base, py->ver_major, py->ver_minor);
+  else if (appdata && *appdata)
+     snprintf (buf, size, "%s\\Python\\Python%d%d\\site-packages", appdata, py->ver_major, py->ver_minor);
+  else
+    return (FALSE);
+  return (TRUE);
+}
+
+/**
+ * Compute the \c sys.path[] of a CPython without spawning it. This emulates
+ * what \c getpathp.c and \c site.py does for the common cases:
+ *   \li a \c "pythonXY._pth" or \c "python._pth" file.
+ *   \li a virtual environment with a \c "pyvenv.cfg" file.
+ *   \li \c %PYTHONPATH and \c %PYTHONHOME.
+ *   \li the \c "pythonXY.zip", \c "DLLs" and \c "lib" directories.
+ *   \li the user-site and \c site-packages directories with
+ *       their \c .pth-files.
+ *
+ * The directories are added as \c char* to \c sl and the user-site path
+ * is returned in \c user_site.
+ *
+ * \retval FALSE  if this is not a CPython or a \c .pth-file has an \c "import" line.
+ *                The Python must then be spawned.
+ * \retval TRUE   the \c sys.path[] is complete.
+ *
+ * \todo The \c "PythonPath" sub-keys in the Registry are not handled.
+ */
+static BOOL native_sys_path (const struct python_info *py, smartlist_t *sl,
+                             char *user_site, size_t user_site_size)
+{
+  char        prefix [_MAX_PATH], home [_MAX_PATH], dir [_MAX_PATH];
+  char        zip_dir [_MAX_PATH], venv_dir [_MAX_PATH], landmark [_MAX_PATH];
+  const char *env;
+  char       *copy, *tok, *end;
+  BOOL        is_venv, system_site = TRUE, rc;
+
+  user_site[0] = '\0';
+
+  if (!py->matched ||
+      (py->matched->variant != PY2_PYTHON && py->matched->variant != PY3_PYTHON) ||
+      py->is_cygwin || py->ver_major < 2)
+     return (FALSE);
+
+  /* A Python 2 'virtualenv' has it's own 'site.py'.
+   */
+  snprintf (dir, sizeof(dir), "%s\\..\\lib\\orig-prefix.txt", py->dir);
+  if (FILE_EXISTS(dir))
+     return (FALSE);
+
+  /* The 'pythonXY.zip' and 'pythonXY._pth' are in the directory of the .DLL.
+   */
+  if (py->dll_name)
+  {
+    char *d = dirname (py->dll_name);
+
+    _strlcpy (zip_dir, d, sizeof(zip_dir));
+    FREE (d);
+  }
+  else
+    _strlcpy (zip_dir, py->dir, sizeof(zip_dir));
+
+  snprintf (dir, sizeof(dir), "%s\\python%d%d._pth", zip_dir, py->ver_major, py->ver_minor);
+  if (FILE_EXISTS(dir))
+     return native_read_pth_file (sl, dir);
+
+  _strlcpy (dir, py->exe_name, sizeof(dir));
+  end = strrchr (dir, '.');
+  if (end)
+  {
+    strcpy (end, "._pth");
+    if (FILE_EXISTS(dir))
+       return native_read_pth_file (sl, dir);
+  }
+
+  is_venv = native_read_pyvenv (py, venv_dir, home, sizeof(home), &system_site);
+  if (!is_venv)
+     _strlcpy (home, py->dir, sizeof(home));
+  if (is_venv && !py->dll_name)
+     _strlcpy (zip_dir, home, sizeof(zip_dir));
+
+  /* 1: The %PYTHONPATH.
+   */
+  env = getenv ("PYTHONPATH");
+  if (env && *env)
+  {
+    copy = STRDUP (env);
+    for (tok = strtok(copy, ";"); tok; tok = strtok(NULL, ";"))
+    {
+      _fix_path (tok, dir);
+      native_add (sl, dir);
+    }
+    FREE (copy);
+  }
+
+  /* 2: The zip-file. It's added even if it doesn't exist.
+   */
+  snprintf (dir, sizeof(dir), "%s\\python%d%d.zip", zip_dir, py->ver_major, py->ver_minor);
+  native_add (sl, dir);
+
+  /* 3: The standard library. Relative to %PYTHONHOME or the directory
+   *    where the landmark "lib\os.py" is found.
+   */
+  env = getenv ("PYTHONHOME");
+  if (env && *env)
+     _fix_path (env, prefix);
+  else
+  {
+    _strlcpy (prefix, home, sizeof(prefix));
+    while (1)
+    {
+      snprintf (landmark, sizeof(landmark), "%s\\lib\\os.py", prefix);
+      if (FILE_EXISTS(landmark))
+         break;
+      end = strrchr (prefix, '\\');
+      if (!end)
+      {
+        DEBUGF (2, "Landmark \"lib\\os.py\" not found for %s.\n", py->exe_name);
+        return (FALSE);
+      }
+      *end = '\0';
+    }
+  }
+
+  snprintf (dir, sizeof(dir), "%s\\DLLs", prefix);
+  native_add (sl, dir);
+  snprintf (dir, sizeof(dir), "%s\\lib", prefix);
+  native_add (sl, dir);
+  if (py->ver_major == 2)
+  {
+    snprintf (dir, sizeof(dir), "%s\\lib\\plat-win", prefix);
+    native_add (sl, dir);
+    snprintf (dir, sizeof(dir), "%s\\lib\\lib-tk", prefix);
+    native_add (sl, dir);
+  }
+
+  /* 4: The directory of the program (or 'home' in a venv).
+   */
+  native_add (sl, home);
+
+  /* 5: site.py: the venv 'site-packages' first. Then the user-site and
+   *    the system 'site-packages'.
+   */
+  rc = TRUE;
+  if (is_venv)
+     rc = native_add_site_packages (sl, venv_dir);
+
+  if (rc && system_site)
+  {
+    if (native_user_site(py, user_site, user_site_size))
+       rc = native_add_site_dir (sl, user_site);
+    if (rc)
+       rc = native_add_site_packages (sl, prefix);
+  }
+  return (rc);
+}
+
+/**
+ * Set \c pi->sys_path[] using \c native_sys_path().
+ * Also set \c pi->user_site_path.
+ */
+static BOOL py_native_sys_path (struct python_info *pi)
+{
+  smartlist_t *sl = smartlist_new();
+  char         user_site [_MAX_PATH];
+  int          i, max;
+  BOOL         rc = native_sys_path (pi, sl, user_site, sizeof(user_site));
+
+  if (rc)
+  {
+    smartlist_wipe (pi->sys_path, free_sys_path);
+    max = smartlist_len (sl);
+    for (i = 0; i < max; i++)
+        add_sys_path (pi, smartlist_get(sl, i));
+
+    FREE (pi->user_site_path);
+    pi->user_site_path = user_site[0] ? STRDUP (user_site) : NULL;
+  }
+  DEBUGF (1, "native_sys_path(): %s for %s.\n", rc ? "OK" : "failed", pi->exe_name);
+  smartlist_free_all (sl);
+  return (rc);
+}
+
+/**
+ * Get the \c sys.path[] of \c pi. Normally this was already done by
+ * \c py_probe_all() or taken from the cache. Otherwise try
+ * \c py_native_sys_path() and spawn the Python only if that failed.
+ *
  * \todo:
  *   CygWin's Python doesn't like the \c ";" and \c "\\" in \c %PYTHONPATH.
  *   Try to detect Cygwin and please it before calling \c popen_runf().
@@ -1503,7 +2466,22 @@ static int build_sys_path (char *str, int index)
  */
 static int get_sys_path (struct python_info *pi)
 {
+  char *str;
+  BOOL  crashed = FALSE;
+
   ASSERT (pi == g_py);
+  if (smartlist_len(pi->sys_path) > 0 || py_native_sys_path(pi))
+     return smartlist_len (pi->sys_path);
+
+  str = py_helper_call (pi, PY_PRINT_SYS_PATH_DIRECT, &crashed);
+  if (str)
+  {
+    if (!crashed)
+       build_sys_path (str, -1);
+    FREE (str);
+    return smartlist_len (pi->sys_path);
+  }
+
   return popen_runf (build_sys_path, "%s -c \"%s\"",
                      pi->exe_name, pi->ver_major >= 3 ?
                      PY_PRINT_SYS_PATH3_CMD : PY_PRINT_SYS_PATH2_CMD);
@@ -1598,7 +2576,8 @@ static int get_dll_name (struct python_info *pi, const char **libs)
 /**
  * Run a Python, figure out the \c sys.path[] array and search along that
  * for matches. If a \c sys.path[] component contains a ZIP/EGG-file, use
- * \c process_zip() to list files inside it for a match.
+ * \c process_zip() to report the files inside it that matches.
+ * All ZIP/EGG-files are listed in parallel by \c zip_scan() first.
  *
  * \note First setup \c g_py to use either the 1st suitable Python or the
  *       one specified in the \c "envtool --py=X" option.
@@ -1608,8 +2587,9 @@ static int get_dll_name (struct python_info *pi, const char **libs)
  */
 int py_search (void)
 {
-  char *str = NULL;
-  int   i, len, found;
+  smartlist_t *zip_jobs;
+  char        *str = NULL;
+  int          i, j, len, found;
 
   g_py = py_select (py_which);
   if (!g_py)
@@ -1627,6 +2607,9 @@ int py_search (void)
     if (!str)
        return (0);
 
+    /* The embedded 'sys.path[]' replaces the one from 'py_probe_all()'.
+     */
+    smartlist_wipe (g_py->sys_path, free_sys_path);
     build_sys_path (str, -1);
     FREE (str);
   }
@@ -1635,8 +2618,24 @@ int py_search (void)
 
   found = 0;
   len = smartlist_len (g_py->sys_path);
+  zip_jobs = smartlist_new();
 
   for (i = 0; i < len; i++)
+  {
+    struct python_path *pp = smartlist_get (g_py->sys_path, i);
+    struct zip_job     *job;
+
+    if (!pp->is_zip)
+       continue;
+    job = CALLOC (1, sizeof(*job));
+    job->zfile   = pp->dir;
+    job->matches = smartlist_new();
+    smartlist_add (zip_jobs, job);
+  }
+
+  tasks_run_list (zip_jobs, zip_scan);
+
+  for (i = j = 0; i < len; i++)
   {
     struct python_path *pp = smartlist_get (g_py->sys_path, i);
 
@@ -1646,18 +2645,347 @@ int py_search (void)
        pp->exist = pp->is_dir = TRUE;
 
     if (pp->is_zip)
-         found += process_zip (g_py, pp->dir);
+         found += process_zip (g_py, smartlist_get(zip_jobs, j++));
     else found += process_dir (pp->dir, 0, pp->exist, FALSE, pp->is_dir,
                                TRUE, "sys.path[]", HKEY_PYTHON_PATH, FALSE);
   }
+  smartlist_wipe (zip_jobs, free_zip_job);
+  smartlist_free (zip_jobs);
   return (found);
 }
 
 /**
- * Allocate a new \c python_info node, fill it and return it
- * for adding to the \c py_programs smartlist.
+ * The handler for mode \c "envtool --python[=X] --list-modules". \n
+ * Print the modules of the selected Python.
  */
-static struct python_info *add_python (const char *exe, struct python_info *py)
+int py_list_modules (void)
+{
+  g_py = py_select (py_which);
+  if (!g_py)
+  {
+    WARN ("%s was not found on PATH.\n", py_variant_name(py_which));
+    return (1);
+  }
+  get_sys_path (g_py);
+  py_print_modules();
+  return (0);
+}
+
+/**\struct py_probe
+ * The result of spawning a Python to get it's version, user-site and
+ * \c sys.path[] in one go. Filled by \c py_probe_cb().
+ */
+struct py_probe {
+       struct python_info *py;          /** the Python to probe */
+       int                 ver_major;   /** the version found */
+       int                 ver_minor;
+       int                 ver_micro;
+       char               *user_site;   /** the user-site path found (or NULL) */
+       smartlist_t        *sys_path;    /** the \c sys.path[] found; a list of \c char* */
+     };
+
+/**
+ * \c runner_submit() callback for \c py_probe(). \n
+ * The 1st line is the version, the 2nd is the user-site path and
+ * the remaining lines are the \c sys.path[].
+ */
+static int py_probe_cb (char *output, int line, void *arg)
+{
+  struct py_probe *probe = (struct py_probe*) arg;
+
+ /* 'pypy.exe -c "import sys; print(sys.version_info)"' doesn't print this
+  */
+  const char *prefix = "sys.version_info";
+
+  if (line == 0)
+  {
+    if (!strncmp(output,prefix,strlen(prefix)))
+       output += strlen (prefix);
+    return (sscanf(output, "(major=%d, minor=%d, micro=%d",
+                   &probe->ver_major, &probe->ver_minor, &probe->ver_micro) >= 2);
+  }
+  if (line == 1)
+  {
+    if (strcmp(output,"None"))
+       probe->user_site = STRDUP (output);
+  }
+  else
+    smartlist_add (probe->sys_path, STRDUP(output));
+  return (1);
+}
+
+/**
+ * Add the Python of \c probe to the runner \c r.
+ * The \c probe gets filled in \c runner_wait().
+ */
+static void py_probe (struct runner *r, struct py_probe *probe)
+{
+  runner_submitf (r, 0, py_probe_cb, probe, "\"%s\" -c \"%s\"",
+                  probe->py->exe_name, PY_PROBE_CMD);
+}
+
+/**
+ * Return the newest modification-time of \c dir and the \c .pth-files in it.
+ * A new or deleted \c .pth-file changes the time of \c dir. An edited
+ * one changes only it's own time.
+ */
+static time_t py_pth_newest (const char *dir)
+{
+  WIN32_FIND_DATA ff_data;
+  HANDLE          handle;
+  struct stat     st;
+  char            spec [_MAX_PATH];
+  time_t          newest;
+
+  if (!dir || stat(dir, &st) != 0)
+     return (0);
+
+  newest = st.st_mtime;
+  snprintf (spec, sizeof(spec), "%s\\*.pth", dir);
+  handle = FindFirstFile (spec, &ff_data);
+  if (handle == INVALID_HANDLE_VALUE)
+     return (newest);
+
+  do
+  {
+    time_t mtime = FILETIME_to_time_t (&ff_data.ftLastWriteTime);
+
+    if (mtime > newest)
+       newest = mtime;
+  }
+  while (FindNextFile(handle, &ff_data));
+  FindClose (handle);
+  return (newest);
+}
+
+/**
+ * Build a string of the things (except the \c exe_name itself) that
+ * the \c sys.path[] of \c py depends on:
+ *   \li the \c %PYTHONPATH, \c %PYTHONHOME and \c %PYTHONUSERBASE values.
+ *   \li the newest modification-time of the \c site-packages directories
+ *       and the \c .pth-files in them; a new or edited \c .pth-file can
+ *       change the \c sys.path[].
+ *
+ * If this string is not the same as the cached one, the cached values are stale.
+ */
+static void py_cache_depends (const struct python_info *py, const char *user_site,
+                              char *buf, size_t size)
+{
+  const char *env1 = getenv ("PYTHONPATH");
+  const char *env2 = getenv ("PYTHONHOME");
+  const char *env3 = getenv ("PYTHONUSERBASE");
+  char        site [_MAX_PATH];
+
+  snprintf (site, sizeof(site), "%s\\Lib\\site-packages", py->dir);
+  snprintf (buf, size, "%s|%s|%s|%" S64_FMT "|%" S64_FMT,
+            env1 ? env1 : "", env2 ? env2 : "", env3 ? env3 : "",
+            (INT64)py_pth_newest(site), (INT64)py_pth_newest(user_site));
+}
+
+/**
+ * Try to fill \c py from the cache.
+ * The \c sys.path[] is computed by \c py_native_sys_path() if possible.
+ * Otherwise the cached \c sys.path[] is used unless something it depends
+ * on has changed.
+ *
+ * \retval FALSE if anything is missing or stale. Then \c py must be probed.
+ * \retval TRUE  all values were found.
+ */
+static BOOL py_get_cached (struct python_info *py)
+{
+  char *version, *user_site, *sys_path, *depends, *dll_name, *bitness;
+  char  buf [2000];
+  char *tok;
+  BOOL  rc = FALSE;
+
+  version   = cache_get (SECTION_PYTHON, py->exe_name, "version");
+  user_site = cache_get (SECTION_PYTHON, py->exe_name, "user_site");
+  sys_path  = cache_get (SECTION_PYTHON, py->exe_name, "sys_path");
+  dll_name  = cache_get (SECTION_PYTHON, py->exe_name, "dll_name");
+  bitness   = cache_get (SECTION_PYTHON, py->exe_name, "bitness");
+  depends   = cache_get (SECTION_PYTHON, py->exe_name, "depends");
+
+  if (!version || !user_site || !dll_name || !bitness)
+     goto quit;
+
+  if ((dll_name[0] && !FILE_EXISTS(dll_name)) ||
+      sscanf(version, "%d.%d.%d", &py->ver_major, &py->ver_minor, &py->ver_micro) != 3)
+     goto quit;
+
+  py->dll_name = dll_name[0] ? STRDUP (dll_name) : NULL;
+  py->bitness  = (enum Bitness) atoi (bitness);
+
+  if (py_native_sys_path(py))
+  {
+    rc = TRUE;
+    goto quit;
+  }
+
+  if (sys_path && depends)
+     py_cache_depends (py, user_site[0] ? user_site : NULL, buf, sizeof(buf));
+
+  if (!sys_path || !depends || strcmp(buf,depends))
+  {
+    DEBUGF (1, "Cached values for %s are stale.\n", py->exe_name);
+    FREE (py->dll_name);
+    py->bitness = bit_unknown;
+    goto quit;
+  }
+
+  py->user_site_path = user_site[0] ? STRDUP (user_site) : NULL;
+
+  for (tok = strtok(sys_path, ";"); tok; tok = strtok(NULL, ";"))
+      add_sys_path (py, tok);
+  rc = TRUE;
+
+quit:
+  FREE (version);
+  FREE (user_site);
+  FREE (sys_path);
+  FREE (dll_name);
+  FREE (bitness);
+  FREE (depends);
+  return (rc);
+}
+
+/**
+ * Store the values for \c py in the cache.
+ * The \c sys.path[] is stored as a \c ';' separated list.
+ */
+static void py_put_cached (const struct python_info *py)
+{
+  char   depends [2000];
+  char  *sys_path;
+  size_t size = 1;
+  int    i, max = smartlist_len (py->sys_path);
+
+  for (i = 0; i < max; i++)
+  {
+    const struct python_path *pp = smartlist_get (py->sys_path, i);
+
+    size += strlen (pp->dir) + 1;
+  }
+  sys_path = MALLOC (size);
+  *sys_path = '\0';
+  for (i = 0; i < max; i++)
+  {
+    const struct python_path *pp = smartlist_get (py->sys_path, i);
+
+    if (i > 0)
+       strcat (sys_path, ";");
+    strcat (sys_path, pp->dir);
+  }
+
+  py_cache_depends (py, py->user_site_path, depends, sizeof(depends));
+
+  cache_putf (SECTION_PYTHON, py->exe_name, "version", "%d.%d.%d",
+              py->ver_major, py->ver_minor, py->ver_micro);
+  cache_put  (SECTION_PYTHON, py->exe_name, "user_site", py->user_site_path ? py->user_site_path : "");
+  cache_put  (SECTION_PYTHON, py->exe_name, "sys_path", sys_path);
+  cache_put  (SECTION_PYTHON, py->exe_name, "dll_name", py->dll_name ? py->dll_name : "");
+  cache_putf (SECTION_PYTHON, py->exe_name, "bitness", "%d", py->bitness);
+  cache_put  (SECTION_PYTHON, py->exe_name, "depends", depends);
+  FREE (sys_path);
+}
+
+/**
+ * Finish the setup of \c py after it's version is known.
+ * Find the .DLL-name (unless we got it from the cache), the variant
+ * and the home/program names.
+ */
+static void py_setup (struct python_info *py, BOOL from_cache)
+{
+  const struct python_info *match = py->matched;
+
+  if (from_cache ? !py->dll_name : !get_dll_name(py, match->libraries))
+     return;
+
+ /** If embeddable, test the bitness of the .DLL to check
+  *  if \c LoadLibrary() will succeed.
+  */
+  py->is_embeddable = match->is_embeddable;
+  if (py->is_embeddable)
+     check_bitness (py, NULL);
+
+  fix_python_variant (py, match->variant);
+  set_python_home (py);
+  set_python_prog (py);
+}
+
+/**
+ * Get the version, user-site and \c sys.path[] of all Pythons found.
+ * Use the cached values for a Python if it's unchanged since last time.
+ * Otherwise spawn all the remaining Pythons in parallel using \c py_probe().
+ */
+static void py_probe_all (void)
+{
+  smartlist_t   *probes = smartlist_new();
+  struct runner *r = runner_new();
+  int          i, max = smartlist_len (py_programs);
+
+  for (i = 0; i < max; i++)
+  {
+    struct python_info *py = smartlist_get (py_programs, i);
+    struct py_probe    *probe;
+
+    if (py_get_cached(py))
+    {
+      DEBUGF (1, "Using cached values for %s.\n", py->exe_name);
+      py_setup (py, TRUE);
+      continue;
+    }
+    probe = CALLOC (1, sizeof(*probe));
+    probe->py = py;
+    probe->ver_major = probe->ver_minor = probe->ver_micro = -1;
+    probe->sys_path = smartlist_new();
+    smartlist_add (probes, probe);
+    py_probe (r, probe);
+  }
+
+  runner_wait (r);
+  runner_free (r);
+
+  max = smartlist_len (probes);
+  for (i = 0; i < max; i++)
+  {
+    struct py_probe    *probe = smartlist_get (probes, i);
+    struct python_info *py = probe->py;
+    int    j;
+
+    DEBUGF (1, "%s: ver: %d.%d.%d, user_site: '%s'\n", py->exe_name,
+            probe->ver_major, probe->ver_minor, probe->ver_micro,
+            probe->user_site ? probe->user_site : "<None>");
+
+    if (probe->ver_major >= 0)
+    {
+      py->ver_major = probe->ver_major;
+      py->ver_minor = probe->ver_minor;
+      py->ver_micro = probe->ver_micro;
+      py->user_site_path = probe->user_site;
+      probe->user_site = NULL;
+
+      for (j = 0; j < smartlist_len(probe->sys_path); j++)
+      {
+        const char *dir = smartlist_get (probe->sys_path, j);
+
+        DEBUGF (2, "index: %d: \"%s\"\n", j, dir);
+        add_sys_path (py, dir);
+      }
+      py_setup (py, FALSE);
+      py_put_cached (py);
+    }
+    FREE (probe->user_site);
+    smartlist_free_all (probe->sys_path);
+    FREE (probe);
+  }
+  smartlist_free (probes);
+}
+
+/**
+ * Allocate a new \c python_info node and return it for adding to
+ * the \c py_programs smartlist. The rest is filled in \c py_probe_all().
+ */
+static struct python_info *add_python (const char *exe, const struct python_info *py)
 {
   struct python_info *py2 = CALLOC (sizeof(*py2), 1);
   const char *base = basename (exe);
@@ -1669,28 +2997,7 @@ static struct python_info *add_python (const char *exe, struct python_info *py)
   py2->do_warn_home      = TRUE;
   py2->do_warn_user_site = TRUE;
   py2->sys_path = smartlist_new();
-
-  if (get_python_version(exe) >= 1)
-  {
-    py2->ver_major = tmp_ver_major;
-    py2->ver_minor = tmp_ver_minor;
-    py2->ver_micro = tmp_ver_micro;
-    py2->user_site_path = tmp_user_site[0] ? STRDUP(tmp_user_site) : NULL;
-
-    if (get_dll_name(py2, py->libraries))
-    {
-     /** If embeddable, test the bitness of the .DLL to check
-      *  if \c LoadLibrary() will succeed.
-      */
-      py2->is_embeddable = py->is_embeddable;
-      if (py2->is_embeddable)
-         check_bitness (py2, NULL);
-
-      fix_python_variant (py2, py->variant);
-      set_python_home (py2);
-      set_python_prog (py2);
-    }
-  }
+  py2->matched  = py;
   return (py2);
 }
 
@@ -1698,7 +3005,7 @@ static struct python_info *add_python (const char *exe, struct python_info *py)
  * For each \c dir in \c %PATH, try to match a Python from the ones in
  * \c all_py_programs[]. \n
  * If it's found in the \c "ignore-list", do not add it.
- * Figure out it's version and .DLL-name (if embeddable).
+ * It's version and .DLL-name is found later in \c py_probe_all().
  */
 static int match_python_exe (const char *dir)
 {
@@ -1780,6 +3087,68 @@ static void enum_pythons_on_path (void)
   FREE (path);
 }
 
+/**
+ * Verify that \c native_sys_path() gives the same \c sys.path[] and
+ * user-site as the real interpreter. Done in \c "envtool --test --python".
+ *
+ * \retval the number of differences found.
+ */
+static int py_verify_native_sys_path (struct python_info *pi)
+{
+  struct py_probe probe;
+  struct runner  *r;
+  smartlist_t    *native = smartlist_new();
+  char            user_site [_MAX_PATH], real [_MAX_PATH];
+  int             i, max1, max2, diff = 0;
+
+  if (!native_sys_path(pi, native, user_site, sizeof(user_site)))
+  {
+    C_puts ("Native sys.path[]: not possible for this Python.\n");
+    smartlist_free_all (native);
+    return (0);
+  }
+
+  memset (&probe, '\0', sizeof(probe));
+  probe.py = pi;
+  probe.ver_major = probe.ver_minor = probe.ver_micro = -1;
+  probe.sys_path = smartlist_new();
+  r = runner_new();
+  py_probe (r, &probe);
+  runner_free (r);
+
+  max1 = smartlist_len (native);
+  max2 = smartlist_len (probe.sys_path);
+  for (i = 0; i < max1 || i < max2; i++)
+  {
+    const char *n = i < max1 ? smartlist_get (native, i) : "<none>";
+
+    if (i < max2)
+         _fix_path (smartlist_get(probe.sys_path, i), real);
+    else _strlcpy (real, "<none>", sizeof(real));
+
+    if (stricmp(n, real))
+    {
+      C_printf ("  ~5[%d]~0: native: %s\n"
+                "        real:   %s\n", i, n, real);
+      diff++;
+    }
+  }
+
+  if (probe.user_site && stricmp(user_site, probe.user_site))
+  {
+    C_printf ("  ~5user-site~0: native: %s\n"
+              "             real:   %s\n", user_site, probe.user_site);
+    diff++;
+  }
+
+  C_printf ("Native sys.path[]: %s\n", diff ? "~5differs from the real one.~0" : "same as the real one.");
+
+  FREE (probe.user_site);
+  smartlist_free_all (probe.sys_path);
+  smartlist_free_all (native);
+  return (diff);
+}
+
 /**
  * Loop over 'all_py_programs[]' and do some tests on a Python matching 'py_which'.
  * This can be the 'default', one specific Python or 'all'.
@@ -1826,6 +3195,7 @@ int py_test (void)
       get_sys_path (pi);
       C_puts ("Python paths:\n");
       print_sys_path (pi, 0);
+      py_verify_native_sys_path (pi);
 
       if (pi->is_embeddable && !test_python_funcs(pi))
          C_puts ("Embedding failed.");
@@ -1842,43 +3212,6 @@ int py_test (void)
   return (found);
 }
 
-/**
- * \c popen_runf() callback to get the Python version.
- */
-static int report_py_version_cb (char *output, int line)
-{
- /* 'pypy.exe -c "import sys; print(sys.version_info)"' doesn't print this
-  */
-  const char *prefix = "sys.version_info";
-  int   num;
-
-  if (output && line == 1)
-  {
-    DEBUGF (1, "line: %d, output: '%s'\n", line, output);
-    _strlcpy (tmp_user_site, output, sizeof(tmp_user_site));
-    return (1);
-  }
-
-  if (!strncmp(output,prefix,strlen(prefix)))
-     output += strlen (prefix);
-
-  num = sscanf (output, "(major=%d, minor=%d, micro=%d",
-                &tmp_ver_major, &tmp_ver_minor, &tmp_ver_micro);
-  DEBUGF (1, "Python ver: %d.%d.%d\n", tmp_ver_major, tmp_ver_minor, tmp_ver_micro);
-  return  (num >= 2);
-}
-
-/**
- * Get the Python version and 'user-site' path by spawning the program and
- * parsing the 'popen()' output.
- */
-static int get_python_version (const char *exe_name)
-{
-  tmp_ver_major = tmp_ver_minor = tmp_ver_micro = -1;
-  tmp_user_site[0] = '\0';
-  return (popen_runf(report_py_version_cb, "%s -c \"%s\"", exe_name, PY_GET_VERSION) >= 1);
-}
-
 /**
  * Called from \c show_version():
  *   \li Print information for all found Pythons.
@@ -1927,15 +3260,11 @@ void py_searchpaths (void)
 
     if (pi->exe_name && opt.do_version >= 3)
     {
-      int save = opt.cache_ver_level;
-
-      opt.cache_ver_level = 3;
       g_py = pi;
       print_home_path (g_py, 18);
       print_user_site_path (g_py, 18);
       get_sys_path (g_py);
       print_sys_path (g_py, 18);
-      opt.cache_ver_level = save;
     }
   }
 
@@ -2074,6 +3403,7 @@ void enum_python_in_registry (const char *key_name)
  *  \li Find the details of all supported Pythons in \c all_py_programs[].
  *  \li Walk the \c %PATH and Registry (not yet) to find this information.
  *  \li Add each Python found to the \c py_programs smartlist as they are found.
+ *  \li Get their version etc. from the cache or by running them in parallel.
  */
 void py_init (void)
 {
@@ -2091,6 +3421,7 @@ void py_init (void)
   py_programs = smartlist_new();
 
   enum_pythons_on_path();
+  py_probe_all();
 
 #if 0  /** \todo */
   enum_python_in_registry ("Software\\Python\\PythonCore");
@@ -29,6 +29,7 @@ extern const char **py_get_variants  (void);
 extern const char  *py_variant_name  (enum python_variants v);
 extern int          py_variant_value (const char *short_name, const char *full_name);
 extern int          py_print_modules (void);
+extern int          py_list_modules  (void);
 struct python_info *py_select        (enum python_variants which);
 
 #endif  /* _ENVTOOL_PY_H */
@@ -37,16 +37,18 @@ static smartlist_t *ignore_list;
  * \param[in] sl    the smartlist to add the string-value to.
  * \param[in] line  the prepped string-value from the file opened in
  *                  \c cfg_ignore_init().
+ * \param[in] len   the length of \c line.
  */
-static void cfg_parse (smartlist_t *sl, char *line)
+static void cfg_parse (smartlist_t *sl, char *line, size_t len)
 {
-  char   ignore [256], *p;
-  struct ignore_node *node = NULL;
-  BOOL   add_it = FALSE;
+  struct ignore_node *node;
+  char  *p, *end, *value;
   static const char *section = NULL;
 
-  strip_nl (line);
-  p = str_trim (line);
+  p   = str_ltrim (line);
+  end = line + len;
+  while (end > p && isspace((int)end[-1]))
+     *(--end) = '\0';
 
   if (*p == '[')
   {
@@ -58,33 +60,41 @@ static void cfg_parse (smartlist_t *sl, char *line)
     return;
   }
 
-  if (!section)
+  if (!section || strncmp(p, "ignore", 6))
      return;
 
-  ignore[0] = '\0';
-
-  if (sscanf(p, "ignore = %256s", ignore) == 1 && ignore[0] != '\"')
-     add_it = TRUE;
+  p = str_ltrim (p + 6);
+  if (*p != '=')
+     return;
 
-  /**
-   * For things to "ignore with spaces", the above \c sscanf() returned with
-   * \c "ignore[0] == '\"'" and \b not the full ignore string-value.
-   * Therefore use this quite complex \c sscanf() expression to get the whole
-   * string-value.
-   *   Ref: https://msdn.microsoft.com/en-us/library/xdb9w69d.aspx
+  /* The value is the first word after the '='. Or for things to
+   * "ignore with spaces", all up to the closing quote.
    */
-  if (ignore[0] == '\"' &&
-      sscanf(p, "ignore = \"%256[-_ :()\\/.a-zA-Z0-9^\"]\"", ignore) == 1)
-     add_it = TRUE;
+  value = p + 1;
+  while (value < end && isspace((int)*value))
+     value++;
 
-  if (add_it)
+  if (*value == '\"')
+  {
+    p = strchr (++value, '\"');
+    if (p)
+       *p = '\0';
+  }
+  else
   {
-    node = MALLOC (sizeof(*node));
-    node->section = section;
-    node->value   = STRDUP (ignore);
-    smartlist_add (sl, node);
-    DEBUGF (3, "%s: '%s'.\n", section, ignore);
+    for (p = value; p < end && !isspace((int)*p); p++)
+        ;
+    *p = '\0';
   }
+
+  if (!*value)
+     return;
+
+  node = MALLOC (sizeof(*node));
+  node->section = section;
+  node->value   = STRDUP (value);
+  smartlist_add (sl, node);
+  DEBUGF (3, "%s: '%s'.\n", section, value);
 }
 
 /**
@@ -98,7 +108,7 @@ int cfg_ignore_init (const char *fname)
   DEBUGF (3, "file: %s\n", file);
   if (file)
   {
-    ignore_list = smartlist_read_file (file, (smartlist_parse_func)cfg_parse);
+    ignore_list = smartlist_read_file (file, cfg_parse);
     FREE (file);
   }
   cfg_ignore_dump();
@@ -243,5 +253,6 @@ void cfg_ignore_exit (void)
     FREE (node);
   }
   smartlist_free (ignore_list);
+  ignore_list = NULL;
 }
 
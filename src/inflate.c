@@ -0,0 +1,445 @@
+/**\file    inflate.c
+ * \ingroup Misc
+ * \brief
+ *   A small streaming DEFLATE decoder for reading the start of GZIP-files.
+ *   Used to check the first line of compressed man-pages without spawning
+ *   \c gzip.exe.
+ *
+ * The input is read in small blocks and the decoding stops as soon as
+ * enough output is produced. Since the output is never more than the
+ * caller's buffer, no sliding window is needed; all back-references
+ * point into that buffer.
+ *
+ * Everything is reentrant and nothing is printed. So \c gzip_peek() can
+ * run on several worker-threads at once.
+ *
+ * Ref: RFC 1951 (DEFLATE) and RFC 1952 (GZIP).
+ */
+#include "envtool.h"
+#include "inflate.h"
+
+#define MAX_BITS     15    /* max bits in a code */
+#define MAX_LCODES   286   /* max number of literal/length codes */
+#define MAX_DCODES   30    /* max number of distance codes */
+#define FIX_LCODES   288   /* number of fixed literal/length codes */
+
+#define GZ_FHCRC     0x02
+#define GZ_FEXTRA    0x04
+#define GZ_FNAME     0x08
+#define GZ_FCOMMENT  0x10
+
+/**\struct huffman
+ * A canonical Huffman code. \c count[len] is the number of codes of length
+ * \c len and \c symbol[] the symbols ordered by their code.
+ */
+struct huffman {
+       short count [MAX_BITS+1];
+       short symbol [FIX_LCODES];
+     };
+
+/**\struct inflate_state
+ */
+struct inflate_state {
+       FILE   *file;        /** the compressed input */
+       BYTE    in [4096];   /** the input buffer */
+       size_t  in_len;      /** bytes in \c in */
+       size_t  in_pos;      /** next byte to use in \c in */
+       DWORD   bit_buf;     /** bits not yet used */
+       int     bit_cnt;     /** the number of bits in \c bit_buf */
+       BYTE   *out;         /** the caller's buffer */
+       size_t  out_size;    /** the max number of bytes to produce */
+       size_t  out_len;     /** the number of bytes produced */
+       BOOL    first_line;  /** stop after the first newline */
+       BOOL    full;        /** enough output produced */
+       BOOL    eof;         /** premature end of input */
+     };
+
+/*
+ * Base values and extra bits for the length codes 257..285
+ * and the distance codes 0..29.
+ */
+static const short len_base [29] = {
+                   3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+                 };
+static const short len_extra [29] = {
+                   0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+                 };
+static const short dist_base [30] = {
+                   1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                   257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                   8193, 12289, 16385, 24577
+                 };
+static const short dist_extra [30] = {
+                   0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                   7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+                 };
+
+static int get_byte (struct inflate_state *s)
+{
+  if (s->in_pos == s->in_len)
+  {
+    s->in_len = fread (s->in, 1, sizeof(s->in), s->file);
+    s->in_pos = 0;
+    if (s->in_len == 0)
+    {
+      s->eof = TRUE;
+      return (0);
+    }
+  }
+  return (s->in [s->in_pos++]);
+}
+
+/**
+ * Return \c need bits (LSB first) from the input.
+ */
+static unsigned get_bits (struct inflate_state *s, int need)
+{
+  DWORD val = s->bit_buf;
+
+  while (s->bit_cnt < need)
+  {
+    val |= (DWORD)get_byte(s) << s->bit_cnt;
+    s->bit_cnt += 8;
+  }
+  s->bit_buf = val >> need;
+  s->bit_cnt -= need;
+  return (unsigned) (val & ((1UL << need) - 1));
+}
+
+static void put_byte (struct inflate_state *s, int c)
+{
+  s->out [s->out_len++] = (BYTE) c;
+  if (s->out_len >= s->out_size || (s->first_line && c == '\n'))
+     s->full = TRUE;
+}
+
+/**
+ * Build the Huffman table \c h from the code lengths in \c length[].
+ *
+ * \retval  0  a complete code.
+ * \retval >0  an incomplete code.
+ * \retval <0  an over-subscribed code (invalid).
+ */
+static int build_huffman (struct huffman *h, const short *length, int n)
+{
+  short offs [MAX_BITS+1];
+  int   len, sym, left;
+
+  memset (h->count, '\0', sizeof(h->count));
+  for (sym = 0; sym < n; sym++)
+      h->count [length[sym]]++;
+
+  if (h->count[0] == n)   /* no codes; complete but decoding will fail */
+     return (0);
+
+  left = 1;
+  for (len = 1; len <= MAX_BITS; len++)
+  {
+    left <<= 1;
+    left -= h->count [len];
+    if (left < 0)
+       return (left);
+  }
+
+  offs[1] = 0;
+  for (len = 1; len < MAX_BITS; len++)
+      offs [len+1] = offs[len] + h->count[len];
+
+  for (sym = 0; sym < n; sym++)
+      if (length[sym] != 0)
+         h->symbol [offs[length[sym]]++] = (short) sym;
+  return (left);
+}
+
+/**
+ * Decode one symbol using the Huffman table \c h.
+ * Returns -1 on an invalid code.
+ */
+static int decode (struct inflate_state *s, const struct huffman *h)
+{
+  int code = 0, first = 0, index = 0, len, count;
+
+  for (len = 1; len <= MAX_BITS; len++)
+  {
+    code |= get_bits (s, 1);
+    count = h->count [len];
+    if (code - count < first)
+       return h->symbol [index + (code - first)];
+    index += count;
+    first += count;
+    first <<= 1;
+    code  <<= 1;
+    if (s->eof)
+       break;
+  }
+  return (-1);
+}
+
+/**
+ * Decode a stored (uncompressed) block.
+ * \retval 0 the block is done, 1 enough output, -1 an error.
+ */
+static int do_stored (struct inflate_state *s)
+{
+  unsigned len, nlen;
+
+  s->bit_buf = 0;   /* skip to the byte boundary */
+  s->bit_cnt = 0;
+
+  len   = get_byte (s);
+  len  |= get_byte (s) << 8;
+  nlen  = get_byte (s);
+  nlen |= get_byte (s) << 8;
+  if (s->eof || len != (~nlen & 0xFFFF))
+     return (-1);
+
+  while (len--)
+  {
+    int c = get_byte (s);
+
+    if (s->eof)
+       return (-1);
+    put_byte (s, c);
+    if (s->full)
+       return (1);
+  }
+  return (0);
+}
+
+/**
+ * Decode literals and length/distance pairs until the end-of-block code.
+ * \retval 0 the block is done, 1 enough output, -1 an error.
+ */
+static int do_codes (struct inflate_state *s, const struct huffman *lencode,
+                     const struct huffman *distcode)
+{
+  int sym;
+
+  do
+  {
+    sym = decode (s, lencode);
+    if (sym < 0 || s->eof)
+       return (-1);
+
+    if (sym < 256)
+       put_byte (s, sym);
+
+    else if (sym > 256)
+    {
+      unsigned len, dist;
+
+      sym -= 257;
+      if (sym >= 29)
+         return (-1);
+      len = len_base[sym] + get_bits (s, len_extra[sym]);
+
+      sym = decode (s, distcode);
+      if (sym < 0 || sym >= 30)
+         return (-1);
+      dist = dist_base[sym] + get_bits (s, dist_extra[sym]);
+      if (s->eof || dist > s->out_len)
+         return (-1);
+
+      while (len-- && !s->full)
+         put_byte (s, s->out[s->out_len - dist]);
+    }
+    if (s->full)
+       return (1);
+  }
+  while (sym != 256);
+  return (0);
+}
+
+/**
+ * Decode a block with the fixed Huffman codes.
+ */
+static int do_fixed (struct inflate_state *s)
+{
+  struct huffman lencode, distcode;
+  short  lengths [FIX_LCODES];
+  int    sym;
+
+  for (sym = 0; sym < 144; sym++)
+      lengths [sym] = 8;
+  for ( ; sym < 256; sym++)
+      lengths [sym] = 9;
+  for ( ; sym < 280; sym++)
+      lengths [sym] = 7;
+  for ( ; sym < FIX_LCODES; sym++)
+      lengths [sym] = 8;
+  build_huffman (&lencode, lengths, FIX_LCODES);
+
+  for (sym = 0; sym < MAX_DCODES; sym++)
+      lengths [sym] = 5;
+  build_huffman (&distcode, lengths, MAX_DCODES);
+  return do_codes (s, &lencode, &distcode);
+}
+
+/**
+ * Decode a block with dynamic Huffman codes.
+ */
+static int do_dynamic (struct inflate_state *s)
+{
+  static const short order [19] = {
+                     16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+                   };
+  struct huffman lencode, distcode;
+  short  lengths [MAX_LCODES + MAX_DCODES];
+  int    nlen, ndist, ncode, index, sym, len, rc;
+
+  nlen  = get_bits (s, 5) + 257;
+  ndist = get_bits (s, 5) + 1;
+  ncode = get_bits (s, 4) + 4;
+  if (s->eof || nlen > MAX_LCODES || ndist > MAX_DCODES)
+     return (-1);
+
+  for (index = 0; index < ncode; index++)
+      lengths [order[index]] = (short) get_bits (s, 3);
+  for ( ; index < 19; index++)
+      lengths [order[index]] = 0;
+
+  if (build_huffman(&lencode, lengths, 19) != 0)
+     return (-1);
+
+  /* Read the code lengths of the literal/length and distance codes.
+   */
+  index = 0;
+  while (index < nlen + ndist)
+  {
+    sym = decode (s, &lencode);
+    if (sym < 0 || s->eof)
+       return (-1);
+
+    if (sym < 16)
+    {
+      lengths [index++] = (short) sym;
+      continue;
+    }
+
+    len = 0;
+    if (sym == 16)
+    {
+      if (index == 0)
+         return (-1);
+      len = lengths [index-1];
+      sym = 3 + get_bits (s, 2);
+    }
+    else if (sym == 17)
+         sym = 3 + get_bits (s, 3);
+    else sym = 11 + get_bits (s, 7);
+
+    if (index + sym > nlen + ndist)
+       return (-1);
+    while (sym--)
+       lengths [index++] = (short) len;
+  }
+
+  if (lengths[256] == 0)   /* no end-of-block code */
+     return (-1);
+
+  rc = build_huffman (&lencode, lengths, nlen);
+  if (rc < 0 || (rc > 0 && nlen - lencode.count[0] != 1))
+     return (-1);
+
+  rc = build_huffman (&distcode, lengths + nlen, ndist);
+  if (rc < 0 || (rc > 0 && ndist - distcode.count[0] != 1))
+     return (-1);
+
+  return do_codes (s, &lencode, &distcode);
+}
+
+/**
+ * Skip the GZIP header.
+ */
+static BOOL skip_gzip_header (struct inflate_state *s)
+{
+  int flags, i, len;
+
+  if (get_byte(s) != 0x1F || get_byte(s) != 0x8B || get_byte(s) != 8)
+     return (FALSE);
+
+  flags = get_byte (s);
+  for (i = 0; i < 6; i++)   /* mtime, xfl and os */
+      get_byte (s);
+
+  if (flags & GZ_FEXTRA)
+  {
+    len  = get_byte (s);
+    len |= get_byte (s) << 8;
+    while (len-- > 0 && !s->eof)
+       get_byte (s);
+  }
+  if (flags & GZ_FNAME)
+     while (get_byte(s) != 0 && !s->eof)
+        ;
+  if (flags & GZ_FCOMMENT)
+     while (get_byte(s) != 0 && !s->eof)
+        ;
+  if (flags & GZ_FHCRC)
+  {
+    get_byte (s);
+    get_byte (s);
+  }
+  return (!s->eof);
+}
+
+/**
+ * Decompress the start of the GZIP-file \c file into \c buf.
+ *
+ * \param[in]  file        the GZIP-file to read.
+ * \param[out] buf         where to put the decompressed data. It is always 0-terminated.
+ * \param[in]  size        the size of \c buf.
+ * \param[in]  first_line  stop after the first newline.
+ *
+ * \retval -1   \c file is not a GZIP-file or the data is corrupt.
+ * \retval >=0  the number of bytes in \c buf.
+ */
+int gzip_peek (const char *file, char *buf, size_t size, BOOL first_line)
+{
+  struct inflate_state *s;
+  int    last, type, rc = 0, len = -1;
+
+  if (size < 2)
+     return (-1);
+
+  s = CALLOC (1, sizeof(*s));
+  s->file = fopen (file, "rb");
+  if (!s->file)
+  {
+    FREE (s);
+    return (-1);
+  }
+
+  s->out        = (BYTE*) buf;
+  s->out_size   = size - 1;
+  s->first_line = first_line;
+
+  if (skip_gzip_header(s))
+  {
+    do
+    {
+      last = get_bits (s, 1);
+      type = get_bits (s, 2);
+      if (s->eof)
+         rc = -1;
+      else if (type == 0)
+         rc = do_stored (s);
+      else if (type == 1)
+         rc = do_fixed (s);
+      else if (type == 2)
+         rc = do_dynamic (s);
+      else rc = -1;
+    }
+    while (rc == 0 && !last);
+
+    if (rc >= 0)
+       len = (int) s->out_len;
+  }
+
+  buf [len >= 0 ? len : 0] = '\0';
+  fclose (s->file);
+  FREE (s);
+  return (len);
+}
@@ -0,0 +1,8 @@
+/** \file inflate.h
+ */
+#ifndef _INFLATE_H
+#define _INFLATE_H
+
+extern int gzip_peek (const char *file, char *buf, size_t size, BOOL first_line);
+
+#endif /* _INFLATE_H */
@@ -45,10 +45,6 @@
 #include "color.h"
 #include "envtool.h"
 
-#ifndef IMAGE_FILE_MACHINE_ALPHA
-#define IMAGE_FILE_MACHINE_ALPHA 0x123456
-#endif
-
 #ifndef KEY_WOW64_32KEY
 #define KEY_WOW64_32KEY          0x0200
 #endif
@@ -57,6 +53,10 @@
 #define KEY_WOW64_64KEY          0x0100
 #endif
 
+#ifndef INVALID_FILE_SIZE
+#define INVALID_FILE_SIZE        ((DWORD)0xFFFFFFFF)
+#endif
+
 #define TOUPPER(c)    toupper ((int)(c))
 #define TOLOWER(c)    tolower ((int)(c))
 
@@ -68,18 +68,53 @@
    * \c _RELEASE builds.
    * Since \c _DEBUG builds (on MSVC at least), should be good enough.
    *
+   * Each allocation site (\c file and \c line) gets a \c mem_site with
+   * some counters. \c mem_report() shows the top sites.
+   *
+   * \struct mem_site
+   */
+  struct mem_site {
+         const char *file;        /** allocation happened in file */
+         unsigned    line;        /** and at line */
+         size_t      allocs;      /** # of allocations here */
+         size_t      reallocs;    /** # of realloc() that moved a block from here */
+         UINT64      bytes;       /** total bytes allocated here */
+         size_t      live;        /** bytes from here not yet freed */
+         size_t      peak;        /** max of 'live' */
+       };
+
+  /**
    * All these allocations starts with this header.
+   * The blocks are on a doubly-linked list; so a free is O(1).
+   *
+   * The size is padded to 32 or 48 bytes; a multiple of 16. So the
+   * user-block keeps the 16 byte alignment that \c malloc() gives.
    *
    * \struct mem_head
    */
   struct mem_head {
          unsigned long    marker;     /** Magic marker. Equals MEM_MARKER or MEM_FREED */
          size_t           size;       /** length of allocation including the size of this header */
-         char             file [20];  /** allocation happened in file */
-         unsigned         line;       /** and at line */
-         struct mem_head *next;       /** size is 36 bytes = 24h */
+         struct mem_site *site;       /** where the allocation happened */
+         struct mem_head *next;
+         struct mem_head *prev;
+#if (IS_WIN64) || defined(__x86_64__)
+         void            *pad;        /** 40 + 8 bytes */
+#else
+         DWORD            pad [3];    /** 20 + 12 bytes */
+#endif
        };
 
+  /**
+   * The size of the \c mem_sites[] hash-table. Must be a power of 2.
+   * If it gets full, the remaining sites are counted in \c mem_site_other.
+   */
+  #define MEM_MAX_SITES  4096
+
+  static struct mem_site  mem_sites [MEM_MAX_SITES];
+  static struct mem_site  mem_site_other = { "<other>", 0 };
+  static unsigned         mem_num_sites = 0;
+
   static struct mem_head *mem_list = NULL; /** The linked list of our allocations */
   static size_t mem_reallocs = 0;          /** # of realloc() */
   static DWORD  mem_max         = 0;       /** Max bytes allocated at one time */
@@ -87,6 +122,46 @@
   static DWORD  mem_deallocated = 0;       /** Bytes deallocated */
   static size_t mem_allocs      = 0;       /** # of allocations */
   static size_t mem_frees       = 0;       /** # of mem-frees */
+  static UINT64 mem_bytes       = 0;       /** Total bytes ever allocated */
+
+  /**
+   * A simple spin-lock protecting the \c mem_list, \c mem_sites[] and the above counters.
+   * Needed since the worker-threads in tasks.c also allocates memory.
+   */
+  static volatile LONG mem_lock = 0;
+
+  #define MEM_LOCK()    while (InterlockedExchange((LONG*)&mem_lock, 1)) \
+                           Sleep (0)
+  #define MEM_UNLOCK()  InterlockedExchange ((LONG*)&mem_lock, 0)
+
+  /**
+   * Find or add the \c mem_site for \c file and \c line.
+   * The \c file is always from a \c __FILE__ literal. So comparing the pointers is enough.
+   * Caller must hold the \c mem_lock.
+   */
+  static struct mem_site *mem_site_get (const char *file, unsigned line)
+  {
+    unsigned idx = (unsigned) (((UINT_PTR)file >> 2) ^ (line * 2654435761U));
+    unsigned i;
+
+    for (i = 0; i < MEM_MAX_SITES; i++)
+    {
+      struct mem_site *s = mem_sites + ((idx + i) & (MEM_MAX_SITES-1));
+
+      if (s->file == file && s->line == line)
+         return (s);
+      if (!s->file)
+      {
+        if (mem_num_sites >= MEM_MAX_SITES/2)   /* keep the probes short */
+           break;
+        s->file = file;
+        s->line = line;
+        mem_num_sites++;
+        return (s);
+      }
+    }
+    return (&mem_site_other);
+  }
 
   /**
    * Add this memory block to the \c mem_list.
@@ -96,14 +171,29 @@
    */
   static void add_to_mem_list (struct mem_head *m, const char *file, unsigned line)
   {
+    struct mem_site *s;
+
+    MEM_LOCK();
+    s = mem_site_get (file, line);
+    s->allocs++;
+    s->bytes += m->size;
+    s->live  += m->size;
+    if (s->live > s->peak)
+       s->peak = s->live;
+
+    m->site = s;
+    m->prev = NULL;
     m->next = mem_list;
-    m->line = line;
-    _strlcpy (m->file, file, sizeof(m->file));
+    if (mem_list)
+       mem_list->prev = m;
     mem_list = m;
+
     mem_allocated += (DWORD) m->size;
     if (mem_allocated > mem_max)
        mem_max = mem_allocated;
     mem_allocs++;
+    mem_bytes += m->size;
+    MEM_UNLOCK();
   }
 
   /**
@@ -115,34 +205,26 @@
 
   /**
    * Delete this memory block from the \c mem_list.
+   * Caller must hold the \c mem_lock.
    * \param[in] m    the block to delete.
    * \param[in] line the line where this function was called.
    */
-  static void del_from_mem_list (const struct mem_head *m, unsigned line)
+  static void del_from_mem_list (struct mem_head *m, unsigned line)
   {
-    struct mem_head *m1, *prev;
-    unsigned i, max_loops = (unsigned) (mem_allocs - mem_frees);
+    if (m->next && !IS_MARKER(m->next))
+       FATAL ("m->next->marker: 0x%08lX munged from line %u!?\n", m->next->marker, line);
+    if (m->prev && !IS_MARKER(m->prev))
+       FATAL ("m->prev->marker: 0x%08lX munged from line %u!?\n", m->prev->marker, line);
 
-    ASSERT (max_loops > 0);
+    if (m->prev)
+         m->prev->next = m->next;
+    else mem_list      = m->next;
+    if (m->next)
+       m->next->prev = m->prev;
 
-    for (m1 = prev = mem_list, i = 1; m1 && i <= max_loops; m1 = m1->next, i++)
-    {
-      if (!IS_MARKER(m1))
-         FATAL ("m->marker: 0x%08lX munged from line %u!?\n", m1->marker, line);
-
-      if (m1 != m)
-         continue;
-
-      if (m == mem_list)
-           mem_list   = m1->next;
-      else prev->next = m1->next;
-      mem_deallocated += (DWORD) m->size;
-      mem_allocated   -= (DWORD) m->size;
-      break;
-    }
-    if (i > max_loops)
-       FATAL ("max-loops (%u) exceeded. mem_list munged from line %u!?\n",
-              max_loops, line);
+    m->site->live   -= m->size;
+    mem_deallocated += (DWORD) m->size;
+    mem_allocated   -= (DWORD) m->size;
   }
 #endif  /* _CRTDBG_MAP_ALLOC */
 
@@ -222,338 +304,6 @@ void init_misc (void)
   done = TRUE;
 }
 
-/**
- * If given a 'fname' without any extension, open the 'fname' and check if
- * there's a she-bang line on 1st line.
- * Accepts "#!/xx" or "#! /xx".
- */
-const char *check_if_shebang (const char *fname)
-{
-  static char shebang [30];
-  const char *ext = get_file_ext (fname);
-  char  *p;
-  FILE  *f;
-
-  /* Return NULL if 'fname' have an extension.
-   */
-  if (*ext)
-     return (NULL);
-
-  memset (&shebang, '\0', sizeof(shebang));
-  f = fopen (fname, "rb");
-  if (f)
-  {
-    shebang[0] = fgetc (f);
-    shebang[1] = fgetc (f);
-    shebang[2] = fgetc (f);
-    if (shebang[2] == ' ')
-       shebang[2] = fgetc (f);
-    fread (shebang+3, 1, sizeof(shebang)-3, f);
-    fclose (f);
-  }
-
-  if (strncmp(shebang, "#!/", 3))
-     return (FALSE);
-
-  /* If it's a Unix file with 2 "\r\r" in the 'shebang[]' buffer,
-   * we cannot use 'strip_nl()'. That will only remove the last
-   * '\r'. Look for the 1st '\n' or '\r' and remove them.
-   */
-  p = strchr (shebang, '\n');
-  if (p)
-     *p = '\0';
-  p = strchr (shebang, '\r');
-  if (p)
-     *p = '\0';
-
-  /* Drop any space; this is usually arguments for this
-   * specific interpreter.
-   */
-  p = strchr (shebang, ' ');
-  if (strncmp(shebang, "#!/usr/bin/env ",15) && p)
-     *p = '\0';
-
-  DEBUGF (1, "shebang: \"%s\"\n", shebang);
-  return (shebang);
-}
-
-/**
- * Open a fname and check if there's a "PK" signature in header.
- */
-int check_if_zip (const char *fname)
-{
-  static const char header[4] = { 'P', 'K', 3, 4 };
-  const char *ext;
-  char   buf [sizeof(header)];
-  FILE  *f;
-  int    rc = 0;
-
-  /* Return 0 if extension is neither ".egg" nor ".zip"
-   */
-  ext = get_file_ext (fname);
-  if (stricmp(ext,"egg") && stricmp(ext,"zip"))
-     return (0);
-
-  f = fopen (fname, "rb");
-  if (f)
-  {
-    rc = (fread(&buf,1,sizeof(buf),f) == sizeof(buf) &&
-          !memcmp(&buf,&header,sizeof(buf)));
-    fclose (f);
-  }
-  if (rc)
-     DEBUGF (1, "\"%s\" is a ZIP-file.\n", fname);
-  return (rc);
-}
-
-/**
- * Open a fname and check if there's a "GZIP" or "TAR.GZ" signature in header.
- */
-int check_if_gzip (const char *fname)
-{
-  static const BYTE header1[4] = { 0x1F, 0x8B, 0x08, 0x08 };
-  static const BYTE header2[4] = { 0x1F, 0x8B, 0x08, 0x00 };
-  const char *ext;
-  char   buf [sizeof(header1)];
-  FILE  *f;
-  BOOL   is_gzip, is_tgz;
-  int    rc = 0;
-
-  /* Accept only ".gz" or ".tgz" extensions.
-   */
-  ext = get_file_ext (fname);
-  is_gzip = (stricmp(ext,"gz") == 0);
-  is_tgz  = (stricmp(ext,"tgz") == 0 || stricmp(ext,"tar.gz") == 0);
-
-  if (!is_gzip && !is_tgz)
-  {
-    DEBUG_NL (2);
-    DEBUGF (2, "\"%s\" does have wrong extension: '%s'.\n", fname, ext);
-    return (0);
-  }
-
-  f = fopen (fname, "rb");
-  if (f)
-  {
-    if (fread(&buf,1,sizeof(buf),f) == sizeof(buf) &&
-        (!memcmp(&buf,&header1,sizeof(buf)) || !memcmp(&buf,&header2,sizeof(buf))) )
-       rc = 1;
-    fclose (f);
-  }
-  DEBUG_NL (2);
-  DEBUGF (2, "\"%s\" is %sa GZIP-file.\n", fname, rc == 1 ? "": "not ");
-  return (rc);
-}
-
-/**
- * Open a GZIP-file and extract first line to check if it contains a
- * ".so real-file-name". This is typical for CygWin man-pages.
- * Return result as "<dir_name>/real-file-name". Which is just an
- * assumption; the "real-file-name" can be anywhere on %MANPATH%.
- */
-static char gzip_link_name [_MAX_PATH];
-
-static int gzip_cb (char *buf, int index)
-{
-  if (index == 0 && strlen(buf) < sizeof(gzip_link_name)-3 &&
-      sscanf(buf, ".so %s", gzip_link_name) == 1)
-     return (1);
-  return (-1);  /* causes popen_run() to quit */
-}
-
-const char *get_gzip_link (const char *file)
-{
-  static char gzip [_MAX_PATH];
-  static BOOL done = FALSE;
-  const char *f = file;
-  const char *p;
-
-  if (!done)
-  {
-    p = searchpath ("gzip.exe", "PATH");
-    if (p)
-       slashify2 (gzip, p, '\\');
-    done = TRUE;
-  }
-
-  if (!gzip[0])
-     return (NULL);
-
-  gzip_link_name[0] = '\0';
-
-#if defined(__CYGWIN__)
-  {
-    char cyg_name [_MAX_PATH];
-    if (cygwin_conv_path(CCP_WIN_A_TO_POSIX, f, cyg_name, sizeof(cyg_name)) == 0)
-       f = cyg_name;
-  }
-#endif
-
-  if (popen_runf(gzip_cb, "\"%s\" -cd %s 2> %s", gzip, f, DEV_NULL) > 0)
-  {
-    static char fqfn_name [_MAX_PATH];
-    char       *dir_name = dirname (file);
-
-    DEBUGF (2, "gzip_link_name: \"%s\", dir_name: \"%s\".\n", gzip_link_name, dir_name);
-    snprintf (fqfn_name, sizeof(fqfn_name), "%s%c%s", dir_name, DIR_SEP, gzip_link_name);
-    FREE (dir_name);
-    if (opt.show_unix_paths)
-       return slashify2 (fqfn_name, fqfn_name, '/');
-    return (fqfn_name);
-  }
-  return (NULL);
-}
-
-/**
- * Open a raw MAN-file and check if first line contains a
- * ".so real-file-name". This is typical for CygWin man-pages.
- * Return result as "<dir_name>/real-file-name". Which is just an
- * assumption; the "real-file-name" can be anywhere on %MANPATH%.
- */
-const char *get_man_link (const char *file)
-{
-  char  buf [_MAX_PATH];
-  FILE *f = fopen (file, "r");
-
-  if (!f)
-     return (NULL);
-
-  memset (buf, '\0', sizeof(buf));
-  if (fread(&buf,1,sizeof(buf),f) > 0 && !strncmp(buf,".so ",4))
-  {
-    static char fqfn_name [_MAX_PATH];
-    char       *dir_name = dirname (file);
-    const char *base = basename (strip_nl(buf+4));
-
-    fclose (f);
-    DEBUG_NL (1);
-    DEBUGF (1, "get_man_link: \"%s\", dir_name: \"%s\".\n", base, dir_name);
-    snprintf (fqfn_name, sizeof(fqfn_name), "%s%c%s", dir_name, DIR_SEP, base);
-    FREE (dir_name);
-    if (opt.show_unix_paths)
-       return slashify2 (fqfn_name, fqfn_name, '/');
-    return (fqfn_name);
-  }
-
-  fclose (f);
-  return (NULL);
-}
-
-/**
- * Open a fname, read the optional header in PE-header.
- *  - For verifying it's signature.
- *  - Showing the version information (if any) in it's resources.
- */
-static const IMAGE_DOS_HEADER *dos;
-static const IMAGE_NT_HEADERS *nt;
-static char  file_buf [sizeof(*dos) + 4*sizeof(*nt)];
-
-static enum Bitness last_bitness = -1;
-
-int check_if_PE (const char *fname, enum Bitness *bits)
-{
-  BOOL   is_exe, is_pe;
-  BOOL   is_32Bit = FALSE;
-  BOOL   is_64Bit = FALSE;
-  size_t len = 0;
-  FILE  *f = fopen (fname, "rb");
-
-  last_bitness = bit_unknown;
-  if (bits)
-     *bits = bit_unknown;
-
-  if (f)
-  {
-    len = fread (&file_buf, 1, sizeof(file_buf), f);
-    fclose (f);
-  }
-  dos = NULL;
-  nt  = NULL;
-
-  if (len < sizeof(file_buf))
-  {
-    DEBUGF (3, "%s: failed fread(). errno: %d\n", fname, errno);
-    return (FALSE);
-  }
-
-  dos = (const IMAGE_DOS_HEADER*) file_buf;
-  nt  = (const IMAGE_NT_HEADERS*) ((const BYTE*)file_buf + dos->e_lfanew);
-
-  DEBUG_NL (3);
-
-  /* Probably not a PE-file at all.
-   * Check 'nt < file_buf' too in case 'e_lfanew' folds 'nt' to a negative value.
-   */
-  if ( (char*)nt > file_buf + sizeof(file_buf) ||
-       (char*)nt < file_buf )
-  {
-    DEBUGF (3, "%s: NT-header at wild offset.\n", fname);
-    return (FALSE);
-  }
-
-  is_exe = (dos->e_magic  == IMAGE_DOS_SIGNATURE);  /* 'MZ' */
-  is_pe  = (nt->Signature == IMAGE_NT_SIGNATURE);   /* 'PE\0\0 ' */
-
-  if (is_pe)
-  {
-    is_32Bit = (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC);
-    is_64Bit = (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC);
-
-    if (is_32Bit)
-       last_bitness = bit_32;
-    else if (is_64Bit)
-       last_bitness = bit_64;
-  }
-  else if (is_exe)
-  {
-    const IMAGE_FILE_HEADER *fil_hdr = (const IMAGE_FILE_HEADER*) dos;
-
-    if (fil_hdr->Machine != IMAGE_FILE_MACHINE_AMD64 &&
-        fil_hdr->Machine != IMAGE_FILE_MACHINE_ALPHA &&
-        fil_hdr->Machine != IMAGE_FILE_MACHINE_IA64)
-      last_bitness = bit_16;  /* Just a guess */
-  }
-
-  if (bits)
-     *bits = last_bitness;
-
-  DEBUGF (3, "%s: is_exe: %d, is_pe: %d, is_32Bit: %d, is_64Bit: %d.\n",
-          fname, is_exe, is_pe, is_32Bit, is_64Bit);
-  return (is_exe && is_pe);
-}
-
-/**
- * Verify the checksum of last opened file above.
- * if 'CheckSum == 0' is set to 0, it meants "don't care"
- * (similar to in UDP).
- */
-int verify_PE_checksum (const char *fname)
-{
-  const IMAGE_OPTIONAL_HEADER64 *oh;
-  DWORD file_sum, header_sum, calc_chk_sum, rc;
-
-  ASSERT (nt);
-
-  if (last_bitness == bit_32)
-    file_sum = nt->OptionalHeader.CheckSum;
-
-  else if (last_bitness == bit_64)
-  {
-    oh = (const IMAGE_OPTIONAL_HEADER64*) &nt->OptionalHeader;
-    file_sum = oh->CheckSum;
-  }
-  else
-    return (FALSE);
-
-  DEBUGF (1, "last_bitness: %u, Opt magic: 0x%04X, file_sum: 0x%08lX\n",
-             last_bitness, nt->OptionalHeader.Magic, (u_long)file_sum);
-
-  rc = MapFileAndCheckSum ((PTSTR)fname, &header_sum, &calc_chk_sum);
-  DEBUGF (1, "rc: %lu, 0x%08lX, 0x%08lX\n",
-          (u_long)rc, (u_long)header_sum, (u_long)calc_chk_sum);
-  return (file_sum == 0 || header_sum == calc_chk_sum);
-}
-
 /**
  * Check if running under WOW64; "Windows 32-bit on Windows 64-bit".
  *
@@ -1247,14 +997,29 @@ char *basename (const char *fname)
  */
 char *dirname (const char *fname)
 {
-  const char *p = fname;
-  const char *slash = NULL;
-  size_t      dirlen;
-  char       *dirpart;
+  size_t size;
 
   if (!fname)
      return (NULL);
 
+  size = strlen (fname) + 3;   /* room for "x:." */
+  return dirname_buf (fname, MALLOC(size), size);
+}
+
+/**
+ * Copy the directory part of a filename into \c buf.
+ *
+ * \param[in] fname  the filename.
+ * \param[in] buf    the buffer to fill. \c size \c >= \c strlen(fname)+3 is always enough.
+ * \param[in] size   the size of \c buf.
+ * \return           \c buf.
+ */
+char *dirname_buf (const char *fname, char *buf, size_t size)
+{
+  const char *p = fname;
+  const char *slash = NULL;
+  size_t      dirlen;
+
   if (fname[0] && fname[1] == ':')
   {
     slash = fname + 1;
@@ -1289,15 +1054,13 @@ char *dirname (const char *fname)
        dirlen += 2;
   }
 
-  dirpart = MALLOC (dirlen + 1);
-  if (dirpart)
-  {
-    strncpy (dirpart, fname, dirlen);
-    if (slash && *slash == ':' && dirlen == 3)
-       dirpart[2] = '.';      /* for "x:foo" return "x:." */
-    dirpart[dirlen] = '\0';
-  }
-  return (dirpart);
+  if (dirlen >= size)
+     dirlen = size - 1;
+  strncpy (buf, fname, dirlen);
+  if (slash && *slash == ':' && dirlen == 3)
+     buf[2] = '.';      /* for "x:foo" return "x:." */
+  buf[dirlen] = '\0';
+  return (buf);
 }
 
 /**
@@ -1477,6 +1240,8 @@ BOOL is_directory (const char *file)
  * \c stat() implementations can crash. MSVC would be one case.
  *
  * \return any \c GetLastError() is set in \c *win_err.
+ *         If \c win_err is given, nothing is printed. So a worker-thread
+ *         can call it.
  * \retval 0   okay (the same as \c stat()).
  * \retval -1  fail. \c errno set (the same as \c stat()).
  *
@@ -1488,6 +1253,7 @@ int safe_stat (const char *file, struct stat *st, DWORD *win_err)
   DWORD attr;
   BOOL  is_dir;
 
+  STAT_INC (STAT_SAFE_STAT);
   if (win_err)
      *win_err = 0;
 
@@ -1515,9 +1281,9 @@ int safe_stat (const char *file, struct stat *st, DWORD *win_err)
 
   err = GetLastError();
   if (win_err)
-     *win_err = err;
-  DEBUGF (1, "file: %s, attr: 0x%08lX, err: %s\n",
-          file, (unsigned long)attr, win_strerror(err));
+       *win_err = err;
+  else DEBUGF (1, "file: %s, attr: 0x%08lX, err: %s\n",
+               file, (unsigned long)attr, win_strerror(err));
 
 #if 0   /* \todo: Need to check for Hidden/System files here */
   if (attr == FILE_ATTRIBUTE_HIDDEN || attr == FILE_ATTRIBUTE_SYSTEM)
@@ -1540,6 +1306,128 @@ int safe_stat (const char *file, struct stat *st, DWORD *win_err)
   return (-1);
 }
 
+/**
+ * Map a whole file read-only into memory.
+ * The mapping is private to \c mf and nothing is printed; hence this is
+ * safe to call from several threads at once.
+ *
+ * \param[in]  fname  the file to map.
+ * \param[out] mf     the mapping. Must be released by \c unmap_file().
+ * \retval TRUE       \c mf->data and \c mf->size are valid.
+ * \retval FALSE      the file could not be opened or is empty.
+ *                    \c GetLastError() tells why.
+ */
+BOOL map_file (const char *fname, struct mapped_file *mf)
+{
+  DWORD size_lo, size_hi = 0, err;
+
+  memset (mf, '\0', sizeof(*mf));
+  mf->map  = NULL;
+  mf->file = CreateFile (fname, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (mf->file == INVALID_HANDLE_VALUE)
+     return (FALSE);
+
+  size_lo = GetFileSize (mf->file, &size_hi);
+  if (size_lo == INVALID_FILE_SIZE && GetLastError() != NO_ERROR)
+     goto fail;
+
+  if (size_lo == 0 && size_hi == 0)
+  {
+    SetLastError (ERROR_FILE_INVALID);
+    goto fail;
+  }
+
+  mf->map = CreateFileMapping (mf->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mf->map)
+     goto fail;
+
+  mf->data = MapViewOfFile (mf->map, FILE_MAP_READ, 0, 0, 0);
+  if (!mf->data)
+     goto fail;
+
+  mf->size = ((UINT64)size_hi << 32) + size_lo;
+  return (TRUE);
+
+fail:
+  err = GetLastError();
+  unmap_file (mf);
+  SetLastError (err);
+  return (FALSE);
+}
+
+/**
+ * Read all of a file into one buffer and call \c func for each line in it.
+ *
+ * Each line is 0-terminated in place (the \c "\r\n" or \c "\n" is cut off)
+ * and handed to \c func as a view \c (line, len). So there is no per-line
+ * copy and no limit on the line-length. \c func may modify the line, but
+ * must copy anything it wants to keep. The newlines are found with
+ * \c memchr(); that is vectorised in all the CRTs.
+ *
+ * \param[in] fname  the file to read.
+ * \param[in] func   the function to call for each line.
+ * \param[in] arg    passed on to \c func.
+ * \retval -1        the file could not be read.
+ * \retval >= 0      the number of lines.
+ */
+int file_read_lines (const char *fname, file_line_func func, void *arg)
+{
+  FILE *f = fopen (fname, "rb");
+  char *buf, *line, *end;
+  long  size;
+  int   num = 0;
+
+  if (!f)
+     return (-1);
+
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0)
+  {
+    fclose (f);
+    return (-1);
+  }
+
+  buf  = MALLOC (size + 1);
+  size = (long) fread (buf, 1, size, f);
+  fclose (f);
+  buf [size] = '\0';
+  end = buf + size;
+
+  for (line = buf; line < end; num++)
+  {
+    char *nl = memchr (line, '\n', end - line);
+    char *next;
+
+    if (!nl)
+       nl = end;
+    next = nl + 1;
+    if (nl > line && nl[-1] == '\r')
+       nl--;
+    *nl = '\0';
+    (*func) (line, nl - line, arg);
+    line = next;
+  }
+  FREE (buf);
+  return (num);
+}
+
+/**
+ * Release a mapping done by \c map_file().
+ */
+void unmap_file (struct mapped_file *mf)
+{
+  if (mf->data)
+     UnmapViewOfFile ((void*)mf->data);
+  if (mf->map)
+     CloseHandle (mf->map);
+  if (mf->file != INVALID_HANDLE_VALUE)
+     CloseHandle (mf->file);
+  mf->data = NULL;
+  mf->map  = NULL;
+  mf->file = INVALID_HANDLE_VALUE;
+  mf->size = 0;
+}
+
 /**
  * Create a \c \%TEMP-file.
  * \return The allocated name which caller must call \c FREE() on.
@@ -2260,8 +2148,11 @@ void *realloc_at (void *ptr, size_t size, const char *file, unsigned line)
     ptr = malloc_at (size, file, line);
     size = p->size - sizeof(*p);
     memmove (ptr, p+1, size);        /* since memory could be overlapping */
+    MEM_LOCK();
+    p->site->reallocs++;
     del_from_mem_list (p, __LINE__);
     mem_reallocs++;
+    MEM_UNLOCK();
     free (p);
   }
   return (ptr);
@@ -2282,14 +2173,122 @@ void free_at (void *ptr, const char *file, unsigned line)
      FATAL ("free() of unknown block at %s, line %u.\n", file, line);
 
   head->marker = MEM_FREED;
+  MEM_LOCK();
   del_from_mem_list (head, __LINE__);
   mem_frees++;
+  MEM_UNLOCK();
   free (head);
 }
 #endif  /* !_CRTDBG_MAP_ALLOC */
 
 /**
- * Print a report of memory-counters and warn on any unfreed memory blocks.
+ * The counters updated by \c STAT_INC().
+ */
+volatile LONG stat_counters [STAT_MAX];
+
+/**
+ * The function recording the \c TRACE_BEGIN() and \c TRACE_END() events.
+ * It's in trace.c; but the small programs linking with misc.c should not
+ * need that.
+ */
+void (*trace_hook) (char ph, const char *cat, const char *name, unsigned id) = NULL;
+
+/**
+ * Counters for the allocations done from arenas. These never hit the heap.
+ */
+static size_t mem_arena_allocs = 0;
+static size_t mem_arena_resets = 0;
+static UINT64 mem_arena_bytes  = 0;
+
+/**
+ * Called from \c arena_free() to add the counters of an arena.
+ */
+void mem_arena_count (size_t allocs, size_t resets, UINT64 bytes)
+{
+  mem_arena_allocs += allocs;
+  mem_arena_resets += resets;
+  mem_arena_bytes  += bytes;
+}
+
+/**
+ * Get the total number of heap allocations and bytes allocated so far.
+ * Used to get the allocations per operation in bench.c.
+ *
+ * \retval FALSE  if the allocations are not tracked (\c _CRTDBG_MAP_ALLOC);
+ *                the counters are then 0.
+ */
+BOOL mem_get_counters (UINT64 *allocs, UINT64 *bytes)
+{
+#if defined(_CRTDBG_MAP_ALLOC)
+  *allocs = *bytes = 0;
+  return (FALSE);
+#else
+  MEM_LOCK();
+  *allocs = mem_allocs;
+  *bytes  = mem_bytes;
+  MEM_UNLOCK();
+  return (TRUE);
+#endif
+}
+
+#if !defined(_CRTDBG_MAP_ALLOC)
+/**
+ * The number of allocation sites shown by \c mem_report().
+ */
+#define MEM_REPORT_TOP  10
+
+/**
+ * \c qsort() helper for \c mem_report(); the site with the most bytes allocated first.
+ */
+static int mem_site_compare (const void *_a, const void *_b)
+{
+  const struct mem_site *a = *(const struct mem_site**) _a;
+  const struct mem_site *b = *(const struct mem_site**) _b;
+
+  if (a->bytes != b->bytes)
+     return (a->bytes < b->bytes ? 1 : -1);
+  if (a->allocs != b->allocs)
+     return (a->allocs < b->allocs ? 1 : -1);
+  return (0);
+}
+
+/**
+ * Print the \c MEM_REPORT_TOP allocation sites with the most bytes allocated.
+ */
+static void mem_report_sites (void)
+{
+  static const struct mem_site *sites [MEM_MAX_SITES+1];
+  unsigned i, num = 0;
+
+  for (i = 0; i < MEM_MAX_SITES; i++)
+      if (mem_sites[i].allocs > 0)
+         sites [num++] = mem_sites + i;
+  if (mem_site_other.allocs > 0)
+     sites [num++] = &mem_site_other;
+
+  if (num == 0)
+     return;
+
+  qsort (sites, num, sizeof(sites[0]), mem_site_compare);
+
+  C_printf ("  Top %u of %u allocation sites:\n", min(num, MEM_REPORT_TOP), num);
+  C_printf ("    %-25s %10s %12s %12s %12s %10s\n", "Site", "allocs", "bytes", "peak", "live", "reallocs");
+  for (i = 0; i < num && i < MEM_REPORT_TOP; i++)
+  {
+    const struct mem_site *s = sites[i];
+    char  where [50];
+
+    snprintf (where, sizeof(where), "%s(%u)", s->file, s->line);
+    C_printf ("    %-25s %10u %12" U64_FMT " %12u %12u %10u\n",
+              where, (unsigned)s->allocs, s->bytes, (unsigned)s->peak,
+              (unsigned)s->live, (unsigned)s->reallocs);
+  }
+}
+#endif  /* !_CRTDBG_MAP_ALLOC */
+
+/**
+ * Print a report of memory-counters, the top allocation sites and
+ * warn on any unfreed memory blocks.
  */
 void mem_report (void)
 {
@@ -2301,11 +2300,15 @@ void mem_report (void)
   C_printf ("  Total # of allocations: %u.\n", (unsigned int)mem_allocs);
   C_printf ("  Total # of realloc():   %u.\n", (unsigned int)mem_reallocs);
   C_printf ("  Total # of frees:       %u.\n", (unsigned int)mem_frees);
+  C_printf ("  Arena allocations:      %u (%s bytes, %u resets).\n",
+            (unsigned int)mem_arena_allocs, qword_str(mem_arena_bytes), (unsigned int)mem_arena_resets);
+
+  mem_report_sites();
 
   for (m = mem_list, num = 0; m; m = m->next, num++)
   {
     C_printf ("  Un-freed memory 0x%p at %s (%u). %u bytes: \"%s\"\n",
-              m+1, m->file, m->line, (unsigned int)m->size, dump10(m+1,m->size));
+              m+1, m->site->file, m->site->line, (unsigned int)m->size, dump10(m+1,m->size));
     if (num > 20)
     {
       C_printf ("  ..and more.\n");
@@ -2414,6 +2417,59 @@ const char *empty_time (void)
   return (opt.decimal_timestamp ? "00000000.000000" : "01 Jan 1970 - 00:00:00");
 }
 
+/**
+ * Return a monotonic time-stamp in nano-seconds.
+ * Only the difference between two calls is meaningful.
+ */
+UINT64 get_time_ns (void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER        now;
+  UINT64               sec, rem;
+
+  if (freq.QuadPart == 0)
+     QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&now);
+
+  /* Split it to avoid an overflow in 'now * 1E9'.
+   */
+  sec = now.QuadPart / freq.QuadPart;
+  rem = now.QuadPart % freq.QuadPart;
+  return (sec * 1000000000 + (rem * 1000000000) / freq.QuadPart);
+}
+
+/**
+ * Make \c num paths with some shared prefixes and mixed case.
+ * The corpus for \c bench.c and the \c STRSORT_TEST program.
+ * The same seed is used every time; so the corpus is equal between runs.
+ *
+ * \retval an array of \c num paths. \c FREE() each path and the array.
+ */
+char **make_test_paths (int num)
+{
+  static const char *top[] = { "c:\\Program Files", "C:\\Windows\\System32", "d:\\MinGW\\include",
+                               "c:\\Users\\Some User\\AppData\\Local", "f:\\src" };
+  static const char *ext[] = { "dll", "EXE", "h", "Lib", "txt", "py", "c" };
+  DWORD  seed = 12345;
+  char **paths = MALLOC (num * sizeof(char*));
+  char   buf [_MAX_PATH];
+  int    i;
+
+  for (i = 0; i < num; i++)
+  {
+    DWORD r;
+
+    seed = seed * 1103515245UL + 12345UL;
+    r = seed >> 8;
+    snprintf (buf, sizeof(buf), "%s\\%s%u\\sub%02u\\File_%05u.%s",
+              top[r % DIM(top)], (r & 0x100) ? "Dir" : "dir",
+              (unsigned)(r % 97), (unsigned)((r >> 4) % 50), (unsigned)(r % 99991),
+              ext[(r >> 12) % DIM(ext)]);
+    paths[i] = STRDUP (buf);
+  }
+  return (paths);
+}
+
 /**
  * Return a nicely formatted string for a 'time_t'.
  *
@@ -2641,8 +2697,8 @@ static char *popen_setup (const char *cmd)
   {
     DEBUGF (3, "%%COMSPEC: %s.\n", env);
 #if !defined(__WATCOMC__)
-    env = strlwr (basename(env));
-    if (!strcmp(env,"4nt.exe") || !strcmp(env,"tcc.exe"))
+    env = basename (env);
+    if (!stricmp(env,"4nt.exe") || !stricmp(env,"tcc.exe"))
        setdos = "setdos /x-3 & ";
 #endif
   }
@@ -2687,12 +2743,17 @@ int popen_run (popen_callback callback, const char *cmd)
 
   DEBUGF (3, "Trying to run '%s'\n", cmd2);
 
+  TRACE_BEGIN ("process", cmd2);
+  spawn_lock();
   f = _popen (cmd2, "r");
+  spawn_unlock();
   if (!f)
   {
     DEBUGF (1, "failed to call _popen(); errno=%d.\n", errno);
+    TRACE_END ("process");
     goto quit;
   }
+  STAT_INC (STAT_SPAWNED);
 
   j = 0;
   while (fgets(buf,sizeof(buf)-1,f))
@@ -2709,12 +2770,34 @@ int popen_run (popen_callback callback, const char *cmd)
        break;
   }
   _pclose (f);
+  TRACE_END ("process");
 
 quit:
   FREE (cmd2);
   return (j);
 }
 
+/**
+ * A child process inherits all the inheritable handles of this process.
+ * That includes the pipe-ends another thread just made for it's own child.
+ * The wrong child then holds that pipe open and the EOF is delayed until
+ * it exits. Hence the inheritable handles for a child are created, given
+ * to \c CreateProcess() (or \c _popen()) and closed again while holding
+ * this lock.
+ */
+static volatile LONG spawn_lock_flag = 0;
+
+void spawn_lock (void)
+{
+  while (InterlockedExchange((LONG*)&spawn_lock_flag, 1))
+     Sleep (0);
+}
+
+void spawn_unlock (void)
+{
+  InterlockedExchange ((LONG*)&spawn_lock_flag, 0);
+}
+
 /**
  * A var-arg version of 'popen_run()'.
  */
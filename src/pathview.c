@@ -0,0 +1,296 @@
+/**\file    pathview.c
+ * \ingroup Misc
+ * \brief
+ *   Length-aware path-names that are normalised in place.
+ *
+ * \c _fix_path(), \c slashify() and \c slashify2() each copy the path into
+ * a new buffer of \c _MAX_PATH characters and the callers then do a
+ * \c strlen() to find the end again. A \c pathview_t keeps the length and
+ * does all the steps in the same buffer. The search for slashes checks a
+ * whole machine-word at a time; most of a path has no slashes in it.
+ */
+#include "envtool.h"
+#include "pathview.h"
+
+/*
+ * Word-at-a-time ("SWAR") test for a byte in a 'size_t'.
+ * Ref:
+ *   https://graphics.stanford.edu/~seander/bithacks.html#ValueInWord
+ */
+#define ONES          ((size_t)-1 / 255)
+#define HIGHS         (ONES * 128)
+#define HAS_ZERO(w)   (((w) - ONES) & ~(w) & HIGHS)
+#define HAS_BYTE(w,c) HAS_ZERO ((w) ^ (ONES * (BYTE)(c)))
+
+/*
+ * Return the first '/' or '\\' in the range 's' to 'end'.
+ * Or 'end' if there is none.
+ */
+static char *find_slash (char *s, const char *end)
+{
+  while (s < end && ((UINT_PTR)s & (sizeof(size_t) - 1)))
+  {
+    if (IS_SLASH(*s))
+       return (s);
+    s++;
+  }
+
+  while (end - s >= (ptrdiff_t)sizeof(size_t))
+  {
+    size_t w;
+
+    memcpy (&w, s, sizeof(w));
+    if (HAS_BYTE(w, '/') || HAS_BYTE(w, '\\'))
+       break;
+    s += sizeof(size_t);
+  }
+
+  while (s < end && !IS_SLASH(*s))
+     s++;
+  return (s);
+}
+
+/*
+ * Make room for 'size' characters (including the 0-terminator).
+ */
+static void pathview_reserve (pathview_t *pv, size_t size)
+{
+  if (size <= pv->cap)
+     return;
+
+  size = max (size, 2*pv->cap);
+  if (pv->heap)
+     pv->buf = REALLOC (pv->buf, size);
+  else
+  {
+    char *buf = MALLOC (size);
+
+    memcpy (buf, pv->buf, pv->len + 1);
+    pv->buf  = buf;
+    pv->heap = TRUE;
+  }
+  pv->cap = size;
+}
+
+/*
+ * Start with an empty path in the caller's 'buf' of 'size' characters.
+ */
+void pathview_init (pathview_t *pv, char *buf, size_t size)
+{
+  ASSERT (size > 0);
+  pv->buf  = buf;
+  pv->cap  = size;
+  pv->len  = 0;
+  pv->heap = FALSE;
+  *buf = '\0';
+}
+
+/*
+ * Free the buffer if it was moved to the heap.
+ */
+void pathview_free (pathview_t *pv)
+{
+  if (pv->heap)
+     FREE (pv->buf);
+  pv->buf  = NULL;
+  pv->cap  = pv->len = 0;
+  pv->heap = FALSE;
+}
+
+/*
+ * Set the path to the 'len' first characters of 'str'.
+ */
+void pathview_set (pathview_t *pv, const char *str, size_t len)
+{
+  pv->len = 0;
+  pathview_append (pv, str, len);
+}
+
+/*
+ * Append 'len' characters of 'str' to the path.
+ */
+void pathview_append (pathview_t *pv, const char *str, size_t len)
+{
+  pathview_reserve (pv, pv->len + len + 1);
+  memmove (pv->buf + pv->len, str, len);
+  pv->len += len;
+  pv->buf [pv->len] = '\0';
+}
+
+/*
+ * Cut the path at 'len' characters. E.g. to reuse a directory prefix.
+ */
+void pathview_truncate (pathview_t *pv, size_t len)
+{
+  ASSERT (len <= pv->len);
+  pv->len = len;
+  pv->buf [len] = '\0';
+}
+
+/*
+ * As 'slashify()'; replace all (single or multiple) '\\' and '/'
+ * with a single 'use'.
+ */
+void pathview_slashify (pathview_t *pv, char use)
+{
+  char       *s   = pv->buf;
+  char       *d   = pv->buf;
+  const char *end = pv->buf + pv->len;
+
+  while (s < end)
+  {
+    char  *slash = find_slash (s, end);
+    size_t len   = slash - s;
+
+    if (d != s)
+       memmove (d, s, len);
+    d += len;
+    s = slash;
+    if (s < end)
+    {
+      *d++ = use;
+      while (++s < end && IS_SLASH(*s))  /* collapse multiple slashes */
+          ;
+    }
+  }
+  *d = '\0';
+  pv->len = d - pv->buf;
+}
+
+/*
+ * As '_fix_drive()'; report the drive-letter in lower case.
+ */
+void pathview_fix_drive (pathview_t *pv)
+{
+  if (pv->len >= 3 && pv->buf[1] == ':' && IS_SLASH(pv->buf[2]))
+     pv->buf[0] = (char) tolower ((int)pv->buf[0]);
+}
+
+/*
+ * Lower-case the whole path.
+ */
+void pathview_lower (pathview_t *pv)
+{
+  char *p, *end = pv->buf + pv->len;
+
+  for (p = pv->buf; p < end; p++)
+      *p = (char) tolower ((int)*p);
+}
+
+/*
+ * Return the length of the root; "x:\", "x:" or "\".
+ */
+static size_t pathview_root_len (const pathview_t *pv)
+{
+  size_t len = 0;
+
+  if (pv->len >= 2 && pv->buf[1] == ':')
+     len = 2;
+  if (len < pv->len && IS_SLASH(pv->buf[len]))
+     len++;
+  return (len);
+}
+
+/*
+ * Remove any trailing slashes; except from a root.
+ */
+void pathview_strip_trailing (pathview_t *pv)
+{
+  size_t root = pathview_root_len (pv);
+
+  while (pv->len > root && IS_SLASH(pv->buf[pv->len-1]))
+     pv->len--;
+  pv->buf [pv->len] = '\0';
+}
+
+/*
+ * Remove the "." segments and collapse "dir\.." segments.
+ * A ".." at the start of a relative path is kept. A ".." directly
+ * under a root (like "c:\..") is dropped.
+ */
+void pathview_collapse_dots (pathview_t *pv)
+{
+  char       *s    = pv->buf + pathview_root_len (pv);
+  char       *root = s;
+  char       *d    = s;
+  const char *end  = pv->buf + pv->len;
+  BOOL        abs  = (root > pv->buf && IS_SLASH(root[-1]));
+  BOOL        trailing = (end > root && IS_SLASH(end[-1]));
+
+  while (s < end)
+  {
+    char  *seg = s;
+    size_t len;
+
+    s   = find_slash (s, end);
+    len = s - seg;
+    while (s < end && IS_SLASH(*s))
+       s++;
+
+    if (len == 0 || (len == 1 && seg[0] == '.'))
+       continue;
+
+    if (len == 2 && seg[0] == '.' && seg[1] == '.')
+    {
+      char *last = d;
+
+      while (last > root && !IS_SLASH(last[-1]))
+         last--;
+
+      if (d > root && !(d - last == 2 && last[0] == '.' && last[1] == '.'))
+      {
+        d = (last > root) ? last - 1 : root;   /* pop the last segment */
+        continue;
+      }
+      if (d == root && abs)
+         continue;
+    }
+
+    if (d > root)
+    {
+      char sep = seg[-1];   /* read it before it's overwritten */
+
+      *d++ = IS_SLASH(sep) ? sep : '\\';
+    }
+    memmove (d, seg, len);
+    d += len;
+  }
+
+  if (trailing && d > root)
+     *d++ = IS_SLASH(end[-1]) ? end[-1] : '\\';
+  *d = '\0';
+  pv->len = d - pv->buf;
+}
+
+/*
+ * As '_fix_path()'; set the path to the fully qualified name of 'path'.
+ * With '\\' slashes and a lower-case drive-letter.
+ */
+void pathview_full (pathview_t *pv, const char *path)
+{
+  size_t len = strlen (path);
+  DWORD  rc;
+
+  pathview_set (pv, path, len);
+  pathview_slashify (pv, '\\');
+  rc = GetFullPathName (pv->buf, (DWORD)pv->cap, pv->buf, NULL);
+  if (rc >= pv->cap)
+  {
+    /* Too small; 'rc' is the size needed. Start again with a bigger buffer.
+     */
+    pathview_reserve (pv, rc + 1);
+    pathview_set (pv, path, len);
+    pathview_slashify (pv, '\\');
+    rc = GetFullPathName (pv->buf, (DWORD)pv->cap, pv->buf, NULL);
+  }
+
+  if (rc > 0 && rc < pv->cap)
+     pv->len = rc;
+  else
+  {
+    DEBUGF (2, "GetFullPathName(\"%s\") failed: %s\n", path, win_strerror(GetLastError()));
+    pathview_set (pv, path, len);
+    pathview_slashify (pv, '\\');
+  }
+  pathview_fix_drive (pv);
+}
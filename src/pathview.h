@@ -0,0 +1,35 @@
+/** \file pathview.h
+ */
+#ifndef _PATHVIEW_H
+#define _PATHVIEW_H
+
+/**\typedef pathview_t
+ * A path-name with its length and the size of its buffer.
+ *
+ * The buffer is normally given by the caller (on the stack). If the path
+ * gets longer than that, it is moved to the heap; so nothing is ever
+ * truncated at \c _MAX_PATH. Call \c pathview_free() when done.
+ *
+ * All the \c pathview_x() functions keep \c buf 0-terminated and \c len
+ * updated; so there is no need for a \c strlen() on the result.
+ */
+typedef struct pathview_t {
+        char  *buf;    /** the 0-terminated path */
+        size_t len;    /** == strlen(buf) */
+        size_t cap;    /** the size of 'buf' */
+        BOOL   heap;   /** 'buf' was MALLOC()'ed by us */
+      } pathview_t;
+
+void pathview_init (pathview_t *pv, char *buf, size_t size);
+void pathview_free (pathview_t *pv);
+void pathview_set (pathview_t *pv, const char *str, size_t len);
+void pathview_append (pathview_t *pv, const char *str, size_t len);
+void pathview_truncate (pathview_t *pv, size_t len);
+void pathview_slashify (pathview_t *pv, char use);
+void pathview_fix_drive (pathview_t *pv);
+void pathview_lower (pathview_t *pv);
+void pathview_strip_trailing (pathview_t *pv);
+void pathview_collapse_dots (pathview_t *pv);
+void pathview_full (pathview_t *pv, const char *path);
+
+#endif
@@ -0,0 +1,855 @@
+/**\file    pe.c
+ * \ingroup Misc
+ * \brief
+ *   A reentrant parser for PE-files (.EXE, .DLL etc.).
+ *
+ * \c pe_open() maps the whole file into memory once. The DOS, NT and
+ * optional headers are then validated with \c pe_parse(); every pointer
+ * is checked to be inside the mapping before use.
+ *
+ * \c pe_checksum() computes the same checksum as \c MapFileAndCheckSum()
+ * in imagehlp.dll, but on the already mapped file and without reading it
+ * again. It sums 32-bit words in 4 independent 64-bit accumulators; the
+ * compiler is free to vectorise that loop. Since \f$2^{16} \equiv 1\f$
+ * (mod \f$2^{16}-1\f$), folding this sum to 16 bits at the end gives the
+ * same result as adding 16-bit words with end-around carry.
+ *
+ * \c pe_get_resource() walks the resource directory in the mapping; E.g.
+ * to find the \c VS_VERSIONINFO for \c get_PE_version_info().
+ *
+ * \c pe_authenticode_digest() hashes the mapped file the way Authenticode
+ * does (with \c sha.c). Thus a signature can be matched to the file without
+ * calling \c WinVerifyTrust(). And it works on any OS.
+ *
+ * Nothing here uses global state or prints anything. Hence it can be
+ * used by the jobs in \c tasks_run_list().
+ *
+ * Compile with \c -DPE_TEST for a small program that checks and
+ * benchmarks the checksum (or with \c -a, the Authenticode digests) of
+ * the files on the command-line. With \c -t, it checks
+ * \c pe_authenticode_digest() against the signed PE-files in \c pe_samples/.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <windows.h>
+
+#include "envtool.h"
+#include "pe.h"
+
+#if !PE_WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+#endif
+
+/**
+ * The optional header must at least reach to the end of \c CheckSum.
+ * Which is at the same offset in the 32 and 64-bit optional headers.
+ */
+#define PE_CHECKSUM_OFS  offsetof (IMAGE_OPTIONAL_HEADER32, CheckSum)
+#define PE_CHECKSUM_END  (PE_CHECKSUM_OFS + sizeof(DWORD))
+
+/**
+ * Validate the headers in the \c size bytes at \c base.
+ *
+ * \param[out] pe    the result. \c pe->dos is set if \c base starts with \c "MZ".
+ * \param[in]  base  the start of a PE-file; the whole file or just the first part of it.
+ * \param[in]  size  the number of bytes at \c base.
+ *
+ * \retval TRUE  if \c base has both a \c "MZ" and a \c "PE\0\0" signature and
+ *               the optional header is inside \c size.
+ */
+BOOL pe_parse (struct pe_file *pe, const void *base, size_t size)
+{
+  const IMAGE_DOS_HEADER *dos = (const IMAGE_DOS_HEADER*) base;
+  const IMAGE_NT_HEADERS *nt;
+  size_t ofs, opt_ofs;
+
+  pe->base         = (const BYTE*) base;
+  pe->size         = size;
+  pe->dos          = NULL;
+  pe->nt           = NULL;
+  pe->bits         = bit_unknown;
+  pe->header_sum   = 0;
+  pe->checksum_ofs = 0;
+
+  if (size < sizeof(*dos) || dos->e_magic != IMAGE_DOS_SIGNATURE)  /* 'MZ' */
+     return (FALSE);
+
+  pe->dos = dos;
+
+  /* Check 'e_lfanew' for a negative value too.
+   */
+  if (dos->e_lfanew < 0 || (size_t)dos->e_lfanew > size)
+     return (FALSE);
+
+  ofs     = (size_t) dos->e_lfanew;
+  opt_ofs = ofs + offsetof (IMAGE_NT_HEADERS, OptionalHeader);
+  if (opt_ofs + PE_CHECKSUM_END > size)
+     return (FALSE);
+
+  nt = (const IMAGE_NT_HEADERS*) (pe->base + ofs);
+  if (nt->Signature != IMAGE_NT_SIGNATURE)    /* 'PE\0\0 ' */
+     return (FALSE);
+
+  if (nt->FileHeader.SizeOfOptionalHeader < PE_CHECKSUM_END ||
+      opt_ofs + nt->FileHeader.SizeOfOptionalHeader > size)
+     return (FALSE);
+
+  if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC)
+     pe->bits = bit_32;
+  else if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+     pe->bits = bit_64;
+
+  pe->nt           = nt;
+  pe->header_sum   = nt->OptionalHeader.CheckSum;
+  pe->checksum_ofs = opt_ofs + PE_CHECKSUM_OFS;
+  return (TRUE);
+}
+
+/**
+ * Map \c file into memory and parse the headers.
+ *
+ * \retval TRUE  if \c file is a PE-file. Call \c pe_close() when done with it.
+ * \retval FALSE if not; \c pe_close() is not needed.
+ */
+BOOL pe_open (struct pe_file *pe, const char *file)
+{
+  const void *base = NULL;
+  size_t      size = 0;
+
+  memset (pe, '\0', sizeof(*pe));
+
+#if PE_WIN32
+  {
+    LARGE_INTEGER fsize;
+
+    pe->map_hnd  = NULL;
+    pe->file_hnd = CreateFile (file, GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (pe->file_hnd == INVALID_HANDLE_VALUE)
+       return (FALSE);
+
+    /* A PE-file can not be larger than 4 GByte. And an empty file can not be mapped.
+     */
+    if (GetFileSizeEx(pe->file_hnd, &fsize) && fsize.HighPart == 0 && fsize.LowPart > 0)
+    {
+      size = fsize.LowPart;
+      pe->map_hnd = CreateFileMapping (pe->file_hnd, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (pe->map_hnd)
+         base = MapViewOfFile (pe->map_hnd, FILE_MAP_READ, 0, 0, 0);
+    }
+  }
+#else
+  {
+    struct stat st;
+
+    pe->fd = open (file, O_RDONLY);
+    if (pe->fd < 0)
+       return (FALSE);
+
+    if (fstat(pe->fd, &st) == 0 && st.st_size > 0 && (UINT64)st.st_size <= 0xFFFFFFFF)
+    {
+      size = (size_t) st.st_size;
+      base = mmap (NULL, size, PROT_READ, MAP_PRIVATE, pe->fd, 0);
+      if (base == MAP_FAILED)
+         base = NULL;
+    }
+  }
+#endif
+
+  if (!base || !pe_parse(pe, base, size))
+  {
+    pe->base = base;
+    pe->size = size;
+    pe_close (pe);
+    return (FALSE);
+  }
+  return (TRUE);
+}
+
+/**
+ * Unmap and close the file opened by \c pe_open().
+ */
+void pe_close (struct pe_file *pe)
+{
+#if PE_WIN32
+  if (pe->base)
+     UnmapViewOfFile ((void*)pe->base);
+  if (pe->map_hnd)
+     CloseHandle (pe->map_hnd);
+  if (pe->file_hnd && pe->file_hnd != INVALID_HANDLE_VALUE)
+     CloseHandle (pe->file_hnd);
+  pe->map_hnd  = NULL;
+  pe->file_hnd = INVALID_HANDLE_VALUE;
+#else
+  if (pe->base)
+     munmap ((void*)pe->base, pe->size);
+  if (pe->fd >= 0)
+     close (pe->fd);
+  pe->fd = -1;
+#endif
+
+  pe->base = NULL;
+  pe->dos  = NULL;
+  pe->nt   = NULL;
+}
+
+/**
+ * Compute the checksum of a PE-file like \c MapFileAndCheckSum() does.
+ * The 4 bytes at \c checksum_ofs (the \c CheckSum field itself) are
+ * counted as 0.
+ *
+ * \param[in] base          the whole file. Should be 4-byte aligned.
+ * \param[in] size          the size of the file.
+ * \param[in] checksum_ofs  the file-offset of \c CheckSum in the optional header.
+ */
+DWORD pe_checksum (const void *base, size_t size, size_t checksum_ofs)
+{
+  const BYTE  *p = (const BYTE*) base;
+  const DWORD *w = (const DWORD*) base;
+  UINT64       s0 = 0, s1 = 0, s2 = 0, s3 = 0, sum;
+  size_t       i, num_words = size / sizeof(DWORD);
+
+  for (i = 0; i + 4 <= num_words; i += 4)
+  {
+    s0 += w[i+0];
+    s1 += w[i+1];
+    s2 += w[i+2];
+    s3 += w[i+3];
+  }
+  for ( ; i < num_words; i++)
+      s0 += w[i];
+  sum = s0 + s1 + s2 + s3;
+
+  /* The remaining 1 - 3 bytes; an odd last byte is the low-byte of a word.
+   */
+  for (i = num_words * sizeof(DWORD); i < size; i++)
+      sum += (UINT64)p[i] << (8 * (i & 3));
+
+  /* Take the 'CheckSum' field out again. Since 'sum' is exact, this works
+   * for any alignment of 'checksum_ofs'.
+   */
+  for (i = checksum_ofs; i < checksum_ofs + sizeof(DWORD) && i < size; i++)
+      sum -= (UINT64)p[i] << (8 * (i & 3));
+
+  while (sum >> 16)
+    sum = (sum & 0xFFFF) + (sum >> 16);
+
+  return (DWORD) (sum + size);
+}
+
+/**
+ * Verify the checksum of a PE-file opened by \c pe_open().
+ * If the \c CheckSum in the header is 0, it means "don't care"
+ * (similar to in UDP).
+ *
+ * \param[in]  pe        the PE-file.
+ * \param[out] calc_sum  if non-NULL, the computed checksum.
+ */
+BOOL pe_verify_checksum (const struct pe_file *pe, DWORD *calc_sum)
+{
+  DWORD sum;
+
+  if (!pe->nt)
+     return (FALSE);
+
+  sum = pe_checksum (pe->base, pe->size, pe->checksum_ofs);
+  if (calc_sum)
+     *calc_sum = sum;
+  return (pe->header_sum == 0 || pe->header_sum == sum);
+}
+
+/**
+ * Read a \c DWORD at file-offset \c ofs.
+ * Returns FALSE if that is outside the file.
+ */
+static BOOL pe_get_dword (const struct pe_file *pe, size_t ofs, DWORD *val)
+{
+  if (ofs > pe->size || pe->size - ofs < sizeof(*val))
+     return (FALSE);
+  memcpy (val, pe->base + ofs, sizeof(*val));
+  return (TRUE);
+}
+
+/**
+ * Get the file-offset of data-directory entry \c idx in the optional header.
+ */
+static BOOL pe_data_directory_ofs (const struct pe_file *pe, unsigned idx, size_t *ofs)
+{
+  size_t opt_ofs = (const BYTE*)&pe->nt->OptionalHeader - pe->base;
+  size_t num_ofs, dir_ofs;
+  DWORD  num;
+
+  if (pe->bits == bit_64)
+  {
+    num_ofs = offsetof (IMAGE_OPTIONAL_HEADER64, NumberOfRvaAndSizes);
+    dir_ofs = offsetof (IMAGE_OPTIONAL_HEADER64, DataDirectory);
+  }
+  else if (pe->bits == bit_32)
+  {
+    num_ofs = offsetof (IMAGE_OPTIONAL_HEADER32, NumberOfRvaAndSizes);
+    dir_ofs = offsetof (IMAGE_OPTIONAL_HEADER32, DataDirectory);
+  }
+  else
+    return (FALSE);
+
+  dir_ofs += idx * sizeof(IMAGE_DATA_DIRECTORY);
+  if (dir_ofs + sizeof(IMAGE_DATA_DIRECTORY) > pe->nt->FileHeader.SizeOfOptionalHeader)
+     return (FALSE);
+
+  if (!pe_get_dword(pe, opt_ofs + num_ofs, &num) || idx >= num)
+     return (FALSE);
+
+  *ofs = opt_ofs + dir_ofs;
+  return (*ofs + sizeof(IMAGE_DATA_DIRECTORY) <= pe->size);
+}
+
+/**
+ * Get the RVA and size of data-directory \c idx in the optional header.
+ */
+static BOOL pe_data_directory (const struct pe_file *pe, unsigned idx, DWORD *rva, DWORD *size)
+{
+  size_t ofs;
+
+  return (pe_data_directory_ofs(pe, idx, &ofs) &&
+          pe_get_dword(pe, ofs, rva) &&
+          pe_get_dword(pe, ofs + sizeof(DWORD), size));
+}
+
+/**
+ * Convert the \c len bytes at \c rva to a file-offset by looking in the
+ * section table. All of it must be inside the raw data of one section.
+ */
+static BOOL pe_rva_to_ofs (const struct pe_file *pe, DWORD rva, DWORD len, size_t *ofs)
+{
+  const IMAGE_SECTION_HEADER *sec;
+  size_t   sec_ofs = (const BYTE*)&pe->nt->OptionalHeader - pe->base +
+                     pe->nt->FileHeader.SizeOfOptionalHeader;
+  unsigned i, num = pe->nt->FileHeader.NumberOfSections;
+
+  if (sec_ofs + num * sizeof(*sec) > pe->size)
+     return (FALSE);
+
+  sec = (const IMAGE_SECTION_HEADER*) (pe->base + sec_ofs);
+  for (i = 0; i < num; i++, sec++)
+  {
+    DWORD  va  = sec->VirtualAddress;
+    DWORD  raw = sec->SizeOfRawData;
+    size_t pos;
+
+    if (rva < va || rva - va >= raw || len > raw - (rva - va))
+       continue;
+
+    pos = (size_t)sec->PointerToRawData + (rva - va);
+    if (pos > pe->size || len > pe->size - pos)
+       return (FALSE);
+    *ofs = pos;
+    return (TRUE);
+  }
+  return (FALSE);
+}
+
+/**
+ * The sizes of an \c IMAGE_RESOURCE_DIRECTORY and it's entries.
+ */
+#define PE_RES_DIR_SIZE    16
+#define PE_RES_ENTRY_SIZE  8
+#define PE_RES_SUBDIR      0x80000000
+
+/**
+ * Look in the resource-directory at offset \c dir for an entry with
+ * \c id. If \c id is 0, just take the first entry.
+ *
+ * \param[in]  pe        the PE-file.
+ * \param[in]  res_ofs   the file-offset of the resource section.
+ * \param[in]  res_size  the size of the resource section.
+ * \param[in]  dir       the offset of the directory relative to \c res_ofs.
+ * \param[in]  id        the numeric ID to find.
+ * \param[out] data      the \c OffsetToData of the entry found.
+ */
+static BOOL pe_res_lookup (const struct pe_file *pe, size_t res_ofs, DWORD res_size,
+                           DWORD dir, WORD id, DWORD *data)
+{
+  WORD   num_named, num_id;
+  DWORD  i, name;
+  size_t ofs;
+
+  if (dir > res_size || res_size - dir < PE_RES_DIR_SIZE)
+     return (FALSE);
+
+  ofs = res_ofs + dir;
+  memcpy (&num_named, pe->base + ofs + 12, sizeof(num_named));
+  memcpy (&num_id, pe->base + ofs + 14, sizeof(num_id));
+  ofs += PE_RES_DIR_SIZE;
+
+  if (((DWORD)num_named + num_id) * PE_RES_ENTRY_SIZE > res_size - dir - PE_RES_DIR_SIZE)
+     return (FALSE);
+
+  for (i = 0; i < (DWORD)num_named + num_id; i++, ofs += PE_RES_ENTRY_SIZE)
+  {
+    memcpy (&name, pe->base + ofs, sizeof(name));
+    if (id == 0 || name == id)
+    {
+      memcpy (data, pe->base + ofs + sizeof(name), sizeof(*data));
+      return (TRUE);
+    }
+  }
+  return (FALSE);
+}
+
+/**
+ * Find the first resource of \c type in a PE-file opened by \c pe_open().
+ * The levels in the resource-tree are: type, name and language. The first
+ * name and language found for \c type is used.
+ *
+ * \param[in]  pe    the PE-file.
+ * \param[in]  type  the numeric resource type. E.g. \c PE_RT_VERSION.
+ * \param[out] size  the size of the resource data.
+ *
+ * \retval NULL if not found. Otherwise a pointer to the data inside the mapping.
+ */
+const BYTE *pe_get_resource (const struct pe_file *pe, WORD type, DWORD *size)
+{
+  DWORD  rva, res_size, entry, data_rva, data_size;
+  size_t res_ofs, data_ofs;
+
+  if (!pe->nt ||
+      !pe_data_directory(pe, IMAGE_DIRECTORY_ENTRY_RESOURCE, &rva, &res_size) ||
+      rva == 0 || !pe_rva_to_ofs(pe, rva, res_size, &res_ofs))
+     return (NULL);
+
+  if (!pe_res_lookup(pe, res_ofs, res_size, 0, type, &entry) ||
+      !(entry & PE_RES_SUBDIR) ||
+      !pe_res_lookup(pe, res_ofs, res_size, entry & ~PE_RES_SUBDIR, 0, &entry) ||
+      !(entry & PE_RES_SUBDIR) ||
+      !pe_res_lookup(pe, res_ofs, res_size, entry & ~PE_RES_SUBDIR, 0, &entry) ||
+      (entry & PE_RES_SUBDIR))
+     return (NULL);
+
+  /* 'entry' is now the offset of an 'IMAGE_RESOURCE_DATA_ENTRY'.
+   * It's 'OffsetToData' is a RVA.
+   */
+  if (entry > res_size || res_size - entry < 2*sizeof(DWORD) ||
+      !pe_get_dword(pe, res_ofs + entry, &data_rva) ||
+      !pe_get_dword(pe, res_ofs + entry + sizeof(DWORD), &data_size) ||
+      !pe_rva_to_ofs(pe, data_rva, data_size, &data_ofs))
+     return (NULL);
+
+  *size = data_size;
+  return (pe->base + data_ofs);
+}
+
+/**
+ * Get the Authenticode certificate table of a PE-file.
+ * The "RVA" of the security data-directory is a plain file-offset since
+ * this table is not mapped into the image.
+ *
+ * \param[in]  pe       the mapped PE-file.
+ * \param[out] dir_ofs  the file-offset of the data-directory entry itself.
+ * \param[out] ofs      the file-offset of the table; 0 if there is none.
+ * \param[out] size     the size of the table;        0 if there is none.
+ *
+ * \retval FALSE if the directory entry is missing or the table is outside the file.
+ */
+BOOL pe_get_certificates (const struct pe_file *pe, size_t *dir_ofs, size_t *ofs, DWORD *size)
+{
+  DWORD cert_ofs, cert_size;
+
+  *ofs  = 0;
+  *size = 0;
+  if (!pe->nt ||
+      !pe_data_directory_ofs(pe, IMAGE_DIRECTORY_ENTRY_SECURITY, dir_ofs) ||
+      !pe_get_dword(pe, *dir_ofs, &cert_ofs) ||
+      !pe_get_dword(pe, *dir_ofs + sizeof(DWORD), &cert_size))
+     return (FALSE);
+
+  if (cert_size == 0)
+     return (TRUE);
+
+  /* The table must come after the headers we hash and be inside the file.
+   */
+  if (cert_ofs < *dir_ofs + sizeof(IMAGE_DATA_DIRECTORY) ||
+      cert_ofs > pe->size || cert_size > pe->size - cert_ofs)
+     return (FALSE);
+
+  *ofs  = cert_ofs;
+  *size = cert_size;
+  return (TRUE);
+}
+
+/**
+ * Compute the Authenticode digest of a mapped PE-file. This is the
+ * digest a signature (if any) was made over; it should match the one
+ * in the \c SpcIndirectDataContent of the embedded PKCS#7 signature.
+ *
+ * The whole file is hashed except:
+ *  \li the \c CheckSum field in the optional header.
+ *  \li the security data-directory entry.
+ *  \li the certificate table and anything after it.
+ *
+ * This is the same as hashing the headers and then the sections sorted on
+ * \c PointerToRawData as in the specification, but without looking at the
+ * section table. An unsigned file is padded with 0s to a multiple of 8 bytes
+ * as \c signtool does before appending the certificate table.
+ *
+ * \param[in]  pe      the mapped PE-file (from \c pe_open()).
+ * \param[in]  alg     \c SHA_1 or \c SHA_256.
+ * \param[out] digest  at least \c sha_digest_size(alg) bytes.
+ *
+ * \retval FALSE if the headers are not sane enough to compute it.
+ */
+BOOL pe_authenticode_digest (const struct pe_file *pe, enum sha_alg alg, BYTE *digest)
+{
+  static const BYTE zeroes [8];
+  struct sha_ctx ctx;
+  size_t dir_ofs, cert_ofs, end;
+  DWORD  cert_size;
+
+  if (!pe_get_certificates(pe, &dir_ofs, &cert_ofs, &cert_size) ||
+      pe->checksum_ofs + sizeof(DWORD) > dir_ofs)
+     return (FALSE);
+
+  end = cert_size ? cert_ofs : pe->size;
+
+  sha_init (&ctx, alg);
+  sha_update (&ctx, pe->base, pe->checksum_ofs);
+  sha_update (&ctx, pe->base + pe->checksum_ofs + sizeof(DWORD),
+              dir_ofs - pe->checksum_ofs - sizeof(DWORD));
+  sha_update (&ctx, pe->base + dir_ofs + sizeof(IMAGE_DATA_DIRECTORY),
+              end - dir_ofs - sizeof(IMAGE_DATA_DIRECTORY));
+  if (cert_size == 0 && (end % 8) != 0)
+     sha_update (&ctx, zeroes, 8 - (end % 8));
+  sha_final (&ctx, digest);
+  return (TRUE);
+}
+
+#if defined(PE_TEST)
+
+#if PE_WIN32
+  #include <imagehlp.h>
+#else
+  #include <time.h>
+#endif
+
+struct prog_options opt;
+
+static double pe_test_msec (void)
+{
+#if PE_WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER        now;
+
+  if (freq.QuadPart == 0)
+     QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&now);
+  return (1000.0 * (double)now.QuadPart / (double)freq.QuadPart);
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (1000.0 * (double)ts.tv_sec + (double)ts.tv_nsec / 1E6);
+#endif
+}
+
+static void usage (void)
+{
+  printf ("Usage: pe [-a] [-n loops] <file(s)>\n"
+          "       pe -t [dir]\n"
+          "  Verify the checksum of each PE-file and report the throughput.\n"
+          "  -a: print the Authenticode SHA-1 and SHA-256 digests instead.\n"
+          "  -t: test the Authenticode digests of the sample files in 'dir' (default \"pe_samples\").\n");
+  exit (-1);
+}
+
+/**
+ * Print the Authenticode digests of \c pe.
+ */
+static double pe_test_digest (const struct pe_file *pe, const char *file, int loops)
+{
+  BYTE   digest [SHA_MAX_DIGEST_SIZE];
+  char   hex [2*SHA_MAX_DIGEST_SIZE+1];
+  size_t cert_dir, cert_ofs;
+  DWORD  cert_size;
+  double start, msec;
+  int    alg, j;
+
+  if (!pe_get_certificates(pe, &cert_dir, &cert_ofs, &cert_size))
+  {
+    printf ("%s: bad security directory.\n", file);
+    return (0.0);
+  }
+  printf ("%s: %u-bit, certificates: %lu bytes at 0x%lX\n",
+          file, pe->bits == bit_64 ? 64 : pe->bits == bit_32 ? 32 : 0,
+          (unsigned long)cert_size, (unsigned long)cert_ofs);
+
+  start = pe_test_msec();
+  for (alg = SHA_1; alg <= SHA_256; alg++)
+  {
+    for (j = 0; j < loops; j++)
+        pe_authenticode_digest (pe, (enum sha_alg)alg, digest);
+    printf ("  %-6s: %s\n", sha_name((enum sha_alg)alg),
+            sha_hex(digest, sha_digest_size((enum sha_alg)alg), hex));
+  }
+  msec = pe_test_msec() - start;
+  return (msec);
+}
+
+/**
+ * Read a DER tag and length at \c *p (not beyond \c end).
+ * Only the definite lengths used inside the \c SpcIndirectDataContent.
+ *
+ * \retval NULL  if it's not a \c tag or does not fit.
+ * \retval the start of the contents; \c *len bytes long.
+ */
+static const BYTE *pe_test_der (const BYTE *p, const BYTE *end, BYTE tag, size_t *len)
+{
+  size_t n, i;
+
+  if (end - p < 2 || p[0] != tag)
+     return (NULL);
+
+  n = p[1];
+  p += 2;
+  if (n & 0x80)
+  {
+    i = n & 0x7F;
+    if (i == 0 || i > sizeof(DWORD) || (size_t)(end - p) < i)
+       return (NULL);
+    for (n = 0; i > 0; i--)
+        n = (n << 8) + *p++;
+  }
+  if (n > (size_t)(end - p))
+     return (NULL);
+  *len = n;
+  return (p);
+}
+
+/**
+ * Get the digest a signed PE-file was signed over. That's the \c messageDigest
+ * of the \c SpcIndirectDataContent in the PKCS#7 \c SignedData of the first
+ * certificate:
+ * \code
+ *   SEQUENCE { OID 1.3.6.1.4.1.311.2.1.4,          -- SPC_INDIRECT_DATA_OBJID
+ *     [0] { SEQUENCE {                              -- SpcIndirectDataContent
+ *             SEQUENCE { ... },                     -- data
+ *             SEQUENCE { SEQUENCE { OID, ... },     -- messageDigest: algorithm
+ *                        OCTET STRING } } } }       --                digest
+ * \endcode
+ */
+static BOOL pe_test_signed_digest (const struct pe_file *pe, enum sha_alg *alg, BYTE *digest)
+{
+  static const BYTE spc_indirect_data[] = { 0x06, 0x0A, 0x2B, 0x06, 0x01, 0x04, 0x01, 0x82, 0x37, 0x02, 0x01, 0x04 };
+  static const BYTE oid_sha1[]   = { 0x2B, 0x0E, 0x03, 0x02, 0x1A };
+  static const BYTE oid_sha256[] = { 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01 };
+  const BYTE *p, *end, *oid;
+  size_t      dir_ofs, cert_ofs, len, oid_len;
+  DWORD       cert_size;
+
+  if (!pe_get_certificates(pe, &dir_ofs, &cert_ofs, &cert_size) || cert_size <= 8)
+     return (FALSE);
+
+  /* Skip the 'WIN_CERTIFICATE' header and find the 'contentType' of the 'SignedData'.
+   */
+  end = pe->base + cert_ofs + cert_size;
+  for (p = pe->base + cert_ofs + 8; p + sizeof(spc_indirect_data) <= end; p++)
+      if (!memcmp(p, spc_indirect_data, sizeof(spc_indirect_data)))
+         break;
+  if (p + sizeof(spc_indirect_data) > end)
+     return (FALSE);
+  p += sizeof(spc_indirect_data);
+
+  if (!(p = pe_test_der(p, end, 0xA0, &len)) ||        /* [0] */
+      !(p = pe_test_der(p, end, 0x30, &len)))          /* SpcIndirectDataContent */
+     return (FALSE);
+  end = p + len;
+
+  if (!(p = pe_test_der(p, end, 0x30, &len)))          /* data; skip it */
+     return (FALSE);
+  p += len;
+
+  if (!(p = pe_test_der(p, end, 0x30, &len)) ||        /* messageDigest */
+      !(p = pe_test_der(p, end, 0x30, &len)) ||        /* algorithm */
+      !(oid = pe_test_der(p, p + len, 0x06, &oid_len)))
+     return (FALSE);
+  p += len;
+
+  if (oid_len == sizeof(oid_sha1) && !memcmp(oid, oid_sha1, oid_len))
+       *alg = SHA_1;
+  else if (oid_len == sizeof(oid_sha256) && !memcmp(oid, oid_sha256, oid_len))
+       *alg = SHA_256;
+  else return (FALSE);
+
+  if (!(p = pe_test_der(p, end, 0x04, &len)) || len != sha_digest_size(*alg))
+     return (FALSE);
+  memcpy (digest, p, len);
+  return (TRUE);
+}
+
+/**
+ * The files in \c pe_samples/. Each \c file must have the Authenticode digest
+ * that \c signed_file was signed over. They are:
+ *  \li signed32.dll: a signed 32-bit .NET resource DLL (from NuGet.Client).
+ *  \li signed64.exe: a signed 64-bit .NET program (from vstest).
+ *  \li pad32.dll:    signed32.dll with the certificate table removed and then
+ *                    4 bytes short of a multiple of 8. It's digest needs the
+ *                    pad to 8 bytes that \c signtool did before signing.
+ */
+static const struct pe_test_sample {
+       const char *file;
+       const char *signed_file;
+       DWORD       cert_size;   /* 0 for the unsigned one */
+     } pe_test_samples[] = {
+       { "signed32.dll", "signed32.dll", 9080  },
+       { "signed64.exe", "signed64.exe", 10144 },
+       { "pad32.dll",    "signed32.dll", 0     }
+     };
+
+/**
+ * Compare the Authenticode digest of each file in \c pe_test_samples[]
+ * with the digest it's signature (or that of it's \c signed_file) was made over.
+ *
+ * \retval the number of failed samples.
+ */
+static int pe_test_samples_run (const char *dir)
+{
+  const struct pe_test_sample *t;
+  int num_bad = 0;
+
+  for (t = pe_test_samples; t < pe_test_samples + DIM(pe_test_samples); t++)
+  {
+    struct pe_file pe, pe_signed;
+    enum sha_alg   alg;
+    BYTE           want [SHA_MAX_DIGEST_SIZE], got [SHA_MAX_DIGEST_SIZE];
+    char           file [_MAX_PATH], signed_file [_MAX_PATH], hex [2*SHA_MAX_DIGEST_SIZE+1];
+    size_t         dir_ofs, cert_ofs;
+    DWORD          cert_size;
+    BOOL           ok = FALSE;
+
+    snprintf (file, sizeof(file), "%s/%s", dir, t->file);
+    snprintf (signed_file, sizeof(signed_file), "%s/%s", dir, t->signed_file);
+
+    if (!pe_open(&pe_signed, signed_file))
+    {
+      printf ("%-14s: %s is not a PE-file.\n", t->file, signed_file);
+      num_bad++;
+      continue;
+    }
+    if (!pe_test_signed_digest(&pe_signed, &alg, want))
+    {
+      printf ("%-14s: no signed digest in %s.\n", t->file, signed_file);
+      pe_close (&pe_signed);
+      num_bad++;
+      continue;
+    }
+    pe_close (&pe_signed);
+
+    if (!pe_open(&pe, file))
+    {
+      printf ("%-14s: not a PE-file.\n", t->file);
+      num_bad++;
+      continue;
+    }
+    if (pe_get_certificates(&pe, &dir_ofs, &cert_ofs, &cert_size) && cert_size == t->cert_size &&
+        pe_authenticode_digest(&pe, alg, got))
+       ok = (memcmp(got, want, sha_digest_size(alg)) == 0);
+
+    printf ("%-14s: %s, size: %5lu, certificates: %5lu, %-6s: %s %s\n",
+            t->file, pe.bits == bit_64 ? "PE32+" : "PE32 ", (unsigned long)pe.size,
+            (unsigned long)cert_size, sha_name(alg),
+            sha_hex(want, sha_digest_size(alg), hex), ok ? "OK" : "FAIL");
+    if (!ok)
+       num_bad++;
+    pe_close (&pe);
+  }
+  printf ("%d errors.\n", num_bad);
+  return (num_bad);
+}
+
+int main (int argc, char **argv)
+{
+  int    i, loops = 10, num_bad = 0;
+  BOOL   do_digest = FALSE;
+  double total_bytes = 0.0, total_msec = 0.0;
+
+  if (argc >= 2 && !strcmp(argv[1], "-t"))
+     return (pe_test_samples_run(argc >= 3 ? argv[2] : "pe_samples") ? 1 : 0);
+
+  if (argc >= 2 && !strcmp(argv[1], "-a"))
+  {
+    do_digest = TRUE;
+    loops = 1;
+    argc--;
+    argv++;
+  }
+  if (argc >= 3 && !strcmp(argv[1], "-n"))
+  {
+    loops = atoi (argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc < 2 || loops < 1)
+     usage();
+
+  for (i = 1; i < argc; i++)
+  {
+    struct pe_file pe;
+    const char    *file = argv[i];
+    DWORD          sum = 0;
+    double         start, msec;
+    int            j;
+
+    if (!pe_open(&pe, file))
+    {
+      printf ("%s: not a PE-file.\n", file);
+      continue;
+    }
+
+    if (do_digest)
+    {
+      total_msec  += pe_test_digest (&pe, file, loops);
+      total_bytes += 2.0 * pe.size * loops;
+      pe_close (&pe);
+      continue;
+    }
+
+    start = pe_test_msec();
+    for (j = 0; j < loops; j++)
+        sum = pe_checksum (pe.base, pe.size, pe.checksum_ofs);
+    msec = pe_test_msec() - start;
+
+    total_bytes += (double)pe.size * loops;
+    total_msec  += msec;
+
+    printf ("%s: %u-bit, header: 0x%08lX, calc: 0x%08lX%s, %.1f MB/s\n",
+            file, pe.bits == bit_64 ? 64 : pe.bits == bit_32 ? 32 : 0,
+            (unsigned long)pe.header_sum, (unsigned long)sum,
+            pe_verify_checksum(&pe, NULL) ? "" : " (bad)",
+            msec > 0.0 ? ((double)pe.size * loops / (1024.0*1024.0)) / (msec / 1000.0) : 0.0);
+
+#if PE_WIN32
+    {
+      DWORD header_sum, calc_sum;
+
+      /* Cross-check against imagehlp.
+       */
+      if (MapFileAndCheckSum((PTSTR)file, &header_sum, &calc_sum) == CHECKSUM_SUCCESS &&
+          calc_sum != sum)
+      {
+        printf ("  MapFileAndCheckSum() disagrees: 0x%08lX.\n", (unsigned long)calc_sum);
+        num_bad++;
+      }
+    }
+#endif
+    pe_close (&pe);
+  }
+
+  if (total_msec > 0.0)
+     printf ("Total: %.1f MB in %.1f msec; %.1f MB/s.\n",
+             total_bytes / (1024.0*1024.0), total_msec,
+             (total_bytes / (1024.0*1024.0)) / (total_msec / 1000.0));
+  return (num_bad ? 1 : 0);
+}
+#endif  /* PE_TEST */
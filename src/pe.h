@@ -0,0 +1,52 @@
+/** \file pe.h
+ */
+#ifndef _PE_H
+#define _PE_H
+
+#include "sha.h"
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  #define PE_WIN32 1
+#else
+  #define PE_WIN32 0
+#endif
+
+/**\struct pe_file
+ * A PE-file mapped into memory by \c pe_open().
+ * Or just the header of it given to \c pe_parse().
+ *
+ * All pointers are checked to be inside \c base and \c size.
+ */
+struct pe_file {
+       const BYTE             *base;          /** the mapped file (or header) */
+       size_t                  size;          /** the size of it */
+       const IMAGE_DOS_HEADER *dos;           /** set if there's a \c "MZ" signature */
+       const IMAGE_NT_HEADERS *nt;            /** set if there's a \c "PE\0\0" signature too */
+       enum Bitness            bits;          /** from the optional header magic */
+       DWORD                   header_sum;    /** the \c CheckSum in the optional header */
+       size_t                  checksum_ofs;  /** the file-offset of \c CheckSum */
+#if PE_WIN32
+       HANDLE                  file_hnd;
+       HANDLE                  map_hnd;
+#else
+       int                     fd;
+#endif
+     };
+
+extern BOOL  pe_parse    (struct pe_file *pe, const void *base, size_t size);
+extern BOOL  pe_open     (struct pe_file *pe, const char *file);
+extern void  pe_close    (struct pe_file *pe);
+extern DWORD pe_checksum (const void *base, size_t size, size_t checksum_ofs);
+extern BOOL  pe_verify_checksum (const struct pe_file *pe, DWORD *calc_sum);
+
+/**
+ * The numeric \c RT_VERSION resource type for \c pe_get_resource().
+ */
+#define PE_RT_VERSION  16
+
+extern const BYTE *pe_get_resource (const struct pe_file *pe, WORD type, DWORD *size);
+
+extern BOOL pe_get_certificates    (const struct pe_file *pe, size_t *dir_ofs, size_t *ofs, DWORD *size);
+extern BOOL pe_authenticode_digest (const struct pe_file *pe, enum sha_alg alg, BYTE *digest);
+
+#endif /* _PE_H */
@@ -0,0 +1,820 @@
+/**\file    runner.c
+ * \ingroup Misc
+ * \brief
+ *   Run many child-processes at once and collect their output.
+ *
+ * Unlike \c popen_run(), no shell is involved; the program is started
+ * directly. Hence a command can not contain any redirections or pipes.
+ * Use the \c RUNNER_STDERR_x flags instead. The \c stdin of a child is
+ * always the null-device.
+ *
+ * Usage:
+ * \code
+ *   struct runner *r = runner_new();
+ *
+ *   id1 = runner_submitf (r, 0, callback1, arg1, "\"%s\" --version", prog1);
+ *   id2 = runner_submitf (r, RUNNER_STDERR_MERGE, callback2, arg2, "\"%s\" -v", prog2);
+ *   runner_wait (r);
+ *   found = runner_result (r, id1);
+ *   runner_free (r);
+ * \endcode
+ *
+ * The children are run in parallel (but no more than \c tasks_max_threads()
+ * at once). The callbacks are called from the thread calling \c runner_wait();
+ * each callback gets the lines of it's child in order. Thus a callback is
+ * free to print and modify global state.
+ *
+ * On Windows, the children are started with \c CreateProcess() and a thread
+ * per child reads it's pipe. On CygWin \c posix_spawnp() and \c poll() are
+ * used instead.
+ *
+ * The inheritable handles for a child are only open while holding
+ * \c spawn_lock(). So a child started by another thread at the same time
+ * does not inherit them.
+ */
+#include <errno.h>
+
+#include "envtool.h"
+#include "smartlist.h"
+#include "tasks.h"
+#include "runner.h"
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  #define RUNNER_WIN32 1
+#else
+  #define RUNNER_WIN32 0
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <spawn.h>
+  #include <unistd.h>
+  #include <sys/wait.h>
+
+  extern char **environ;
+#endif
+
+/**\struct runner_stream
+ * A pipe from a child; it's \c stdout or \c stderr.
+ */
+struct runner_stream {
+       char           *buf;        /** output not yet passed to the \c callback */
+       size_t          len;        /** the number of bytes in \c buf */
+       size_t          size;       /** the allocated size of \c buf */
+#if RUNNER_WIN32
+       HANDLE          pipe;       /** the read-end */
+       HANDLE          reader;     /** the thread reading \c pipe */
+#else
+       int             fd;         /** the read-end. -1 at EOF (or if not used) */
+#endif
+     };
+
+/**\struct runner_child
+ * One submitted command.
+ */
+struct runner_child {
+       char                *cmd;       /** the program + args to run */
+       unsigned             flags;     /** the \c RUNNER_x flags */
+       runner_callback      callback;  /** called for each line */
+       void                *arg;       /** passed on to \c callback */
+       int                  lines;     /** the number of lines passed to \c callback so far */
+       int                  result;    /** the sum of \c callback return values. -1 if not started */
+       BOOL                 started;   /** the child was (tried) started */
+       BOOL                 running;   /** it's output is still being read */
+       BOOL                 stopped;   /** \c callback returned < 0 */
+       struct runner_stream out;       /** it's \c stdout */
+       struct runner_stream err;       /** it's \c stderr with \c RUNNER_STDERR_PIPE */
+#if RUNNER_WIN32
+       HANDLE               process;   /** the child process */
+       DWORD                pid;       /** it's id; for \c TRACE_ASYNC_END() */
+#else
+       pid_t                pid;       /** the child process */
+#endif
+     };
+
+/**\struct runner
+ */
+struct runner {
+       smartlist_t *children;      /** the \c runner_child list in order of submit */
+       int          max_running;   /** run no more than this at once */
+     };
+
+/**
+ * Append \c size bytes of output to the buffer of \c s.
+ */
+static void runner_append (struct runner_stream *s, const char *data, size_t size)
+{
+  if (s->len + size + 1 > s->size)
+  {
+    s->size = 2 * (s->len + size) + 1000;
+    s->buf  = REALLOC (s->buf, s->size);
+  }
+  memcpy (s->buf + s->len, data, size);
+  s->len += size;
+}
+
+/**
+ * Pass all complete lines in the buffer of \c s to the \c callback of \c c.
+ * If \c final, the pipe is at EOF and a partial last line is passed too.
+ * Like \c popen_run(), empty lines are skipped.
+ */
+static void runner_deliver (struct runner_child *c, struct runner_stream *s, BOOL final)
+{
+  char  *line = s->buf;
+  char  *end  = s->buf + s->len;
+  char  *nl;
+
+  while (line < end)
+  {
+    nl = memchr (line, '\n', end - line);
+    if (!nl)
+    {
+      if (!final)
+         break;
+      nl = end;
+    }
+    *nl = '\0';
+    strip_nl (line);
+    if (line[0] && !c->stopped && c->callback)
+    {
+      int rc = (*c->callback) (line, c->lines++, c->arg);
+
+      c->result += rc;
+      if (rc < 0)
+         c->stopped = TRUE;
+    }
+    line = nl + 1;
+  }
+
+  if (line >= end)
+       s->len = 0;
+  else if (line > s->buf)
+  {
+    s->len = end - line;
+    memmove (s->buf, line, s->len);
+  }
+}
+
+#if RUNNER_WIN32
+/**
+ * The thread reading one pipe of a child. The main thread does not
+ * touch the buffer until this thread has finished.
+ */
+static DWORD WINAPI runner_reader (void *arg)
+{
+  struct runner_stream *s = (struct runner_stream*) arg;
+  char   buf [4096];
+  DWORD  got;
+
+  while (ReadFile(s->pipe, buf, sizeof(buf), &got, NULL) && got > 0)
+     runner_append (s, buf, got);
+  return (0);
+}
+
+static void runner_close (HANDLE *h)
+{
+  if (*h && *h != INVALID_HANDLE_VALUE)
+     CloseHandle (*h);
+  *h = NULL;
+}
+
+/**
+ * Create a pipe for the \c stdout or \c stderr of a child.
+ * Only the write-end \c wr is inheritable.
+ */
+static BOOL runner_pipe (SECURITY_ATTRIBUTES *sa, HANDLE *rd, HANDLE *wr)
+{
+  if (!CreatePipe(rd, wr, sa, 0))
+     return (FALSE);
+  SetHandleInformation (*rd, HANDLE_FLAG_INHERIT, 0);
+  return (TRUE);
+}
+
+/**
+ * Wait for the reader of \c s to finish.
+ */
+static void runner_finish_stream (struct runner_stream *s)
+{
+  if (s->reader)
+  {
+    WaitForSingleObject (s->reader, INFINITE);
+    runner_close (&s->reader);
+  }
+  runner_close (&s->pipe);
+}
+
+/**
+ * Start the child \c c and a thread to read each of it's pipes.
+ * The pipes are read concurrently; so a child filling one pipe while
+ * we wait on the other, can not dead-lock.
+ */
+static BOOL runner_start (struct runner_child *c)
+{
+  SECURITY_ATTRIBUTES sa;
+  STARTUPINFO         si;
+  PROCESS_INFORMATION pi;
+  HANDLE              out_wr = NULL, err_wr = NULL, nul;
+  BOOL                err_pipe = (c->flags & RUNNER_STDERR_PIPE) != 0;
+  DWORD               tid;
+  char               *cmd;
+  BOOL                rc;
+
+  memset (&sa, '\0', sizeof(sa));
+  sa.nLength        = sizeof(sa);
+  sa.bInheritHandle = TRUE;
+
+  spawn_lock();
+  nul = CreateFile ("NUL", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                    &sa, OPEN_EXISTING, 0, NULL);
+  if (nul == INVALID_HANDLE_VALUE || !runner_pipe(&sa, &c->out.pipe, &out_wr) ||
+      (err_pipe && !runner_pipe(&sa, &c->err.pipe, &err_wr)))
+  {
+    DEBUGF (1, "CreatePipe() failed; %s\n", win_strerror(GetLastError()));
+    runner_close (&nul);
+    runner_close (&out_wr);
+    runner_close (&err_wr);
+    spawn_unlock();
+    runner_close (&c->out.pipe);
+    runner_close (&c->err.pipe);
+    return (FALSE);
+  }
+
+  memset (&si, '\0', sizeof(si));
+  si.cb         = sizeof(si);
+  si.dwFlags    = STARTF_USESTDHANDLES;
+  si.hStdInput  = nul;
+  si.hStdOutput = out_wr;
+  if (c->flags & RUNNER_STDERR_MERGE)
+       si.hStdError = out_wr;
+  else if (c->flags & RUNNER_STDERR_NULL)
+       si.hStdError = nul;
+  else if (err_pipe)
+       si.hStdError = err_wr;
+  else si.hStdError = GetStdHandle (STD_ERROR_HANDLE);
+
+  /* CreateProcess() may modify the command-line.
+   */
+  cmd = STRDUP (c->cmd);
+  memset (&pi, '\0', sizeof(pi));
+  rc = CreateProcess (NULL, cmd, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+  FREE (cmd);
+  runner_close (&out_wr);
+  runner_close (&err_wr);
+  runner_close (&nul);
+  spawn_unlock();
+
+  if (!rc)
+  {
+    DEBUGF (1, "CreateProcess (\"%s\") failed; %s\n", c->cmd, win_strerror(GetLastError()));
+    runner_close (&c->out.pipe);
+    runner_close (&c->err.pipe);
+    return (FALSE);
+  }
+  STAT_INC (STAT_SPAWNED);
+  TRACE_ASYNC_BEGIN ("process", c->cmd, pi.dwProcessId);
+  CloseHandle (pi.hThread);
+  c->process    = pi.hProcess;
+  c->pid        = pi.dwProcessId;
+  c->out.reader = CreateThread (NULL, 0, runner_reader, &c->out, 0, &tid);
+  if (c->out.reader && err_pipe)
+     c->err.reader = CreateThread (NULL, 0, runner_reader, &c->err, 0, &tid);
+
+  if (!c->out.reader || (err_pipe && !c->err.reader))
+  {
+    /* Reading the pipes one after the other could dead-lock.
+     * So give up on this child.
+     */
+    DEBUGF (1, "CreateThread() failed; %s\n", win_strerror(GetLastError()));
+    TerminateProcess (c->process, 1);
+    WaitForSingleObject (c->process, INFINITE);
+    TRACE_ASYNC_END ("process", c->cmd, c->pid);
+    runner_close (&c->process);
+    runner_finish_stream (&c->out);
+    runner_finish_stream (&c->err);
+    return (FALSE);
+  }
+  return (TRUE);
+}
+
+/**
+ * Wait for the child \c c to finish and pass it's output to the \c callback.
+ * The \c stdout lines first, then any \c stderr lines.
+ */
+static void runner_finish (struct runner_child *c)
+{
+  runner_finish_stream (&c->out);
+  runner_finish_stream (&c->err);
+  runner_deliver (c, &c->out, TRUE);
+  runner_deliver (c, &c->err, TRUE);
+  WaitForSingleObject (c->process, INFINITE);
+  TRACE_ASYNC_END ("process", c->cmd, c->pid);
+  runner_close (&c->process);
+  c->running = FALSE;
+}
+
+#else  /* RUNNER_WIN32 */
+
+/**
+ * Split the command-line \c cmd (in-place) into an \c argv[] array.
+ * Arguments are separated by spaces or tabs. A double-quote starts
+ * or ends a quoted part (which can contain spaces). Backslashes are
+ * kept as-is since \c cmd normally contains Windows paths.
+ */
+static char **runner_split_args (char *cmd)
+{
+  char **argv = CALLOC (strlen(cmd)/2 + 2, sizeof(char*));
+  char  *in = cmd, *out;
+  int    argc = 0;
+
+  while (1)
+  {
+    BOOL quoted = FALSE;
+
+    while (*in == ' ' || *in == '\t')
+       in++;
+    if (!*in)
+       break;
+
+    argv [argc++] = out = in;
+    while (*in && (quoted || (*in != ' ' && *in != '\t')))
+    {
+      if (*in == '"')
+           quoted = !quoted;
+      else *out++ = *in;
+      in++;
+    }
+    if (*in)
+       in++;
+    *out = '\0';
+  }
+  argv [argc] = NULL;
+  return (argv);
+}
+
+/**
+ * Start the child \c c.
+ */
+static BOOL runner_start (struct runner_child *c)
+{
+  posix_spawn_file_actions_t fa;
+  BOOL   err_pipe = (c->flags & RUNNER_STDERR_PIPE) != 0;
+  char **argv, *cmd;
+  int    out_fds[2], err_fds[2] = { -1, -1 };
+  int    rc;
+
+  c->out.fd = c->err.fd = -1;
+
+  spawn_lock();
+  if (pipe(out_fds) < 0)
+  {
+    DEBUGF (1, "pipe() failed; errno: %d.\n", errno);
+    spawn_unlock();
+    return (FALSE);
+  }
+  if (err_pipe && pipe(err_fds) < 0)
+  {
+    DEBUGF (1, "pipe() failed; errno: %d.\n", errno);
+    close (out_fds[0]);
+    close (out_fds[1]);
+    spawn_unlock();
+    return (FALSE);
+  }
+  fcntl (out_fds[0], F_SETFD, FD_CLOEXEC);
+  if (err_pipe)
+     fcntl (err_fds[0], F_SETFD, FD_CLOEXEC);
+
+  posix_spawn_file_actions_init (&fa);
+  posix_spawn_file_actions_addopen (&fa, 0, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2 (&fa, out_fds[1], 1);
+  if (c->flags & RUNNER_STDERR_MERGE)
+     posix_spawn_file_actions_adddup2 (&fa, out_fds[1], 2);
+  else if (c->flags & RUNNER_STDERR_NULL)
+     posix_spawn_file_actions_addopen (&fa, 2, "/dev/null", O_WRONLY, 0);
+  else if (err_pipe)
+  {
+    posix_spawn_file_actions_adddup2 (&fa, err_fds[1], 2);
+    posix_spawn_file_actions_addclose (&fa, err_fds[1]);
+  }
+  posix_spawn_file_actions_addclose (&fa, out_fds[1]);
+
+  cmd  = STRDUP (c->cmd);
+  argv = runner_split_args (cmd);
+  rc = argv[0] ? posix_spawnp (&c->pid, argv[0], &fa, NULL, argv, environ) : EINVAL;
+  posix_spawn_file_actions_destroy (&fa);
+  FREE (argv);
+  FREE (cmd);
+  close (out_fds[1]);
+  if (err_pipe)
+     close (err_fds[1]);
+  spawn_unlock();
+
+  if (rc != 0)
+  {
+    DEBUGF (1, "posix_spawnp (\"%s\") failed; errno: %d.\n", c->cmd, rc);
+    close (out_fds[0]);
+    if (err_pipe)
+       close (err_fds[0]);
+    return (FALSE);
+  }
+  STAT_INC (STAT_SPAWNED);
+  TRACE_ASYNC_BEGIN ("process", c->cmd, (unsigned)c->pid);
+  c->out.fd = out_fds[0];
+  c->err.fd = err_fds[0];
+  return (TRUE);
+}
+
+/**
+ * Read what is available on the pipe \c s of the child \c c. The complete
+ * \c stdout lines are passed to the \c callback at once. The \c stderr lines
+ * are kept until the \c stdout lines are done.
+ * When both pipes are at EOF, reap the child.
+ */
+static void runner_read (struct runner_child *c, struct runner_stream *s)
+{
+  char    buf [4096];
+  ssize_t got = read (s->fd, buf, sizeof(buf));
+
+  if (got < 0 && errno == EINTR)
+     return;
+
+  if (got > 0)
+  {
+    runner_append (s, buf, got);
+    if (s == &c->out)
+       runner_deliver (c, s, FALSE);
+    return;
+  }
+
+  close (s->fd);
+  s->fd = -1;
+  if (c->out.fd >= 0 || c->err.fd >= 0)
+     return;
+
+  runner_deliver (c, &c->out, TRUE);
+  runner_deliver (c, &c->err, TRUE);
+  while (waitpid(c->pid, NULL, 0) < 0 && errno == EINTR)
+     ;
+  TRACE_ASYNC_END ("process", c->cmd, (unsigned)c->pid);
+  c->running = FALSE;
+}
+#endif  /* RUNNER_WIN32 */
+
+/**
+ * Start the next not-yet-started child (in order of submit).
+ * A child that fails to start keeps it's result of -1 and is skipped.
+ *
+ * \retval FALSE  no more children to start.
+ */
+static BOOL runner_start_next (struct runner *r)
+{
+  int i, max = smartlist_len (r->children);
+
+  for (i = 0; i < max; i++)
+  {
+    struct runner_child *c = smartlist_get (r->children, i);
+
+    if (c->started)
+       continue;
+    c->started = TRUE;
+    if (runner_start(c))
+    {
+      c->running = TRUE;
+      c->result  = 0;
+      return (TRUE);
+    }
+  }
+  return (FALSE);
+}
+
+/**
+ * Start children until \c r->max_running are running.
+ */
+static void runner_fill (struct runner *r)
+{
+  int i, running = 0, max = smartlist_len (r->children);
+
+  for (i = 0; i < max; i++)
+  {
+    const struct runner_child *c = smartlist_get (r->children, i);
+
+    if (c->running)
+       running++;
+  }
+  while (running < r->max_running && runner_start_next(r))
+     running++;
+}
+
+/**
+ * Create a new runner.
+ */
+struct runner *runner_new (void)
+{
+  struct runner *r = CALLOC (1, sizeof(*r));
+
+  r->children    = smartlist_new();
+  r->max_running = tasks_max_threads();
+  return (r);
+}
+
+/**
+ * Wait for any children still running and free the runner.
+ */
+void runner_free (struct runner *r)
+{
+  int i, max;
+
+  if (!r)
+     return;
+
+  runner_wait (r);
+  max = smartlist_len (r->children);
+  for (i = 0; i < max; i++)
+  {
+    struct runner_child *c = smartlist_get (r->children, i);
+
+    FREE (c->cmd);
+    FREE (c->out.buf);
+    FREE (c->err.buf);
+    FREE (c);
+  }
+  smartlist_free (r->children);
+  FREE (r);
+}
+
+/**
+ * Add a command to the runner. It is started in \c runner_run() or
+ * \c runner_wait().
+ *
+ * \param[in] r      the runner to add to.
+ * \param[in] flags  a combination of the \c RUNNER_x flags.
+ * \param[in] cb     the function to call for each line of output.
+ *                   Can be NULL if only the exit of the program is needed.
+ * \param[in] arg    passed on to \c cb.
+ * \param[in] cmd    the program + args to run. No shell redirections allowed.
+ *
+ * \retval the id of this command for \c runner_result().
+ */
+int runner_submit (struct runner *r, unsigned flags, runner_callback cb, void *arg, const char *cmd)
+{
+  struct runner_child *c = CALLOC (1, sizeof(*c));
+
+  c->cmd      = STRDUP (cmd);
+  c->flags    = flags;
+  c->callback = cb;
+  c->arg      = arg;
+  c->result   = -1;
+  smartlist_add (r->children, c);
+  return (smartlist_len(r->children) - 1);
+}
+
+/**
+ * A var-arg version of \c runner_submit().
+ */
+int runner_submitf (struct runner *r, unsigned flags, runner_callback cb, void *arg, const char *fmt, ...)
+{
+  char    cmd [5000];
+  va_list args;
+
+  va_start (args, fmt);
+  vsnprintf (cmd, sizeof(cmd), fmt, args);
+  va_end (args);
+  return runner_submit (r, flags, cb, arg, cmd);
+}
+
+/**
+ * Start the first batch of the submitted commands and return at once.
+ * So they can run while the caller does something else. Their output
+ * is passed to the callbacks in \c runner_wait().
+ *
+ * \note On CygWin nothing reads the pipes until \c runner_wait(). A child
+ *       with more output than a pipe holds, just waits for that.
+ */
+void runner_run (struct runner *r)
+{
+  runner_fill (r);
+}
+
+/**
+ * Run all submitted commands and wait for them to finish.
+ * The callbacks are called from this thread.
+ * More commands can be submitted and waited for afterwards.
+ */
+void runner_wait (struct runner *r)
+{
+  int i, max = smartlist_len (r->children);
+
+  runner_fill (r);
+
+#if RUNNER_WIN32
+  /* Finish them in order of submit. Each finished child makes room
+   * for the next one.
+   */
+  for (i = 0; i < max; i++)
+  {
+    struct runner_child *c = smartlist_get (r->children, i);
+
+    if (!c->running)
+       continue;
+    runner_finish (c);
+    runner_start_next (r);
+  }
+#else
+  {
+    struct pollfd         *pfd    = CALLOC (2*max, sizeof(*pfd));
+    struct runner_child  **poll_c = CALLOC (2*max, sizeof(*poll_c));
+    struct runner_stream **poll_s = CALLOC (2*max, sizeof(*poll_s));
+
+    while (1)
+    {
+      int num = 0;
+
+      for (i = 0; i < max; i++)
+      {
+        struct runner_child  *c = smartlist_get (r->children, i);
+        struct runner_stream *s [2];
+        int    j;
+
+        if (!c->running)
+           continue;
+
+        s[0] = &c->out;
+        s[1] = &c->err;
+        for (j = 0; j < 2; j++)
+        {
+          if (s[j]->fd < 0)
+             continue;
+          pfd [num].fd      = s[j]->fd;
+          pfd [num].events  = POLLIN;
+          pfd [num].revents = 0;
+          poll_c [num] = c;
+          poll_s [num++] = s[j];
+        }
+      }
+      if (num == 0)
+         break;
+
+      if (poll(pfd, num, -1) < 0)
+      {
+        if (errno == EINTR)
+           continue;
+        DEBUGF (1, "poll() failed; errno: %d.\n", errno);
+        break;
+      }
+      for (i = 0; i < num; i++)
+      {
+        if (pfd[i].revents == 0)
+           continue;
+        runner_read (poll_c[i], poll_s[i]);
+        if (!poll_c[i]->running)
+           runner_start_next (r);
+      }
+    }
+    FREE (pfd);
+    FREE (poll_c);
+    FREE (poll_s);
+  }
+#endif
+}
+
+/**
+ * Return the result of a command after \c runner_wait().
+ *
+ * \retval -1   the command could not be started.
+ * \retval >=0  the sum of the values returned from the callback
+ *              (like \c popen_run()).
+ */
+int runner_result (const struct runner *r, int id)
+{
+  const struct runner_child *c;
+
+  if (id < 0 || id >= smartlist_len(r->children))
+     return (-1);
+  c = smartlist_get (r->children, id);
+  return (c->result);
+}
+
+/**
+ * Run one command and wait for it. Like \c popen_runf() but without a shell.
+ *
+ * \retval -1   the command could not be started.
+ * \retval >=0  the sum of the values returned from the callback.
+ */
+int runner_runf (unsigned flags, runner_callback cb, void *arg, const char *fmt, ...)
+{
+  struct runner *r = runner_new();
+  char    cmd [5000];
+  va_list args;
+  int     rc;
+
+  va_start (args, fmt);
+  vsnprintf (cmd, sizeof(cmd), fmt, args);
+  va_end (args);
+
+  runner_submit (r, flags, cb, arg, cmd);
+  runner_wait (r);
+  rc = runner_result (r, 0);
+  runner_free (r);
+  return (rc);
+}
+
+#if defined(RUNNER_TEST)
+
+struct prog_options opt;
+
+/*
+ * The commands below need a shell to write to 'stderr'.
+ */
+#if RUNNER_WIN32
+  #define SH_CMD(cmd)   "cmd.exe /c \"" cmd "\""
+  #define SH_OUT_ERR    SH_CMD ("echo out& echo err 1>&2")
+  #define SH_BIG_ERR    SH_CMD ("(for /L %i in (1,1,5000) do @echo xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx 1>&2)& echo done")
+  #define SH_ECHO       SH_CMD ("echo %d")
+#else
+  #define SH_CMD(cmd)   "sh -c \"" cmd "\""
+  #define SH_OUT_ERR    SH_CMD ("echo out; echo err 1>&2")
+  #define SH_BIG_ERR    SH_CMD ("i=0; while [ $i -lt 5000 ]; do echo xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx 1>&2; i=$((i+1)); done; echo done")
+  #define SH_ECHO       SH_CMD ("echo %d")
+#endif
+
+/**\struct test_output
+ * What a test-command wrote.
+ */
+struct test_output {
+       int  lines;
+       char first [100];
+       char last [100];
+     };
+
+static int test_cb (char *line, int index, void *arg)
+{
+  struct test_output *t = (struct test_output*) arg;
+
+  if (t->lines++ == 0)
+     _strlcpy (t->first, str_trim(line), sizeof(t->first));
+  _strlcpy (t->last, str_trim(line), sizeof(t->last));
+  ARGSUSED (index);
+  return (1);
+}
+
+static int test_check (const char *what, BOOL ok)
+{
+  printf ("  %-40s %s\n", what, ok ? "OK" : "FAIL");
+  return (ok ? 0 : 1);
+}
+
+/*
+ * Run some commands through a runner and check their output.
+ * Also run many at once and check the output comes in order of submit.
+ */
+int main (void)
+{
+  struct runner      *r = runner_new();
+  struct test_output  t_null, t_merge, t_pipe, t_big, t_echo[20];
+  int    id_null, id_merge, id_pipe, id_big, id_none, id_echo[20];
+  int    i, errors = 0;
+  BOOL   ok;
+
+  memset (&t_null, '\0', sizeof(t_null));
+  memset (&t_merge, '\0', sizeof(t_merge));
+  memset (&t_pipe, '\0', sizeof(t_pipe));
+  memset (&t_big, '\0', sizeof(t_big));
+  memset (&t_echo, '\0', sizeof(t_echo));
+
+  id_null  = runner_submit (r, RUNNER_STDERR_NULL, test_cb, &t_null, SH_OUT_ERR);
+  id_merge = runner_submit (r, RUNNER_STDERR_MERGE, test_cb, &t_merge, SH_OUT_ERR);
+  id_pipe  = runner_submit (r, RUNNER_STDERR_PIPE, test_cb, &t_pipe, SH_OUT_ERR);
+  id_big   = runner_submit (r, RUNNER_STDERR_PIPE, test_cb, &t_big, SH_BIG_ERR);
+  id_none  = runner_submit (r, 0, NULL, NULL, "no-such-program-xyz");
+  for (i = 0; i < DIM(t_echo); i++)
+      id_echo[i] = runner_submitf (r, 0, test_cb, &t_echo[i], SH_ECHO, i);
+
+  runner_run (r);
+  runner_wait (r);
+
+  puts ("runner_start() / runner_finish():");
+  errors += test_check ("stderr to null-device",
+                        runner_result(r,id_null) == 1 && !strcmp(t_null.first, "out"));
+  errors += test_check ("stderr merged with stdout",
+                        runner_result(r,id_merge) == 2 && t_merge.lines == 2);
+  errors += test_check ("stderr on it's own pipe",
+                        runner_result(r,id_pipe) == 2 &&
+                        !strcmp(t_pipe.first, "out") && !strcmp(t_pipe.last, "err"));
+  errors += test_check ("5000 lines on stderr pipe",
+                        runner_result(r,id_big) == 5001 && !strcmp(t_big.first, "done"));
+  errors += test_check ("program not found",
+                        runner_result(r,id_none) <= 0);
+
+  ok = TRUE;
+  for (i = 0; i < DIM(t_echo); i++)
+      if (runner_result(r,id_echo[i]) != 1 || atoi(t_echo[i].first) != i)
+         ok = FALSE;
+  errors += test_check ("20 commands at once", ok);
+
+  runner_free (r);
+
+  memset (&t_pipe, '\0', sizeof(t_pipe));
+  ok = (runner_runf(RUNNER_STDERR_PIPE, test_cb, &t_pipe, SH_OUT_ERR) == 2);
+  errors += test_check ("runner_runf()", ok);
+
+  printf ("%d errors.\n", errors);
+  return (errors ? 1 : 0);
+}
+#endif  /* RUNNER_TEST */
@@ -0,0 +1,34 @@
+/** \file runner.h
+ */
+#ifndef _RUNNER_H
+#define _RUNNER_H
+
+/**
+ * Flags for \c runner_submit().
+ * By default the \c stderr of a child is inherited from us.
+ */
+#define RUNNER_STDERR_MERGE  0x01   /**< read \c stderr together with \c stdout (like \c "2>&1") */
+#define RUNNER_STDERR_NULL   0x02   /**< discard \c stderr (like \c "2> NUL") */
+#define RUNNER_STDERR_PIPE   0x04   /**< read \c stderr on it's own pipe. It's lines are passed after those of \c stdout */
+
+/**
+ * The callback for each line a child writes.
+ * Return < 0 to ignore the rest of the output from this child.
+ */
+typedef int (*runner_callback) (char *line, int index, void *arg);
+
+struct runner;
+
+extern struct runner *runner_new (void);
+extern void           runner_free (struct runner *r);
+
+extern int  runner_submit  (struct runner *r, unsigned flags, runner_callback cb, void *arg, const char *cmd);
+extern int  runner_submitf (struct runner *r, unsigned flags, runner_callback cb, void *arg, const char *fmt, ...)
+                            ATTR_PRINTF(5,6);
+extern void runner_run     (struct runner *r);
+extern void runner_wait    (struct runner *r);
+extern int  runner_result  (const struct runner *r, int id);
+extern int  runner_runf    (unsigned flags, runner_callback cb, void *arg, const char *fmt, ...)
+                            ATTR_PRINTF(4,5);
+
+#endif /* _RUNNER_H */
@@ -0,0 +1,322 @@
+/**\file    sha.c
+ * \ingroup Misc
+ * \brief
+ *   Portable SHA-1 and SHA-256 (FIPS 180-4).
+ *
+ * Used for the Authenticode digest of PE-files (see \c pe_authenticode_digest())
+ * where the input is a memory-mapped file. Hence whole blocks are hashed
+ * directly from the caller's buffer; only a partial block at the start or
+ * end of an \c sha_update() is copied to \c sha_ctx::buf.
+ *
+ * The rounds are fully unrolled and the message schedule is kept in a
+ * 16 word ring. The big-endian loads are written as shifts which most
+ * compilers turn into a single \c bswap.
+ *
+ * Nothing here uses global state.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include "envtool.h"
+#include "sha.h"
+
+#define ROL(x, n)  (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define LOAD_BE32(p)  (((DWORD)(p)[0] << 24) | ((DWORD)(p)[1] << 16) | \
+                       ((DWORD)(p)[2] << 8)  |  (DWORD)(p)[3])
+
+#define STORE_BE32(p, v)  do {                        \
+                            (p)[0] = (BYTE) ((v) >> 24); \
+                            (p)[1] = (BYTE) ((v) >> 16); \
+                            (p)[2] = (BYTE) ((v) >> 8);  \
+                            (p)[3] = (BYTE) (v);         \
+                          } while (0)
+
+/*
+ * SHA-1.
+ */
+#define SHA1_W(i)  (W[(i) & 15] = ROL (W[((i)+13) & 15] ^ W[((i)+8) & 15] ^ \
+                                       W[((i)+2) & 15]  ^ W[(i) & 15], 1))
+
+#define SHA1_F1(b, c, d)  ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F2(b, c, d)  ((b) ^ (c) ^ (d))
+#define SHA1_F3(b, c, d)  (((b) & (c)) | ((d) & ((b) | (c))))
+
+#define SHA1_R0(a, b, c, d, e, i) \
+        e += ROL (a, 5) + SHA1_F1 (b, c, d) + W[i] + 0x5A827999; b = ROL (b, 30)
+#define SHA1_R1(a, b, c, d, e, i) \
+        e += ROL (a, 5) + SHA1_F1 (b, c, d) + SHA1_W (i) + 0x5A827999; b = ROL (b, 30)
+#define SHA1_R2(a, b, c, d, e, i) \
+        e += ROL (a, 5) + SHA1_F2 (b, c, d) + SHA1_W (i) + 0x6ED9EBA1; b = ROL (b, 30)
+#define SHA1_R3(a, b, c, d, e, i) \
+        e += ROL (a, 5) + SHA1_F3 (b, c, d) + SHA1_W (i) + 0x8F1BBCDC; b = ROL (b, 30)
+#define SHA1_R4(a, b, c, d, e, i) \
+        e += ROL (a, 5) + SHA1_F2 (b, c, d) + SHA1_W (i) + 0xCA62C1D6; b = ROL (b, 30)
+
+/* 5 rounds rotating the variables back to where they started.
+ */
+#define SHA1_R5(R, i)  R (a, b, c, d, e, (i));   \
+                       R (e, a, b, c, d, (i)+1); \
+                       R (d, e, a, b, c, (i)+2); \
+                       R (c, d, e, a, b, (i)+3); \
+                       R (b, c, d, e, a, (i)+4)
+
+static void sha1_blocks (DWORD *state, const BYTE *p, size_t num)
+{
+  DWORD a, b, c, d, e, W [16];
+  int   i;
+
+  while (num--)
+  {
+    for (i = 0; i < 16; i++)
+        W[i] = LOAD_BE32 (p + 4*i);
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+
+    SHA1_R5 (SHA1_R0, 0);
+    SHA1_R5 (SHA1_R0, 5);
+    SHA1_R5 (SHA1_R0, 10);
+    SHA1_R0 (a, b, c, d, e, 15);
+    SHA1_R1 (e, a, b, c, d, 16);
+    SHA1_R1 (d, e, a, b, c, 17);
+    SHA1_R1 (c, d, e, a, b, 18);
+    SHA1_R1 (b, c, d, e, a, 19);
+
+    SHA1_R5 (SHA1_R2, 20);
+    SHA1_R5 (SHA1_R2, 25);
+    SHA1_R5 (SHA1_R2, 30);
+    SHA1_R5 (SHA1_R2, 35);
+
+    SHA1_R5 (SHA1_R3, 40);
+    SHA1_R5 (SHA1_R3, 45);
+    SHA1_R5 (SHA1_R3, 50);
+    SHA1_R5 (SHA1_R3, 55);
+
+    SHA1_R5 (SHA1_R4, 60);
+    SHA1_R5 (SHA1_R4, 65);
+    SHA1_R5 (SHA1_R4, 70);
+    SHA1_R5 (SHA1_R4, 75);
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    p += SHA_BLOCK_SIZE;
+  }
+}
+
+/*
+ * SHA-256.
+ */
+static const DWORD sha256_K [64] = {
+      0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+      0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+      0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+      0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+      0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+      0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+      0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+      0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+    };
+
+#define SHA256_S0(x)  (ROR (x, 2)  ^ ROR (x, 13) ^ ROR (x, 22))
+#define SHA256_S1(x)  (ROR (x, 6)  ^ ROR (x, 11) ^ ROR (x, 25))
+#define SHA256_s0(x)  (ROR (x, 7)  ^ ROR (x, 18) ^ ((x) >> 3))
+#define SHA256_s1(x)  (ROR (x, 17) ^ ROR (x, 19) ^ ((x) >> 10))
+
+#define SHA256_CH(e, f, g)   ((g) ^ ((e) & ((f) ^ (g))))
+#define SHA256_MAJ(a, b, c)  (((a) & (b)) | ((c) & ((a) | (b))))
+
+#define SHA256_W(i)  (W[(i) & 15] += SHA256_s1 (W[((i)+14) & 15]) + W[((i)+9) & 15] + \
+                                     SHA256_s0 (W[((i)+1) & 15]))
+
+#define SHA256_R(a, b, c, d, e, f, g, h, i, w)                         \
+        do {                                                           \
+          DWORD t1 = h + SHA256_S1 (e) + SHA256_CH (e, f, g) +         \
+                     sha256_K[i] + (w);                                \
+          d += t1;                                                     \
+          h  = t1 + SHA256_S0 (a) + SHA256_MAJ (a, b, c);              \
+        } while (0)
+
+/* 8 rounds rotating the variables back to where they started.
+ * 'j' is the round, 'W_j' gives the message word for it.
+ */
+#define SHA256_R8(j, W_j)                                              \
+        SHA256_R (a, b, c, d, e, f, g, h, (j)+0, W_j ((j)+0));         \
+        SHA256_R (h, a, b, c, d, e, f, g, (j)+1, W_j ((j)+1));         \
+        SHA256_R (g, h, a, b, c, d, e, f, (j)+2, W_j ((j)+2));         \
+        SHA256_R (f, g, h, a, b, c, d, e, (j)+3, W_j ((j)+3));         \
+        SHA256_R (e, f, g, h, a, b, c, d, (j)+4, W_j ((j)+4));         \
+        SHA256_R (d, e, f, g, h, a, b, c, (j)+5, W_j ((j)+5));         \
+        SHA256_R (c, d, e, f, g, h, a, b, (j)+6, W_j ((j)+6));         \
+        SHA256_R (b, c, d, e, f, g, h, a, (j)+7, W_j ((j)+7))
+
+#define SHA256_W0(i)  W[i]
+
+static void sha256_blocks (DWORD *state, const BYTE *p, size_t num)
+{
+  DWORD a, b, c, d, e, f, g, h, W [16];
+  int   i;
+
+  while (num--)
+  {
+    for (i = 0; i < 16; i++)
+        W[i] = LOAD_BE32 (p + 4*i);
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    SHA256_R8 (0, SHA256_W0);
+    SHA256_R8 (8, SHA256_W0);
+    for (i = 16; i < 64; i += 16)
+    {
+      SHA256_R8 (i,   SHA256_W);
+      SHA256_R8 (i+8, SHA256_W);
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+    p += SHA_BLOCK_SIZE;
+  }
+}
+
+static void sha_blocks (struct sha_ctx *ctx, const BYTE *p, size_t num)
+{
+  if (ctx->alg == SHA_1)
+       sha1_blocks (ctx->state, p, num);
+  else sha256_blocks (ctx->state, p, num);
+}
+
+/**
+ * Start a new hash.
+ */
+void sha_init (struct sha_ctx *ctx, enum sha_alg alg)
+{
+  static const DWORD sha1_H [5] = {
+                     0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+                   };
+  static const DWORD sha256_H [8] = {
+                     0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                     0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+                   };
+
+  memset (ctx, '\0', sizeof(*ctx));
+  ctx->alg = alg;
+  if (alg == SHA_1)
+       memcpy (ctx->state, sha1_H, sizeof(sha1_H));
+  else memcpy (ctx->state, sha256_H, sizeof(sha256_H));
+}
+
+/**
+ * Add \c len bytes at \c data to the hash.
+ */
+void sha_update (struct sha_ctx *ctx, const void *data, size_t len)
+{
+  const BYTE *p    = (const BYTE*) data;
+  size_t      used = (size_t) (ctx->count % SHA_BLOCK_SIZE);
+  size_t      num;
+
+  ctx->count += len;
+
+  if (used > 0)
+  {
+    size_t left = SHA_BLOCK_SIZE - used;
+
+    if (len < left)
+    {
+      memcpy (ctx->buf + used, p, len);
+      return;
+    }
+    memcpy (ctx->buf + used, p, left);
+    sha_blocks (ctx, ctx->buf, 1);
+    p   += left;
+    len -= left;
+  }
+
+  num = len / SHA_BLOCK_SIZE;
+  if (num > 0)
+  {
+    sha_blocks (ctx, p, num);
+    p   += num * SHA_BLOCK_SIZE;
+    len -= num * SHA_BLOCK_SIZE;
+  }
+  if (len > 0)
+     memcpy (ctx->buf, p, len);
+}
+
+/**
+ * Finish the hash and return the digest.
+ *
+ * \param[in]  ctx     the hash-state; must be reinitialised after this.
+ * \param[out] digest  at least \c sha_digest_size() bytes.
+ * \retval the size of the digest.
+ */
+size_t sha_final (struct sha_ctx *ctx, BYTE *digest)
+{
+  UINT64 bits = ctx->count << 3;
+  size_t used = (size_t) (ctx->count % SHA_BLOCK_SIZE);
+  size_t i, size = sha_digest_size (ctx->alg);
+
+  ctx->buf [used++] = 0x80;
+  if (used > SHA_BLOCK_SIZE - 8)
+  {
+    memset (ctx->buf + used, '\0', SHA_BLOCK_SIZE - used);
+    sha_blocks (ctx, ctx->buf, 1);
+    used = 0;
+  }
+  memset (ctx->buf + used, '\0', SHA_BLOCK_SIZE - 8 - used);
+  STORE_BE32 (ctx->buf + SHA_BLOCK_SIZE - 8, (DWORD)(bits >> 32));
+  STORE_BE32 (ctx->buf + SHA_BLOCK_SIZE - 4, (DWORD)bits);
+  sha_blocks (ctx, ctx->buf, 1);
+
+  for (i = 0; i < size / 4; i++)
+      STORE_BE32 (digest + 4*i, ctx->state[i]);
+  return (size);
+}
+
+size_t sha_digest_size (enum sha_alg alg)
+{
+  return (alg == SHA_1 ? SHA1_DIGEST_SIZE : SHA256_DIGEST_SIZE);
+}
+
+const char *sha_name (enum sha_alg alg)
+{
+  return (alg == SHA_1 ? "sha1" : "sha256");
+}
+
+/**
+ * Format a digest as lower-case hex.
+ * \c buf must hold at least \c 2*len+1 characters.
+ */
+char *sha_hex (const BYTE *digest, size_t len, char *buf)
+{
+  static const char hex[] = "0123456789abcdef";
+  size_t i;
+
+  for (i = 0; i < len; i++)
+  {
+    buf [2*i]   = hex [digest[i] >> 4];
+    buf [2*i+1] = hex [digest[i] & 15];
+  }
+  buf [2*len] = '\0';
+  return (buf);
+}
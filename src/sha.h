@@ -0,0 +1,36 @@
+/** \file sha.h
+ */
+#ifndef _SHA_H
+#define _SHA_H
+
+#define SHA1_DIGEST_SIZE    20
+#define SHA256_DIGEST_SIZE  32
+#define SHA_MAX_DIGEST_SIZE SHA256_DIGEST_SIZE
+#define SHA_BLOCK_SIZE      64
+
+/**\enum sha_alg
+ * The hash-algorithms in \c sha.c.
+ */
+enum sha_alg {
+     SHA_1 = 1,
+     SHA_256
+   };
+
+/**\struct sha_ctx
+ * The state of a SHA-1 or SHA-256 hash.
+ */
+struct sha_ctx {
+       enum sha_alg alg;                    /** which algorithm */
+       DWORD        state [8];              /** the chaining state; 5 words for SHA-1 */
+       UINT64       count;                  /** the number of bytes hashed so far */
+       BYTE         buf [SHA_BLOCK_SIZE];   /** a partial block */
+     };
+
+extern void        sha_init   (struct sha_ctx *ctx, enum sha_alg alg);
+extern void        sha_update (struct sha_ctx *ctx, const void *data, size_t len);
+extern size_t      sha_final  (struct sha_ctx *ctx, BYTE *digest);
+extern size_t      sha_digest_size (enum sha_alg alg);
+extern const char *sha_name   (enum sha_alg alg);
+extern char       *sha_hex    (const BYTE *digest, size_t len, char *buf);
+
+#endif /* _SHA_H */
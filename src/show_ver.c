@@ -1,7 +1,13 @@
 /** \file    show_ver.c
  *  \ingroup Misc
  *  \brief
- *    Interface for GetFileVersionInfo(); Retrieves VERSIONINFO from PE-files.
+ *    Retrieves VERSIONINFO from PE-files.
+ *
+ *    The \c RT_VERSION resource is found with \c pe_get_resource() in the
+ *    mapped file and parsed here; without \c GetFileVersionInfo() and
+ *    \c VerQueryValue(). Everything is bounds-checked and no global
+ *    state is used. Hence \c get_PE_version_info() can be called from
+ *    worker threads.
  */
 
 /*
@@ -24,67 +30,10 @@
  * by Gisle Vanem <gvanem@yahoo.no> August 2011.
  *
  * Use at your own risk!
- *
- * Note: Must be compiled as C++ in MSVC.
  */
 
 #include "envtool.h"
-
-struct VS_VERSIONINFO {
-       WORD              wLength;
-       WORD              wValueLength;
-       WORD              wType;
-       WCHAR             szKey[1];
-       WORD              Padding1[1];
-       VS_FIXEDFILEINFO  Value;
-       WORD              Padding2[1];
-       WORD              Children[1];
-     };
-
-struct String {
-       WORD          wLength;
-       WORD          wValueLength;
-       WORD          wType;
-       WCHAR         szKey[1];
-       WORD          Padding[1];
-       WORD          Value[1];
-     };
-
-struct StringTable {
-       WORD          wLength;
-       WORD          wValueLength;
-       WORD          wType;
-       WCHAR         szKey[1];
-       WORD          Padding[1];
-       struct String Children[1];
-     };
-
-struct StringFileInfo {
-       WORD               wLength;
-       WORD               wValueLength;
-       WORD               wType;
-       WCHAR              szKey[1];
-       WORD               Padding[1];
-       struct StringTable Children[1];
-     };
-
-struct Var {
-       WORD       wLength;
-       WORD       wValueLength;
-       WORD       wType;
-       WCHAR      szKey[1];
-       WORD       Padding[1];
-       DWORD      Value[1];
-     };
-
-struct VarFileInfo {
-       WORD       wLength;
-       WORD       wValueLength;
-       WORD       wType;
-       WCHAR      szKey[1];
-       WORD       Padding[1];
-       struct Var Children[1];
-     };
+#include "pe.h"
 
 /* ----- VS_VERSION.dwFileFlags ----- */
 #define S_VS_FFI_SIGNATURE        "VS_FFI_SIGNATURE"
@@ -99,64 +48,56 @@ struct VarFileInfo {
 #define S_VS_FF_INFOINFERRED      "VS_FF_INFOINFERRED"
 #define S_VS_FF_SPECIALBUILD      "VS_FF_SPECIALBUILD"
 
-static DWORD last_err = 0;
-static BOOL  print_it = FALSE;
-
-#define VER_ERROR(fname)  do {                                                  \
-                            last_err = GetLastError();                          \
-                            DEBUGF (1, "Unable to access file \"%s\":\n  %s\n", \
-                                    fname, win_strerror(last_err));             \
-                          } while (0)
-
-static char *trace_buf  = NULL;
-static char *trace_head = NULL;
-
-char *get_PE_version_info_buf (void)
-{
-  return (trace_buf);
-}
-
-void get_PE_version_info_free (void)
-{
-  FREE (trace_buf);
-  trace_buf = trace_head = NULL;
-}
+/**\struct ver_trace
+ * The text collected by \c ver_printf().
+ */
+struct ver_trace {
+       char   *buf;
+       size_t  len;
+       size_t  size;
+     };
 
 #if defined(__POCC__)
-  static _CRTCHK(printf,1,2) void do_printf (const char *fmt, ...);
+  static _CRTCHK(printf,2,3) void ver_printf (struct ver_trace *t, const char *fmt, ...);
 #else
-  static void do_printf (_Printf_format_string_ const char *fmt, ...) ATTR_PRINTF (1,2);
+  static void ver_printf (struct ver_trace *t, _Printf_format_string_ const char *fmt, ...) ATTR_PRINTF (2,3);
 #endif
 
-static void do_printf (const char *fmt, ...)
+/**
+ * Append to the trace-text. Does nothing if \c t is NULL.
+ */
+static void ver_printf (struct ver_trace *t, const char *fmt, ...)
 {
-  static  size_t left = 1000;
-  static  size_t size = 1000;
   va_list args;
+  size_t  left;
+  int     len;
 
-  if (!print_it)
+  if (!t)
      return;
 
-  if (!trace_buf || left < 100)
+  while (1)
   {
-    size_t delta = trace_head - trace_buf;
-    if (left < 100)
-         size *= 2;
-    else size = 1000;
-    trace_buf = (char*) REALLOC (trace_buf, size);
-    trace_head = trace_buf + delta;
+    left = t->size - t->len;
+    if (left > 1)
+    {
+      va_start (args, fmt);
+      len = vsnprintf (t->buf + t->len, left, fmt, args);
+      va_end (args);
+      if (len >= 0 && (size_t)len < left)
+      {
+        t->len += len;
+        return;
+      }
+    }
+    if (t->size >= 100000)  /* Some old CRTs returns -1 on truncation; give up */
+       return;
+    t->size = t->size ? 2*t->size : 1000;
+    t->buf  = REALLOC (t->buf, t->size);
   }
-
-  va_start (args, fmt);
-  left = size - (trace_head - trace_buf);
-  trace_head += vsnprintf (trace_head, left, fmt, args);
-  left = size - (trace_head - trace_buf);
-  va_end (args);
 }
 
-static const char *show_file_flags (DWORD dwFileFlags)
+static const char *show_file_flags (DWORD dwFileFlags, char *s)
 {
-  static char s[200];
   int pos = 0;
 
   s[pos] = '\0';
@@ -346,10 +287,8 @@ static const char *show_file_type (DWORD type)
 #define S_VFT2_FONT_VECTOR     "VFT2_FONT_VECTOR"
 #define S_VFT2_FONT_TRUETYPE   "VFT2_FONT_TRUETYPE"
 
-static const char *show_file_subtype (DWORD dwFileType, DWORD dwFileSubtype)
+static const char *show_file_subtype (DWORD dwFileType, DWORD dwFileSubtype, char *s)
 {
-  static char s[50];
-
   s[0] = '\0';
 
   switch (dwFileType)
@@ -401,187 +340,266 @@ static const char *show_file_subtype (DWORD dwFileType, DWORD dwFileSubtype)
   return (s);
 }
 
-static void show_FIXEDFILEINFO (const VS_FIXEDFILEINFO *pValue, struct ver_info *ver_p)
+static void show_FIXEDFILEINFO (const VS_FIXEDFILEINFO *pValue, struct ver_info *ver_p,
+                                struct ver_trace *t)
 {
-  ASSERT (VS_FFI_SIGNATURE == pValue->dwSignature);
-  ASSERT (VS_FFI_STRUCVERSION == pValue->dwStrucVersion);
+  char flags [200], subtype [50];
 
   ver_p->val_1 = (UINT) (pValue->dwFileVersionMS >> 16);
   ver_p->val_2 = (UINT) (pValue->dwFileVersionMS & 0xFFFF);
   ver_p->val_3 = (UINT) (pValue->dwFileVersionLS >> 16);
   ver_p->val_4 = (UINT) (pValue->dwFileVersionLS & 0xFFFF);
 
-  do_printf ("  Signature:      0x%08lX\n", (u_long)pValue->dwSignature);
-  do_printf ("  StrucVersion:   %u.%u\n", HIWORD(pValue->dwStrucVersion), LOWORD(pValue->dwStrucVersion));
-  do_printf ("  FileVersion:    %u.%u.%u.%u\n", ver_p->val_1, ver_p->val_2, ver_p->val_3, ver_p->val_4);
+  ver_printf (t, "  Signature:      0x%08lX\n", (u_long)pValue->dwSignature);
+  ver_printf (t, "  StrucVersion:   %u.%u\n", HIWORD(pValue->dwStrucVersion), LOWORD(pValue->dwStrucVersion));
+  ver_printf (t, "  FileVersion:    %u.%u.%u.%u\n", ver_p->val_1, ver_p->val_2, ver_p->val_3, ver_p->val_4);
 
-  do_printf ("  ProductVersion: %u.%u.%u.%u\n", HIWORD(pValue->dwProductVersionMS),
-                                                LOWORD(pValue->dwProductVersionMS),
-                                                HIWORD(pValue->dwProductVersionLS),
-                                                LOWORD(pValue->dwProductVersionLS));
+  ver_printf (t, "  ProductVersion: %u.%u.%u.%u\n", HIWORD(pValue->dwProductVersionMS),
+                                                    LOWORD(pValue->dwProductVersionMS),
+                                                    HIWORD(pValue->dwProductVersionLS),
+                                                    LOWORD(pValue->dwProductVersionLS));
 
-  do_printf ("  FileFlagsMask:  0x%lX\n", (u_long)pValue->dwFileFlagsMask);
+  ver_printf (t, "  FileFlagsMask:  0x%lX\n", (u_long)pValue->dwFileFlagsMask);
 
   if (pValue->dwFileFlags)
-       do_printf ("  FileFlags:      0x%lX (%s)\n", (u_long)pValue->dwFileFlags, show_file_flags(pValue->dwFileFlags));
-  else do_printf ("  FileFlags:      0\n");
+       ver_printf (t, "  FileFlags:      0x%lX (%s)\n", (u_long)pValue->dwFileFlags,
+                   show_file_flags(pValue->dwFileFlags, flags));
+  else ver_printf (t, "  FileFlags:      0\n");
+
+  ver_printf (t, "  FileOS:         %s\n", show_file_OS (pValue->dwFileOS));
+  ver_printf (t, "  FileType:       %s\n", show_file_type (pValue->dwFileType));
+  ver_printf (t, "  FileSubType:    %s\n", show_file_subtype (pValue->dwFileType, pValue->dwFileSubtype, subtype));
+  ver_printf (t, "  FileDate:       %lX.%lX\n", (u_long)pValue->dwFileDateMS, (u_long)pValue->dwFileDateLS);
+}
+
+/**\struct ver_node
+ * One node in the \c VS_VERSIONINFO tree. They all have this layout:
+ * \code
+ *   WORD  wLength;       length of the node including the children
+ *   WORD  wValueLength;  length of Value; in WCHARs if wType == 1
+ *   WORD  wType;         1 = text, 0 = binary
+ *   WCHAR szKey[];       0-terminated
+ *   WORD  Padding[];     to a 32-bit boundary
+ *   Value
+ *   WORD  Padding[];     to a 32-bit boundary
+ *   Children
+ * \endcode
+ */
+struct ver_node {
+       const WORD *key;        /** the \c szKey */
+       size_t      key_len;    /** it's length in WCHARs without the 0 */
+       WORD        type;       /** the \c wType */
+       WORD        value_len;  /** the \c wValueLength */
+       const BYTE *value;      /** the \c Value */
+       const BYTE *children;   /** the first child */
+       const BYTE *end;        /** the end of this node and it's children */
+       const BYTE *next;       /** the next sibling */
+     };
 
-  do_printf ("  FileOS:         %s\n", show_file_OS (pValue->dwFileOS));
-  do_printf ("  FileType:       %s\n", show_file_type (pValue->dwFileType));
-  do_printf ("  FileSubType:    %s\n", show_file_subtype (pValue->dwFileType, pValue->dwFileSubtype));
-  do_printf ("  FileDate:       %lX.%lX\n", (u_long)pValue->dwFileDateMS, (u_long)pValue->dwFileDateLS);
+/**
+ * Round up \c p to a 32-bit boundary relative to \c base.
+ */
+#define VER_ALIGN(base, p)  ((base) + (((p) - (base) + 3) & ~3))
+
+/**
+ * Parse the node at \c p. The node must be entirely before \c end.
+ */
+static BOOL ver_node_parse (const BYTE *base, const BYTE *p, const BYTE *end, struct ver_node *n)
+{
+  const BYTE *q;
+  size_t      value_size;
+  WORD        length;
+
+  if (p >= end || end - p < 3*sizeof(WORD))
+     return (FALSE);
+
+  memcpy (&length, p, sizeof(length));
+  memcpy (&n->value_len, p + 2, sizeof(n->value_len));
+  memcpy (&n->type, p + 4, sizeof(n->type));
+
+  if (length < 3*sizeof(WORD) || length > end - p)
+     return (FALSE);
+
+  n->end = p + length;
+  n->key = (const WORD*) (p + 6);
+  for (q = p + 6; q + 2 <= n->end && (q[0] | q[1]); q += 2)
+      ;
+  if (q + 2 > n->end)   /* no 0-terminator */
+     return (FALSE);
+
+  n->key_len = (q - (p + 6)) / 2;
+  n->value   = VER_ALIGN (base, q + 2);
+  if (n->value > n->end)
+     n->value = n->end;
+
+  value_size = (n->type == 1) ? 2 * n->value_len : n->value_len;
+  if (value_size > (size_t)(n->end - n->value))
+     value_size = n->end - n->value;
+
+  n->children = VER_ALIGN (base, n->value + value_size);
+  if (n->children > n->end)
+     n->children = n->end;
+  n->next = VER_ALIGN (base, n->end);
+  return (TRUE);
 }
 
+/**
+ * Compare the key of a node with an ASCII string.
+ */
+static BOOL ver_key_is (const struct ver_node *n, const char *key)
+{
+  size_t i;
 
-#define ROUND_OFS(a,b,r)    (((BYTE*)(b) - (BYTE*)(a) + ((r)-1)) & ~((r)-1))
-#define ROUND_POS(b, a, r)  (((BYTE*)(a)) + ROUND_OFS(a,b,r))
+  for (i = 0; i < n->key_len; i++)
+      if (key[i] == '\0' || n->key[i] != (WORD)key[i])
+         return (FALSE);
+  return (key[i] == '\0');
+}
 
-static void get_PE_version_data (const void *pVer, DWORD size, struct ver_info *ver_p)
+/**
+ * Convert the UTF-16 string \c w (at most \c len characters) for printing.
+ */
+static const char *ver_wstr (const WORD *w, size_t len, char *buf, size_t size)
 {
-  /* Interpret the VS_VERSIONINFO header pseudo-struct.
-   */
-  const struct VS_VERSIONINFO *pVS     = (const struct VS_VERSIONINFO*) pVer;
-  const BYTE                  *pVS_max = (const BYTE*) pVer + size;
-  const BYTE                  *pVt;
-  const VS_FIXEDFILEINFO      *pValue;
-  const struct StringFileInfo *pSFI;
+  size_t i, n = 0;
 
-#if 0
-  BYTE* nEndRaw   = ROUND_POS ((((BYTE*)pVer) + size), pVer, 4);
-  BYTE* nEndNamed = ROUND_POS ((((BYTE*) pVS) + pVS->wLength), pVS, 4);
+  for (i = 0; i < len && w[i]; i++)
+      ;
+  len = i;
 
-  ASSERT (nEndRaw == nEndNamed); /* size reported from GetFileVersionInfoSize is much padded for some reason. */
+#if PE_WIN32
+  if (len > 0)
+     n = WideCharToMultiByte (CP_ACP, 0, (const WCHAR*)w, (int)len, buf, (int)size-1, NULL, NULL);
+#else
+  for (i = 0; i < len && n < size-1; i++)
+      buf[n++] = (w[i] < 0x80) ? (char)w[i] : '?';
 #endif
 
-  ASSERT (!wcscmp(pVS->szKey, L"VS_VERSION_INFO"));
-  do_printf (" (type:%d)\n", pVS->wType);
+  buf[n] = '\0';
+  return (buf);
+}
 
-  pVt = (const BYTE*) &pVS->szKey [wcslen(pVS->szKey)+1];
+/**
+ * Interpret the \c VS_VERSIONINFO in the \c size bytes at \c data.
+ */
+static BOOL get_PE_version_data (const BYTE *data, DWORD size, struct ver_info *ver_p,
+                                 struct ver_trace *t)
+{
+  struct ver_node vs, sfi, st, str, var;
+  const BYTE     *end = data + size;
+  const BYTE     *p, *q, *r;
+  char            key [100], val [500];
 
-  pValue = (const VS_FIXEDFILEINFO *) ROUND_POS (pVt, pVS, 4);
+  if (!ver_node_parse(data, data, end, &vs) || !ver_key_is(&vs, "VS_VERSION_INFO"))
+     return (FALSE);
 
-  if (pVS->wValueLength)
-     show_FIXEDFILEINFO (pValue, ver_p); /* Show the 'Value' element */
+  ver_printf (t, " (type:%d)\n", vs.type);
 
-  /* Iterate over the 'Children' elements of VS_VERSIONINFO (either a
-   * 'struct StringFileInfo' or 'struct VarFileInfo').
+  /* Show the 'Value' element.
    */
-  pSFI = (struct StringFileInfo*) ROUND_POS (((BYTE*)pValue) + pVS->wValueLength, pValue, 4);
+  if (vs.value_len >= sizeof(VS_FIXEDFILEINFO) && vs.end - vs.value >= (int)sizeof(VS_FIXEDFILEINFO))
+  {
+    VS_FIXEDFILEINFO ffi;
 
-  for (; ((const BYTE*)pSFI) < (((const BYTE*)pVS) + pVS->wLength);
-         pSFI = (const struct StringFileInfo*) ROUND_POS ((((const BYTE*)pSFI) + pSFI->wLength), pSFI, 4))
-  {                             /* 'struct StringFileInfo' or 'struct VarFileInfo' */
-    if (!wcscmp(pSFI->szKey, L"StringFileInfo"))
-    {
-      const struct StringTable *pST;
-      const struct String      *pS;
-      const wchar_t            *psVal;
+    memcpy (&ffi, vs.value, sizeof(ffi));
+    if (ffi.dwSignature == VS_FFI_SIGNATURE)
+       show_FIXEDFILEINFO (&ffi, ver_p, t);
+  }
 
-      /* The current child is a 'struct StringFileInfo' element
-       */
-      ASSERT (1 == pSFI->wType);
-      ASSERT (!pSFI->wValueLength);
+  if (!t)
+     return (TRUE);
 
-      /* Iterate through the 'struct StringTable' elements of 'struct StringFileInfo'
+  /* Iterate over the 'Children' elements of VS_VERSIONINFO (either a
+   * 'StringFileInfo' or 'VarFileInfo').
+   */
+  for (p = vs.children; ver_node_parse(data, p, vs.end, &sfi); p = sfi.next)
+  {
+    if (ver_key_is(&sfi, "StringFileInfo"))
+    {
+      /* Iterate through the 'StringTable' elements of 'StringFileInfo'.
        */
-      pST = (const struct StringTable*) ROUND_POS (&pSFI->szKey[wcslen(pSFI->szKey)+1], pSFI, 4);
-
-      for (; (const BYTE*)pST < (const BYTE*)pSFI + pSFI->wLength;
-            pST = (const struct StringTable*) ROUND_POS ((BYTE*)pST + pST->wLength, pST, 4))
+      for (q = sfi.children; ver_node_parse(data, q, sfi.end, &st); q = st.next)
       {
-        do_printf ("  LangID:         %" WIDESTR_FMT "\n", pST->szKey);
-
-        ASSERT (!pST->wValueLength);
+        ver_printf (t, "  LangID:         %s\n", ver_wstr(st.key, st.key_len, key, sizeof(key)));
 
-        /* Iterate through the String elements of 'struct StringTable'
+        /* Iterate through the 'String' elements of 'StringTable'.
          */
-        pS = (const struct String*) ROUND_POS (&pST->szKey[wcslen(pST->szKey) + 1], pST, 4);
-
-        for (; (const BYTE*)pS < (const BYTE*)pST + pST->wLength;
-             pS = (const struct String*) ROUND_POS ((BYTE*)pS + pS->wLength, pS, 4))
+        for (r = st.children; ver_node_parse(data, r, st.end, &str); r = str.next)
         {
-          psVal = (const wchar_t*) ROUND_POS (&pS->szKey[wcslen(pS->szKey)+1], pS, 4);
-          do_printf ("  %-17S: %.*S\n", pS->szKey, (int)pS->wValueLength, psVal);   /* print <sKey> : <sValue> */
+          ver_wstr (str.key, str.key_len, key, sizeof(key));
+          ver_wstr ((const WORD*)str.value, (str.children - str.value) / 2, val, sizeof(val));
+          ver_printf (t, "  %-17s: %s\n", key, val);   /* print <sKey> : <sValue> */
         }
       }
     }
     else
     {
-      const struct VarFileInfo *pVFI = (const struct VarFileInfo*) pSFI;
-      const struct Var         *pV;
-
-      /* The current child is a 'struct VarFileInfo' element */
-      ASSERT (1 == pSFI->wType); /* ?? it just seems to be this way... */
-
-      ASSERT (!wcscmp(pVFI->szKey, L"VarFileInfo"));
-      ASSERT (!pVFI->wValueLength);
-
-      /* Iterate through the Var elements of 'struct VarFileInfo'
+      /* Iterate through the 'Var' elements of 'VarFileInfo'
        * (there should be only one, but just in case...)
        */
-      pV = (const struct Var*) ROUND_POS (&pVFI->szKey[wcslen(pVFI->szKey)+1], pVFI, 4);
-
-      for (; (const BYTE*)pV < (const BYTE*)pVFI + pVFI->wLength;
-           pV = (const struct Var*) ROUND_POS ((const BYTE*)pV + pV->wLength, pV, 4))
+      for (q = sfi.children; ver_node_parse(data, q, sfi.end, &var); q = var.next)
       {
-        const WORD *wpos, *pwV;
+        const BYTE *wpos, *wend = var.value + var.value_len;
+
+        if (wend > var.end)
+           wend = var.end;
 
-        do_printf ("  %" WIDESTR_FMT ":    ", pV->szKey);
+        ver_printf (t, "  %s:    ", ver_wstr(var.key, var.key_len, key, sizeof(key)));
 
         /* Iterate through the array of pairs of 16-bit language ID values that make up
          * the standard 'Translation' VarFileInfo element.
          */
-        pwV = (const WORD*) ROUND_POS (&pV->szKey[wcslen(pV->szKey)+1], pV, 4);
-
-        for (wpos = pwV; (const BYTE*)wpos < (const BYTE*)pwV + pV->wValueLength; wpos += 2)
+        for (wpos = var.value; wpos + 2*sizeof(WORD) <= wend; wpos += 2*sizeof(WORD))
         {
-          WORD w1 = wpos[0];
-          WORD w2 = wpos[1];
-          do_printf ("%04X%04X ", w1, w2);
-        }
+          WORD w1, w2;
 
-        if ((const BYTE*)pV >= pVS_max)
-        {
-          do_printf ("Bogus ver-data.\n");
-          return;
+          memcpy (&w1, wpos, sizeof(w1));
+          memcpy (&w2, wpos + sizeof(w1), sizeof(w2));
+          ver_printf (t, "%04X%04X ", w1, w2);
         }
-        do_printf ("\n");
+        ver_printf (t, "\n");
       }
     }
   }
-  ASSERT ((const BYTE*)pSFI == ROUND_POS ((const BYTE*)pVS + pVS->wLength, pVS, 4));
+  return (TRUE);
 }
 
-int get_PE_version_info (const char *file, struct ver_info *ver)
+/**
+ * Get the version information of a PE-file.
+ *
+ * \param[in]  file   the PE-file.
+ * \param[out] ver    the \c FileVersion from the \c VS_FIXEDFILEINFO.
+ * \param[out] trace  if non-NULL, all the version information as text.
+ *                    The caller must \c FREE() it.
+ *
+ * \retval 1  if \c file has a \c RT_VERSION resource.
+ */
+int get_PE_version_info (const char *file, struct ver_info *ver, char **trace)
 {
-  DWORD  dummy = 0;
-  DWORD  size = GetFileVersionInfoSizeA (file, &dummy);
-  void  *ver_data;
+  struct pe_file    pe;
+  struct ver_trace  t, *tp = trace ? &t : NULL;
+  const BYTE       *data;
+  DWORD             size;
+  int               rc = 0;
 
-  last_err = 0;
   memset (ver, 0, sizeof(*ver));
+  memset (&t, 0, sizeof(t));
+  if (trace)
+     *trace = NULL;
 
-  if (!size)
-  {
-    VER_ERROR (file);
-    return (0);
-  }
-
-  DEBUGF (1, "size: %lu\n", (u_long)size);
+  if (!pe_open(&pe, file))
+     return (0);
 
-  ver_data = CALLOC (size, 1);
-  if (!GetFileVersionInfoA(file, 0, size, ver_data))
+  data = pe_get_resource (&pe, PE_RT_VERSION, &size);
+  if (data)
   {
-    VER_ERROR (file);
-    FREE (ver_data);
-    return (0);
+    ver_printf (tp, "VERSIONINFO: ");
+    rc = get_PE_version_data (data, size, ver, tp);
   }
+  pe_close (&pe);
 
-  print_it = (opt.verbose >= 1);
-
-  do_printf ("VERSIONINFO: ");
-  get_PE_version_data (ver_data, size, ver);
-
-  FREE (ver_data);
-  return (1);
+  if (trace && rc)
+       *trace = t.buf;
+  else FREE (t.buf);
+  return (rc);
 }
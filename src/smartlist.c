@@ -181,6 +181,29 @@ void smartlist_add (smartlist_t *sl, void *element)
   sl->list [sl->num_used++] = element;
 }
 
+/*
+ * Insert 'element' as the new 'idx'-th element of 'sl', moving all
+ * elements previously at 'idx' or later forward one space.
+ * Used with 'smartlist_bsearch_idx()' to keep a list sorted.
+ */
+void smartlist_insert (smartlist_t *sl, int idx, void *element)
+{
+  ASSERT (sl);
+  ASSERT_VAL (sl);
+  ASSERT (idx >= 0);
+  ASSERT (idx <= sl->num_used);
+
+  if (idx == sl->num_used)
+  {
+    smartlist_add (sl, element);
+    return;
+  }
+  smartlist_ensure_capacity (sl, 1 + (size_t)sl->num_used);
+  memmove (sl->list+idx+1, sl->list+idx, (sl->num_used - idx) * sizeof(void*));
+  sl->num_used++;
+  sl->list [idx] = element;
+}
+
 /*
  * Remove the 'idx'-th element of 'sl':
  *   if 'idx' is not the last element, swap the last element of 'sl'
@@ -282,32 +305,38 @@ void smartlist_make_uniq (smartlist_t *sl, smartlist_sort_func compare, void (*f
   }
 }
 
+struct read_file_ctx {
+       smartlist_t         *sl;
+       smartlist_parse_func parse;
+     };
+
+static void read_file_line (char *line, size_t len, void *arg)
+{
+  struct read_file_ctx *ctx = (struct read_file_ctx*) arg;
+  const char           *p = str_ltrim (line);
+
+  if (*p != '#' && *p != ';')
+     (*ctx->parse) (ctx->sl, line, len);
+}
+
 /*
  * Open a file and return parsed lines as a smartlist.
+ * The file is read in one go by 'file_read_lines()'. The 'parse' function
+ * gets each line 0-terminated and without the newline.
  */
 smartlist_t *smartlist_read_file (const char *file, smartlist_parse_func parse)
 {
-  smartlist_t *sl;
-  FILE *f = fopen (file, "r");
-
-  if (!f)
-     return (NULL);
+  struct read_file_ctx ctx;
 
-  sl = smartlist_new();
+  ctx.sl    = smartlist_new();
+  ctx.parse = parse;
 
-  while (sl)
+  if (file_read_lines(file, read_file_line, &ctx) < 0)
   {
-    char buf[500], *p;
-
-    if (!fgets(buf,sizeof(buf)-1,f))   /* EOF */
-       break;
-
-    p = str_ltrim (buf);
-    if (*p != '#' && *p != ';')
-       (*parse) (sl, buf);
+    smartlist_free (ctx.sl);
+    return (NULL);
   }
-  fclose (f);
-  return (sl);
+  return (ctx.sl);
 }
 
 /*
@@ -365,7 +394,17 @@ void smartlist_sort (smartlist_t *sl, smartlist_sort_func compare)
      qsort (sl->list, sl->num_used, sizeof(void*), (CmpFunc)compare);
 }
 
-#if defined(NOT_USED_YET)
+/*
+ * Sort the members of 'sl' on the string 'key_func' returns for each.
+ * Like 'smartlist_sort()' with a 'strcmp()' comparator (or 'stricmp()' if
+ * 'flags' has 'STR_SORT_NOCASE'). But each key is case-folded only once.
+ */
+void smartlist_sort_str (smartlist_t *sl, str_sort_key_func key_func, unsigned flags)
+{
+  ASSERT (sl);
+  str_sort (sl->list, sl->num_used, key_func, flags);
+}
+
 /*
  * Assuming the members of 'sl' are in order, return the index of the
  * member that matches 'key'.  If no member matches, return the index of
@@ -522,4 +561,3 @@ void *smartlist_bsearch (const smartlist_t *sl, const void *key,
 
   return (found ? smartlist_get(sl, idx) : NULL);
 }
-#endif  /* NOT_USED_YET */
@@ -1,11 +1,13 @@
 #ifndef _SMARTLIST_H
 #define _SMARTLIST_H
 
+#include "strsort.h"
+
 typedef struct smartlist_t smartlist_t;  /* Opaque struct; defined in smartlist.c */
 
 typedef int  (*smartlist_sort_func) (const void **a, const void **b);
 typedef int  (*smartlist_compare_func) (const void *key, const void **member);
-typedef void (*smartlist_parse_func) (smartlist_t *sl, const char *line);
+typedef void (*smartlist_parse_func) (smartlist_t *sl, char *line, size_t len);
 
 
 int          smartlist_len (const smartlist_t *sl);
@@ -18,6 +20,7 @@ void  smartlist_free (smartlist_t *sl);
 void  smartlist_free_all (smartlist_t *sl);
 void  smartlist_ensure_capacity (smartlist_t *sl, size_t num);
 void  smartlist_add (smartlist_t *sl, void *element);
+void  smartlist_insert (smartlist_t *sl, int idx, void *element);
 void  smartlist_del (smartlist_t *sl, int idx);
 void  smartlist_del_keeporder (smartlist_t *sl, int idx);
 void  smartlist_append (smartlist_t *sl1, const smartlist_t *sl2);
@@ -29,6 +32,7 @@ int   smartlist_duplicates (smartlist_t *sl, smartlist_sort_func compare);
 void  smartlist_make_uniq (smartlist_t *sl, smartlist_sort_func compare, void (*free_fn)(void *a));
 
 void  smartlist_sort (smartlist_t *sl, smartlist_sort_func compare);
+void  smartlist_sort_str (smartlist_t *sl, str_sort_key_func key_func, unsigned flags);
 
 int   smartlist_bsearch_idx (const smartlist_t *sl, const void *key,
                              smartlist_compare_func compare, int *found_out);
@@ -0,0 +1,458 @@
+/**\file    sniff.c
+ * \ingroup Misc
+ * \brief
+ *   Classify files by reading their header once.
+ *
+ * \c check_if_PE(), \c check_if_zip(), \c check_if_gzip(), \c check_if_shebang()
+ * and \c get_man_link() all look at the first few bytes of a file. Instead of
+ * each of these opening and reading the file again, \c sniff_file() reads the
+ * first \c SNIFF_HEADER_SIZE bytes once and stores what it found in a
+ * \c file_sniff record. The records are kept until \c sniff_exit() and are
+ * keyed on the file-name together with it's size and modification-time.
+ * So asking again about an unchanged file costs only a \c stat().
+ *
+ * \c sniff_file() prints nothing and is thread-safe. Hence many files can
+ * be sniffed in parallel by \c sniff_prefetch(). A record is never changed
+ * once it's in \c sniff_records; a file that has changed gets a new record
+ * and the old one is kept in \c sniff_retired until \c sniff_exit(). So
+ * another thread can still use it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <windows.h>
+
+#include "envtool.h"
+#include "smartlist.h"
+#include "tasks.h"
+#include "inflate.h"
+#include "pe.h"
+#include "sniff.h"
+
+#ifndef IMAGE_FILE_MACHINE_ALPHA
+#define IMAGE_FILE_MACHINE_ALPHA 0x123456
+#endif
+
+static smartlist_t     *sniff_records = NULL;  /**< sorted on \c file */
+static smartlist_t     *sniff_retired = NULL;  /**< replaced records */
+static CRITICAL_SECTION sniff_crit;
+
+static int sniff_compare (const void *key, const void **member)
+{
+  const struct file_sniff *fs = *(const struct file_sniff**) member;
+
+  return stricmp ((const char*)key, fs->file);
+}
+
+static void sniff_free (void *e)
+{
+  struct file_sniff *fs = (struct file_sniff*) e;
+
+  FREE (fs->file);
+  FREE (fs->so_link);
+  FREE (fs);
+}
+
+static void sniff_init (void)
+{
+  if (sniff_records)
+     return;
+  InitializeCriticalSection (&sniff_crit);
+  sniff_retired = smartlist_new();
+  sniff_records = smartlist_new();
+}
+
+/**
+ * Free all the records.
+ */
+void sniff_exit (void)
+{
+  if (!sniff_records)
+     return;
+
+  DEBUGF (2, "Sniffed %d files.\n", smartlist_len(sniff_records));
+  smartlist_wipe (sniff_records, sniff_free);
+  smartlist_free (sniff_records);
+  smartlist_wipe (sniff_retired, sniff_free);
+  smartlist_free (sniff_retired);
+  sniff_records = sniff_retired = NULL;
+  DeleteCriticalSection (&sniff_crit);
+}
+
+/**
+ * Return the target of a ".so real-file-name" in \c line.
+ * This is typical for CygWin man-pages.
+ */
+static char *sniff_so_link (const char *line, size_t len)
+{
+  const char *p, *end = line + len;
+  char        name [_MAX_PATH];
+  size_t      i = 0;
+
+  if (len < 5 || strncmp(line, ".so ", 4))
+     return (NULL);
+
+  for (p = line + 4; p < end && (*p == ' ' || *p == '\t'); p++)
+      ;
+  while (p < end && !isspace((int)*p) && i < sizeof(name)-1)
+     name[i++] = *p++;
+  name[i] = '\0';
+  return (i > 0 ? STRDUP(name) : NULL);
+}
+
+/**
+ * Check the \c "MZ" and \c "PE\0\0" signatures in \c buf.
+ * The headers must be entirely inside \c buf.
+ */
+static void sniff_PE (struct file_sniff *fs, const BYTE *buf, size_t len)
+{
+  struct pe_file pe;
+
+  if (pe_parse(&pe, buf, len))
+  {
+    fs->flags |= SNIFF_EXE | SNIFF_PE;
+    fs->bits = pe.bits;
+    fs->pe_checksum = pe.header_sum;
+  }
+  else if (pe.dos)
+  {
+    const IMAGE_FILE_HEADER *fil_hdr = (const IMAGE_FILE_HEADER*) pe.dos;
+
+    fs->flags |= SNIFF_EXE;
+
+    if (fil_hdr->Machine != IMAGE_FILE_MACHINE_AMD64 &&
+        fil_hdr->Machine != IMAGE_FILE_MACHINE_ALPHA &&
+        fil_hdr->Machine != IMAGE_FILE_MACHINE_IA64)
+      fs->bits = bit_16;  /* Just a guess */
+  }
+}
+
+/**
+ * Check for a she-bang on the 1st line in \c buf.
+ * Accepts "#!/xx" or "#! /xx".
+ */
+static void sniff_shebang (struct file_sniff *fs, const char *buf, size_t len)
+{
+  char  *shebang = fs->shebang;
+  char  *p;
+  size_t i;
+
+  if (len < 3 || buf[0] != '#' || buf[1] != '!')
+     return;
+
+  i = (buf[2] == ' ') ? 3 : 2;
+  shebang[0] = '#';
+  shebang[1] = '!';
+  _strlcpy (shebang+2, buf+i, min(len-i, sizeof(fs->shebang)-3) + 1);
+
+  if (strncmp(shebang, "#!/", 3))
+  {
+    shebang[0] = '\0';
+    return;
+  }
+
+  /* If it's a Unix file with 2 "\r\r" in the 'shebang[]' buffer,
+   * we cannot use 'strip_nl()'. That will only remove the last
+   * '\r'. Look for the 1st '\n' or '\r' and remove them.
+   */
+  p = strchr (shebang, '\n');
+  if (p)
+     *p = '\0';
+  p = strchr (shebang, '\r');
+  if (p)
+     *p = '\0';
+
+  /* Drop any space; this is usually arguments for this
+   * specific interpreter.
+   */
+  p = strchr (shebang, ' ');
+  if (strncmp(shebang, "#!/usr/bin/env ",15) && p)
+     *p = '\0';
+
+  fs->flags |= SNIFF_SHEBANG;
+}
+
+/**
+ * Read the header of \c file and classify it.
+ * Called without holding \c sniff_crit.
+ */
+static void sniff_read (const char *file, struct file_sniff *fs)
+{
+  static const BYTE zip_hdr[4]   = { 'P', 'K', 3, 4 };
+  static const BYTE gzip_hdr1[4] = { 0x1F, 0x8B, 0x08, 0x08 };
+  static const BYTE gzip_hdr2[4] = { 0x1F, 0x8B, 0x08, 0x00 };
+  BYTE   buf [SNIFF_HEADER_SIZE+1];
+  size_t len = 0;
+  FILE  *f = fopen (file, "rb");
+
+  fs->bits = bit_unknown;
+  if (!f)
+     return;
+
+  len = fread (buf, 1, SNIFF_HEADER_SIZE, f);
+  fclose (f);
+  buf[len] = '\0';
+
+  if (len < 4)
+     return;
+
+  if (buf[0] == 'M')
+     sniff_PE (fs, buf, len);
+
+  else if (!memcmp(buf, zip_hdr, sizeof(zip_hdr)))
+     fs->flags |= SNIFF_ZIP;
+
+  else if (!memcmp(buf, gzip_hdr1, sizeof(gzip_hdr1)) || !memcmp(buf, gzip_hdr2, sizeof(gzip_hdr2)))
+  {
+    char line [_MAX_PATH+10];
+    int  line_len;
+
+    fs->flags |= SNIFF_GZIP;
+    line_len = gzip_peek (file, line, sizeof(line), TRUE);
+    if (line_len > 0)
+       fs->so_link = sniff_so_link (line, line_len);
+  }
+
+  else if (buf[0] == '#')
+     sniff_shebang (fs, (const char*)buf, len);
+
+  else
+  {
+    const char *nl = strpbrk ((const char*)buf, "\r\n");
+
+    fs->so_link = sniff_so_link ((const char*)buf, nl ? (size_t)(nl - (const char*)buf) : len);
+  }
+
+  if (fs->so_link)
+     fs->flags |= SNIFF_MAN_LINK;
+}
+
+/**
+ * Return the \c file_sniff record for \c file.
+ * The header of \c file is only read if it's not already known or if
+ * it's size or modification-time has changed since.
+ *
+ * \retval NULL  if \c file does not exist.
+ *
+ * \note The returned record is valid and unchanged until \c sniff_exit().
+ */
+const struct file_sniff *sniff_file (const char *file)
+{
+  struct file_sniff *fs;
+  struct stat        st;
+  int                idx, found;
+
+  sniff_init();
+
+  if (stat(file, &st) != 0)
+     return (NULL);
+
+  EnterCriticalSection (&sniff_crit);
+  idx = smartlist_bsearch_idx (sniff_records, file, sniff_compare, &found);
+  if (found)
+  {
+    fs = smartlist_get (sniff_records, idx);
+    if (fs->size == (UINT64)st.st_size && fs->mtime == st.st_mtime)
+    {
+      LeaveCriticalSection (&sniff_crit);
+      return (fs);
+    }
+  }
+  LeaveCriticalSection (&sniff_crit);
+
+  fs = CALLOC (1, sizeof(*fs));
+  fs->file  = STRDUP (file);
+  fs->size  = (UINT64) st.st_size;
+  fs->mtime = st.st_mtime;
+  sniff_read (file, fs);
+
+  /* Another thread could have added (or replaced) a record for 'file' meanwhile.
+   * Other threads may still use the old record; retire it.
+   */
+  EnterCriticalSection (&sniff_crit);
+  idx = smartlist_bsearch_idx (sniff_records, file, sniff_compare, &found);
+  if (found)
+  {
+    smartlist_add (sniff_retired, smartlist_get(sniff_records, idx));
+    smartlist_set (sniff_records, idx, fs);
+  }
+  else
+    smartlist_insert (sniff_records, idx, fs);
+  LeaveCriticalSection (&sniff_crit);
+  return (fs);
+}
+
+/**
+ * The job-function for \c tasks_run_list().
+ */
+static void sniff_job (void *arg)
+{
+  sniff_file ((const char*)arg);
+}
+
+/**
+ * Sniff many files in parallel. The following \c sniff_file() (or
+ * \c check_if_x()) for one of these returns without reading it again.
+ *
+ * \param[in] files  a list of file-names.
+ */
+void sniff_prefetch (smartlist_t *files)
+{
+  sniff_init();
+  tasks_run_list (files, sniff_job);
+}
+
+/**
+ * If given a 'fname' without any extension, open the 'fname' and check if
+ * there's a she-bang line on 1st line.
+ */
+const char *check_if_shebang (const char *fname)
+{
+  const struct file_sniff *fs;
+
+  /* Return NULL if 'fname' have an extension.
+   */
+  if (*get_file_ext(fname))
+     return (NULL);
+
+  fs = sniff_file (fname);
+  if (!fs || !(fs->flags & SNIFF_SHEBANG))
+     return (NULL);
+
+  DEBUGF (1, "shebang: \"%s\"\n", fs->shebang);
+  return (fs->shebang);
+}
+
+/**
+ * Check if there's a "PK" signature in header of 'fname'.
+ */
+int check_if_zip (const char *fname)
+{
+  const struct file_sniff *fs;
+  const char *ext;
+
+  /* Return 0 if extension is neither ".egg" nor ".zip"
+   */
+  ext = get_file_ext (fname);
+  if (stricmp(ext,"egg") && stricmp(ext,"zip"))
+     return (0);
+
+  fs = sniff_file (fname);
+  if (!fs || !(fs->flags & SNIFF_ZIP))
+     return (0);
+
+  DEBUGF (1, "\"%s\" is a ZIP-file.\n", fname);
+  return (1);
+}
+
+/**
+ * Check if there's a "GZIP" or "TAR.GZ" signature in header of 'fname'.
+ */
+int check_if_gzip (const char *fname)
+{
+  const struct file_sniff *fs;
+  const char *ext;
+  BOOL   is_gzip, is_tgz;
+  int    rc;
+
+  /* Accept only ".gz" or ".tgz" extensions.
+   */
+  ext = get_file_ext (fname);
+  is_gzip = (stricmp(ext,"gz") == 0);
+  is_tgz  = (stricmp(ext,"tgz") == 0 || stricmp(ext,"tar.gz") == 0);
+
+  if (!is_gzip && !is_tgz)
+  {
+    DEBUG_NL (2);
+    DEBUGF (2, "\"%s\" does have wrong extension: '%s'.\n", fname, ext);
+    return (0);
+  }
+
+  fs = sniff_file (fname);
+  rc = (fs && (fs->flags & SNIFF_GZIP));
+  DEBUG_NL (2);
+  DEBUGF (2, "\"%s\" is %sa GZIP-file.\n", fname, rc == 1 ? "": "not ");
+  return (rc);
+}
+
+/**
+ * Check if the first line of a raw or a gzipped MAN-file contains a
+ * ".so real-file-name". This is typical for CygWin man-pages.
+ * Return result as "<dir_name>/real-file-name". Which is just an
+ * assumption; the "real-file-name" can be anywhere on %MANPATH%.
+ */
+const char *get_man_link (const char *file)
+{
+  static char fqfn_name [_MAX_PATH];
+  const struct file_sniff *fs = sniff_file (file);
+  const char *base;
+  char        dir_name [_MAX_PATH+3];
+
+  if (!fs || !(fs->flags & SNIFF_MAN_LINK))
+     return (NULL);
+
+  dirname_buf (file, dir_name, sizeof(dir_name));
+  base = basename (fs->so_link);
+  DEBUG_NL (1);
+  DEBUGF (1, "get_man_link: \"%s\", dir_name: \"%s\".\n", base, dir_name);
+  snprintf (fqfn_name, sizeof(fqfn_name), "%s%c%s", dir_name, DIR_SEP, base);
+  if (opt.show_unix_paths)
+     return slashify2 (fqfn_name, fqfn_name, '/');
+  return (fqfn_name);
+}
+
+/**
+ * Check the PE-header of 'fname'. For verifying it's signature and
+ * showing the version information (if any) in it's resources.
+ */
+int check_if_PE (const char *fname, enum Bitness *bits)
+{
+  const struct file_sniff *fs = sniff_file (fname);
+  BOOL  is_exe, is_pe;
+
+  if (bits)
+     *bits = fs ? fs->bits : bit_unknown;
+
+  if (!fs)
+     return (FALSE);
+
+  is_exe = (fs->flags & SNIFF_EXE) ? TRUE : FALSE;
+  is_pe  = (fs->flags & SNIFF_PE)  ? TRUE : FALSE;
+
+  DEBUG_NL (3);
+  DEBUGF (3, "%s: is_exe: %d, is_pe: %d, is_32Bit: %d, is_64Bit: %d.\n",
+          fname, is_exe, is_pe, fs->bits == bit_32, fs->bits == bit_64);
+  return (is_exe && is_pe);
+}
+
+/**
+ * Verify the checksum of a PE-file. A \c CheckSum of 0 means "don't care"
+ * (similar to in UDP). Prints nothing; safe to call from a job
+ * in a \c task_pool.
+ *
+ * \param[in]  fname     the PE-file to check.
+ * \param[out] calc_sum  the calculated checksum (if the file was mapped).
+ * \retval TRUE if the checksum is OK or 0 ("don't care").
+ */
+BOOL sniff_PE_checksum (const char *fname, DWORD *calc_sum)
+{
+  const struct file_sniff *fs = sniff_file (fname);
+  struct pe_file pe;
+  BOOL   rc;
+
+  *calc_sum = 0;
+  if (!fs || (fs->bits != bit_32 && fs->bits != bit_64))
+     return (FALSE);
+
+  /* No need to map the file if the checksum is "don't care".
+   */
+  if (fs->pe_checksum == 0)
+     return (TRUE);
+
+  if (!pe_open(&pe, fname))
+     return (FALSE);
+
+  rc = pe_verify_checksum (&pe, calc_sum);
+  pe_close (&pe);
+  return (rc);
+}
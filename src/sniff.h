@@ -0,0 +1,42 @@
+/** \file sniff.h
+ */
+#ifndef _SNIFF_H
+#define _SNIFF_H
+
+#include "smartlist.h"
+
+/**
+ * The flags in \c file_sniff::flags.
+ */
+#define SNIFF_EXE       0x01   /**< has a \c "MZ" signature */
+#define SNIFF_PE        0x02   /**< has a \c "PE\0\0" signature too */
+#define SNIFF_ZIP       0x04   /**< has a \c "PK\3\4" signature */
+#define SNIFF_GZIP      0x08   /**< has a GZIP signature */
+#define SNIFF_SHEBANG   0x10   /**< starts with a \c "#!/" line */
+#define SNIFF_MAN_LINK  0x20   /**< a (gzipped) man-page with a \c ".so file" line */
+
+/**
+ * The number of bytes read from the start of each file.
+ */
+#define SNIFF_HEADER_SIZE  4096
+
+/**\struct file_sniff
+ * What \c sniff_file() found in the header of a file.
+ */
+struct file_sniff {
+       char         *file;         /** the file-name */
+       UINT64        size;         /** the size of \c file when it was sniffed */
+       time_t        mtime;        /** the modification time of \c file ditto */
+       unsigned      flags;        /** a combination of the \c SNIFF_x flags */
+       enum Bitness  bits;         /** the bitness of a \c SNIFF_EXE */
+       DWORD         pe_checksum;  /** the \c CheckSum in the optional header of a \c SNIFF_PE */
+       char          shebang [30]; /** the interpreter of a \c SNIFF_SHEBANG; E.g. \c "#!/bin/sh" */
+       char         *so_link;      /** the \c ".so" target of a \c SNIFF_MAN_LINK */
+     };
+
+extern const struct file_sniff *sniff_file (const char *file);
+extern void                     sniff_prefetch (smartlist_t *files);
+extern void                     sniff_exit (void);
+extern BOOL                     sniff_PE_checksum (const char *file, DWORD *calc_sum);
+
+#endif /* _SNIFF_H */
@@ -0,0 +1,311 @@
+/**\file    strsort.c
+ * \ingroup Misc
+ * \brief
+ *   Sorting of elements on a string key.
+ *
+ * A \c qsort() comparator like \c stricmp() case-folds both strings on
+ * every one of the \c O(n*log(n)) comparisons. Here each key is folded once
+ * into a side buffer. The buffer is then sorted with a MSD (most significant
+ * digit first) radix sort on the bytes of the keys. Buckets smaller than
+ * \c STR_SORT_INSERTION elements are finished with an insertion sort.
+ *
+ * The order equals that of \c strcmp() (or \c stricmp() with \c STR_SORT_NOCASE)
+ * and the sort is stable.
+ *
+ * Compile with \c -DSTRSORT_TEST for a small program that benchmarks
+ * this against \c qsort() on a list of paths.
+ */
+#include "envtool.h"
+#include "strsort.h"
+
+/**
+ * Buckets smaller than this are insertion sorted.
+ */
+#define STR_SORT_INSERTION  32
+
+/**\struct str_sort_ent
+ * An element and its folded key.
+ */
+struct str_sort_ent {
+       const BYTE *key;    /** the group-byte and folded key in the side buffer */
+       void       *elem;   /** the element to sort */
+     };
+
+/**
+ * Insertion sort the \c num elements in \c e. The first \c depth bytes
+ * of their keys are known to be equal.
+ */
+static void insertion_sort (struct str_sort_ent *e, int num, size_t depth)
+{
+  int i, j;
+
+  for (i = 1; i < num; i++)
+  {
+    struct str_sort_ent t = e[i];
+
+    for (j = i; j > 0 && strcmp((const char*)e[j-1].key + depth, (const char*)t.key + depth) > 0; j--)
+        e[j] = e[j-1];
+    e[j] = t;
+  }
+}
+
+/**
+ * Sort the \c num elements in \c e on byte \c depth of their keys and
+ * recurse into each bucket.
+ *
+ * \param[in] e      the elements; the first \c depth bytes of their keys are equal.
+ * \param[in] tmp    scratch space for the scatter; shared by all levels.
+ * \param[in] bytes  a cache of the key-bytes at \c depth; shared by all levels.
+ * \param[in] num    the number of elements in \c e.
+ * \param[in] depth  the key-byte to sort on.
+ */
+static void msd_radix_sort (struct str_sort_ent *e, struct str_sort_ent *tmp, BYTE *bytes,
+                            int num, size_t depth)
+{
+  int count [256];
+  int i, c, start;
+
+  while (num >= STR_SORT_INSERTION)
+  {
+    memset (&count, '\0', sizeof(count));
+    for (i = 0; i < num; i++)
+    {
+      bytes[i] = e[i].key [depth];
+      count [bytes[i]]++;
+    }
+
+    /* All the keys have the same byte here; no need to move anything.
+     * If it's the terminator, the keys are equal. Otherwise skip the whole
+     * common prefix of the keys.
+     */
+    if (count[bytes[0]] == num)
+    {
+      size_t prefix;
+
+      if (bytes[0] == '\0')
+         return;
+
+      prefix = strlen ((const char*)e[0].key + depth);
+      for (i = 1; i < num && prefix > 1; i++)
+      {
+        const BYTE *a = e[0].key + depth;
+        const BYTE *b = e[i].key + depth;
+        size_t      j;
+
+        for (j = 1; j < prefix && a[j] == b[j]; j++)
+            ;
+        prefix = j;
+      }
+      depth += prefix;
+      continue;
+    }
+
+    /* Turn the counts into start-indices and scatter the elements.
+     * Afterwards 'count[c]' is the end-index of bucket 'c'.
+     */
+    for (c = start = 0; c < 256; c++)
+    {
+      int n = count[c];
+
+      count[c] = start;
+      start += n;
+    }
+    for (i = 0; i < num; i++)
+        tmp [count[bytes[i]]++] = e[i];
+    memcpy (e, tmp, num * sizeof(*e));
+
+    /* Bucket 0 holds the keys that ended here. These are equal.
+     */
+    for (c = 1; c < 256; c++)
+    {
+      start = count [c-1];
+      if (count[c] - start > 1)
+         msd_radix_sort (e + start, tmp, bytes, count[c] - start, depth + 1);
+    }
+    return;
+  }
+  insertion_sort (e, num, depth);
+}
+
+/**
+ * Fold the keys of the \c num elements in \c elems[] into a side-buffer and
+ * return them sorted. The caller must free the returned array and \c *keys_p.
+ */
+static struct str_sort_ent *str_sort_ents (void **elems, int num, str_sort_key_func key_func,
+                                           unsigned flags, BYTE **keys_p)
+{
+  struct str_sort_ent *ents, *tmp;
+  BYTE  *bytes, *keys, *p;
+  size_t total = 0;
+  int    i;
+
+  ents  = MALLOC (num * sizeof(*ents));
+  bytes = MALLOC (num);
+
+  /* Get the keys and groups. Cache the groups in 'bytes[]' for now.
+   */
+  for (i = 0; i < num; i++)
+  {
+    int group = 0;
+
+    ents[i].elem = elems[i];
+    ents[i].key  = (const BYTE*) (*key_func) (elems[i], &group);
+    ASSERT (group >= 0 && group < 255);
+    bytes[i] = (BYTE) group;
+    total += strlen ((const char*)ents[i].key) + 2;
+  }
+
+  /* Fold them into one buffer; the group-byte + 1 first.
+   */
+  keys = p = MALLOC (total);
+  for (i = 0; i < num; i++)
+  {
+    const BYTE *s = ents[i].key;
+
+    ents[i].key = p;
+    *p++ = bytes[i] + 1;
+    if (flags & STR_SORT_NOCASE)
+    {
+      for ( ; *s; s++)
+          *p++ = (BYTE) tolower (*s);
+    }
+    else
+    {
+      for ( ; *s; s++)
+          *p++ = *s;
+    }
+    *p++ = '\0';
+  }
+
+  tmp = MALLOC (num * sizeof(*tmp));
+  msd_radix_sort (ents, tmp, bytes, num, 0);
+  FREE (tmp);
+  FREE (bytes);
+  *keys_p = keys;
+  return (ents);
+}
+
+/**
+ * Sort the \c num pointers in \c elems[] on the key \c key_func() returns for each.
+ *
+ * \param[in,out] elems     the array of elements to sort.
+ * \param[in]     num       the number of elements in \c elems[].
+ * \param[in]     key_func  the function returning the key (and group) of an element.
+ * \param[in]     flags     a combination of \c STR_SORT_NOCASE and \c STR_SORT_REVERSE.
+ */
+void str_sort (void **elems, int num, str_sort_key_func key_func, unsigned flags)
+{
+  struct str_sort_ent *ents;
+  BYTE  *keys;
+  int    i;
+
+  if (num < 2)
+     return;
+
+  ents = str_sort_ents (elems, num, key_func, flags, &keys);
+  for (i = 0; i < num; i++)
+      elems [(flags & STR_SORT_REVERSE) ? num-1-i : i] = ents[i].elem;
+
+  FREE (keys);
+  FREE (ents);
+}
+
+/**
+ * As \c str_sort(), but for the \c num elements of \c size bytes each
+ * at \c base. Like \c qsort().
+ */
+void str_sort_array (void *base, int num, size_t size, str_sort_key_func key_func, unsigned flags)
+{
+  void **elems;
+  BYTE  *copy;
+  int    i;
+
+  if (num < 2)
+     return;
+
+  elems = MALLOC (num * sizeof(void*));
+  for (i = 0; i < num; i++)
+      elems[i] = (BYTE*)base + i * size;
+
+  str_sort (elems, num, key_func, flags);
+
+  copy = MALLOC (num * size);
+  for (i = 0; i < num; i++)
+      memcpy (copy + i * size, elems[i], size);
+  memcpy (base, copy, num * size);
+  FREE (copy);
+  FREE (elems);
+}
+
+#if defined(STRSORT_TEST)
+
+struct prog_options opt;
+
+static double strsort_test_msec (void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER        now;
+
+  if (freq.QuadPart == 0)
+     QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&now);
+  return (1000.0 * (double)now.QuadPart / (double)freq.QuadPart);
+}
+
+static const char *path_key (const void *elem, int *group)
+{
+  ARGSUSED (group);
+  return (const char*) elem;
+}
+
+static int path_compare (const void *a, const void *b)
+{
+  return stricmp (*(const char**)a, *(const char**)b);
+}
+
+int main (int argc, char **argv)
+{
+  char **paths, **copy;
+  double now, t_qsort, t_radix;
+  int    i, num = 1000000, errors = 0;
+
+  if (argc > 1)
+     num = atoi (argv[1]);
+  if (num < 2)
+  {
+    printf ("Usage: strsort [num-paths]\n");
+    return (-1);
+  }
+
+  paths = make_test_paths (num);
+  copy  = MALLOC (num * sizeof(char*));
+
+  memcpy (copy, paths, num * sizeof(char*));
+  now = strsort_test_msec();
+  qsort (copy, num, sizeof(char*), path_compare);
+  t_qsort = strsort_test_msec() - now;
+
+  memcpy (copy, paths, num * sizeof(char*));
+  now = strsort_test_msec();
+  str_sort ((void**)copy, num, path_key, STR_SORT_NOCASE);
+  t_radix = strsort_test_msec() - now;
+
+  for (i = 1; i < num; i++)
+      if (stricmp(copy[i-1], copy[i]) > 0)
+         errors++;
+
+  str_sort ((void**)copy, num, path_key, STR_SORT_REVERSE);
+  for (i = 1; i < num; i++)
+      if (strcmp(copy[i-1], copy[i]) < 0)
+         errors++;
+
+  printf ("%d paths: qsort()+stricmp(): %.1f msec, str_sort(): %.1f msec. %d errors.\n",
+          num, t_qsort, t_radix, errors);
+
+  for (i = 0; i < num; i++)
+      FREE (paths[i]);
+  FREE (paths);
+  FREE (copy);
+  return (errors ? 1 : 0);
+}
+#endif  /* STRSORT_TEST */
@@ -0,0 +1,21 @@
+/** \file strsort.h
+ */
+#ifndef _STRSORT_H
+#define _STRSORT_H
+
+/**
+ * Flags for \c str_sort() and \c str_sort_array().
+ */
+#define STR_SORT_NOCASE   0x01   /**< fold the keys to lower-case; like \c stricmp() */
+#define STR_SORT_REVERSE  0x02   /**< sort in descending order */
+
+/**
+ * Return the sort-key of \c elem. \c *group is 0 on entry and can be set
+ * to a major key in the range \c 0..254 that is compared before the string.
+ */
+typedef const char *(*str_sort_key_func) (const void *elem, int *group);
+
+extern void str_sort       (void **elems, int num, str_sort_key_func key_func, unsigned flags);
+extern void str_sort_array (void *base, int num, size_t size, str_sort_key_func key_func, unsigned flags);
+
+#endif /* _STRSORT_H */
@@ -0,0 +1,406 @@
+/**\file    tasks.c
+ * \ingroup Misc
+ * \brief
+ *   A simple pool of worker-threads for running independent jobs
+ *   in parallel. E.g. listing many ZIP-files at once.
+ *
+ *   A \c task_pipe adds a bounded reorder-buffer on top of a pool. The
+ *   results are reported in the order the jobs were submitted.
+ *
+ * \note
+ *   The jobs must not print anything (neither with \c C_printf() nor
+ *   \c DEBUGF()). They should only collect their results; the caller
+ *   reports these in the main thread after \c task_pool_wait() returns.
+ */
+#include "envtool.h"
+#include "smartlist.h"
+#include "tasks.h"
+
+/**
+ * The number of worker-threads to use.
+ * If 0, use the number of CPUs (see \c tasks_max_threads()).
+ * If 1, all jobs are run synchronously in the calling thread.
+ */
+int task_num_threads = 0;
+
+/**
+ * Never start more threads than this.
+ */
+#define TASKS_MAX_THREADS  32
+
+/**\struct task
+ * A queued job.
+ */
+struct task {
+       task_func    func;   /** the job to run */
+       void        *arg;    /** and it's argument */
+       struct task *next;
+     };
+
+/**\struct task_pool
+ */
+struct task_pool {
+       CRITICAL_SECTION crit;         /** protects the members below */
+       HANDLE           sema;         /** released once for each queued job */
+       HANDLE           idle_event;   /** set when \c pending drops to 0 */
+       HANDLE          *threads;      /** the worker-threads */
+       int              num_threads;  /** the number of \c threads[] */
+       struct task     *head, *tail;  /** the FIFO queue of jobs */
+       long             pending;      /** # of jobs queued or running */
+       BOOL             quit;         /** tell the workers to exit */
+     };
+
+/**
+ * Return the number of worker-threads to use for a new pool.
+ */
+int tasks_max_threads (void)
+{
+  SYSTEM_INFO si;
+  int         num = task_num_threads;
+
+  if (num <= 0)
+  {
+    GetSystemInfo (&si);
+    num = (int) si.dwNumberOfProcessors;
+  }
+  if (num < 1)
+     num = 1;
+  if (num > TASKS_MAX_THREADS)
+     num = TASKS_MAX_THREADS;
+  return (num);
+}
+
+/**
+ * The worker-thread. Pick jobs off the queue until told to quit.
+ */
+static DWORD WINAPI task_worker (void *arg)
+{
+  struct task_pool *pool = (struct task_pool*) arg;
+
+  while (1)
+  {
+    struct task *t;
+
+    WaitForSingleObject (pool->sema, INFINITE);
+
+    EnterCriticalSection (&pool->crit);
+    t = pool->head;
+    if (t)
+    {
+      pool->head = t->next;
+      if (!pool->head)
+         pool->tail = NULL;
+    }
+    LeaveCriticalSection (&pool->crit);
+
+    if (!t)
+    {
+      if (pool->quit)
+         break;
+      continue;
+    }
+
+    (*t->func) (t->arg);
+    FREE (t);
+
+    EnterCriticalSection (&pool->crit);
+    if (--pool->pending == 0)
+       SetEvent (pool->idle_event);
+    LeaveCriticalSection (&pool->crit);
+  }
+  return (0);
+}
+
+/**
+ * Create a new pool with \c num_threads workers.
+ * If \c num_threads <= 1, no threads are created and \c task_pool_submit()
+ * will run the jobs directly.
+ */
+struct task_pool *task_pool_new (int num_threads)
+{
+  struct task_pool *pool = CALLOC (1, sizeof(*pool));
+  int    i;
+
+  if (num_threads > TASKS_MAX_THREADS)
+     num_threads = TASKS_MAX_THREADS;
+
+  InitializeCriticalSection (&pool->crit);
+  pool->idle_event = CreateEvent (NULL, TRUE, TRUE, NULL);
+  pool->sema = CreateSemaphore (NULL, 0, LONG_MAX, NULL);
+
+  if (num_threads <= 1)
+     return (pool);
+
+  pool->threads = CALLOC (num_threads, sizeof(HANDLE));
+  for (i = 0; i < num_threads; i++)
+  {
+    DWORD  tid;
+    HANDLE t = CreateThread (NULL, 0, task_worker, pool, 0, &tid);
+
+    if (!t)
+    {
+      DEBUGF (1, "CreateThread() failed; %s\n", win_strerror(GetLastError()));
+      break;
+    }
+    pool->threads [pool->num_threads++] = t;
+  }
+  DEBUGF (2, "Started %d worker-threads.\n", pool->num_threads);
+  return (pool);
+}
+
+/**
+ * Add a job to the pool.
+ * If the pool has no threads, run it now.
+ */
+void task_pool_submit (struct task_pool *pool, task_func func, void *arg)
+{
+  struct task *t;
+
+  if (pool->num_threads == 0)
+  {
+    (*func) (arg);
+    return;
+  }
+
+  t = MALLOC (sizeof(*t));
+  t->func = func;
+  t->arg  = arg;
+  t->next = NULL;
+
+  EnterCriticalSection (&pool->crit);
+  if (pool->tail)
+       pool->tail->next = t;
+  else pool->head = t;
+  pool->tail = t;
+  if (pool->pending++ == 0)
+     ResetEvent (pool->idle_event);
+  LeaveCriticalSection (&pool->crit);
+
+  ReleaseSemaphore (pool->sema, 1, NULL);
+}
+
+/**
+ * Wait until all submitted jobs have completed.
+ */
+void task_pool_wait (struct task_pool *pool)
+{
+  while (1)
+  {
+    long pending;
+
+    EnterCriticalSection (&pool->crit);
+    pending = pool->pending;
+    LeaveCriticalSection (&pool->crit);
+    if (pending == 0)
+       break;
+    WaitForSingleObject (pool->idle_event, INFINITE);
+  }
+}
+
+/**
+ * Wait for all jobs, stop the workers and free the pool.
+ */
+void task_pool_free (struct task_pool *pool)
+{
+  int i;
+
+  if (!pool)
+     return;
+
+  task_pool_wait (pool);
+
+  if (pool->num_threads > 0)
+  {
+    pool->quit = TRUE;
+    ReleaseSemaphore (pool->sema, pool->num_threads, NULL);
+    WaitForMultipleObjects (pool->num_threads, pool->threads, TRUE, INFINITE);
+    for (i = 0; i < pool->num_threads; i++)
+        CloseHandle (pool->threads[i]);
+  }
+  CloseHandle (pool->sema);
+  CloseHandle (pool->idle_event);
+  DeleteCriticalSection (&pool->crit);
+  FREE (pool->threads);
+  FREE (pool);
+}
+
+/**
+ * Run \c func on every element of \c sl in parallel and wait for
+ * them to finish. A sort of "parallel for".
+ */
+void tasks_run_list (smartlist_t *sl, task_func func)
+{
+  struct task_pool *pool;
+  int    i, max = smartlist_len (sl);
+  int    num_threads = tasks_max_threads();
+
+  if (num_threads > max)
+     num_threads = max;
+
+  if (num_threads <= 1)
+  {
+    for (i = 0; i < max; i++)
+        (*func) (smartlist_get(sl, i));
+    return;
+  }
+
+  pool = task_pool_new (num_threads);
+  for (i = 0; i < max; i++)
+      task_pool_submit (pool, func, smartlist_get(sl, i));
+  task_pool_free (pool);
+}
+
+/**\struct task_slot
+ * One entry in the reorder-buffer of a \c task_pipe.
+ */
+struct task_slot {
+       struct task_pipe *pipe;   /** the pipe owning this slot */
+       void             *arg;    /** the job argument */
+       BOOL              done;   /** set by the worker when \c pipe->work(arg) returned */
+     };
+
+/**\struct task_pipe
+ * A bounded pipeline: jobs run in a \c task_pool, but the \c done()
+ * callback is called in the main thread in the order the jobs were
+ * submitted.
+ */
+struct task_pipe {
+       struct task_pool *pool;        /** the workers running \c work() */
+       task_func         work;        /** called in a worker-thread */
+       task_func         done;        /** called in the main thread; in submit order */
+       CRITICAL_SECTION  crit;        /** protects \c slots[].done */
+       HANDLE            done_event;  /** auto-reset; set when any job completes */
+       struct task_slot *slots;       /** the ring-buffer of in-flight jobs */
+       int               max_slots;   /** the size of \c slots[] */
+       int               head;        /** the oldest in-flight job */
+       int               count;       /** # of in-flight jobs */
+     };
+
+/**
+ * The job-function for \c task_pool_submit() in a \c task_pipe.
+ */
+static void task_pipe_job (void *arg)
+{
+  struct task_slot *slot = (struct task_slot*) arg;
+  struct task_pipe *pipe = slot->pipe;
+
+  (*pipe->work) (slot->arg);
+
+  EnterCriticalSection (&pipe->crit);
+  slot->done = TRUE;
+  LeaveCriticalSection (&pipe->crit);
+  SetEvent (pipe->done_event);
+}
+
+/**
+ * Call \c done() for the completed jobs at the head of the ring-buffer.
+ * Stop at the first job still running; the ones after it must wait
+ * to keep the submit order.
+ */
+static void task_pipe_drain (struct task_pipe *pipe)
+{
+  while (pipe->count > 0)
+  {
+    struct task_slot *slot = pipe->slots + pipe->head;
+    BOOL   done;
+
+    EnterCriticalSection (&pipe->crit);
+    done = slot->done;
+    LeaveCriticalSection (&pipe->crit);
+    if (!done)
+       break;
+
+    (*pipe->done) (slot->arg);
+    pipe->head = (pipe->head + 1) % pipe->max_slots;
+    pipe->count--;
+  }
+}
+
+/**
+ * Create a new pipe with \c tasks_max_threads() workers.
+ *
+ * \param[in] max_in_flight  the max number of jobs submitted but not yet
+ *                           passed to \c done(). If <= 0, use 4 times the
+ *                           number of workers.
+ * \param[in] work           the function to run in a worker-thread.
+ *                           Like other jobs, it must not print anything.
+ * \param[in] done           the function to report the result of \c work().
+ *                           Called in the main thread in submit order.
+ */
+struct task_pipe *task_pipe_new (int max_in_flight, task_func work, task_func done)
+{
+  struct task_pipe *pipe = CALLOC (1, sizeof(*pipe));
+  int    num_threads = tasks_max_threads();
+
+  if (max_in_flight <= 0)
+     max_in_flight = 4 * num_threads;
+
+  pipe->pool       = task_pool_new (num_threads);
+  pipe->work       = work;
+  pipe->done       = done;
+  pipe->max_slots  = max_in_flight;
+  pipe->slots      = CALLOC (max_in_flight, sizeof(*pipe->slots));
+  pipe->done_event = CreateEvent (NULL, FALSE, FALSE, NULL);
+  InitializeCriticalSection (&pipe->crit);
+  return (pipe);
+}
+
+/**
+ * Queue \c arg for \c work() in a worker-thread. If the reorder-buffer
+ * is full, wait for the oldest job to complete (and report it) first.
+ * Any completed jobs at the head are reported before returning.
+ */
+void task_pipe_submit (struct task_pipe *pipe, void *arg)
+{
+  struct task_slot *slot;
+
+  while (1)
+  {
+    task_pipe_drain (pipe);
+    if (pipe->count < pipe->max_slots)
+       break;
+    WaitForSingleObject (pipe->done_event, INFINITE);
+  }
+
+  slot = pipe->slots + (pipe->head + pipe->count) % pipe->max_slots;
+  slot->pipe = pipe;
+  slot->arg  = arg;
+  slot->done = FALSE;
+  pipe->count++;
+
+  task_pool_submit (pipe->pool, task_pipe_job, slot);
+  task_pipe_drain (pipe);
+}
+
+/**
+ * Wait for all submitted jobs and report them.
+ */
+void task_pipe_flush (struct task_pipe *pipe)
+{
+  if (!pipe)
+     return;
+
+  while (1)
+  {
+    task_pipe_drain (pipe);
+    if (pipe->count == 0)
+       break;
+    WaitForSingleObject (pipe->done_event, INFINITE);
+  }
+}
+
+/**
+ * Flush the pipe, stop the workers and free it.
+ */
+void task_pipe_free (struct task_pipe *pipe)
+{
+  if (!pipe)
+     return;
+
+  task_pipe_flush (pipe);
+  task_pool_free (pipe->pool);
+  CloseHandle (pipe->done_event);
+  DeleteCriticalSection (&pipe->crit);
+  FREE (pipe->slots);
+  FREE (pipe);
+}
@@ -0,0 +1,27 @@
+/** \file tasks.h
+ */
+#ifndef _TASKS_H
+#define _TASKS_H
+
+#include "smartlist.h"
+
+typedef void (*task_func) (void *arg);
+
+struct task_pool;  /* Opaque struct; defined in tasks.c */
+struct task_pipe;  /* Opaque struct; defined in tasks.c */
+
+extern int               task_num_threads;
+
+extern int               tasks_max_threads (void);
+extern struct task_pool *task_pool_new     (int num_threads);
+extern void              task_pool_submit  (struct task_pool *pool, task_func func, void *arg);
+extern void              task_pool_wait    (struct task_pool *pool);
+extern void              task_pool_free    (struct task_pool *pool);
+extern void              tasks_run_list    (smartlist_t *sl, task_func func);
+
+extern struct task_pipe *task_pipe_new     (int max_in_flight, task_func work, task_func done);
+extern void              task_pipe_submit  (struct task_pipe *pipe, void *arg);
+extern void              task_pipe_flush   (struct task_pipe *pipe);
+extern void              task_pipe_free    (struct task_pipe *pipe);
+
+#endif /* _TASKS_H */
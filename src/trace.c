@@ -0,0 +1,254 @@
+/**\file    trace.c
+ * \ingroup Misc
+ * \brief
+ *   Records begin / end events of a run in the Chrome trace-event format.
+ *
+ * The events are the directory scans, the child processes, the Python
+ * calls, the PE-checks and the ETP states. The children of runner.c can
+ * overlap in one thread; so these are async events paired on their pid. Load the file in
+ * \c "chrome://tracing" or \c "https://ui.perfetto.dev" to see where
+ * the time of a run goes; also in the worker-threads.
+ *
+ * Each thread appends to its own buffer; found via \c TlsGetValue().
+ * A thread claims a slot in \c trace_threads[] with an \c InterlockedIncrement()
+ * on its first event. So no locks are taken on the hot path. The buffers
+ * are written by \c trace_exit() when all threads are done.
+ *
+ * When tracing is off, \c trace_hook is NULL and the \c TRACE_BEGIN() and
+ * \c TRACE_END() macros in envtool.h cost only a test of a pointer.
+ *
+ * Used by option \c "--trace=file".
+ */
+#include <errno.h>
+
+#include "envtool.h"
+#include "arena.h"
+#include "trace.h"
+
+/**
+ * The max number of threads we record events from.
+ * Events in any other threads are counted in \c trace_dropped.
+ */
+#define TRACE_MAX_THREADS  256
+
+/**
+ * The number of events in a \c trace_block.
+ */
+#define TRACE_BLOCK_EVENTS 512
+
+/**\struct trace_event
+ */
+struct trace_event {
+       UINT64      ts;     /** from 'get_time_ns()' */
+       const char *cat;    /** the category; a string literal */
+       const char *name;   /** copied to the thread's arena. NULL for an 'E' event */
+       unsigned    id;     /** pairs a 'b' and 'e' event */
+       char        ph;     /** the phase; 'B', 'E' or async 'b', 'e' */
+     };
+
+/**\struct trace_block
+ */
+struct trace_block {
+       struct trace_block *next;
+       volatile LONG       num;    /** # of events used; updated after an event is written */
+       struct trace_event  events [TRACE_BLOCK_EVENTS];
+     };
+
+/**\struct trace_thread
+ * The buffer of one thread. Only this thread writes to it.
+ */
+struct trace_thread {
+       DWORD               tid;
+       arena_t            *arena;  /** for the blocks and the names */
+       struct trace_block *first;
+       struct trace_block *last;
+     };
+
+static struct trace_thread *trace_threads [TRACE_MAX_THREADS];
+static volatile LONG        trace_num_threads;
+static volatile LONG        trace_dropped;
+static DWORD                trace_tls = TLS_OUT_OF_INDEXES;
+static DWORD                trace_main_tid;
+static UINT64               trace_start_ns;
+
+/*
+ * Give the calling thread a buffer.
+ * Returns NULL if there are too many threads.
+ */
+static struct trace_thread *trace_thread_new (void)
+{
+  struct trace_thread *t;
+  LONG   idx = InterlockedIncrement (&trace_num_threads) - 1;
+
+  if (idx >= TRACE_MAX_THREADS)
+     return (NULL);
+
+  t = CALLOC (1, sizeof(*t));
+  t->tid   = GetCurrentThreadId();
+  t->arena = arena_new (64*1024);
+  t->first = t->last = arena_calloc (t->arena, sizeof(*t->first));
+  trace_threads [idx] = t;
+  TlsSetValue (trace_tls, t);
+  return (t);
+}
+
+/*
+ * The 'trace_hook' while tracing is on.
+ */
+static void trace_event (char ph, const char *cat, const char *name, unsigned id)
+{
+  struct trace_thread *t = TlsGetValue (trace_tls);
+  struct trace_block  *b;
+  struct trace_event  *ev;
+
+  if (!t)
+  {
+    t = trace_thread_new();
+    if (!t)
+    {
+      InterlockedIncrement (&trace_dropped);
+      return;
+    }
+  }
+
+  b = t->last;
+  if (b->num == TRACE_BLOCK_EVENTS)
+  {
+    b->next = arena_calloc (t->arena, sizeof(*b));
+    b = t->last = b->next;
+  }
+
+  ev = b->events + b->num;
+  ev->ts   = get_time_ns();
+  ev->ph   = ph;
+  ev->id   = id;
+  ev->cat  = cat;
+  ev->name = name ? arena_strdup (t->arena, name) : NULL;
+  InterlockedIncrement (&b->num);
+}
+
+/*
+ * Start recording events.
+ */
+BOOL trace_init (void)
+{
+  trace_tls = TlsAlloc();
+  if (trace_tls == TLS_OUT_OF_INDEXES)
+  {
+    WARN ("TlsAlloc() failed; %s.\n", win_strerror(GetLastError()));
+    return (FALSE);
+  }
+  trace_main_tid = GetCurrentThreadId();
+  trace_start_ns = get_time_ns();
+  trace_hook = trace_event;
+  return (TRUE);
+}
+
+/*
+ * Print 'str' as a JSON string.
+ */
+static void trace_put_str (FILE *f, const char *str)
+{
+  fputc ('"', f);
+  for ( ; *str; str++)
+  {
+    if (*str == '"' || *str == '\\')
+       fprintf (f, "\\%c", *str);
+    else if ((BYTE)*str < ' ')
+       fprintf (f, "\\u%04x", (BYTE)*str);
+    else fputc (*str, f);
+  }
+  fputc ('"', f);
+}
+
+static void trace_put_thread (FILE *f, DWORD pid, const struct trace_thread *t)
+{
+  const struct trace_block *b;
+  int   i;
+
+  fprintf (f, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %lu, \"tid\": %lu, "
+              "\"args\": {\"name\": \"%s\"}}",
+           (u_long)pid, (u_long)t->tid, t->tid == trace_main_tid ? "main" : "worker");
+
+  for (b = t->first; b; b = b->next)
+  {
+    LONG num = b->num;
+
+    for (i = 0; i < num; i++)
+    {
+      const struct trace_event *ev = b->events + i;
+      UINT64 ts = ev->ts - trace_start_ns;
+
+      fprintf (f, ",\n  {\"ph\": \"%c\", \"cat\": \"%s\", ", ev->ph, ev->cat);
+      if (ev->name)
+      {
+        fputs ("\"name\": ", f);
+        trace_put_str (f, ev->name);
+        fputs (", ", f);
+      }
+      if (ev->ph == 'b' || ev->ph == 'e')
+         fprintf (f, "\"id\": %u, ", ev->id);
+      fprintf (f, "\"ts\": %" U64_FMT ".%03u, \"pid\": %lu, \"tid\": %lu}",
+               ts / 1000, (unsigned)(ts % 1000), (u_long)pid, (u_long)t->tid);
+    }
+  }
+}
+
+/*
+ * Stop recording and write the events to 'json_file'.
+ *
+ * If interrupted, a worker-thread could still be adding events. So the
+ * buffers are not freed then.
+ */
+int trace_exit (const char *json_file)
+{
+  FILE *f;
+  DWORD pid = GetCurrentProcessId();
+  BOOL  first = TRUE;
+  int   i, rc = 0, num;
+
+  if (!trace_hook)
+     return (0);
+
+  trace_hook = NULL;
+  num = min (trace_num_threads, TRACE_MAX_THREADS);
+
+  f = fopen (json_file, "wt");
+  if (!f)
+  {
+    WARN ("Failed to create \"%s\"; %s.\n", json_file, strerror(errno));
+    rc = 1;
+  }
+  else
+  {
+    fputs ("{\"displayTimeUnit\": \"ms\",\n \"traceEvents\": [\n", f);
+    for (i = 0; i < num; i++)
+    {
+      if (!trace_threads[i])  /* still in 'trace_thread_new()' */
+         continue;
+      if (!first)
+         fputs (",\n", f);
+      first = FALSE;
+      trace_put_thread (f, pid, trace_threads[i]);
+    }
+    fputs ("\n]}\n", f);
+    fclose (f);
+  }
+
+  if (trace_dropped > 0)
+     WARN ("%ld trace-events dropped in more than %d threads.\n",
+           (long)trace_dropped, TRACE_MAX_THREADS);
+
+  if (halt_flag == 0)
+  {
+    for (i = 0; i < num; i++)
+    {
+      if (!trace_threads[i])
+         continue;
+      arena_free (trace_threads[i]->arena);
+      FREE (trace_threads[i]);
+    }
+    TlsFree (trace_tls);
+  }
+  return (rc);
+}
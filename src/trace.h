@@ -0,0 +1,9 @@
+/** \file trace.h
+ */
+#ifndef _TRACE_H
+#define _TRACE_H
+
+extern BOOL trace_init (void);
+extern int  trace_exit (const char *json_file);
+
+#endif /* _TRACE_H */
@@ -0,0 +1,70 @@
+/** \file vector.h
+ */
+#ifndef _VECTOR_H
+#define _VECTOR_H
+
+/**\typedef vector_t
+ * A resizeable array of fixed-size elements. Unlike a \c smartlist_t,
+ * the elements are stored by value in one contiguous block.
+ *
+ * The members are exposed so the \c VECTOR_x() macros and hot loops
+ * can index \c data directly. \c data may move on every add; do not
+ * keep pointers into it across a \c vector_add().
+ *
+ * A struct of arrays is simply a struct of \c vector_t columns. Rows are
+ * removed from all the columns with \c vector_compact() and the same
+ * \c keep[] array.
+ */
+typedef struct vector_t {
+        void  *data;        /** 'capacity' elements of 'elem_size' bytes each */
+        size_t elem_size;   /** the size of one element */
+        int    num_used;    /** the first 'num_used' elements are valid */
+        int    capacity;    /** the number of elements 'data' has room for */
+      } vector_t;
+
+typedef int (*vector_sort_func) (const void *a, const void *b);
+typedef int (*vector_compare_func) (const void *key, const void *member);
+
+/** The \c idx'th element of \c v as a \c type lvalue.
+ */
+#define VECTOR_AT(v, type, idx)  (((type*)(v)->data) [idx])
+
+/** The elements of \c v as a \c type array.
+ */
+#define VECTOR_DATA(v, type)     ((type*)(v)->data)
+
+/** Append the value \c val of \c type to \c v.
+ */
+#define VECTOR_ADD(v, type, val) do {                                       \
+                                   type _val = (val);                       \
+                                   ASSERT ((v)->elem_size == sizeof(type)); \
+                                   vector_add (v, &_val);                   \
+                                 } while (0)
+
+int       vector_len (const vector_t *v);
+void     *vector_get (const vector_t *v, int idx);
+vector_t *vector_new (size_t elem_size);
+vector_t *vector_init (vector_t *v, size_t elem_size);
+
+void  vector_free (vector_t *v);
+void  vector_release (vector_t *v);
+void  vector_ensure_capacity (vector_t *v, size_t num);
+void *vector_add (vector_t *v, const void *elem);
+void *vector_add_n (vector_t *v, const void *elems, int num);
+void  vector_del_keeporder (vector_t *v, int idx);
+void  vector_clear (vector_t *v);
+void  vector_wipe (vector_t *v, void (*free_fn)(void *elem));
+int   vector_compact (vector_t *v, const BYTE *keep);
+
+int   vector_duplicates (const vector_t *v, vector_sort_func compare);
+void  vector_make_uniq (vector_t *v, vector_sort_func compare, void (*free_fn)(void *elem));
+
+void  vector_sort (vector_t *v, vector_sort_func compare);
+
+int   vector_bsearch_idx (const vector_t *v, const void *key,
+                          vector_compare_func compare, int *found_out);
+
+void *vector_bsearch (const vector_t *v, const void *key,
+                      vector_compare_func compare);
+
+#endif
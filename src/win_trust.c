@@ -37,7 +37,7 @@
   #define PRINTF(fmt, ...)  ((void)0)
   #define NEWLINE()         ((void)0)
   #undef  ERROR
-  #define ERROR(s)          last_err = GetLastError()
+  #define ERROR(s)          ((void)0)
 #endif
 
 #define ASN_ENCODING  (X509_ASN_ENCODING | PKCS_7_ASN_ENCODING)
@@ -52,10 +52,8 @@ struct SPROG_PUBLISHERINFO {
 char *wintrust_signer_subject, *wintrust_timestamp_subject;
 char *wintrust_signer_issuer,  *wintrust_timestamp_issuer;
 
-static DWORD last_err;
-
 static wchar_t *evil_char_to_wchar (const char *text);
-static int      crypt_check_file (const char *fname);
+static int      crypt_check_file (const char *fname, struct wintrust_info *info);
 
 #if defined(WIN_TRUST_TEST)
 
@@ -197,7 +195,39 @@ void wintrust_cleanup (void)
   FREE (wintrust_timestamp_issuer);
 }
 
+void wintrust_info_free (struct wintrust_info *info)
+{
+  FREE (info->signer_subject);
+  FREE (info->signer_issuer);
+  FREE (info->timestamp_subject);
+  FREE (info->timestamp_issuer);
+}
+
+/**
+ * Check the signature of \c pe_file and keep the subject/issuer names
+ * in the \c wintrust_x globals until the next call.
+ */
 DWORD wintrust_check (const char *pe_file, BOOL check_details, BOOL revoke_check)
+{
+  struct wintrust_info info;
+  DWORD  rc;
+
+  wintrust_cleanup();
+  rc = wintrust_check_r (pe_file, check_details, revoke_check, &info);
+  wintrust_signer_subject    = info.signer_subject;
+  wintrust_signer_issuer     = info.signer_issuer;
+  wintrust_timestamp_subject = info.timestamp_subject;
+  wintrust_timestamp_issuer  = info.timestamp_issuer;
+  return (rc);
+}
+
+/**
+ * Like \c wintrust_check(), but with no global state.
+ * Hence it can be called from the jobs in a \c task_pool.
+ * The caller must call \c wintrust_info_free() on \c info afterwards.
+ */
+DWORD wintrust_check_r (const char *pe_file, BOOL check_details, BOOL revoke_check,
+                        struct wintrust_info *info)
 {
   void              *p;
   DWORD              rc;
@@ -210,17 +240,16 @@ DWORD wintrust_check (const char *pe_file, BOOL check_details, BOOL revoke_check
                        WINTRUST_ACTION_TRUSTPROVIDER_TEST;
 #endif
 
-  wintrust_cleanup();
+  memset (info, '\0', sizeof(*info));
 
   if (!pe_file || !FILE_EXISTS(pe_file))
   {
-    SetLastError (last_err = ERROR_FILE_NOT_FOUND);
-    return (last_err);
+    SetLastError (ERROR_FILE_NOT_FOUND);
+    return (ERROR_FILE_NOT_FOUND);
   }
 
   memset (&data, 0, sizeof(data));
   memset (&file_info, 0, sizeof(file_info));
-  last_err = 0;
 
   file_info.cbStruct      = sizeof(file_info);
   file_info.pcwszFilePath = evil_char_to_wchar (pe_file);
@@ -234,7 +263,7 @@ DWORD wintrust_check (const char *pe_file, BOOL check_details, BOOL revoke_check
   data.fdwRevocationChecks = revoke_check ? WTD_REVOKE_WHOLECHAIN : WTD_REVOKE_NONE;
   data.dwProvFlags         = revoke_check ? WTD_REVOCATION_CHECK_CHAIN : 0;
 
-  rc = last_err = WinVerifyTrust (NULL, &action, &data);
+  rc = WinVerifyTrust (NULL, &action, &data);
 
   data.dwStateAction = WTD_STATEACTION_CLOSE;
   WinVerifyTrust (NULL, &action, &data);
@@ -245,7 +274,7 @@ DWORD wintrust_check (const char *pe_file, BOOL check_details, BOOL revoke_check
   if (check_details)
   {
     PRINTF ("\nDetails for crypt_check_file (\"%s\").\n", pe_file);
-    crypt_check_file (pe_file);
+    crypt_check_file (pe_file, info);
   }
   return (rc);
 }
@@ -528,7 +557,7 @@ quit:
   return (res);
 }
 
-static int crypt_check_file (const char *fname)
+static int crypt_check_file (const char *fname, struct wintrust_info *info)
 {
   wchar_t             file_name [_MAX_PATH];
   HCERTSTORE          h_store      = NULL;
@@ -620,7 +649,7 @@ static int crypt_check_file (const char *fname)
   /* Print Signer certificate information
    */
   PRINTF ("Signer Certificate:\n\n");
-  PrintCertificateInfo (cert_context, &wintrust_signer_subject, &wintrust_signer_issuer);
+  PrintCertificateInfo (cert_context, &info->signer_subject, &info->signer_issuer);
   NEWLINE();
 
   /* Get the timestamp certificate signerinfo structure
@@ -641,7 +670,7 @@ static int crypt_check_file (const char *fname)
     }
 
     PRINTF ("TimeStamp Certificate:\n\n");
-    PrintCertificateInfo (cert_context, &wintrust_timestamp_subject, &wintrust_timestamp_issuer);
+    PrintCertificateInfo (cert_context, &info->timestamp_subject, &info->timestamp_issuer);
 
     PRINTF ("\nTimeStamp: ");
     if (GetDateOfTimeStamp (counter_signer_info, &st))
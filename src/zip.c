@@ -0,0 +1,253 @@
+/**\file    zip.c
+ * \ingroup Envtool_PY
+ * \brief
+ *   A minimal reader for the central directory of ZIP-files (and
+ *   Python .EGG-files). No decompression is done here; only the list
+ *   of entries with their name, size and time-stamp is returned.
+ *
+ * The file is memory-mapped and the "End of Central Directory" record
+ * is located by scanning backwards from the end. ZIP64 archives are
+ * supported. Everything is reentrant; \c zip_list() can run on several
+ * worker-threads at once.
+ *
+ * Ref: https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+ */
+#include "envtool.h"
+#include "zip.h"
+
+#define ZIP_SIG_CENTRAL      0x02014B50  /* "PK\1\2" */
+#define ZIP_SIG_EOCD         0x06054B50  /* "PK\5\6" */
+#define ZIP_SIG_EOCD64       0x06064B50  /* "PK\6\6" */
+#define ZIP_SIG_EOCD64_LOC   0x07064B50  /* "PK\6\7" */
+
+#define ZIP_EOCD_SIZE        22
+#define ZIP_EOCD64_SIZE      56
+#define ZIP_EOCD64_LOC_SIZE  20
+#define ZIP_CENTRAL_SIZE     46
+#define ZIP_MAX_COMMENT      0xFFFF
+#define ZIP_EXTRA_ZIP64      0x0001
+
+/**\struct zip_dir
+ * The location of the central directory.
+ */
+struct zip_dir {
+       UINT64 offset;     /** start of central directory */
+       UINT64 size;       /** size of central directory */
+       UINT64 entries;    /** number of entries in it */
+     };
+
+static unsigned get_u16 (const BYTE *p)
+{
+  return (p[0] + (p[1] << 8));
+}
+
+static DWORD get_u32 (const BYTE *p)
+{
+  return (p[0] + (p[1] << 8) + (p[2] << 16) + ((DWORD)p[3] << 24));
+}
+
+static UINT64 get_u64 (const BYTE *p)
+{
+  return (get_u32(p) + ((UINT64)get_u32(p+4) << 32));
+}
+
+/**
+ * Convert a DOS date and time into a \c time_t.
+ * Like Python's \c zipfile module, the DOS time is assumed to be local time.
+ */
+static time_t dos_to_time_t (unsigned dos_date, unsigned dos_time)
+{
+  struct tm tm;
+
+  memset (&tm, '\0', sizeof(tm));
+  tm.tm_year  = ((dos_date >> 9) & 0x7F) + 80;
+  tm.tm_mon   = ((dos_date >> 5) & 0x0F) - 1;
+  tm.tm_mday  = dos_date & 0x1F;
+  tm.tm_hour  = (dos_time >> 11) & 0x1F;
+  tm.tm_min   = (dos_time >> 5) & 0x3F;
+  tm.tm_sec   = (dos_time & 0x1F) * 2;
+  tm.tm_isdst = -1;
+  return mktime (&tm);
+}
+
+/**
+ * Find the "End of Central Directory" record and fill \c zd.
+ * Handles ZIP64 archives and archives with data prepended
+ * (e.g. self-extracting archives).
+ */
+static BOOL zip_find_dir (const BYTE *data, UINT64 size, struct zip_dir *zd)
+{
+  const BYTE *p = NULL;
+  UINT64      pos, stop, eocd_pos, dir_end;
+
+  if (size < ZIP_EOCD_SIZE)
+     return (FALSE);
+
+  stop = (size > ZIP_EOCD_SIZE + ZIP_MAX_COMMENT) ? size - ZIP_EOCD_SIZE - ZIP_MAX_COMMENT : 0;
+
+  for (pos = size - ZIP_EOCD_SIZE + 1; pos-- > stop; )
+  {
+    const BYTE *q = data + pos;
+
+    if (q[0] == 'P' && q[1] == 'K' && get_u32(q) == ZIP_SIG_EOCD &&
+        pos + ZIP_EOCD_SIZE + get_u16(q+20) <= size)
+    {
+      p = q;
+      break;
+    }
+  }
+  if (!p)
+     return (FALSE);
+
+  eocd_pos    = pos;
+  zd->entries = get_u16 (p+10);
+  zd->size    = get_u32 (p+12);
+  zd->offset  = get_u32 (p+16);
+  dir_end     = eocd_pos;
+
+  /* A ZIP64 archive has a locator just before the EOCD record.
+   */
+  if (eocd_pos >= ZIP_EOCD64_LOC_SIZE &&
+      get_u32(p - ZIP_EOCD64_LOC_SIZE) == ZIP_SIG_EOCD64_LOC)
+  {
+    UINT64 eocd64_pos = get_u64 (p - ZIP_EOCD64_LOC_SIZE + 8);
+
+    /* 'eocd64_pos' is read from the file; check it without any overflow.
+     */
+    if (eocd64_pos <= eocd_pos && eocd_pos - eocd64_pos >= ZIP_EOCD64_SIZE &&
+        get_u32(data + eocd64_pos) == ZIP_SIG_EOCD64)
+    {
+      const BYTE *p64 = data + eocd64_pos;
+
+      zd->entries = get_u64 (p64+32);
+      zd->size    = get_u64 (p64+40);
+      zd->offset  = get_u64 (p64+48);
+      dir_end     = eocd64_pos;
+    }
+  }
+
+  if (zd->size > dir_end)
+     return (FALSE);
+
+  /* If something was prepended to the archive, all offsets are off by
+   * the size of that. Adjust for it.
+   */
+  if (zd->offset < dir_end - zd->size)
+     zd->offset = dir_end - zd->size;
+  return (zd->offset <= size && zd->size <= size - zd->offset);
+}
+
+/**
+ * Pick the 64-bit values from a ZIP64 "extra field" for those
+ * fields in the central header that were set to 0xFFFFFFFF.
+ */
+static void zip_get_extra64 (const BYTE *extra, unsigned len, struct zip_entry *ze,
+                             BOOL need_size, BOOL need_csize, BOOL need_ofs)
+{
+  const BYTE *end = extra + len;
+
+  while (extra + 4 <= end)
+  {
+    unsigned    id    = get_u16 (extra);
+    unsigned    e_len = get_u16 (extra+2);
+    const BYTE *val   = extra + 4;
+    const BYTE *e_end = val + e_len;
+
+    if (e_end > end)
+       break;
+
+    if (id == ZIP_EXTRA_ZIP64)
+    {
+      if (need_size && val + 8 <= e_end)
+      {
+        ze->size = get_u64 (val);
+        val += 8;
+      }
+      if (need_csize && val + 8 <= e_end)
+      {
+        ze->csize = get_u64 (val);
+        val += 8;
+      }
+      if (need_ofs && val + 8 <= e_end)
+         ze->local_ofs = get_u64 (val);
+      break;
+    }
+    extra = e_end;
+  }
+}
+
+/**
+ * Walk the central directory of \c zfile and call \c callback for
+ * each entry.
+ *
+ * \param[in] zfile     the ZIP-file to list.
+ * \param[in] callback  the function to call for each entry.
+ * \param[in] arg       passed on to the \c callback.
+ *
+ * \retval -1   \c zfile could not be mapped or is not a valid ZIP-file.
+ *              \c GetLastError() tells why.
+ * \retval >=0  the number of entries passed to \c callback.
+ */
+int zip_list (const char *zfile, zip_callback callback, void *arg)
+{
+  struct mapped_file mf;
+  struct zip_dir     zd;
+  const BYTE        *p, *end;
+  UINT64             i;
+  int                num = 0;
+
+  if (!map_file(zfile, &mf))
+     return (-1);
+
+  if (!zip_find_dir(mf.data, mf.size, &zd))
+  {
+    unmap_file (&mf);
+    SetLastError (ERROR_BAD_FORMAT);
+    return (-1);
+  }
+
+  p   = mf.data + zd.offset;
+  end = p + zd.size;
+
+  for (i = 0; i < zd.entries && p + ZIP_CENTRAL_SIZE <= end; i++)
+  {
+    struct zip_entry ze;
+    unsigned name_len, extra_len, comment_len;
+    DWORD    csize, size, ofs;
+
+    if (get_u32(p) != ZIP_SIG_CENTRAL)
+       break;
+
+    name_len    = get_u16 (p+28);
+    extra_len   = get_u16 (p+30);
+    comment_len = get_u16 (p+32);
+    if (p + ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len > end)
+       break;
+
+    csize = get_u32 (p+20);
+    size  = get_u32 (p+24);
+    ofs   = get_u32 (p+42);
+
+    ze.name      = (const char*) (p + ZIP_CENTRAL_SIZE);
+    ze.name_len  = name_len;
+    ze.method    = get_u16 (p+10);
+    ze.mtime     = dos_to_time_t (get_u16(p+14), get_u16(p+12));
+    ze.csize     = csize;
+    ze.size      = size;
+    ze.local_ofs = ofs;
+    ze.is_dir    = (name_len > 0 && ze.name[name_len-1] == '/');
+
+    if (csize == 0xFFFFFFFF || size == 0xFFFFFFFF || ofs == 0xFFFFFFFF)
+       zip_get_extra64 (p + ZIP_CENTRAL_SIZE + name_len, extra_len, &ze,
+                        size == 0xFFFFFFFF, csize == 0xFFFFFFFF, ofs == 0xFFFFFFFF);
+
+    num++;
+    if ((*callback) (&ze, arg) < 0)
+       break;
+
+    p += ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len;
+  }
+
+  unmap_file (&mf);
+  return (num);
+}
@@ -0,0 +1,27 @@
+/** \file zip.h
+ */
+#ifndef _ZIP_H
+#define _ZIP_H
+
+/**\struct zip_entry
+ * One entry in the central directory of a ZIP-file.
+ */
+struct zip_entry {
+       const char *name;        /** the name; \b not 0-terminated. Points into the mapped archive */
+       size_t      name_len;    /** the length of \c name */
+       UINT64      size;        /** uncompressed size */
+       UINT64      csize;       /** compressed size */
+       UINT64      local_ofs;   /** offset of the local header */
+       unsigned    method;      /** compression method; 0 = stored, 8 = deflated */
+       time_t      mtime;       /** the modification time (local time) */
+       BOOL        is_dir;      /** name ends in a '/' */
+     };
+
+/**
+ * The callback for \c zip_list(). Return < 0 to stop the enumeration.
+ */
+typedef int (*zip_callback) (const struct zip_entry *ze, void *arg);
+
+extern int zip_list (const char *zfile, zip_callback callback, void *arg);
+
+#endif /* _ZIP_H */